@@ -33,7 +33,8 @@ int AlignRGMatches(RGMatches *m,
 		int32_t pairedEndLength,
 		int32_t mirroringType,
 		int32_t forceMirroring,
-		AlignMatrix *matrix)
+		AlignMatrix *matrix,
+		BCounters *counters)
 {
 	double bestScore;
 	int32_t i;
@@ -72,7 +73,8 @@ int AlignRGMatches(RGMatches *m,
 				bestOnly,
 				&bestScore,
 				&numAligned,
-				matrix);
+				matrix,
+				counters);
 		if(BestOnly == bestOnly) {
 			numLocalAlignments += AlignRGMatchesKeepBestScore(&a->ends[i],
 					bestScore);
@@ -96,7 +98,8 @@ void AlignRGMatchesOneEnd(RGMatch *m,
 		int32_t bestOnly,
 		double *bestScore,
 		int32_t *numAligned,
-		AlignMatrix *matrix)
+		AlignMatrix *matrix,
+		BCounters *counters)
 {
 	char *FnName="AlignRGMatchOneEnd";
 	int32_t i;
@@ -258,7 +261,7 @@ void AlignRGMatchesOneEnd(RGMatch *m,
 							readEndInsertionLengths[ctr] + 1));
 			}
 			/* Copy over mask */
-			masks[ctr] = RGMatchMaskToString(m->masks[i], m->readLength);
+			masks[ctr] = RGMatchMaskToString(GETMASK(m, i), m->readLength);
 			/* Update contig name and strand */
 			end->entries[ctr].contig = m->contigs[i];
 			end->entries[ctr].strand = m->strands[i];
@@ -323,6 +326,9 @@ void AlignRGMatchesOneEnd(RGMatch *m,
 					end->entries[i].strand)) {
 			foundExact=1;
 			numberFound++;
+			if(NULL != counters) {
+				counters->counts[CounterExactAlignments]++;
+			}
 			if((*bestScore) < end->entries[i].score) {
 				(*bestScore) = end->entries[i].score;
 			}
@@ -358,6 +364,9 @@ void AlignRGMatchesOneEnd(RGMatch *m,
 			for(i=0;i<end->numEntries;i++) {
 				if(readLength <= referenceLengths[i] &&
 						!(NEGATIVE_INFINITY < end->entries[i].score)) { // If we did not find an exact match
+					if(NULL != counters) {
+						counters->counts[CounterUngappedAlignments]++;
+					}
 					numberFound += AlignUngapped(read,
 							colors,
 							masks[i],
@@ -426,6 +435,9 @@ void AlignRGMatchesOneEnd(RGMatch *m,
 
 	/* Run Gapped */
 	for(i=0;i<end->numEntries;i++) {
+		if(NULL != counters) {
+			counters->counts[CounterGappedAlignments]++;
+		}
 		AlignGapped(read,
 				colors,
 				masks[i],
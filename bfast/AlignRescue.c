@@ -0,0 +1,343 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+#include "BLibDefinitions.h"
+#include "BError.h"
+#include "BLib.h"
+#include "RGBinary.h"
+#include "RGMatch.h"
+#include "AlignRescue.h"
+
+#define RESCUE_ODD_BITS 0x5555555555555555ULL
+
+/* Counts the bits set in a word that only has bits on even positions */
+static inline int32_t AlignRescuePopCount(uint64_t x)
+{
+	x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+	x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+	return (int32_t)((x * 0x0101010101010101ULL) >> 56);
+}
+
+/* Gets the RESCUE_BASES_PER_WORD bases starting at the given base from a
+ * packed sequence.  The packed sequence must have one word of padding. */
+static inline uint64_t AlignRescueGetWord(uint64_t *packed, int32_t position)
+{
+	int32_t word = position / RESCUE_BASES_PER_WORD;
+	int32_t shift = 2*(position % RESCUE_BASES_PER_WORD);
+	if(0 == shift) {
+		return packed[word];
+	}
+	return (packed[word] >> shift) | (packed[word+1] << (64 - shift));
+}
+
+/* TODO */
+/* Mate rescue: if one end of a pair has CALs and the other has none, scan
+ * the window implied by the insert size around each CAL of the anchored end
+ * for the unanchored end using a 2-bit ungapped filter.  The best hits are
+ * added as CALs for the unanchored end so that they go through the usual
+ * local alignment.  Returns the number of ends rescued.
+ * */
+int32_t AlignRescueMates(RGMatches *m,
+		RGBinary *rg,
+		int32_t space,
+		double insertSizeAvg,
+		double insertSizeStdDev,
+		double numStdDev,
+		int32_t numHits,
+		int64_t *numWindows)
+{
+	char *FnName="AlignRescueMates";
+	RGMatch *anchor=NULL, *mate=NULL;
+	char read[SEQUENCE_LENGTH]="\0";
+	char reverseCompliment[SEQUENCE_LENGTH]="\0";
+	uint64_t readBits[2][SEQUENCE_LENGTH/RESCUE_BASES_PER_WORD+1];
+	uint64_t readUnknown[2][SEQUENCE_LENGTH/RESCUE_BASES_PER_WORD+1];
+	uint64_t *referenceBits=NULL, *referenceUnknown=NULL;
+	int32_t referenceNumWords, maxReferenceNumWords=0;
+	char *reference=NULL;
+	int32_t readLength, numWords, lastBases, maxNumMismatches;
+	uint64_t lastMask;
+	int32_t minDistance, maxDistance, maxPosition;
+	int32_t starts[2], ends[2], numSides;
+	int32_t i, j, k, s, numFound=0, bound;
+	AlignRescueHit *hits=NULL, hit;
+	const char strands[2] = {FORWARD, REVERSE};
+
+	if(2 != m->numEnds) {
+		return 0;
+	}
+	for(i=0;i<2;i++) {
+		if(0 <= m->ends[i].maxReached && 0 < m->ends[i].numEntries &&
+				0 <= m->ends[1-i].maxReached && 0 == m->ends[1-i].numEntries) {
+			anchor = &m->ends[i];
+			mate = &m->ends[1-i];
+			break;
+		}
+	}
+	if(NULL == anchor || mate->readLength <= 0 || SEQUENCE_LENGTH <= mate->readLength) {
+		return 0;
+	}
+
+	/* Get the bases of the mate in both orientations */
+	strcpy(read, mate->read);
+	readLength = mate->readLength;
+	if(ColorSpace == space) {
+		readLength = ConvertReadFromColorSpace(read, readLength);
+	}
+	if(readLength <= 0) {
+		return 0;
+	}
+	GetReverseComplimentAnyCase(read, reverseCompliment, readLength);
+	AlignRescuePack(read, readLength, readBits[0], readUnknown[0]);
+	AlignRescuePack(reverseCompliment, readLength, readBits[1], readUnknown[1]);
+	numWords = (readLength + RESCUE_BASES_PER_WORD - 1) / RESCUE_BASES_PER_WORD;
+	lastBases = readLength - (numWords - 1)*RESCUE_BASES_PER_WORD;
+	lastMask = (RESCUE_BASES_PER_WORD == lastBases) ? RESCUE_ODD_BITS : (RESCUE_ODD_BITS & ((((uint64_t)1) << (2*lastBases)) - 1));
+	maxNumMismatches = (int32_t)(RESCUE_MAX_MISMATCH_FRACTION*readLength);
+
+	minDistance = (int32_t)floor(insertSizeAvg - numStdDev*insertSizeStdDev);
+	maxDistance = (int32_t)ceil(insertSizeAvg + numStdDev*insertSizeStdDev);
+
+	hits = malloc(sizeof(AlignRescueHit)*numHits);
+	if(NULL == hits) {
+		PrintError(FnName, "hits", "Could not allocate memory", Exit, MallocMemory);
+	}
+
+	for(i=0;i<anchor->numEntries;i++) {
+		if(anchor->contigs[i] < 1 || rg->numContigs < anchor->contigs[i]) {
+			continue;
+		}
+		maxPosition = rg->contigs[anchor->contigs[i]-1].sequenceLength - readLength + 1;
+
+		/* The mate may be on either side of the anchor */
+		starts[0] = anchor->positions[i] + minDistance;
+		ends[0] = anchor->positions[i] + maxDistance;
+		starts[1] = anchor->positions[i] - maxDistance;
+		ends[1] = anchor->positions[i] - minDistance;
+		numSides = 2;
+		if(starts[0] - 1 <= ends[1]) {
+			starts[0] = GETMIN(starts[0], starts[1]);
+			ends[0] = GETMAX(ends[0], ends[1]);
+			numSides = 1;
+		}
+
+		for(s=0;s<numSides;s++) {
+			int32_t start = GETMAX(1, starts[s]);
+			int32_t end = GETMIN(maxPosition, ends[s]);
+			int32_t referenceLength = end - start + readLength;
+			if(end < start) {
+				continue;
+			}
+
+			/* Get and pack the forward strand of the window */
+			reference=NULL;
+			if(0 == RGBinaryGetSequence(rg, anchor->contigs[i], start, FORWARD, &reference, referenceLength)) {
+				continue;
+			}
+			referenceNumWords = (referenceLength + RESCUE_BASES_PER_WORD - 1) / RESCUE_BASES_PER_WORD + 1;
+			if(maxReferenceNumWords < referenceNumWords) {
+				maxReferenceNumWords = referenceNumWords;
+				referenceBits = realloc(referenceBits, sizeof(uint64_t)*maxReferenceNumWords);
+				if(NULL == referenceBits) {
+					PrintError(FnName, "referenceBits", "Could not reallocate memory", Exit, ReallocMemory);
+				}
+				referenceUnknown = realloc(referenceUnknown, sizeof(uint64_t)*maxReferenceNumWords);
+				if(NULL == referenceUnknown) {
+					PrintError(FnName, "referenceUnknown", "Could not reallocate memory", Exit, ReallocMemory);
+				}
+			}
+			AlignRescuePack(reference, referenceLength, referenceBits, referenceUnknown);
+			referenceBits[referenceNumWords-1] = referenceUnknown[referenceNumWords-1] = 0;
+			(*numWindows)++;
+
+			for(j=0;j<=end-start;j++) {
+				for(k=0;k<2;k++) {
+					bound = (numFound < numHits) ? maxNumMismatches : hits[numHits-1].numMismatches - 1;
+					hit.numMismatches = AlignRescueCountMismatches(readBits[k],
+							readUnknown[k],
+							numWords,
+							lastMask,
+							referenceBits,
+							referenceUnknown,
+							j,
+							bound);
+					if(bound < hit.numMismatches) {
+						continue;
+					}
+					hit.contig = anchor->contigs[i];
+					hit.position = start + j;
+					hit.strand = strands[k];
+					hit.maskStart = 0;
+					hit.maskLength = 0;
+					if(NTSpace == space) {
+						/* The constrained alignment needs an exact seed */
+						hit.maskLength = AlignRescueGetMask(read, readLength, reference + j, hit.strand, &hit.maskStart);
+						if(hit.maskLength < RESCUE_MIN_MASK_LENGTH) {
+							continue;
+						}
+					}
+					numFound = AlignRescueAddHit(hits, numFound, numHits, &hit);
+				}
+			}
+			free(reference);
+			reference=NULL;
+		}
+	}
+	free(referenceBits);
+	free(referenceUnknown);
+
+	if(0 < numFound) {
+		RGMatchReallocate(mate, numFound);
+		for(i=0;i<numFound;i++) {
+			mate->contigs[i] = hits[i].contig;
+			mate->positions[i] = hits[i].position;
+			mate->strands[i] = hits[i].strand;
+			/* An empty mask in color space makes the aligner fall back
+			 * to a bounded alignment */
+			for(j=hits[i].maskStart;j<hits[i].maskStart+hits[i].maskLength;j++) {
+				RGMatchUpdateMask(GETMASK(mate, i), j);
+			}
+		}
+		RGMatchRemoveDuplicates(mate, numHits);
+	}
+	free(hits);
+
+	return (0 < numFound) ? 1 : 0;
+}
+
+/* TODO */
+/* Packs bases two bits at a time, RESCUE_BASES_PER_WORD bases per word.  Any
+ * base that is not A, C, G, or T has both of its bits set in unknown. */
+void AlignRescuePack(char *seq,
+		int32_t length,
+		uint64_t *bits,
+		uint64_t *unknown)
+{
+	int32_t i, numWords;
+	uint64_t base;
+
+	numWords = (length + RESCUE_BASES_PER_WORD - 1) / RESCUE_BASES_PER_WORD;
+	memset(bits, 0, sizeof(uint64_t)*numWords);
+	memset(unknown, 0, sizeof(uint64_t)*numWords);
+	for(i=0;i<length;i++) {
+		switch(seq[i]) {
+			case 'a':
+			case 'A':
+				base = 0; break;
+			case 'c':
+			case 'C':
+				base = 1; break;
+			case 'g':
+			case 'G':
+				base = 2; break;
+			case 't':
+			case 'T':
+				base = 3; break;
+			default:
+				base = 0;
+				unknown[i/RESCUE_BASES_PER_WORD] |= ((uint64_t)3) << (2*(i%RESCUE_BASES_PER_WORD));
+				break;
+		}
+		bits[i/RESCUE_BASES_PER_WORD] |= base << (2*(i%RESCUE_BASES_PER_WORD));
+	}
+}
+
+/* TODO */
+/* Counts the mismatches between the packed read and the packed reference
+ * starting at the given base, RESCUE_BASES_PER_WORD bases at a time.  Stops
+ * early once the count exceeds bound.  Unknown bases always mismatch. */
+int32_t AlignRescueCountMismatches(uint64_t *readBits,
+		uint64_t *readUnknown,
+		int32_t numWords,
+		uint64_t lastMask,
+		uint64_t *referenceBits,
+		uint64_t *referenceUnknown,
+		int32_t position,
+		int32_t bound)
+{
+	int32_t i, numMismatches=0;
+	uint64_t x;
+
+	for(i=0;i<numWords && numMismatches <= bound;i++) {
+		int32_t cur = position + i*RESCUE_BASES_PER_WORD;
+		x = readBits[i] ^ AlignRescueGetWord(referenceBits, cur);
+		/* Fold each 2-bit difference onto its low bit */
+		x = (x | (x >> 1) | readUnknown[i] | AlignRescueGetWord(referenceUnknown, cur)) & RESCUE_ODD_BITS;
+		if(i == numWords - 1) {
+			x &= lastMask;
+		}
+		numMismatches += AlignRescuePopCount(x);
+	}
+	return numMismatches;
+}
+
+/* TODO */
+/* Finds the longest run of exact matches between the read and the reference
+ * on the given strand, where reference points to the forward strand at the
+ * hit.  The run is in read coordinates, as the constrained alignment
+ * expects. */
+int32_t AlignRescueGetMask(char *read,
+		int32_t readLength,
+		char *reference,
+		char strand,
+		int32_t *maskStart)
+{
+	int32_t i, curLength=0, bestLength=0;
+	char readBase, referenceBase;
+
+	(*maskStart) = 0;
+	for(i=0;i<readLength;i++) {
+		readBase = ToLower(read[i]);
+		if(FORWARD == strand) {
+			referenceBase = ToLower(reference[i]);
+		}
+		else {
+			referenceBase = ToLower(GetReverseComplimentAnyCaseBase(reference[readLength-1-i]));
+		}
+		if(readBase == referenceBase &&
+				('a' == readBase || 'c' == readBase || 'g' == readBase || 't' == readBase)) {
+			curLength++;
+			if(bestLength < curLength) {
+				bestLength = curLength;
+				(*maskStart) = i - curLength + 1;
+			}
+		}
+		else {
+			curLength = 0;
+		}
+	}
+	return bestLength;
+}
+
+/* TODO */
+/* Adds the hit to the list, kept sorted by the number of mismatches, keeping
+ * at most numHits.  Returns the new number of hits. */
+int32_t AlignRescueAddHit(AlignRescueHit *hits,
+		int32_t numFound,
+		int32_t numHits,
+		AlignRescueHit *hit)
+{
+	int32_t i;
+
+	/* The windows of nearby anchors can overlap */
+	for(i=0;i<numFound;i++) {
+		if(hits[i].contig == hit->contig &&
+				hits[i].position == hit->position &&
+				hits[i].strand == hit->strand) {
+			return numFound;
+		}
+	}
+	if(numFound == numHits) {
+		if(hits[numHits-1].numMismatches <= hit->numMismatches) {
+			return numFound;
+		}
+		numFound--;
+	}
+	for(i=numFound;0 < i && hit->numMismatches < hits[i-1].numMismatches;i--) {
+		hits[i] = hits[i-1];
+	}
+	hits[i] = (*hit);
+	return numFound+1;
+}
@@ -0,0 +1,21 @@
+#ifndef ALIGNRESCUE_H_
+#define ALIGNRESCUE_H_
+#include "BLibDefinitions.h"
+
+/* A candidate placement of the unanchored mate */
+typedef struct {
+	int32_t numMismatches;
+	uint32_t contig;
+	int32_t position;
+	char strand;
+	int32_t maskStart; /* longest exact run, in read coordinates */
+	int32_t maskLength;
+} AlignRescueHit;
+
+int32_t AlignRescueMates(RGMatches*, RGBinary*, int32_t, double, double, double, int32_t, int64_t*);
+void AlignRescuePack(char*, int32_t, uint64_t*, uint64_t*);
+int32_t AlignRescueCountMismatches(uint64_t*, uint64_t*, int32_t, uint64_t, uint64_t*, uint64_t*, int32_t, int32_t);
+int32_t AlignRescueGetMask(char*, int32_t, char*, char, int32_t*);
+int32_t AlignRescueAddHit(AlignRescueHit*, int32_t, int32_t, AlignRescueHit*);
+
+#endif
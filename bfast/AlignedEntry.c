@@ -396,6 +396,17 @@ void AlignedEntryCopy(AlignedEntry *dest, AlignedEntry *src)
 	}
 }
 
+/* TODO */
+/* Moves the alignment without copying it, leaving the source empty */
+void AlignedEntryMove(AlignedEntry *dest, AlignedEntry *src)
+{
+	if(src != dest) {
+		free(dest->alnRead);
+		(*dest) = (*src);
+		AlignedEntryInitialize(src);
+	}
+}
+
 void AlignedEntryFree(AlignedEntry *a)
 {
 	free(a->alnRead);
@@ -18,6 +18,7 @@ int32_t AlignedEntryCompare(AlignedEntry*, AlignedEntry*, int32_t);
 int32_t AlignedEntryGetOneRead(AlignedEntry**, FILE*);
 int32_t AlignedEntryGetAll(AlignedEntry**, FILE*);
 void AlignedEntryCopy(AlignedEntry*, AlignedEntry*);
+void AlignedEntryMove(AlignedEntry*, AlignedEntry*);
 void AlignedEntryFree(AlignedEntry*);
 void AlignedEntryInitialize(AlignedEntry*);
 void AlignedEntryCheckReference(AlignedEntry*, RGBinary*, int32_t);
@@ -19,7 +19,8 @@
 void AlignedReadConvertPrintHeader(FILE *fp,
 		RGBinary *rg,
 		int32_t outputFormat,
-		char *readGroup
+		char *readGroup,
+		int sorted
 		) 
 {
 	char *FnName = "AlignedReadConvertPrintHeader";
@@ -31,8 +32,9 @@ void AlignedReadConvertPrintHeader(FILE *fp,
 			break;
 		case SAM:
 			/* Header */
-			if(0>fprintf(fp, "@HD\tVN:%s\tSO:unsorted\tGO:none\n",
-						BFAST_SAM_VERSION)) {
+			if(0>fprintf(fp, "@HD\tVN:%s\tSO:%s\tGO:none\n",
+						BFAST_SAM_VERSION,
+						(1 == sorted) ? "coordinate" : "unsorted")) {
 				PrintError(FnName, "header", "Could not write to file", Exit, WriteFileError);
 			}
 			/* Sequence dictionary */
@@ -9,7 +9,7 @@
 #include "AlignedEntry.h"
 #include "BError.h"
 
-void AlignedReadConvertPrintHeader(FILE*, RGBinary*, int, char*);
+void AlignedReadConvertPrintHeader(FILE*, RGBinary*, int, char*, int);
 void AlignedReadConvertPrintOutputFormat(AlignedRead*, RGBinary*, FILE*, gzFile, char*, char*, int, int*, int, int, int, int);
 void AlignedReadConvertPrintSAM(AlignedRead*, RGBinary*, int32_t, int32_t*, char*, char*, int, int, FILE*);
 void AlignedReadConvertPrintAlignedEntryToSAM(AlignedRead*, RGBinary*, int32_t, int32_t, int32_t, int32_t*, char*, char*, int, int, FILE*);
@@ -7,6 +7,7 @@
 #include <ctype.h>
 #include <zlib.h>
 #include <limits.h>
+#include <time.h>
 
 #include "BLibDefinitions.h"
 #include "RGIndex.h"
@@ -530,12 +531,34 @@ void CloseTmpFile(FILE **fp,
 }
 
 /* TODO */
+/* The temporary files are written once and read back once, so the
+ * compression level is configurable.  Reading does not need to know the
+ * level: gzread recognizes the gzip header and passes through files
+ * without one.
+ * */
 gzFile OpenTmpGZFile(char *tmpDir,
-		char **tmpFileName)
+		char **tmpFileName,
+		int32_t tmpCompression)
 {
 	char *FnName = "OpenTmpGZFile";
 	int fd;
 	gzFile fp = NULL;
+	char *mode=NULL;
+
+	switch(tmpCompression) {
+		case TmpCompressionNone:
+			/* Write without a gzip header if supported, otherwise store */
+			mode = ZLIB_VERNUM >= 0x1252 ? "abT" : (ZLIB_VERNUM >= 0x1250 ? "ab0" : "wb0+");
+			break;
+		case TmpCompressionFast:
+			mode = ZLIB_VERNUM >= 0x1250 ? "ab1" : "wb1+";
+			break;
+		case TmpCompressionDefault:
+			mode = ZLIB_VERNUM >= 0x1250 ? "ab" : "wb+";
+			break;
+		default:
+			PrintError(FnName, "tmpCompression", "Could not understand the temporary file compression", Exit, OutOfRange);
+	}
 
 	/* Allocate memory */
 	(*tmpFileName) = malloc(sizeof(char)*MAX_FILENAME_LENGTH);
@@ -550,7 +573,7 @@ gzFile OpenTmpGZFile(char *tmpDir,
 	strcat((*tmpFileName), BFAST_TMP_TEMPLATE);
 
 	if(-1 == (fd = mkstemp((*tmpFileName))) ||
-			NULL == (fp = gzdopen(fd, ZLIB_VERNUM >= 0x1250 ? "ab" : "wb+"))) {
+			NULL == (fp = gzdopen(fd, mode))) {
 
 		/* Check if the fd was open */ 
 		if(-1 != fd) {
@@ -1027,7 +1050,8 @@ void ConvertReadToColorSpace(char **read,
 
 	assert(0 < (*readLength));
 
-	tempRead = malloc(sizeof(char)*(1 + (*readLength)));
+	/* The adaptor adds one character */
+	tempRead = malloc(sizeof(char)*(2 + (*readLength)));
 	if(NULL == tempRead) {
 		PrintError(FnName, "tempRead", "Could not allocate memory", Exit, MallocMemory);
 	}
@@ -1709,6 +1733,45 @@ char *GetBRGFileName(char *fastaFileName, int32_t space)
 	return rgFileName;
 }
 
+char *GetBRGMMapFileName(char *fastaFileName, int32_t space)
+{
+	char *FnName="GetBRGMMapFileName";
+	char *rgFileName=NULL;
+	assert(NTSpace == space || ColorSpace == space);
+
+	rgFileName=malloc(sizeof(char)*MAX_FILENAME_LENGTH);
+	if(NULL == rgFileName) {
+		PrintError(FnName, "rgFileName", "Could not allocate memory", Exit, MallocMemory);
+	}
+
+	sprintf(rgFileName, "%s.%s.%s",
+			fastaFileName,
+			SPACENAME(space),
+			BFAST_RG_MMAP_FILE_EXTENSION);
+
+	return rgFileName;
+}
+
+char *GetBloomFileName(char *fastaFileName, int32_t space, int32_t indexNumber)
+{
+	char *FnName="GetBloomFileName";
+	char *bloomFileName=NULL;
+	assert(NTSpace == space || ColorSpace == space);
+
+	bloomFileName=malloc(sizeof(char)*MAX_FILENAME_LENGTH);
+	if(NULL == bloomFileName) {
+		PrintError(FnName, "bloomFileName", "Could not allocate memory", Exit, MallocMemory);
+	}
+
+	sprintf(bloomFileName, "%s.%s.%d.%s",
+			fastaFileName,
+			SPACENAME(space),
+			indexNumber,
+			BFAST_BLOOM_FILE_EXTENSION);
+
+	return bloomFileName;
+}
+
 char *GetBIFName(char *fastaFileName, 
 		int32_t space,
 		int32_t depthNumber,
@@ -1948,3 +2011,94 @@ char *ParseReadGroup(char *readGroup)
 
 	return readGroupString;
 }
+
+/* TODO */
+/* A monotonic clock, in nanoseconds */
+int64_t BTimeNow()
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return ((int64_t)t.tv_sec)*1000000000 + t.tv_nsec;
+}
+
+/* TODO */
+void BTimeSplit(int64_t nanoseconds, int *hours, int *minutes, double *seconds)
+{
+	int64_t s = nanoseconds / 1000000000;
+
+	(*hours) = (int)(s / 3600);
+	(*minutes) = (int)((s % 3600) / 60);
+	(*seconds) = (s % 60) + (nanoseconds % 1000000000) / 1000000000.0;
+}
+
+/* TODO */
+void BCountersInitialize(BCounters *counters, int32_t numCounters)
+{
+	int32_t i, j;
+
+	for(i=0;i<numCounters;i++) {
+		for(j=0;j<NumCounters;j++) {
+			counters[i].counts[j] = 0;
+		}
+	}
+}
+
+/* TODO */
+/* Prints the timing summary as one line of JSON.  There are numThreads + 1
+ * counters, the last being for the main thread, which reads and writes. */
+void BCountersPrintJSON(FILE *fp,
+		char *command,
+		int64_t wallTime,
+		char **stageNames,
+		int64_t *stageTimes,
+		int32_t numStages,
+		BCounters *counters,
+		int32_t numThreads)
+{
+	char *names[NumCounters] = {"reads", "indexLookups", "keysSkipped", "CALs", 
+		"exactAlignments", "ungappedAlignments", "gappedAlignments", "readsRejected",
+		"bytesRead", "bytesWritten", "computeTime", "ioTime", "waitTime"};
+	BCounters totals;
+	int32_t i, j;
+
+	BCountersInitialize(&totals, 1);
+	for(i=0;i<=numThreads && NULL != counters;i++) {
+		for(j=0;j<NumCounters;j++) {
+			totals.counts[j] += counters[i].counts[j];
+		}
+	}
+
+	fprintf(fp, "{\"command\":\"%s\",\"wallTime\":%.9lf,\"stages\":{", command, wallTime/1000000000.0);
+	for(i=0;i<numStages;i++) {
+		fprintf(fp, "%s\"%s\":%.9lf", (0 == i) ? "" : ",", stageNames[i], stageTimes[i]/1000000000.0);
+	}
+	fprintf(fp, "},\"totals\":{");
+	for(j=0;j<NumCounters;j++) {
+		if(CounterComputeTime <= j) {
+			fprintf(fp, "%s\"%s\":%.9lf", (0 == j) ? "" : ",", names[j], totals.counts[j]/1000000000.0);
+		}
+		else {
+			fprintf(fp, "%s\"%s\":%lld", (0 == j) ? "" : ",", names[j], (long long int)totals.counts[j]);
+		}
+	}
+	fprintf(fp, "},\"threads\":[");
+	for(i=0;i<=numThreads && NULL != counters;i++) {
+		if(i < numThreads) {
+			fprintf(fp, "%s{\"thread\":%d", (0 == i) ? "" : ",", i);
+		}
+		else {
+			fprintf(fp, "%s{\"thread\":\"main\"", (0 == i) ? "" : ",");
+		}
+		for(j=0;j<NumCounters;j++) {
+			if(CounterComputeTime <= j) {
+				fprintf(fp, ",\"%s\":%.9lf", names[j], counters[i].counts[j]/1000000000.0);
+			}
+			else {
+				fprintf(fp, ",\"%s\":%lld", names[j], (long long int)counters[i].counts[j]);
+			}
+		}
+		fprintf(fp, "}");
+	}
+	fprintf(fp, "]}\n");
+}
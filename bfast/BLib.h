@@ -30,7 +30,7 @@ char TransformFromIUPAC(char);
 void CheckRGIndexes(char**, int, char**, int, int32_t*, int32_t*, int32_t*, int32_t*, int32_t);
 FILE *OpenTmpFile(char*, char**);
 void CloseTmpFile(FILE **, char**);
-gzFile OpenTmpGZFile(char*, char**);
+gzFile OpenTmpGZFile(char*, char**, int32_t);
 void CloseTmpGZFile(gzFile*, char**, int32_t);
 void ReopenTmpGZFile(gzFile*, char**);
 void PrintPercentCompleteShort(double);
@@ -77,6 +77,8 @@ double AddLog10(double, double);
 int64_t gzwrite64(gzFile, void*, int64_t);
 int64_t gzread64(gzFile, void*, int64_t);
 char *GetBRGFileName(char*, int32_t);
+char *GetBRGMMapFileName(char*, int32_t);
+char *GetBloomFileName(char*, int32_t, int32_t);
 char *GetBIFName(char*, int32_t, int32_t, int32_t);
 int32_t FileExists(char*);
 int32_t GetBIFMaximumBin(char*, int32_t);
@@ -86,5 +88,9 @@ char *strtok_r(char *s1, const char *s2, char **lasts);
 #endif
 char *ReadInReadGroup(char *);
 char *ParseReadGroup(char*);
+int64_t BTimeNow();
+void BTimeSplit(int64_t, int*, int*, double*);
+void BCountersInitialize(BCounters*, int32_t);
+void BCountersPrintJSON(FILE*, char*, int64_t, char**, int64_t*, int32_t, BCounters*, int32_t);
 
 #endif
@@ -21,7 +21,6 @@
 #define MAX_FASTA_LINE_LENGTH 2048
 #define MAXIMUM_MAPPING_QUALITY 255
 #define ONE_GIGABYTE (int64_t)1073741824
-#define MERGE_MEMORY_LIMIT 12*((int64_t)1073741824) /* In Gigabytes */
 #define RGINDEXLAYOUT_MAX_HASH_WIDTH 18
 #define READS_BUFFER_LENGTH 40000
 #define BFAST_MATCH_THREAD_SLEEP 1
@@ -39,8 +38,13 @@ extern int32_t VERBOSE;
 /* Sorting */
 #define SHELL_SORT_GAP_DIVIDE_BY 2.2
 #define RGINDEX_SHELL_SORT_MAX 50
-#define RGINDEX_MERGE_BUFFER_LENGTH 1048576
-#define RGMATCH_SHELL_SORT_MAX 50
+#define RGINDEX_MERGE_BUFFER_LENGTH 1048576 /* largest run buffer, in entries */
+#define RGINDEX_MERGE_MIN_BUFFER_LENGTH 65536 /* smallest run buffer, in entries */
+#define RGINDEX_MERGE_MIN_THREAD_LENGTH 65536 /* entries merged per thread */
+#define RGINDEX_MERGE_ALIGNMENT 4096
+#define BFAST_CACHE_LINE_SIZE 64
+#define RGMATCH_INSERTION_SORT_MAX 32
+#define RGMATCH_RADIX_BITS 8
 #define ALIGNEDENTRY_SHELL_SORT_MAX 50
 #define RGRANGES_SHELL_SORT_MAX 50
 #define RGREADS_SHELL_SORT_MAX 50
@@ -65,6 +69,8 @@ enum {BRG, BIF, BMF, BAF, SAM, LastFileType};
 
 /* File extensions */
 #define BFAST_RG_FILE_EXTENSION "brg"
+#define BFAST_RG_MMAP_FILE_EXTENSION "mbrg"
+#define BFAST_BLOOM_FILE_EXTENSION "bbf"
 #define BFAST_INDEX_FILE_EXTENSION "bif"
 #define BFAST_MATCHES_FILE_EXTENSION "bmf"
 #define BFAST_MATCHES_READS_FILTERED_FILE_EXTENSION "fastq"
@@ -81,6 +87,7 @@ enum {BRG, BIF, BMF, BAF, SAM, LastFileType};
 #define PARTITION_MATCHES_ROTATE_NUM 100000
 #define ALIGNENTRIES_READ_ROTATE_NUM 10000
 #define BFAST_TMP_TEMPLATE ".bfast.tmp.XXXXXX"
+#define DEFAULT_TMP_COMPRESSION TmpCompressionDefault
 #define DEFAULT_RANGE "1-1:2147483647-2147483647"
 
 /* For printing to stderr */
@@ -97,6 +104,11 @@ enum {BRG, BIF, BMF, BAF, SAM, LastFileType};
 #define COLOR_SPACE_START_NT 'A'
 // the next define should be the int representation of the previous define
 #define COLOR_SPACE_START_NT_INT 0
+#define BFAST_RG_MMAP_ALIGNMENT 4096 /* each sequence starts on a page */
+#define BFAST_SERVE_READY 1 /* set once the served images are complete */
+#define BFAST_BLOOM_BITS_PER_KEY 10 /* per distinct key */
+#define BFAST_BLOOM_NUM_HASHES 7
+#define BFAST_BLOOM_BLOCK_BITS 512 /* one cache line, so one miss per key */
 #define BFAST_ID 'B'+'F'+'A'+'S'+'T'
 #define AVG_MISMATCH_QUALITY 10
 #define INSERT_MAX_STD 3.0
@@ -107,6 +119,26 @@ enum {BRG, BIF, BMF, BAF, SAM, LastFileType};
 #define MAX_PEDBINS_DISTANCE 20000
 #define MAX_PEDBINS_DISTANCES 10000
 
+/* Mate rescue in localalign */
+#define RESCUE_NUM_HITS 2
+#define RESCUE_MAX_MISMATCH_FRACTION 0.1
+#define RESCUE_MIN_MASK_LENGTH 2
+#define RESCUE_BASES_PER_WORD 32
+
+/* Reading the reference genome from FASTA */
+#define RGBINARY_READ_BLOCK_SIZE 4194304 /* bytes read at a time */
+#define RGBINARY_PACK_BATCH_SIZE 268435456 /* bases read before packing */
+
+/* Building binned indexes */
+#define RGINDEX_DEFAULT_MEMORY_LIMIT 12288 /* In megabytes */
+#define RGINDEX_RESERVED_FILES 64 /* file descriptors left free while binning */
+#define RGINDEX_BIN_READ_LENGTH 1048576 /* entries read back from a bin at a time */
+#define RGINDEX_UPDATE_SUFFIX ".tmp" /* added to an index while it is being updated */
+
+/* For RGIndexAccuracy */
+#define READ_PROFILE_MAX_LENGTH 512
+#define READ_PROFILE_NUM_WORDS (READ_PROFILE_MAX_LENGTH/64)
+
 /* Scoring matrix defaults */
 #define SCORING_MATRIX_GAP_OPEN -175
 #define SCORING_MATRIX_GAP_EXTEND -50
@@ -126,15 +158,23 @@ enum {BRG, BIF, BMF, BAF, SAM, LastFileType};
 #define WHICHSTRAND(_mode) ((0 == _mode) ? "[Both Strands]" : ((1 == _mode) ? "[Forward Strand]" : "[Reverse Strand]"))
 #define MIRRORINGTYPE(_mode) ((0 == _mode) ? "[Not Using]" : ((1 == _mode) ? "[First before the Second]" : ((2 == _mode) ? "[Second before the First]" : "[Both directions]")))
 #define COMPRESSION(_c) ((AFILE_NO_COMPRESSION == _c) ? "[Not Using]" : ((AFILE_GZ_COMPRESSION == _c) ? "[gzip]" : ((AFILE_BZ2_COMPRESSION == _c) ? "[bzip2]" : "[Unknown]")))
+#define TMPCOMPRESSION(_c) ((TmpCompressionNone == _c) ? "[Not Using]" : ((TmpCompressionFast == _c) ? "[gzip fast]" : ((TmpCompressionDefault == _c) ? "[gzip]" : "[Unknown]")))
 #define LOWERBOUNDSCORE(_score) (_score = (_score < NEGATIVE_INFINITY) ? NEGATIVE_INFINITY : _score)
 #define GETMIN(_X, _Y)  ((_X) < (_Y) ? (_X) : (_Y))
 #define GETMAX(_X, _Y)  ((_X) < (_Y) ? (_Y) : (_X))
 #define CHAR2QUAL(c) ((uint8_t)c-33)
 #define QUAL2CHAR(q) (char)(((q<=93)?q:93)+33)
 #define SPACENAME(_space) ((NTSpace == _space) ? "nt" : "cs")
-#define GETMASKNUMBYTES(_m) (((int)((_m->readLength + 7)/8)))
+#define GETMASKNUMBYTES(_m) (((int)(((_m)->readLength + 7)/8)))
 #define GETMASKNUMBYTESFROMLENGTH(_l) (((int)((_l + 7)/8)))
 #define GETMASKBYTE(_pos) ((int)(_pos / 8))
+#define GETMASK(_m, _i) ((_m)->masks + (int64_t)(_i)*GETMASKNUMBYTES(_m))
+#define GETNUMOFFSETS(_m, _i) ((_m)->offsetsStart[(_i)+1] - (_m)->offsetsStart[(_i)])
+#define GETOFFSETS(_m, _i) ((_m)->offsets + (_m)->offsetsStart[(_i)])
+/* Orders entries by contig, position then strand (contigs are below 2^31) */
+#define GETMATCHKEY(_m, _i) ((((uint64_t)(_m)->contigs[(_i)]) << 33) | \
+		(((uint64_t)(((uint32_t)(_m)->positions[(_i)]) ^ 0x80000000)) << 1) | \
+		((REVERSE == (_m)->strands[(_i)]) ? 1 : 0))
 #define ROUND(_x) ((int)((_x) + 0.5))
 #define COLORFROMINT(_c) (COLORS[(int)_c])
 #define COMPAREINTS(_a, _b) ((_a < _b) ? -1 : ((_a == _b) ? 0 : 1))
@@ -155,6 +195,8 @@ enum {BRG, BIF, BMF, BAF, SAM, LastFileType};
 #define COLOR_ERROR -1
 #define DEFAULT_LOCALALIGN_QUEUE_LENGTH 25000
 #define DEFAULT_POSTPROCESS_QUEUE_LENGTH 100000
+#define POSTPROCESS_NUM_BATCHES 3 /* one being read, one being filtered, one being written */
+#define POSTPROCESS_SORT_DEFAULT_MEMORY_LIMIT 2048 /* In megabytes */
 
 extern char COLORS[5];
 
@@ -169,6 +211,8 @@ enum {BFASTReferenceGenomeFile, BFASTIndexFile};
 enum {RGBinaryPacked, RGBinaryUnPacked};
 enum {NoMirroring, MirrorForward, MirrorReverse, MirrorBoth};
 enum {IndexesMemorySerial, IndexesMemoryAll};
+enum {TmpCompressionNone, TmpCompressionFast, TmpCompressionDefault};
+enum {MergeBufferEmpty, MergeBufferFilling, MergeBufferReady};
 /* For RGIndexAccuracy */
 enum {SearchForRGIndexAccuracies, EvaluateRGIndexAccuracies, ProgramParameters};
 enum {NO_EVENT, MISMATCH, INSERTION, DELETION};
@@ -189,6 +233,23 @@ enum {NoFiltering,      /* 0 */
 };                  
 enum {First, Second};
 enum {NoneFound, Found};
+enum {PostProcessBatchEmpty, PostProcessBatchRead, PostProcessBatchFiltered};
+/* For timing (-t), times are in nanoseconds */
+enum {CounterReads,
+	CounterIndexLookups,
+	CounterKeysSkipped, /* more than maxKeyMatches matches */
+	CounterCALs,
+	CounterExactAlignments,
+	CounterUngappedAlignments,
+	CounterGappedAlignments,
+	CounterReadsRejected, /* by the Bloom filters of the secondary indexes */
+	CounterBytesRead,
+	CounterBytesWritten,
+	CounterComputeTime,
+	CounterIOTime,
+	CounterWaitTime, /* blocked on other threads */
+	NumCounters
+};
 
 
 /************************************/
@@ -203,13 +264,17 @@ typedef struct {
 	char *qual;
 	int32_t maxReached;
 	int32_t numEntries;
+	// the first numSorted entries are sorted and have no duplicates
+	int32_t numSorted;
 	uint32_t *contigs;
 	int32_t *positions;
 	char *strands;
-	char **masks;
+	// GETMASKNUMBYTES(m) bytes per entry, stored contiguously (see GETMASK)
+	char *masks;
 	// these are only used when the index is split into pieces
-	int32_t *numOffsets;
-	int32_t **offsets; 
+	// the offsets for entry i are offsets[offsetsStart[i]] up to offsets[offsetsStart[i+1]-1]
+	int32_t *offsetsStart;
+	int32_t *offsets; 
 } RGMatch;
 
 /* TODO */
@@ -261,6 +326,9 @@ typedef struct {
 	int32_t numContigs;
 	/* Metadata */
 	int32_t space;
+	/* Memory map, if the sequences point into one */
+	char *map;
+	int64_t mapLength;
 } RGBinary;
 
 /* TODO */
@@ -294,8 +362,37 @@ typedef struct {
 	uint32_t hashWidth; /* in bases */
 	int64_t hashLength; 
 	uint32_t *starts;
+	/* Memory map, if the arrays point into one */
+	char *map;
+	int64_t mapLength;
 } RGIndex;
 
+/* A reference genome and indexes loaded into shared memory by
+ * bfast index-serve, each as an image at its own offset */
+typedef struct {
+	int fd;
+	char *fastaFileName; /* resolved path */
+	int32_t space;
+	int64_t rgOffset;
+	int64_t rgLength;
+	int32_t numIndexes;
+	char **indexFileNames; /* resolved paths */
+	int64_t *indexOffsets;
+	int64_t *indexLengths;
+} RGServe;
+
+/* A Bloom filter of the keys of an index at every position of the
+ * reference genome, used to reject reads the index cannot find */
+typedef struct {
+	int32_t space;
+	int32_t indexNumber;
+	int32_t width;
+	int32_t *mask; /* the mask of the index */
+	int32_t numHashes;
+	int64_t numBlocks; /* of BFAST_BLOOM_BLOCK_BITS bits each */
+	uint8_t *bits;
+} RGBloom;
+
 /* TODO */
 typedef struct {
 	int32_t hashWidth;
@@ -363,18 +460,6 @@ typedef struct {
 	int64_t mergeMemoryLimit;
 } ThreadRGIndexSortData;
 
-/* TODO */
-typedef struct {
-	RGIndex *index;
-	RGBinary *rg;
-	int32_t threadID;
-	int64_t low;
-	int64_t mid;
-	int64_t high;
-	int64_t mergeMemoryLimit;
-	char *tmpDir;
-} ThreadRGIndexMergeData;
-
 /* TODO */
 typedef struct {
 	int32_t contigStart;
@@ -402,7 +487,8 @@ typedef struct {
 /* RGIndexAccuracy.c */
 typedef struct {
 	int32_t length;
-	int32_t *profile;
+	/* bit i is set if base i can not be part of a key */
+	uint64_t profile[READ_PROFILE_NUM_WORDS];
 } Read;
 
 /* RGIndexAccuracy.c */
@@ -435,4 +521,11 @@ typedef struct {
 	int32_t *maxMismatches;
 } RGIndexAccuracyMismatchProfile;
 
+/* Counters kept by each thread when timing, see BCountersPrintJSON.  Each
+ * is padded to whole cache lines so that threads do not share one. */
+typedef struct {
+	int64_t counts[NumCounters];
+	char pad[BFAST_CACHE_LINE_SIZE - (sizeof(int64_t)*NumCounters) % BFAST_CACHE_LINE_SIZE];
+} BCounters;
+
 #endif
@@ -50,8 +50,8 @@ static char OptionString[]=
 BfastAlign(int argc, char **argv)
 {
 	struct arguments arguments;
-	time_t startTime = time(NULL);
-	time_t endTime;
+	int64_t startTime = BTimeNow();
+	int64_t endTime;
 
 	if(argc>1) {
 		/* Set argument defaults. (overriden if user specifies them)  */ 
@@ -92,14 +92,12 @@ BfastAlign(int argc, char **argv)
 							arguments.timing);
 
 					if(arguments.timing == 1) {
-						endTime = time(NULL);
-						int seconds = endTime - startTime;
-						int hours = seconds/3600;
-						seconds -= hours*3600;
-						int minutes = seconds/60;
-						seconds -= minutes*60;
+						endTime = BTimeNow();
+						int hours, minutes;
+						double seconds;
+						BTimeSplit(endTime - startTime, &hours, &minutes, &seconds);
 						if(0 <= VERBOSE) {
-							fprintf(stderr, "Total time elapsed: %d hours, %d minutes and %d seconds.\n",
+							fprintf(stderr, "Total time elapsed: %d hours, %d minutes and %.3lf seconds.\n",
 									hours,
 									minutes,
 									seconds
@@ -158,7 +158,7 @@ int BfastBAFConvert(int argc, char *argv[])
 		fprintf(stderr, "Input:%s\nOutput:%s\n", inputFileName, outputFileName);
 
 		/* Print Header */
-		AlignedReadConvertPrintHeader(fpOut, &rg, outputType, readGroup);
+		AlignedReadConvertPrintHeader(fpOut, &rg, outputType, readGroup, 0);
 		/* Initialize */
 		AlignedReadInitialize(&a);
 		counter = 0;
@@ -0,0 +1,63 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <config.h>
+#include <unistd.h>
+#include "BLibDefinitions.h"
+#include "BError.h"
+#include "BLib.h"
+#include "RGBinary.h"
+
+#define Name "bfast brg2mmap"
+
+/* Converts the reference genome to the uncompressed, page aligned format
+ * that is memory mapped when it is found next to the reference genome.
+ * */
+
+int BfastBRG2MMap(int argc, char *argv[])
+{
+	char rgFileName[MAX_FILENAME_LENGTH]="\0";
+	char fastaFileName[MAX_FILENAME_LENGTH]="\0";
+	RGBinary rg;
+	int32_t space = NTSpace;
+
+	if(2 == argc) {
+		strcpy(rgFileName, argv[1]);
+		/* Infer the space */
+		strcpy(fastaFileName, rgFileName);
+		assert(0 < strlen(rgFileName) - strlen(BFAST_RG_FILE_EXTENSION) - 1);
+		fastaFileName[strlen(rgFileName) - strlen(BFAST_RG_FILE_EXTENSION) - 1] = '\0'; // remove file extension
+		assert(strlen(SPACENAME(NTSpace)) == strlen(SPACENAME(ColorSpace))); // must hold for the next comparison to work
+		assert(0 < strlen(fastaFileName)-2);
+		if(0 == strcmp(SPACENAME(NTSpace), fastaFileName + (strlen(fastaFileName)-2))) {
+			space = NTSpace;
+		}
+		else { 
+			space = ColorSpace;
+		}
+		assert(0 < strlen(fastaFileName) - strlen(SPACENAME(space)) - 1);
+		fastaFileName[strlen(fastaFileName) - strlen(SPACENAME(space)) - 1]='\0'; // remove space name
+
+		/* Read the BRG */
+		RGBinaryReadBinary(&rg,
+				space,
+				fastaFileName);
+
+		/* Write the memory mapped BRG */
+		RGBinaryWriteBinaryMMap(&rg,
+				space,
+				fastaFileName);
+
+		RGBinaryDelete(&rg);
+
+		fprintf(stderr, "Terminating successfully!\n");
+	}
+	else {
+		fprintf(stderr, "\nUsage:%s <bfast reference genome file>\n", Name);
+		fprintf(stderr, "\nsend bugs to %s\n",
+				PACKAGE_BUGREPORT);
+		return 1;
+	}
+	return 0;
+}
@@ -22,7 +22,7 @@
    */
 enum { 
 	DescInputFilesTitle, DescFastaFileName, 
-	DescAlgoTitle, DescSpace, 
+	DescAlgoTitle, DescSpace, DescNumThreads, 
 	DescOutputTitle, DescTiming,
 	DescMiscTitle, DescParameters, DescHelp
 };
@@ -32,6 +32,7 @@ static struct argp_option options[] = {
 	{"fastaFileName", 'f', "fastaFileName", 0, "Specifies the file name of the FASTA reference genome", 1},
 	{0, 0, 0, 0, "=========== Algorithm Options: ======================================================", 2},
 	{"space", 'A', "space", 0, "0: NT space 1: Color space", 2},
+	{"numThreads", 'n', "numThreads", 0, "Specifies the number of threads to use (Default 1)", 2},
 	{0, 0, 0, 0, "=========== Output Options ==========================================================", 3},
 	{"timing", 't', 0, OPTION_NO_USAGE, "Specifies to output timing information", 3},
 	{0, 0, 0, 0, "=========== Miscellaneous Options ===================================================", 4},
@@ -41,15 +42,15 @@ static struct argp_option options[] = {
 };
 
 static char OptionString[]=
-"d:f:o:A:hpt";
+"d:f:n:o:A:hpt";
 
 	int
 BfastFasta2BRG(int argc, char **argv)
 {
 	struct arguments arguments;
 	RGBinary rg;
-	time_t startTime = time(NULL);
-	time_t endTime;
+	int64_t startTime = BTimeNow();
+	int64_t endTime;
 
 	if(argc>1) {
 		/* Set argument defaults. (overriden if user specifies them)  */ 
@@ -78,7 +79,8 @@ BfastFasta2BRG(int argc, char **argv)
 					/* Read fasta files */
 					RGBinaryRead(arguments.fastaFileName, 
 							&rg,
-							arguments.space);
+							arguments.space,
+							arguments.numThreads);
 					/* Write binary */
 					RGBinaryWriteBinary(&rg,
 							arguments.space,
@@ -89,17 +91,16 @@ BfastFasta2BRG(int argc, char **argv)
 
 					if(arguments.timing == 1) {
 						/* Get the time information */
-						endTime = time(NULL);
-						int seconds = endTime - startTime;
-						int hours = seconds/3600;
-						seconds -= hours*3600;
-						int minutes = seconds/60;
-						seconds -= minutes*60;
-						fprintf(stderr, "Total time elapsed: %d hours, %d minutes and %d seconds.\n",
+						endTime = BTimeNow();
+						int hours, minutes;
+						double seconds;
+						BTimeSplit(endTime - startTime, &hours, &minutes, &seconds);
+						fprintf(stderr, "Total time elapsed: %d hours, %d minutes and %.3lf seconds.\n",
 								hours,
 								minutes,
 								seconds
 							   );
+						BCountersPrintJSON(stderr, "fasta2brg", endTime - startTime, NULL, NULL, 0, NULL, 0);
 					}
 					fprintf(stderr, "Terminating successfully!\n");
 					fprintf(stderr, "%s", BREAK_LINE);
@@ -142,6 +143,10 @@ int BfastFasta2BRGValidateInputs(struct arguments *args) {
 	if(args->space != NTSpace && args->space != ColorSpace) {
 		PrintError(FnName, "space", "Command line argument", Exit, OutOfRange);	
 	}	
+	if(args->numThreads<=0) {		
+		PrintError(FnName, "numThreads", "Command line argument", Exit, OutOfRange);
+	}
+
 	assert(args->timing == 0 || args->timing == 1);
 	return 1;
 }
@@ -155,6 +160,7 @@ BfastFasta2BRGAssignDefaultValues(struct arguments *args)
 	args->programMode = ExecuteProgram;
 	args->fastaFileName = NULL;
 	args->space = NTSpace;
+	args->numThreads = 1;
 
 	args->timing = 0;
 
@@ -171,6 +177,7 @@ BfastFasta2BRGPrintProgramParameters(FILE* fp, struct arguments *args)
 	fprintf(fp, "programMode:\t\t\t\t%s\n", PROGRAMMODE(args->programMode));
 	fprintf(fp, "fastaFileName:\t\t\t\t%s\n", FILEREQUIRED(args->fastaFileName));
 	fprintf(fp, "space:\t\t\t\t\t%s\n", SPACE(args->space));
+	fprintf(fp, "numThreads:\t\t\t\t%d\n", args->numThreads);
 	fprintf(fp, "timing:\t\t\t\t\t%s\n", INTUSING(args->timing));
 	fprintf(fp, BREAK_LINE);
 	return;
@@ -231,6 +238,8 @@ BfastFasta2BRGGetOptParse(int argc, char** argv, char OptionString[], struct arg
 				arguments->timing = 1; break;
 			case 'A':
 				arguments->space=atoi(optarg); break;
+			case 'n':
+				arguments->numThreads=atoi(optarg); break;
 			default:
 				fprintf(stderr, "Key is %c and OptErr = %d\n", key, OptErr);
 				OptErr=1;
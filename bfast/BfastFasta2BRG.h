@@ -6,6 +6,7 @@ struct arguments
 	char *args[1];							/* No arguments to this function */
 	char *fastaFileName;					/* -f */
 	int space;								/* -A */
+	int numThreads;							/* -n */
 	int timing;                             /* -t */
 	int programMode;						/* -h */ 
 };
@@ -12,6 +12,8 @@
 #include "RGBinary.h"
 #include "RGIndexLayout.h"
 #include "RGIndexExons.h"
+#include "RGIndex.h"
+#include "RGBloom.h"
 #include "BError.h"
 #include "BLib.h"
 #include "BfastIndex.h"
@@ -22,7 +24,7 @@
    */
 enum { 
 	DescInputFilesTitle, DescFastaFileName, DescIndexLayoutFileName,  
-	DescAlgoTitle, DescSpace, DescNumThreads, DescRepeatMasker, DescStartContig, DescStartPos, DescEndContig, DescEndPos, DescExonFileName, 
+	DescAlgoTitle, DescSpace, DescNumThreads, DescMemoryLimit, DescRepeatMasker, DescStartContig, DescStartPos, DescEndContig, DescEndPos, DescExonFileName, DescUpdate, DescBloomFilter, 
 	DescOutputTitle, DescTmpDir, DescTiming,
 	DescMiscTitle, DescParameters, DescHelp
 };
@@ -44,7 +46,13 @@ static struct argp_option options[] = {
 	{"endPos", 'E', "endPos", 0, "Specifies the end postion", 2},
 	{"exonsFileName", 'x', "exonsFileName", 0, "Specifies the file name that specifies the exon-like ranges to"
 		"\n\t\t\t  include in the index", 2},
+	{"update", 'u', 0, OPTION_NO_USAGE, "Specifies to add the contigs at the end of the reference"
+		"\n\t\t\t  genome to an existing index", 2},
+	{"bloomFilter", 'B', 0, OPTION_NO_USAGE, "Specifies to also create a Bloom filter of the keys of the"
+		"\n\t\t\t  index, used by bfast match -B to skip reads it cannot find", 2},
 	{"numThreads", 'n', "numThreads", 0, "Specifies the number of threads to use (Default 1)", 2},
+	{"memoryLimit", 'M', "memoryLimit", 0, "Specifies the memory in megabytes to use when creating"
+		"\n\t\t\t  the index (Default 12288)", 2},
 	{0, 0, 0, 0, "=========== Output Options ==========================================================", 3},
 	{"tmpDir", 'T', "tmpDir", 0, "Specifies the directory in which to store temporary files", 3},
 	{"timing", 't', 0, OPTION_NO_USAGE, "Specifies to output timing information", 3},
@@ -55,7 +63,7 @@ static struct argp_option options[] = {
 };
 
 static char OptionString[]=
-"d:e:f:i:m:n:s:w:x:A:E:S:T:hptR";
+"d:e:f:i:m:n:s:w:x:A:E:M:S:T:hptuRB";
 
 	int
 BfastIndex(int argc, char **argv)
@@ -63,8 +71,10 @@ BfastIndex(int argc, char **argv)
 	struct arguments arguments;
 	RGIndexLayout rgLayout;
 	RGIndexExons exons;
-	time_t startTime = time(NULL);
-	time_t endTime;
+	RGBinary rg;
+	RGBloom bloom;
+	int64_t startTime = BTimeNow();
+	int64_t endTime;
 
 	if(argc>1) {
 		/* Set argument defaults. (overriden if user specifies them)  */ 
@@ -115,8 +125,21 @@ BfastIndex(int argc, char **argv)
 							arguments.numThreads,
 							arguments.repeatMasker,
 							0,
+							arguments.update,
+							arguments.memoryLimit*((int64_t)1048576),
 							arguments.tmpDir);
 
+					/* Create the Bloom filter of the index, if necessary */
+					if(1 == arguments.bloomFilter) {
+						RGBinaryReadBinary(&rg,
+								arguments.space,
+								arguments.fastaFileName);
+						RGBloomCreate(&bloom, &rg, &rgLayout, arguments.indexNumber, arguments.numThreads);
+						RGBloomWrite(&bloom, arguments.fastaFileName);
+						RGBloomDelete(&bloom);
+						RGBinaryDelete(&rg);
+					}
+
 					/* Free the RGIndex layout */
 					RGIndexLayoutDelete(&rgLayout);
 					/* Free exons, if necessary */
@@ -131,17 +154,16 @@ BfastIndex(int argc, char **argv)
 
 					if(arguments.timing == 1) {
 						/* Get the time information */
-						endTime = time(NULL);
-						int seconds = endTime - startTime;
-						int hours = seconds/3600;
-						seconds -= hours*3600;
-						int minutes = seconds/60;
-						seconds -= minutes*60;
-						fprintf(stderr, "Total time elapsed: %d hours, %d minutes and %d seconds.\n",
+						endTime = BTimeNow();
+						int hours, minutes;
+						double seconds;
+						BTimeSplit(endTime - startTime, &hours, &minutes, &seconds);
+						fprintf(stderr, "Total time elapsed: %d hours, %d minutes and %.3lf seconds.\n",
 								hours,
 								minutes,
 								seconds
 							   );
+						BCountersPrintJSON(stderr, "index", endTime - startTime, NULL, NULL, 0, NULL, 0);
 					}
 					fprintf(stderr, "Terminating successfully!\n");
 					fprintf(stderr, "%s", BREAK_LINE);
@@ -222,6 +244,10 @@ int BfastIndexValidateInputs(struct arguments *args) {
 		PrintError(FnName, "numThreads", "Command line argument", Exit, OutOfRange);
 	}
 
+	if(args->memoryLimit<=0) {		
+		PrintError(FnName, "memoryLimit", "Command line argument", Exit, OutOfRange);
+	}
+
 	if(args->tmpDir!=0) {
 		fprintf(stderr, "Validating tmpDir path %s. \n",
 				args->tmpDir);
@@ -231,6 +257,8 @@ int BfastIndexValidateInputs(struct arguments *args) {
 	/* If this does not hold, we have done something wrong internally */	
 	assert(args->timing == 0 || args->timing == 1);
 	assert(args->repeatMasker == 0 || args->repeatMasker == 1);
+	assert(args->update == 0 || args->update == 1);
+	assert(args->bloomFilter == 0 || args->bloomFilter == 1);
 
 	/* Cross-check arguments */
 	if(args->startContig > args->endContig) {
@@ -251,6 +279,15 @@ int BfastIndexValidateInputs(struct arguments *args) {
 	if(NULL != args->exonsFileName && args->endPos < INT_MAX) {		
 		PrintError(FnName, "Cannot use -E with -x", "Command line argument", Exit, OutOfRange);	
 	}
+	if(1 == args->update && NULL != args->exonsFileName) {
+		PrintError(FnName, "Cannot use -u with -x", "Command line argument", Exit, OutOfRange);	
+	}
+	if(1 == args->update && (args->startContig > 0 || args->startPos > 0)) {
+		PrintError(FnName, "Cannot use -u with -s or -S", "Command line argument", Exit, OutOfRange);	
+	}
+	if(1 == args->update && (args->endContig < INT_MAX || args->endPos < INT_MAX)) {
+		PrintError(FnName, "Cannot use -u with -e or -E", "Command line argument", Exit, OutOfRange);	
+	}
 
 	return 1;
 }
@@ -274,7 +311,10 @@ BfastIndexAssignDefaultValues(struct arguments *args)
 	args->endContig=INT_MAX;
 	args->endPos=INT_MAX;
 	args->exonsFileName = NULL;
+	args->update = 0;
+	args->bloomFilter = 0;
 	args->numThreads = 1;
+	args->memoryLimit = RGINDEX_DEFAULT_MEMORY_LIMIT;
 
 	args->tmpDir =
 		(char*)malloc(sizeof(DEFAULT_OUTPUT_DIR));
@@ -311,7 +351,10 @@ BfastIndexPrintProgramParameters(FILE* fp, struct arguments *args)
 	fprintf(fp, "endContig:\t\t\t\t%d\n", args->endContig);
 	fprintf(fp, "endPos:\t\t\t\t\t%d\n", args->endPos);
 	fprintf(fp, "exonsFileName:\t\t\t\t%s\n", FILEUSING(args->exonsFileName));
+	fprintf(fp, "update:\t\t\t\t\t%s\n", INTUSING(args->update));
+	fprintf(fp, "bloomFilter:\t\t\t\t%s\n", INTUSING(args->bloomFilter));
 	fprintf(fp, "numThreads:\t\t\t\t%d\n", args->numThreads);
+	fprintf(fp, "memoryLimit:\t\t\t\t%d\n", args->memoryLimit);
 	fprintf(fp, "tmpDir:\t\t\t\t\t%s\n", args->tmpDir);
 	fprintf(fp, "timing:\t\t\t\t\t%s\n", INTUSING(args->timing));
 	fprintf(fp, BREAK_LINE);
@@ -389,14 +432,20 @@ BfastIndexGetOptParse(int argc, char** argv, char OptionString[], struct argumen
 				arguments->startContig=atoi(optarg);break;
 			case 't':
 				arguments->timing = 1;break;
+			case 'u':
+				arguments->update = 1;break;
 			case 'w':
 				arguments->hashWidth=atoi(optarg);break;
 			case 'x':
 				arguments->exonsFileName=strdup(optarg);break;
 			case 'A':
 				arguments->space=atoi(optarg);break;
+			case 'B':
+				arguments->bloomFilter=1;break;
 			case 'E':
 				arguments->endPos=atoi(optarg);break;
+			case 'M':
+				arguments->memoryLimit=atoi(optarg);break;
 			case 'R':
 				arguments->repeatMasker=1;break;
 			case 'S':
@@ -12,12 +12,15 @@ struct arguments
 	int depth;								/* -D */
 	int indexNumber;						/* -i */
 	int numThreads;                         /* -n */
+	int memoryLimit;                        /* -M */
 	int repeatMasker;						/* -R */
 	int startContig;						/* -s */
 	unsigned int startPos;					/* -S */
 	int endContig;							/* -e */
 	unsigned int endPos;					/* -E */
 	char *exonsFileName;					/* -x */
+	int update;								/* -u */
+	int bloomFilter;						/* -B */
 	char *tmpDir;                           /* -T */
 	int timing;                             /* -t */
 	int programMode;						/* -h */ 
@@ -0,0 +1,102 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <config.h>
+#include <unistd.h>
+#include <signal.h>
+#include "BLibDefinitions.h"
+#include "BError.h"
+#include "BLib.h"
+#include "RGServe.h"
+
+#define Name "bfast index-serve"
+
+/* Loads the reference genome and indexes once into shared memory, where
+ * bfast match -S attaches to them read-only, and serves them until
+ * interrupted.
+ * */
+
+static int BfastIndexServeUsage()
+{
+	fprintf(stderr, "\nUsage:%s [options]\n", Name);
+	fprintf(stderr, "\t-f\tFILE\tSpecifies the file name of the FASTA reference genome\n");
+	fprintf(stderr, "\t-A\tINT\t0: NT space 1: Color space\n");
+	fprintf(stderr, "\t-i\tSTRING\tThe index numbers to serve (comma separated, Default all)\n");
+	fprintf(stderr, "\t-S\tSTRING\tThe name to serve under\n");
+	fprintf(stderr, "\t-r\t\tRemove what is served under the name and exit\n");
+	fprintf(stderr, "\t-h\t\tprints this help message\n");
+	fprintf(stderr, "\nsend bugs to %s\n",
+			PACKAGE_BUGREPORT);
+	return 1;
+}
+
+int BfastIndexServe(int argc, char *argv[])
+{
+	char *fastaFileName=NULL;
+	char *indexes=NULL;
+	char *name=NULL;
+	int32_t space = NTSpace;
+	int remove = 0;
+	int c, caught;
+	sigset_t signals;
+
+	while((c = getopt(argc, argv, "f:i:A:S:rh")) >= 0) {
+		switch(c) {
+			case 'f': fastaFileName=strdup(optarg); break;
+			case 'i': indexes=strdup(optarg); break;
+			case 'A': space=atoi(optarg); break;
+			case 'S': name=strdup(optarg); break;
+			case 'r': remove=1; break;
+			case 'h': return BfastIndexServeUsage();
+			default: fprintf(stderr, "Unrecognized option: -%c\n", c); return 1;
+		}
+	}
+
+	if(1 == argc || argc != optind) {
+		return BfastIndexServeUsage();
+	}
+	if(NULL == name) {
+		PrintError(Name, "name", "Command line option", Exit, InputArguments);
+	}
+
+	if(1 == remove) {
+		RGServeRemove(name);
+	}
+	else {
+		if(NULL == fastaFileName) {
+			PrintError(Name, "fastaFileName", "Command line option", Exit, InputArguments);
+		}
+		if(NTSpace != space && ColorSpace != space) {
+			PrintError(Name, "space", "Command line option", Exit, OutOfRange);
+		}
+
+		/* Handle the signals here, after the object is complete */
+		sigemptyset(&signals);
+		sigaddset(&signals, SIGINT);
+		sigaddset(&signals, SIGTERM);
+		sigaddset(&signals, SIGHUP);
+		sigprocmask(SIG_BLOCK, &signals, NULL);
+
+		RGServeCreate(name,
+				fastaFileName,
+				space,
+				indexes);
+
+		if(0 <= VERBOSE) {
+			fprintf(stderr, "Serving until interrupted.\n");
+		}
+		sigwait(&signals, &caught);
+
+		RGServeRemove(name);
+	}
+
+	free(fastaFileName);
+	free(indexes);
+	free(name);
+
+	if(0 <= VERBOSE) {
+		fprintf(stderr, "Terminating successfully!\n");
+	}
+	return 0;
+}
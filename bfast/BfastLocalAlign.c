@@ -22,6 +22,7 @@ enum {
 	DescInputFilesTitle, DescFastaFileName, DescMatchFileName, DescScoringMatrixFileName, 
 	DescAlgoTitle, DescUngapped, DescUnconstrained, DescSpace, DescStartReadNum, DescEndReadNum, DescOffsetLength, DescMaxNumMatches, DescAvgMismatchQuality, DescNumThreads, DescQueueLength,
 	DescPairedEndOptionsTitle, DescPairedEndLength, DescMirroringType, DescForceMirroring, 
+	DescRescueTitle, DescInsertSizeAvg, DescInsertSizeStdDev, DescRescueNumStdDev, DescRescueNumHits, 
 	DescOutputTitle, DescTiming, 
 	DescMiscTitle, DescHelp
 };
@@ -60,6 +61,14 @@ static struct argp_option options[] = {
 	{"forceMirroring", 'F', 0, OPTION_NO_USAGE, "Specifies that we should always mirror CALs using the distance"
 		"\n\t\t\t  from -l", 3},
 		*/
+	{0, 0, 0, 0, "=========== Mate Rescue Options =====================================================", 3},
+	{"insertSizeAvg", 'v', "insertSizeAvg", 0, "Specifies the mean insert size and turns on mate rescue: if one"
+		"\n\t\t\t  end of a pair has CALs and the other does not, the"
+		"\n\t\t\t  latter is searched for near the former", 3},
+	{"insertSizeStdDev", 'w', "insertSizeStdDev", 0, "Specifies the standard deviation of the insert size (with -v)", 3},
+	{"rescueNumStdDev", 'k', "rescueNumStdDev", 0, "Specifies the number of standard deviations around the mean"
+		"\n\t\t\t  insert size to search (with -v)", 3},
+	{"rescueNumHits", 'N', "rescueNumHits", 0, "Specifies the number of best ungapped hits to align (with -v)", 3},
 	{0, 0, 0, 0, "=========== Output Options ==========================================================", 4},
 	{"timing", 't', 0, OPTION_NO_USAGE, "Specifies to output timing information", 4},
 	{0, 0, 0, 0, "=========== Miscellaneous Options ===================================================", 5},
@@ -69,16 +78,17 @@ static struct argp_option options[] = {
 };
 
 static char OptionString[]=
-"e:f:m:n:o:q:s:x:A:M:Q:T:hptuU";
+"e:f:k:m:n:o:q:s:v:w:x:A:M:N:Q:T:hptuU";
 //"e:f:l:m:n:o:q:s:x:A:L:M:Q:T:hptuFU";
 
 	int
 BfastLocalAlign(int argc, char **argv)
 {
 	struct arguments arguments;
-	time_t startTotalTime = time(NULL);
-	time_t endTotalTime;
-	int seconds, minutes, hours;
+	int64_t startTotalTime = BTimeNow();
+	int64_t endTotalTime;
+	int minutes, hours;
+	double seconds;
 	if(argc>1) {
 		/* Set argument defaults. (overriden if user specifies them)  */ 
 		BfastLocalAlignAssignDefaultValues(&arguments);
@@ -125,20 +135,21 @@ BfastLocalAlign(int argc, char **argv)
 							arguments.pairedEndLength,
 							arguments.mirroringType,
 							arguments.forceMirroring,
+							arguments.insertSizeSpecified,
+							arguments.insertSizeAvg,
+							arguments.insertSizeStdDev,
+							arguments.rescueNumStdDev,
+							arguments.rescueNumHits,
 							arguments.timing,
 							stdout);
 
 					if(arguments.timing == 1) {
 
 						/* Output total time */
-						endTotalTime = time(NULL);
-						seconds = endTotalTime - startTotalTime;
-						hours = seconds/3600;
-						seconds -= hours*3600;
-						minutes = seconds/60;
-						seconds -= minutes*60;
+						endTotalTime = BTimeNow();
+						BTimeSplit(endTotalTime - startTotalTime, &hours, &minutes, &seconds);
 						if(0 <= VERBOSE) {
-							fprintf(stderr, "Total time elapsed: %d hours, %d minutes and %d seconds.\n",
+							fprintf(stderr, "Total time elapsed: %d hours, %d minutes and %.3lf seconds.\n",
 									hours,
 									minutes,
 									seconds
@@ -253,6 +264,20 @@ int BfastLocalAlignValidateInputs(struct arguments *args) {
 	if(args->forceMirroring == 1 && args->usePairedEndLength == 0) {		
 		PrintError(FnName, "pairedEndLength", "Must specify a paired end length when using force mirroring", Exit, OutOfRange);	
 	}
+	if(1 == args->insertSizeSpecified) {
+		if(args->insertSizeStdDev <= 0.0) {
+			PrintError(FnName, "insertSizeStdDev", "When specifying insertSizeAvg, you must also specify an insertSizeStdDev > 0", Exit, OutOfRange);
+		}
+		if(args->rescueNumStdDev <= 0.0) {
+			PrintError(FnName, "rescueNumStdDev", "Command line argument", Exit, OutOfRange);
+		}
+		if(args->rescueNumHits <= 0) {
+			PrintError(FnName, "rescueNumHits", "Command line argument", Exit, OutOfRange);
+		}
+	}
+	else if(0.0 != args->insertSizeStdDev) {
+		PrintError(FnName, "insertSizeAvg", "Must specify an insertSizeAvg when specifying an insertSizeStdDev", Exit, OutOfRange);
+	}
 
 	return 1;
 }
@@ -282,6 +307,11 @@ BfastLocalAlignAssignDefaultValues(struct arguments *args)
 	args->pairedEndLength = 0;
 	args->mirroringType = NoMirroring;
 	args->forceMirroring = 0;
+	args->insertSizeSpecified = 0;
+	args->insertSizeAvg = 0.0;
+	args->insertSizeStdDev = 0.0;
+	args->rescueNumStdDev = INSERT_MAX_STD;
+	args->rescueNumHits = RESCUE_NUM_HITS;
 
 	args->timing = 0;
 
@@ -314,6 +344,15 @@ BfastLocalAlignPrintProgramParameters(FILE* fp, struct arguments *args)
 		fprintf(fp, "mirroringType:\t\t\t\t%s\n", MIRRORINGTYPE(args->mirroringType));
 		fprintf(fp, "forceMirroring:\t\t\t\t%s\n", INTUSING(args->forceMirroring));
 		*/
+		if(1 == args->insertSizeSpecified) {
+			fprintf(fp, "insertSizeAvg:\t\t\t\t%lf\n", args->insertSizeAvg);
+			fprintf(fp, "insertSizeStdDev:\t\t\t%lf\n", args->insertSizeStdDev);
+			fprintf(fp, "rescueNumStdDev:\t\t\t%lf\n", args->rescueNumStdDev);
+			fprintf(fp, "rescueNumHits:\t\t\t\t%d\n", args->rescueNumHits);
+		}
+		else {
+			fprintf(fp, "insertSizeAvg:\t\t\t\t%s\n", INTUSING(0));
+		}
 		fprintf(fp, "timing:\t\t\t\t\t%s\n", INTUSING(args->timing));
 		fprintf(fp, BREAK_LINE);
 	}
@@ -372,6 +411,8 @@ BfastLocalAlignGetOptParse(int argc, char** argv, char OptionString[], struct ar
 				arguments->fastaFileName=strdup(optarg);break;
 			case 'h':
 				arguments->programMode=ExecuteGetOptHelp; break;
+			case 'k':
+				arguments->rescueNumStdDev=atof(optarg);break;
 				/*
 			case 'l':
 				arguments->usePairedEndLength=1;
@@ -393,6 +434,11 @@ BfastLocalAlignGetOptParse(int argc, char** argv, char OptionString[], struct ar
 				arguments->timing = 1;break;
 			case 'u':
 				arguments->ungapped = Ungapped; break;
+			case 'v':
+				arguments->insertSizeSpecified=1;
+				arguments->insertSizeAvg=atof(optarg);break;
+			case 'w':
+				arguments->insertSizeStdDev=atof(optarg);break;
 			case 'x':
 				StringCopyAndReallocate(&arguments->scoringMatrixFileName, optarg);
 				break;
@@ -406,6 +452,8 @@ BfastLocalAlignGetOptParse(int argc, char** argv, char OptionString[], struct ar
 				*/
 			case 'M':
 				arguments->maxNumMatches=atoi(optarg);break;
+			case 'N':
+				arguments->rescueNumHits=atoi(optarg);break;
 			case 'Q':
 				arguments->queueLength=atoi(optarg);break;
 			case 'U':
@@ -22,6 +22,11 @@ struct arguments
 	int mirroringType;						/* -L */
 	int forceMirroring;						/* -f */
 	int pairedEndLength;					/* -l */
+	int insertSizeSpecified;				/* -v - companion to insertSizeAvg */
+	double insertSizeAvg;					/* -v */
+	double insertSizeStdDev;				/* -w */
+	double rescueNumStdDev;					/* -k */
+	int rescueNumHits;						/* -N */
 	int timing;                             /* -t */
 	int programMode;						/* -h */ 
 };
@@ -19,14 +19,14 @@
    Order of fields: {NAME, KEY, ARG, FLAGS, DOC, OPTIONAL_GROUP_NAME}.
    */
 enum { 
-	DescInputFilesTitle, DescFastaFileName, DescMainIndexes, DescSecondaryIndexes, DescReadsFileName, DescOffsets,  DescLoadAllIndexes, 
+	DescInputFilesTitle, DescFastaFileName, DescMainIndexes, DescSecondaryIndexes, DescServeName, DescReadsFileName, DescOffsets,  DescLoadAllIndexes, DescPrefetchMemory, DescStopOnUnique, DescMinKeys, 
 #ifndef DISABLE_BZLIB
 	DescCompressionBZ2, 
 #endif
 	DescCompressionGZ,
 	DescAlgoTitle, DescSpace, DescStartReadNum, DescEndReadNum, 
 	DescKeySize, DescMaxKeyMatches, DescMaxTotalMatches, DescWhichStrand, DescNumThreads, DescQueueLength, 
-	DescOutputTitle, DescTmpDir, DescTiming,
+	DescOutputTitle, DescTmpDir, DescTmpCompression, DescTiming,
 	DescMiscTitle, DescParameters, DescHelp
 };
 
@@ -36,9 +36,20 @@ static struct argp_option options[] = {
 	{"mainIndexes", 'i', "mainIndexes", 0, "The index numbers for the main bif files (comma separated)", 1},
 	{"secondaryIndexes", 'I', "secondaryIndexes", 0, "The index numbers for the secondary bif files (comma"
 		"\n\t\t\t\t  separated)", 1},
+	{"serveName", 'S', "serveName", 0, "Attach to the reference genome and indexes served under this"
+		"\n\t\t\t  name by bfast index-serve", 1},
 	{"readsFileName", 'r', "readsFileName", 0, "Specifies the file name for the reads (FASTQ format)", 1}, 
 	{"offsets", 'o', "offsets", 0, "Specifies the offsets", 1},
 	{"loadAllIndexes", 'l', "loadAllIndexes", 0, "Specifies to load all main or secondary indexes into memory", 1},
+	{"prefetchMemory", 'P', "prefetchMemory", 0, "Specifies to load the next index while searching the current"
+		"\n\t\t\t  one, if both fit in this many megabytes (Default 0: disabled)", 1},
+	{"stopOnUnique", 'U', 0, OPTION_NO_USAGE, "Specifies to stop searching the indexes for a read once it has"
+		"\n\t\t\t  one match with no keys skipped (requires -l)", 1},
+	{"minKeys", 'B', "minKeys", 0, "Specifies to skip the secondary index search for reads with fewer"
+		"\n\t\t\t  than this many keys in the Bloom filters of the secondary indexes"
+		"\n\t\t\t  made by bfast index -B.  1 skips no read the secondary indexes"
+		"\n\t\t\t  would find; larger values also skip reads found by fewer keys"
+		"\n\t\t\t  (requires -I, Default 0: disabled)", 1},
 #ifndef DISABLE_BZLIB
 	{"bz2", 'j', "bz2", 0, "Specifies that the input reads are bz2 compressed (bzip2)", 1},
 #endif
@@ -62,6 +73,8 @@ static struct argp_option options[] = {
 	{"queueLength", 'Q', "queueLength", 0, "Specifies the number of reads to cache", 2},
 	{0, 0, 0, 0, "=========== Output Options ==========================================================", 3},
 	{"tmpDir", 'T', "tmpDir", 0, "Specifies the directory in which to store temporary files", 3},
+	{"tmpCompression", 'C', "tmpCompression", 0, "Specifies the compression of temporary files 0: none"
+		"\n\t\t\t 1: fast gzip 2: gzip (Default 2)", 3},
 	{"timing", 't', 0, OPTION_NO_USAGE, "Specifies to output timing information", 3},
 	{0, 0, 0, 0, "=========== Miscellaneous Options ===================================================", 4},
 	{"Parameters", 'p', 0, OPTION_NO_USAGE, "Print program parameters", 4},
@@ -71,17 +84,17 @@ static struct argp_option options[] = {
 
 static char OptionString[]=
 #ifndef DISABLE_BZLIB
-"e:f:i:k:m:n:o:r:s:w:A:I:K:F:M:Q:T:hjlptz";
+"e:f:i:k:m:n:o:r:s:w:A:B:C:I:K:F:M:P:Q:S:T:hjlptUz";
 #else
-"e:f:i:k:m:n:o:r:s:w:A:I:K:M:Q:T:hlptz";
+"e:f:i:k:m:n:o:r:s:w:A:B:C:I:K:M:P:Q:S:T:hlptUz";
 #endif
 
 	int
 BfastMatch(int argc, char **argv)
 {
 	struct arguments arguments;
-	time_t startTime = time(NULL);
-	time_t endTime;
+	int64_t startTime = BTimeNow();
+	int64_t endTime;
 
 	if(argc>1) {
 		/* Set argument defaults. (overriden if user specifies them)  */ 
@@ -116,9 +129,13 @@ BfastMatch(int argc, char **argv)
 							arguments.fastaFileName,
 							arguments.mainIndexes,
 							arguments.secondaryIndexes,
+							arguments.serveName,
 							arguments.readsFileName,
 							arguments.offsets,
 							arguments.loadAllIndexes,
+							arguments.prefetchMemory,
+							arguments.stopOnUnique,
+							arguments.minKeys,
 							arguments.compression,
 							arguments.space,
 							arguments.startReadNum,
@@ -131,18 +148,17 @@ BfastMatch(int argc, char **argv)
 							arguments.numThreads,
 							arguments.queueLength,
 							arguments.tmpDir,
+							arguments.tmpCompression,
 							arguments.timing,
 							stdout);
 
 					if(arguments.timing == 1) {
-						endTime = time(NULL);
-						int seconds = endTime - startTime;
-						int hours = seconds/3600;
-						seconds -= hours*3600;
-						int minutes = seconds/60;
-						seconds -= minutes*60;
+						endTime = BTimeNow();
+						int hours, minutes;
+						double seconds;
+						BTimeSplit(endTime - startTime, &hours, &minutes, &seconds);
 						if(0 <= VERBOSE) {
-							fprintf(stderr, "Total time elapsed: %d hours, %d minutes and %d seconds.\n",
+							fprintf(stderr, "Total time elapsed: %d hours, %d minutes and %.3lf seconds.\n",
 									hours,
 									minutes,
 									seconds
@@ -233,6 +249,18 @@ int BfastMatchValidateInputs(struct arguments *args) {
 		PrintError(FnName, "numThreads", "Command line argument", Exit, OutOfRange);
 	} 
 
+	if(1 == args->stopOnUnique && IndexesMemoryAll != args->loadAllIndexes) {
+		PrintError(FnName, "stopOnUnique", "Requires loading all indexes into memory (-l)", Exit, InputArguments);
+	}
+	if(args->minKeys < 0) {
+		PrintError(FnName, "minKeys", "Command line argument", Exit, OutOfRange);
+	}
+	if(0 < args->minKeys && NULL == args->secondaryIndexes) {
+		PrintError(FnName, "minKeys", "Requires secondary indexes (-I)", Exit, InputArguments);
+	}
+	if(args->prefetchMemory < 0) {
+		PrintError(FnName, "prefetchMemory", "Command line argument", Exit, OutOfRange);
+	}
 	if(args->queueLength<=0) {
 		PrintError(FnName, "queueLength", "Command line argument", Exit, OutOfRange);	
 	} 	
@@ -244,6 +272,9 @@ int BfastMatchValidateInputs(struct arguments *args) {
 		if(ValidatePath(args->tmpDir)==0)
 			PrintError(FnName, "tmpDir", "Command line argument", Exit, IllegalPath);	
 	}	
+	if(args->tmpCompression < TmpCompressionNone || TmpCompressionDefault < args->tmpCompression) {
+		PrintError(FnName, "tmpCompression", "Command line argument", Exit, OutOfRange);	
+	}
 	/* If this does not hold, we have done something wrong internally */	
 	assert(args->timing == 0 || args->timing == 1);
 	assert(IndexesMemorySerial == args->loadAllIndexes || IndexesMemoryAll == args->loadAllIndexes);
@@ -263,9 +294,13 @@ BfastMatchAssignDefaultValues(struct arguments *args)
 
 	args->mainIndexes = NULL;
 	args->secondaryIndexes = NULL;
+	args->serveName = NULL;
 	args->readsFileName = NULL;
 	args->offsets = NULL;
 	args->loadAllIndexes = IndexesMemorySerial;
+	args->prefetchMemory = 0;
+	args->stopOnUnique = 0;
+	args->minKeys = 0;
 	args->compression = AFILE_NO_COMPRESSION;
 
 	args->space = NTSpace;
@@ -284,6 +319,7 @@ BfastMatchAssignDefaultValues(struct arguments *args)
 		(char*)malloc(sizeof(DEFAULT_OUTPUT_DIR));
 	assert(args->tmpDir!=0);
 	strcpy(args->tmpDir, DEFAULT_OUTPUT_DIR);
+	args->tmpCompression = DEFAULT_TMP_COMPRESSION;
 
 	args->timing = 0;
 
@@ -301,9 +337,13 @@ BfastMatchPrintProgramParameters(FILE* fp, struct arguments *args)
 		fprintf(fp, "fastaFileName:\t\t\t\t%s\n", FILEREQUIRED(args->fastaFileName));
 		fprintf(fp, "mainIndexes\t\t\t\t%s\n", (NULL == args->mainIndexes) ? "[Auto-recognizing]" : args->mainIndexes);
 		fprintf(fp, "secondaryIndexes\t\t\t%s\n", FILEUSING(args->secondaryIndexes));
+		fprintf(fp, "serveName\t\t\t\t%s\n", FILEUSING(args->serveName));
 		fprintf(fp, "readsFileName:\t\t\t\t%s\n", FILESTDIN(args->readsFileName));
 		fprintf(fp, "offsets:\t\t\t\t%s\n", (NULL == args->offsets) ? "[Using All]" : args->offsets);
 		fprintf(fp, "loadAllIndexes:\t\t\t\t%s\n", INTUSING(args->loadAllIndexes));
+		fprintf(fp, "prefetchMemory:\t\t\t\t%d\n", args->prefetchMemory);
+		fprintf(fp, "stopOnUnique:\t\t\t\t%s\n", INTUSING(args->stopOnUnique));
+		fprintf(fp, "minKeys:\t\t\t\t%d\n", args->minKeys);
 		fprintf(fp, "compression:\t\t\t\t%s\n", COMPRESSION(args->compression));
 		fprintf(fp, "space:\t\t\t\t\t%s\n", SPACE(args->space));
 		fprintf(fp, "startReadNum:\t\t\t\t%d\n", args->startReadNum);
@@ -317,6 +357,7 @@ BfastMatchPrintProgramParameters(FILE* fp, struct arguments *args)
 		fprintf(fp, "numThreads:\t\t\t\t%d\n", args->numThreads);
 		fprintf(fp, "queueLength:\t\t\t\t%d\n", args->queueLength);
 		fprintf(fp, "tmpDir:\t\t\t\t\t%s\n", args->tmpDir);
+		fprintf(fp, "tmpCompression:\t\t\t\t%s\n", TMPCOMPRESSION(args->tmpCompression));
 		fprintf(fp, "timing:\t\t\t\t\t%s\n", INTUSING(args->timing));
 		fprintf(fp, BREAK_LINE);
 	}
@@ -332,6 +373,8 @@ void BfastMatchFreeProgramParameters(struct arguments *args)
 	args->mainIndexes=NULL;
 	free(args->secondaryIndexes);
 	args->secondaryIndexes=NULL;
+	free(args->serveName);
+	args->serveName=NULL;
 	free(args->readsFileName);
 	args->readsFileName=NULL;
 	free(args->offsets);
@@ -411,6 +454,10 @@ BfastMatchGetOptParse(int argc, char** argv, char OptionString[], struct argumen
 				arguments->compression=AFILE_GZ_COMPRESSION; break;
 			case 'A':
 				arguments->space=atoi(optarg); break;
+			case 'B':
+				arguments->minKeys=atoi(optarg); break;
+			case 'C':
+				arguments->tmpCompression=atoi(optarg); break;
 			case 'I':
 				arguments->secondaryIndexes=strdup(optarg); break;
 			case 'K':
@@ -419,8 +466,14 @@ BfastMatchGetOptParse(int argc, char** argv, char OptionString[], struct argumen
 				arguments->keyMissFraction=atof(optarg); break;
 			case 'M':
 				arguments->maxNumMatches=atoi(optarg); break;
+			case 'P':
+				arguments->prefetchMemory=atoi(optarg); break;
 			case 'Q':
 				arguments->queueLength=atoi(optarg); break;
+			case 'S':
+				arguments->serveName=strdup(optarg); break;
+			case 'U':
+				arguments->stopOnUnique = 1; break;
 			case 'T':
 				StringCopyAndReallocate(&arguments->tmpDir, optarg); break;
 			default:
@@ -10,9 +10,13 @@ struct arguments
 	char *fastaFileName;                   	/* -f */
 	char *mainIndexes;						/* -i */
 	char *secondaryIndexes;					/* -I */
+	char *serveName;						/* -S */
 	char *readsFileName;					/* -r */
 	char *offsets;							/* -o */
 	int loadAllIndexes;						/* -l */
+	int prefetchMemory;						/* -P */
+	int stopOnUnique;						/* -U */
+	int minKeys;							/* -B */
 	int compression;						/* -j, -z */ 
 	int space;								/* -A */
 	int startReadNum;						/* -s */
@@ -25,6 +29,7 @@ struct arguments
 	int numThreads;							/* -n */
 	int queueLength;						/* -Q */
 	char *tmpDir;							/* -T */
+	int tmpCompression;						/* -C */
 	int timing;								/* -t */
 	int programMode;						/* -h */ 
 };
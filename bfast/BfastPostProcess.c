@@ -22,8 +22,8 @@ enum {
 	DescInputFilesTitle, DescFastaFileName, DescInputFileName, 
 	DescAlgoTitle, DescAlgorithm, DescSpace, DescStrandedness, DescPositioning, DescPairing, DescAvgMismatchQuality, 
 	DescScoringMatrixFileName, DescRandomBest, DescMinimumMappingQuality, DescMinimumNormalizedScore,  
-	DescNumThreads, DescQueueLength, 
-	DescOutputTitle, DescOutputFormat, DescOutputID, DescRGFileName, DescBaseQualityType, DescTiming,
+	DescNumThreads, DescNumFormatThreads, DescQueueLength, 
+	DescOutputTitle, DescOutputFormat, DescOutputID, DescRGFileName, DescBaseQualityType, DescSort, DescSortMemoryLimit, DescTmpDir, DescTiming,
 	DescMiscTitle, DescParameters, DescHelp
 };
 
@@ -63,6 +63,7 @@ static struct argp_option options[] = {
 	{"insertSizeAvg", 'v', "insertSizeAvg", 0, "Specifies the mean insert size to use when pairing", 2}, 
 	{"insertSizeStdDev", 's', "insertSizeStdDev", 0, "Specifies the standard deviation of the insert size to use when pairing", 2}, 
 	{"numThreads", 'n', "numThreads", 0, "Specifies the number of threads to use (Default 1)", 2},
+	{"numFormatThreads", 'F', "numFormatThreads", 0, "Specifies the number of threads to use to format SAM output (Default 1)", 2},
 	{"queueLength", 'Q', "queueLength", 0, "Specifies the number of reads to cache", 2},
 	{0, 0, 0, 0, "=========== Output Options ==========================================================", 3},
 	{"outputFormat", 'O', "outputFormat", 0, "Specifies the output format 0: BAF 1: SAM", 3},
@@ -76,6 +77,10 @@ static struct argp_option options[] = {
 			"\n\t\t\t  2: Maximum (max(color 1, color 2))"
 			"\n\t\t\t  3: Nullify (if either are an error, base quality is zero)",
                         3},
+	{"sort", 'C', 0, OPTION_NO_USAGE, "Specifies to sort the output by coordinate (SAM only)", 3},
+	{"sortMemoryLimit", 'L', "sortMemoryLimit", 0, "Specifies the memory in megabytes to use when sorting"
+		"\n\t\t\t  before writing sorted runs to temporary files", 3},
+	{"tmpDir", 'T', "tmpDir", 0, "Specifies the directory in which to store temporary files", 3},
 	{"timing", 't', 0, OPTION_NO_USAGE, "Specifies to output timing information", 3},
 	{0, 0, 0, 0, "=========== Miscellaneous Options ===================================================", 4},
 	{"Parameters", 'p', 0, OPTION_NO_USAGE, "Print program parameters", 4},
@@ -84,14 +89,14 @@ static struct argp_option options[] = {
 };
 
 static char OptionString[]=
-"a:b:i:f:m:n:o:q:r:s:v:x:A:M:O:P:S:Y:Q:hptzRU";
+"a:b:i:f:m:n:o:q:r:s:v:x:A:F:L:M:O:P:S:T:Y:Q:hptzCRU";
 
 	int
 BfastPostProcess(int argc, char **argv)
 {
 	struct arguments arguments;
-	time_t startTime = time(NULL);
-	time_t endTime;
+	int64_t startTime = BTimeNow();
+	int64_t endTime;
 	RGBinary rg;
 	char *readGroup=NULL;
 
@@ -146,11 +151,16 @@ BfastPostProcess(int argc, char **argv)
 							arguments.insertSizeAvg,
 							arguments.insertSizeStdDev,
 							arguments.numThreads,
+							arguments.numFormatThreads,
 							arguments.queueLength,
 							arguments.outputFormat,
 							arguments.outputID,
 							readGroup,
                                                         arguments.baseQualityType,
+							arguments.sort,
+							arguments.sortMemoryLimit,
+							arguments.tmpDir,
+							arguments.timing,
 							stdout);
 					if(BAF != arguments.outputFormat) {
 						/* Free rg binary */
@@ -161,14 +171,12 @@ BfastPostProcess(int argc, char **argv)
 					}
 					if(arguments.timing == 1) {
 						/* Get the time information */
-						endTime = time(NULL);
-						int seconds = endTime - startTime;
-						int hours = seconds/3600;
-						seconds -= hours*3600;
-						int minutes = seconds/60;
-						seconds -= minutes*60;
+						endTime = BTimeNow();
+						int hours, minutes;
+						double seconds;
+						BTimeSplit(endTime - startTime, &hours, &minutes, &seconds);
 						if(0 <= VERBOSE) {
-							fprintf(stderr, "Total time elapsed: %d hours, %d minutes and %d seconds.\n",
+							fprintf(stderr, "Total time elapsed: %d hours, %d minutes and %.3lf seconds.\n",
 									hours,
 									minutes,
 									seconds
@@ -258,6 +266,10 @@ int BfastPostProcessValidateInputs(struct arguments *args) {
 		PrintError(FnName, "numThreads", "Command line argument", Exit, OutOfRange);
 	}
 
+	if(args->numFormatThreads <= 0) {
+		PrintError(FnName, "numFormatThreads", "Command line argument", Exit, OutOfRange);
+	}
+
 	if(args->queueLength<=0) {		
 		PrintError(FnName, "queueLength", "Command line argument", Exit, OutOfRange);
 	}
@@ -298,6 +310,24 @@ int BfastPostProcessValidateInputs(struct arguments *args) {
 		PrintError(FnName, "RGFileName", "Command line argument can only be used when outputting to SAM format", Exit, OutOfRange);
 	}
 
+	assert(args->sort == 0 || args->sort == 1);
+	if(SAM != args->outputFormat && 1 == args->sort) {
+		PrintError(FnName, "sort", "Command line argument can only be used when outputting to SAM format", Exit, OutOfRange);
+	}
+
+	if(args->sortMemoryLimit <= 0) {
+		PrintError(FnName, "sortMemoryLimit", "Command line argument", Exit, OutOfRange);
+	}
+
+	if(args->tmpDir!=0) {
+		if(0 <= VERBOSE) {
+			fprintf(stderr, "Validating tmpDir path %s. \n",
+					args->tmpDir);
+		}
+		if(ValidatePath(args->tmpDir)==0)
+			PrintError(FnName, "tmpDir", "Command line argument", Exit, IllegalPath);	
+	}
+
 	if (1 == args->insertSizeSpecified) {
 		if (args->insertSizeStdDev <= 0.0) {
 			PrintError(FnName, "insertSizeStdDev", "When specifying insertSizeAvg, you must also specify an insertSizeStdDev > 0.", Exit, OutOfRange);
@@ -335,12 +365,20 @@ BfastPostProcessAssignDefaultValues(struct arguments *args)
 	args->insertSizeStdDev=0.0;
 	args->avgMismatchQuality=AVG_MISMATCH_QUALITY;
 	args->numThreads=1;
+	args->numFormatThreads=1;
 	args->queueLength=DEFAULT_POSTPROCESS_QUEUE_LENGTH;
 
 	args->outputFormat=SAM;
 	args->outputID=NULL;
 	args->RGFileName=NULL;
         args->baseQualityType=0;
+	args->sort=0;
+	args->sortMemoryLimit=POSTPROCESS_SORT_DEFAULT_MEMORY_LIMIT;
+
+	args->tmpDir =
+		(char*)malloc(sizeof(DEFAULT_OUTPUT_DIR));
+	assert(args->tmpDir!=0);
+	strcpy(args->tmpDir, DEFAULT_OUTPUT_DIR);
 
 	args->timing = 0;
 
@@ -382,11 +420,15 @@ BfastPostProcessPrintProgramParameters(FILE* fp, struct arguments *args)
 			fprintf(fp, "insertSizeStdDev:\t\t%s\n", INTUSING(0));
                 }
 		fprintf(fp, "numThreads:\t\t\t%d\n", args->numThreads);
+		fprintf(fp, "numFormatThreads:\t\t%d\n", args->numFormatThreads);
 		fprintf(fp, "queueLength:\t\t\t%d\n", args->queueLength);
 		fprintf(fp, "outputFormat:\t\t\t%s\n", outputType[args->outputFormat]);
 		fprintf(fp, "outputID:\t\t\t%s\n", FILEUSING(args->outputID));
 		fprintf(fp, "RGFileName:\t\t\t%s\n", FILEUSING(args->RGFileName));
 		fprintf(fp, "baseQualityType:\t\t\t%s\n", baseQualityType[args->baseQualityType]);
+		fprintf(fp, "sort:\t\t\t\t%s\n", INTUSING(args->sort));
+		fprintf(fp, "sortMemoryLimit:\t\t%d\n", args->sortMemoryLimit);
+		fprintf(fp, "tmpDir:\t\t\t\t%s\n", args->tmpDir);
 		fprintf(fp, "timing:\t\t\t\t%s\n", INTUSING(args->timing));
 		fprintf(fp, BREAK_LINE);
 	}
@@ -406,6 +448,8 @@ void BfastPostProcessFreeProgramParameters(struct arguments *args)
 	args->RGFileName=NULL;
 	free(args->scoringMatrixFileName);
 	args->scoringMatrixFileName=NULL;
+	free(args->tmpDir);
+	args->tmpDir=NULL;
 }
 
 /* TODO */
@@ -482,6 +526,12 @@ BfastPostProcessGetOptParse(int argc, char** argv, char OptionString[], struct a
 				arguments->randomBest = 1; break;
 			case 'A':
 				arguments->space=atoi(optarg);break;
+			case 'C':
+				arguments->sort = 1; break;
+			case 'F':
+				arguments->numFormatThreads=atoi(optarg);break;
+			case 'L':
+				arguments->sortMemoryLimit=atoi(optarg);break;
 			case 'M':
 				arguments->minNormalizedScore=atoi(optarg);break;
 			case 'O':
@@ -503,6 +553,9 @@ BfastPostProcessGetOptParse(int argc, char** argv, char OptionString[], struct a
 			case 'S':
 				arguments->pairing = 0; 
 				arguments->strandedness = atoi(optarg); break;
+			case 'T':
+				StringCopyAndReallocate(&arguments->tmpDir, optarg);
+				break;
 			case 'P':
 				arguments->pairing = 0; 
 				arguments->positioning = atoi(optarg); break;
@@ -24,11 +24,15 @@ struct arguments
 	double insertSizeAvg;						/* -v */
 	double insertSizeStdDev;					/* -s */
 	int numThreads;							/* -n */
+	int numFormatThreads;					/* -F */
 	int queueLength;						/* -Q */
 	int outputFormat;						/* -O */
 	char *outputID;							/* -o */
 	char *RGFileName;						/* -r */
 	int baseQualityType;						/* -b */
+	int sort;								/* -C */
+	int sortMemoryLimit;					/* -L */
+	char *tmpDir;							/* -T */
 	int timing;                             /* -t */
 	int programMode;						/* -h */ 
 };
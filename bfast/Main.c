@@ -19,6 +19,7 @@ static int usage()
 	fprintf(stderr, "Pre-processing:\n");
 	fprintf(stderr, "         fasta2brg\n");
 	fprintf(stderr, "         index\n");
+	fprintf(stderr, "         index-serve\n");
 	fprintf(stderr, "\n");
 	fprintf(stderr, "Alignment:\n");
 	fprintf(stderr, "         match\n");
@@ -32,6 +33,7 @@ static int usage()
 	fprintf(stderr, "         header\n");
 	fprintf(stderr, "         bmfconvert\n");
 	fprintf(stderr, "         brg2fasta\n");
+	fprintf(stderr, "         brg2mmap\n");
 	fprintf(stderr, "\n");
 	fprintf(stderr, "Easy Alignment:\n");
 	fprintf(stderr, "         easyalign\n");
@@ -43,6 +45,7 @@ int main(int argc, char *argv[])
 	if(argc < 2) return usage();
 	else if (0 == strcmp("fasta2brg", argv[1])) return BfastFasta2BRG(argc-1, argv+1);
 	else if (0 == strcmp("index", argv[1])) return BfastIndex(argc-1, argv+1);
+	else if (0 == strcmp("index-serve", argv[1])) return BfastIndexServe(argc-1, argv+1);
 	else if (0 == strcmp("match", argv[1])) return BfastMatch(argc-1, argv+1);
 	else if (0 == strcmp("localalign", argv[1])) return BfastLocalAlign(argc-1, argv+1);
 	else if (0 == strcmp("postprocess", argv[1])) return BfastPostProcess(argc-1, argv+1);
@@ -50,6 +53,7 @@ int main(int argc, char *argv[])
 	else if (0 == strcmp("header", argv[1])) return BfastHeader(argc-1, argv+1);
 	else if (0 == strcmp("bmfconvert", argv[1])) return BfastBMFConvert(argc-1, argv+1);
 	else if (0 == strcmp("brg2fasta", argv[1])) return BfastBRG2Fasta(argc-1, argv+1);
+	else if (0 == strcmp("brg2mmap", argv[1])) return BfastBRG2MMap(argc-1, argv+1);
 	else if (0 == strcmp("easyalign", argv[1])) return BfastAlign(argc-1, argv+1);
 	else {
 		PrintError("bfast", argv[1], "Unknown command", Exit, OutOfRange);
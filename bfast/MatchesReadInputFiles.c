@@ -7,6 +7,7 @@
 #include "BLib.h"
 #include "RGMatch.h"
 #include "RGMatches.h"
+#include "RGBloom.h"
 #include "aflib.h"
 #include "kseq.h"
 #include "MatchesReadInputFiles.h"
@@ -108,6 +109,7 @@ void WriteReadsToTempFile(AFILE *seqFP,
 		int startReadNum, 
 		int endReadNum, 
 		char *tmpDir,
+		int32_t tmpCompression,
 		int *numWritten,
 		int32_t space)
 {
@@ -116,7 +118,7 @@ void WriteReadsToTempFile(AFILE *seqFP,
 	kseq_t *seq=NULL;
 
 	// Open temporary file
-	(*tmpSeqFP) = OpenTmpGZFile(tmpDir, tmpSeqFileName);
+	(*tmpSeqFP) = OpenTmpGZFile(tmpDir, tmpSeqFileName, tmpCompression);
 
 	seq = kseq_init(seqFP);
 	RGMatchesInitialize(&m);
@@ -163,16 +165,22 @@ void WriteReadsToTempFile(AFILE *seqFP,
 /* TODO */
 /* Go through the temporary output file and output those reads that have 
  * at least one match to the final output file.  For those reads that have
- * zero matches, output them to the temporary read file *
+ * zero matches, output them to the temporary read file, unless no end has
+ * minKeys of its keys in the Bloom filter of any of the next indexes (if
+ * given), in which case output them unmatched to the final output file.
  * */
-int ReadTempReadsAndOutput(gzFile tempOutputFP,
-		char *tempOutputFileName,
+int ReadTempReadsAndOutput(gzFile *tempOutputFP,
+		char **tempOutputFileName,
 		gzFile outputFP,
-		AFILE *tempRGMatchesFP)
+		AFILE *tempRGMatchesFP,
+		RGBloom *blooms,
+		int numBlooms,
+		int minKeys,
+		int64_t *numRejected)
 {
 	char *FnName = "ReadTempReadsAndOutput";
 	RGMatches m;
-	int32_t i;
+	int32_t i, j;
 	int numReads = 0;
 	int numOutputted=0;
 	int hasEntries=0;
@@ -181,10 +189,10 @@ int ReadTempReadsAndOutput(gzFile tempOutputFP,
 	RGMatchesInitialize(&m);
 
 	/* Go to the beginning of the temporary output file */
-	ReopenTmpGZFile(&tempOutputFP,
-			&tempOutputFileName);
+	ReopenTmpGZFile(tempOutputFP,
+			tempOutputFileName);
 
-	while(RGMatchesRead(tempOutputFP, 
+	while(RGMatchesRead((*tempOutputFP), 
 				&m)!=EOF) {
 		/* Output if any end has more than one entry */
 		for(i=hasEntries=0;0==hasEntries && i<m.numEnds;i++) {
@@ -192,11 +200,24 @@ int ReadTempReadsAndOutput(gzFile tempOutputFP,
 				hasEntries=1;
 			}
 		}
+		/* Check if any index could find any end (-1 if none can) */
+		if(0 == hasEntries && 0 < numBlooms) {
+			for(i=0,hasEntries=-1;-1==hasEntries && i<m.numEnds;i++) {
+				for(j=0;-1==hasEntries && j<numBlooms;j++) {
+					if(1 == RGBloomCheckRead(&blooms[j], m.ends[i].read, m.ends[i].readLength, minKeys)) {
+						hasEntries=0;
+					}
+				}
+			}
+		}
 		/* Output to final output file */
-		if(1 == hasEntries) {
+		if(0 != hasEntries) {
 			RGMatchesPrint(outputFP,
 					&m);
 			numOutputted++;
+			if(-1 == hasEntries) {
+				(*numRejected)++;
+			}
 		}
 		else {
 			/* Put back in the read file */
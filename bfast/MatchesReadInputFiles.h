@@ -9,8 +9,8 @@
 
 int WriteRead(FILE*, RGMatches*);
 int WriteReadAFILE(AFILE*, RGMatches*);
-void WriteReadsToTempFile(AFILE*, gzFile*, char**, int, int, char*, int*, int32_t);
-int ReadTempReadsAndOutput(gzFile, char*, gzFile, AFILE*); 
+void WriteReadsToTempFile(AFILE*, gzFile*, char**, int, int, char*, int32_t, int*, int32_t);
+int ReadTempReadsAndOutput(gzFile*, char**, gzFile, AFILE*, RGBloom*, int, int, int64_t*); 
 void ReadRGIndex(char*, RGIndex*, int);
 int GetIndexFileNames(char*, int32_t, char*, char***, int32_t***);
 int32_t ReadOffsets(char*, int32_t**);
@@ -3,6 +3,12 @@
 #include <string.h>
 #include <assert.h>
 #include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <pthread.h>
 #ifdef HAVE_CONFIG_H
 #include <config.h>
 #include <zlib.h>
@@ -16,28 +22,28 @@
 /* Read from fasta file */
 void RGBinaryRead(char *fastaFileName, 
 		RGBinary *rg,
-		int32_t space)
+		int32_t space,
+		int32_t numThreads)
 {
 	char *FnName="RGBinaryRead";
 	FILE *fpRG=NULL;
-	int32_t i;
-	char c;
-	char original;
 	int64_t numPosRead=0;
-	int32_t byteIndex;
-	int32_t numCharsPerByte;
+	RGBinaryPackTables *tables=NULL;
+
+	char *block=NULL;
+	int64_t blockLength=0, blockIndex=0, segmentLength;
+	char *newLine=NULL;
+	int32_t lineStart=1, inHeader=0, eofReached=0, firstLine=1;
 
-	char curLine[MAX_FASTA_LINE_LENGTH]="\0";
-	char *buffer=NULL;
-	int64_t bufferLength=0, prevBufferLength=0;
-	int64_t bufferIndex=0;
 	char header[MAX_CONTIG_NAME_LENGTH]="\0";
-	char nextHeader[MAX_CONTIG_NAME_LENGTH]="\0";
-	char prevBase = COLOR_SPACE_START_NT; /* For color space */
+	int32_t headerLength=0;
+	/* The contigs read but not yet packed */
+	RGBinaryPackBatch batch;
+	int64_t batchLength=0;
+	int32_t inContig=0;
 
 	/* We assume that we can hold 2 [acgt] (nts) in each byte */
 	assert(ALPHABET_SIZE==4);
-	numCharsPerByte=ALPHABET_SIZE/2;
 
 	/* Initialize the data structure for holding the rg */
 	rg->id=BFAST_ID;
@@ -48,6 +54,8 @@ void RGBinaryRead(char *fastaFileName,
 	}
 	strcpy(rg->packageVersion, PACKAGE_VERSION);
 	rg->packed=RGBinaryPacked;
+	rg->map=NULL;
+	rg->mapLength=0;
 	rg->contigs=NULL;
 	rg->numContigs=0;
 	rg->space=space;
@@ -63,6 +71,18 @@ void RGBinaryRead(char *fastaFileName,
 		PrintError(FnName, fastaFileName, "Could not open file for reading", Exit, OpenFileError);
 	}
 
+	/* Allocate memory */
+	block = malloc(sizeof(char)*RGBINARY_READ_BLOCK_SIZE);
+	if(NULL == block) {
+		PrintError(FnName, "block", "Could not allocate memory", Exit, MallocMemory);
+	}
+	tables = malloc(sizeof(RGBinaryPackTables));
+	if(NULL == tables) {
+		PrintError(FnName, "tables", "Could not allocate memory", Exit, MallocMemory);
+	}
+	RGBinaryPackTablesInitialize(tables);
+	RGBinaryPackBatchInitialize(&batch);
+
 	/*****/
 	/* Read in the sequence for each contig. */
 	/*****/
@@ -73,181 +93,454 @@ void RGBinaryRead(char *fastaFileName,
 				1);
 	}
 	rg->numContigs=0;
-	// Get a header
-	if(NULL==fgets(nextHeader, MAX_CONTIG_NAME_LENGTH, fpRG)) {
-		PrintError(FnName, "nextHeader", "Could not find a fasta header", Exit, OutOfRange);
-	}
-	int32_t eofReached = 0;
 	while(0 == eofReached) {
-		strcpy(header, nextHeader);
-		ParseFastaHeaderLine(header);
-
-		/* Get sequence */
-		curLine[0]='\0';
-		buffer=NULL;
-		bufferLength=prevBufferLength=0;
-		while(NULL!=fgets(curLine, MAX_FASTA_LINE_LENGTH, fpRG)) {
-
-			if('>' == curLine[0]) {
-				strcpy(nextHeader, curLine);
+		/* Get the next block */
+		if(blockLength <= blockIndex) {
+			blockLength = fread(block, sizeof(char), RGBINARY_READ_BLOCK_SIZE, fpRG);
+			blockIndex = 0;
+			if(blockLength <= 0) {
+				if(0 != ferror(fpRG)) {
+					PrintError(FnName, fastaFileName, "Could not read from file", Exit, ReadFileError);
+				}
+				eofReached = 1;
 				break;
 			}
-			if('\n' == curLine[strlen(curLine)-1]) {
-				curLine[strlen(curLine)-1]='\0';
+		}
+
+		/* Get the rest of the line in this block */
+		newLine = memchr(block + blockIndex, '\n', blockLength - blockIndex);
+		segmentLength = (NULL == newLine)?(blockLength - blockIndex):(newLine - (block + blockIndex));
+
+		if(1 == lineStart) {
+			/* The first line is always a header */
+			inHeader = (1 == firstLine || '>' == block[blockIndex])?1:0;
+			firstLine = 0;
+			if(1 == inHeader) {
+				/* End the previous contig */
+				if(1 == inContig) {
+					if(0 == batch.lengths[batch.numContigs-1]) {
+						/* Stop at an empty contig */
+						inHeader = 0;
+						break;
+					}
+					/* Pack if we have read enough */
+					if(RGBINARY_PACK_BATCH_SIZE <= batchLength) {
+						numPosRead += RGBinaryPackBatchPack(&batch, rg, space, tables, numThreads);
+						batchLength = 0;
+					}
+				}
+				headerLength = 0;
 			}
+		}
 
-			prevBufferLength=bufferLength;
-			bufferLength += strlen(curLine);
-			buffer = realloc(buffer, sizeof(char)*(1+bufferLength));
-			if(NULL == buffer) {
-				PrintError(FnName, "buffer", "Could not reallocate memory", Exit, ReallocMemory);
+		if(1 == inHeader) {
+			/* Keep as much of the header as fits */
+			if(MAX_CONTIG_NAME_LENGTH - 1 - headerLength < segmentLength) {
+				memcpy(header + headerLength, block + blockIndex, MAX_CONTIG_NAME_LENGTH - 1 - headerLength);
+				headerLength = MAX_CONTIG_NAME_LENGTH - 1;
+			}
+			else {
+				memcpy(header + headerLength, block + blockIndex, segmentLength);
+				headerLength += segmentLength;
 			}
-			for(i=prevBufferLength;i<bufferLength;i++) {
-				buffer[i] = curLine[i-prevBufferLength];
+			header[headerLength] = '\0';
+			if(NULL != newLine) {
+				/* Start a new contig */
+				ParseFastaHeaderLine(header);
+				RGBinaryPackBatchAdd(&batch, header);
+				inContig = 1;
+				inHeader = 0;
 			}
-			buffer[bufferLength]='\0';
+		}
+		else {
+			/* Add the sequence */
+			RGBinaryPackBatchAppend(&batch, block + blockIndex, segmentLength);
+			batchLength += segmentLength;
 		}
 
-		if(bufferLength <= 0) {
-			break;
+		blockIndex += segmentLength + ((NULL == newLine)?0:1);
+		lineStart = (NULL == newLine)?0:1;
+	}
+	if(1 == firstLine) {
+		PrintError(FnName, "nextHeader", "Could not find a fasta header", Exit, OutOfRange);
+	}
+	if(1 == inHeader) {
+		/* A header at the end of the file */
+		ParseFastaHeaderLine(header);
+		RGBinaryPackBatchAdd(&batch, header);
+	}
+	/* Pack the rest, without any trailing empty contig */
+	if(0 < batch.numContigs && 0 == batch.lengths[batch.numContigs-1]) {
+		RGBinaryPackBatchPop(&batch);
+	}
+	numPosRead += RGBinaryPackBatchPack(&batch, rg, space, tables, numThreads);
+
+	if(VERBOSE >= 0) {
+		if(0 < rg->numContigs) {
+			PrintContigPos(stderr,
+					rg->numContigs, 
+					rg->contigs[rg->numContigs-1].sequenceLength);
 		}
+		fprintf(stderr, "\n");
+	}
 
-		rg->numContigs++;
-
-		/* Reallocate memory to store one more contig. */
-		rg->contigs = realloc(rg->contigs, rg->numContigs*sizeof(RGBinaryContig));
-		if(NULL == rg->contigs) {
-			PrintError(FnName, "rg->contigs", "Could not reallocate memory", Exit, ReallocMemory);
-		}
-		/* Allocate memory for contig name */
-		rg->contigs[rg->numContigs-1].contigNameLength=strlen(header);
-		rg->contigs[rg->numContigs-1].contigName = malloc(sizeof(char)*(rg->contigs[rg->numContigs-1].contigNameLength+1));
-		if(NULL==rg->contigs[rg->numContigs-1].contigName) {
-			PrintError(FnName, "rg->contigs[rg->numContigs-1].contigName", "Could not allocate memory", Exit, MallocMemory);
-		}
-		/* Copy over contig name */
-		strcpy(rg->contigs[rg->numContigs-1].contigName, header); 
-		/* Initialize contig */
-		rg->contigs[rg->numContigs-1].sequence = NULL;
-		rg->contigs[rg->numContigs-1].sequenceLength = 0;
-		rg->contigs[rg->numContigs-1].numBytes = 0;
-
-		prevBase = COLOR_SPACE_START_NT; /* For color space */
-		for(bufferIndex=0;bufferIndex<bufferLength;bufferIndex++) {
-			original=buffer[bufferIndex];
-			/* original - will be the original sequence.  Possibilities include:
-			 * Non-repeat sequence: a,c,g,t
-			 * Repeat sequence: A,C,G,T
-			 * Null Character: N,n
-			 * */
-
-			/* Transform IUPAC codes */
-			original=TransformFromIUPAC(original);
-
-			if(ColorSpace==space) {
-				/* Convert to color space */
-				/* Convert color space to A,C,G,T */
-				if(0 == ConvertBaseToColorSpace(prevBase, original, &c)) {
-					fprintf(stderr, "bufferIndex=%lld\n", (long long int)bufferIndex);
-					fprintf(stderr, "prevBase=[%c]\toriginal=[%c]\n",
-							prevBase,
-							original);
-					PrintError(FnName, "c", "Could not convert base to color space", Exit, OutOfRange);
-				}
-				/* Convert to nucleotide equivalent for storage */
-				/* Store 0=A, 1=C, 2=G, 3=T, else N */
-				c = ConvertColorToStorage(c);
-				/* Update if it is a repeat */
-				/* For repeat sequence, if both the previous base and 
-				 * current base are non-repeat, the color is non-repeat.
-				 * Otherwise, it is repeat sequence */
-				if(RGBinaryIsBaseRepeat(prevBase) == 1 || RGBinaryIsBaseRepeat(original) == 1) {
-					/* Repeat */
-					prevBase = original; /* Update the previous base */
-					original = ToUpper(c);
-				}
-				else {
-					/* Non-repeat */
-					prevBase = original; /* Update the previous base */
-					original = ToLower(c);
-				}
-			}
+	/* Close file */
+	fclose(fpRG);
 
-			if(VERBOSE >= 0) {
-				if(0==rg->contigs[rg->numContigs-1].sequenceLength % READ_ROTATE_NUM) {
-					PrintContigPos(stderr,
-							rg->numContigs,
-							rg->contigs[rg->numContigs-1].sequenceLength);
-				}
-			}
+	/* Free memory */
+	RGBinaryPackBatchFree(&batch);
+	free(block);
+	free(tables);
+
+	if(VERBOSE>=0) {
+		fprintf(stderr, "In total read %d contigs for a total of %lld bases\n",
+				rg->numContigs,
+				(long long int)numPosRead);
+		fprintf(stderr, "%s", BREAK_LINE);
+	}
+}
+
+/* TODO */
+/* Gets the four bits stored for a base, or -1 if it can not be stored */
+int32_t RGBinaryGetPackCode(char base)
+{
+	int32_t code;
 
-			/* Validate base pair */
-			if(ValidateBasePair(original)==0) {
-				fprintf(stderr, "Base:[%c]\n", original);
-				PrintError(FnName, "original", "Not a valid base pair", Exit, OutOfRange);
+	/* left two bits: the repeat */
+	switch(base) {
+		case 'a':
+		case 'c':
+		case 'g':
+		case 't':
+			code = 0x0;
+			break;
+		case 'A':
+		case 'C':
+		case 'G':
+		case 'T':
+			code = 0x4;
+			break;
+		case 'N':
+		case 'n':
+			code = 0x8;
+			break;
+		default:
+			return -1;
+	}
+	/* right two bits: the base */
+	switch(base) {
+		case 'C':
+		case 'c':
+			code |= 0x1;
+			break;
+		case 'G':
+		case 'g':
+			code |= 0x2;
+			break;
+		case 'T':
+		case 't':
+			code |= 0x3;
+			break;
+		default:
+			break;
+	}
+	return code;
+}
+
+/* TODO */
+void RGBinaryPackTablesInitialize(RGBinaryPackTables *tables)
+{
+	int32_t i, j, a, b;
+	char c, original;
+
+	for(i=0;i<256;i++) {
+		tables->transform[i] = (uint8_t)TransformFromIUPAC((char)i);
+	}
+
+	/* Two nucleotides to a byte */
+	for(i=0;i<256;i++) {
+		a = RGBinaryGetPackCode(tables->transform[i]);
+		for(j=0;j<256;j++) {
+			b = RGBinaryGetPackCode(tables->transform[j]);
+			tables->pair[(i << 8) | j] = (a < 0 || b < 0)?RGBINARY_PACK_INVALID:((a << 4) | b);
+		}
+	}
+
+	/* The color given the previous and current transformed bases */
+	for(i=0;i<256;i++) {
+		for(j=0;j<256;j++) {
+			tables->color[(i << 8) | j] = RGBINARY_PACK_INVALID;
+			if(0 == ConvertBaseToColorSpace((char)i, (char)j, &c)) {
+				continue;
 			}
-			/* Get which byte to insert */
-			byteIndex = rg->contigs[rg->numContigs-1].sequenceLength%numCharsPerByte;
-			/* Check if we must allocate a new byte */
-			if(byteIndex==0) {
-				/* Update the number of bytes */
-				rg->contigs[rg->numContigs-1].numBytes++;
-				/* Reallocate a new byte */
-				rg->contigs[rg->numContigs-1].sequence = realloc(rg->contigs[rg->numContigs-1].sequence, sizeof(char)*(rg->contigs[rg->numContigs-1].numBytes));
-				if(NULL == rg->contigs[rg->numContigs-1].sequence) {
-					PrintError(FnName, "rg->contigs[rg->numContigs-1].sequence", "Could not reallocate memory", Exit, ReallocMemory);
-				}
-				/* Initialize the byte */
-				rg->contigs[rg->numContigs-1].sequence[rg->contigs[rg->numContigs-1].numBytes-1] = 0;
+			/* Store 0=A, 1=C, 2=G, 3=T, else N */
+			c = ConvertColorToStorage(c);
+			/* For repeat sequence, if both the previous base and 
+			 * current base are non-repeat, the color is non-repeat.
+			 * Otherwise, it is repeat sequence */
+			if(RGBinaryIsBaseRepeat((char)i) == 1 || RGBinaryIsBaseRepeat((char)j) == 1) {
+				original = ToUpper(c);
+			}
+			else {
+				original = ToLower(c);
 			}
-			/* Insert the sequence correctly (as opposed to incorrectly) */
-			RGBinaryInsertBase(&rg->contigs[rg->numContigs-1].sequence[rg->contigs[rg->numContigs-1].numBytes-1], 
-					byteIndex, 
-					original);
-			rg->contigs[rg->numContigs-1].sequenceLength++;
-			numPosRead++;
-			if(rg->contigs[rg->numContigs-1].sequenceLength >= UINT_MAX) {
-				PrintError(FnName, "sequenceLength", "Maximum sequence length for a given contig was reached", Exit, OutOfRange);
+			a = RGBinaryGetPackCode(original);
+			if(0 <= a) {
+				tables->color[(i << 8) | j] = a;
 			}
 		}
-		/* Update our our output */
-		if(VERBOSE >= 0) {
-			PrintContigPos(stderr,
-					rg->numContigs, 
-					rg->contigs[rg->numContigs-1].sequenceLength);
+	}
+}
+
+/* TODO */
+void RGBinaryPackBatchInitialize(RGBinaryPackBatch *batch)
+{
+	batch->names = NULL;
+	batch->sequences = NULL;
+	batch->lengths = NULL;
+	batch->capacities = NULL;
+	batch->numContigs = 0;
+}
+
+/* TODO */
+void RGBinaryPackBatchAdd(RGBinaryPackBatch *batch,
+		char *name)
+{
+	char *FnName="RGBinaryPackBatchAdd";
+	int32_t n = batch->numContigs + 1;
+
+	batch->names = realloc(batch->names, sizeof(char*)*n);
+	batch->sequences = realloc(batch->sequences, sizeof(char*)*n);
+	batch->lengths = realloc(batch->lengths, sizeof(int64_t)*n);
+	batch->capacities = realloc(batch->capacities, sizeof(int64_t)*n);
+	if(NULL == batch->names || NULL == batch->sequences || NULL == batch->lengths || NULL == batch->capacities) {
+		PrintError(FnName, "batch", "Could not reallocate memory", Exit, ReallocMemory);
+	}
+	batch->names[n-1] = strdup(name);
+	if(NULL == batch->names[n-1]) {
+		PrintError(FnName, "batch->names[n-1]", "Could not allocate memory", Exit, MallocMemory);
+	}
+	batch->sequences[n-1] = NULL;
+	batch->lengths[n-1] = 0;
+	batch->capacities[n-1] = 0;
+	batch->numContigs = n;
+}
+
+/* TODO */
+/* Appends sequence to the last contig, growing it geometrically */
+void RGBinaryPackBatchAppend(RGBinaryPackBatch *batch,
+		char *sequence,
+		int64_t length)
+{
+	char *FnName="RGBinaryPackBatchAppend";
+	int32_t i = batch->numContigs - 1;
+
+	assert(0 <= i);
+	if(batch->capacities[i] < batch->lengths[i] + length) {
+		batch->capacities[i] = (batch->capacities[i] < RGBINARY_READ_BLOCK_SIZE)?RGBINARY_READ_BLOCK_SIZE:batch->capacities[i];
+		while(batch->capacities[i] < batch->lengths[i] + length) {
+			batch->capacities[i] *= 2;
+		}
+		batch->sequences[i] = realloc(batch->sequences[i], sizeof(char)*batch->capacities[i]);
+		if(NULL == batch->sequences[i]) {
+			PrintError(FnName, "batch->sequences[i]", "Could not reallocate memory", Exit, ReallocMemory);
 		}
+	}
+	memcpy(batch->sequences[i] + batch->lengths[i], sequence, length);
+	batch->lengths[i] += length;
+}
+
+/* TODO */
+void RGBinaryPackBatchPop(RGBinaryPackBatch *batch)
+{
+	assert(0 < batch->numContigs);
+	batch->numContigs--;
+	free(batch->names[batch->numContigs]);
+	free(batch->sequences[batch->numContigs]);
+}
 
-		/* Reallocate to reduce memory (fit exactly) */
-		assert(numCharsPerByte==2);
-		/* we must add one since there could be an odd number of positions */
-		rg->contigs[rg->numContigs-1].sequence = realloc(rg->contigs[rg->numContigs-1].sequence, sizeof(char)*(rg->contigs[rg->numContigs-1].numBytes));
-		if(NULL == rg->contigs[rg->numContigs-1].sequence) {
-			PrintError(FnName, "rg->contigs[numContigs-1].sequence", "Could not reallocate memory", Exit, ReallocMemory);
+/* TODO */
+/* Packs the contigs in the batch, adds them to the reference genome, and
+ * empties the batch.  Returns the number of bases packed. */
+int64_t RGBinaryPackBatchPack(RGBinaryPackBatch *batch,
+		RGBinary *rg,
+		int32_t space,
+		RGBinaryPackTables *tables,
+		int32_t numThreads)
+{
+	char *FnName="RGBinaryPackBatchPack";
+	int32_t i, errCode, start;
+	int64_t numPosRead=0;
+	RGBinaryPackThreadData *data=NULL;
+	pthread_t *threads=NULL;
+	void *status=NULL;
+
+	if(batch->numContigs <= 0) {
+		return 0;
+	}
+
+	/* Add the contigs */
+	start = rg->numContigs;
+	rg->numContigs += batch->numContigs;
+	rg->contigs = realloc(rg->contigs, rg->numContigs*sizeof(RGBinaryContig));
+	if(NULL == rg->contigs) {
+		PrintError(FnName, "rg->contigs", "Could not reallocate memory", Exit, ReallocMemory);
+	}
+	for(i=0;i<batch->numContigs;i++) {
+		if(INT_MAX < batch->lengths[i]) {
+			PrintError(FnName, "sequenceLength", "Maximum sequence length for a given contig was reached", Exit, OutOfRange);
+		}
+		/* Move the contig name */
+		rg->contigs[start+i].contigName = batch->names[i];
+		rg->contigs[start+i].contigNameLength = strlen(batch->names[i]);
+		batch->names[i] = NULL;
+		/* Allocate the sequence */
+		rg->contigs[start+i].sequenceLength = batch->lengths[i];
+		rg->contigs[start+i].numBytes = (batch->lengths[i] + 1)/2;
+		rg->contigs[start+i].sequence = malloc(sizeof(char)*rg->contigs[start+i].numBytes);
+		if(NULL == rg->contigs[start+i].sequence) {
+			PrintError(FnName, "rg->contigs[start+i].sequence", "Could not allocate memory", Exit, MallocMemory);
+		}
+		numPosRead += batch->lengths[i];
+	}
+
+	/* Each thread packs its part of every contig */
+	data = malloc(sizeof(RGBinaryPackThreadData)*numThreads);
+	if(NULL == data) {
+		PrintError(FnName, "data", "Could not allocate memory", Exit, MallocMemory);
+	}
+	threads = malloc(sizeof(pthread_t)*numThreads);
+	if(NULL == threads) {
+		PrintError(FnName, "threads", "Could not allocate memory", Exit, MallocMemory);
+	}
+	for(i=0;i<numThreads;i++) {
+		data[i].sequences = batch->sequences;
+		data[i].lengths = batch->lengths;
+		data[i].contigs = rg->contigs + start;
+		data[i].numContigs = batch->numContigs;
+		data[i].space = space;
+		data[i].tables = tables;
+		data[i].threadID = i;
+		data[i].numThreads = numThreads;
+	}
+	for(i=0;i<numThreads;i++) {
+		errCode = pthread_create(&threads[i], /* thread struct */
+				NULL, /* default thread attributes */
+				RGBinaryPackThread, /* start routine */
+				&data[i]); /* data to routine */
+		if(0!=errCode) {
+			PrintError(FnName, "pthread_create: errCode", "Could not start thread", Exit, ThreadError);
 		}
-		/* End loop for the current contig */
-		free(buffer);
-		buffer=NULL;
-		bufferLength=0;
-		if(0 != feof(fpRG)) {
-			eofReached=1;
+	}
+	for(i=0;i<numThreads;i++) {
+		errCode = pthread_join(threads[i],
+				&status);
+		if(0!=errCode) {
+			PrintError(FnName, "pthread_join: errCode", "Thread returned an error", Exit, ThreadError);
 		}
 	}
+
+	/* Update our our output */
 	if(VERBOSE >= 0) {
 		PrintContigPos(stderr,
 				rg->numContigs, 
 				rg->contigs[rg->numContigs-1].sequenceLength);
-		fprintf(stderr, "\n");
 	}
 
-	/* Close file */
-	fclose(fpRG);
+	/* Empty the batch */
+	while(0 < batch->numContigs) {
+		RGBinaryPackBatchPop(batch);
+	}
+	free(data);
+	free(threads);
 
-	if(VERBOSE>=0) {
-		fprintf(stderr, "In total read %d contigs for a total of %lld bases\n",
-				rg->numContigs,
-				(long long int)numPosRead);
-		fprintf(stderr, "%s", BREAK_LINE);
+	return numPosRead;
+}
+
+/* TODO */
+void RGBinaryPackBatchFree(RGBinaryPackBatch *batch)
+{
+	while(0 < batch->numContigs) {
+		RGBinaryPackBatchPop(batch);
+	}
+	free(batch->names);
+	free(batch->sequences);
+	free(batch->lengths);
+	free(batch->capacities);
+	RGBinaryPackBatchInitialize(batch);
+}
+
+/* TODO */
+void *RGBinaryPackThread(void *arg)
+{
+	char *FnName="RGBinaryPackThread";
+	RGBinaryPackThreadData *data = (RGBinaryPackThreadData*)arg;
+	RGBinaryPackTables *tables = data->tables;
+	int32_t i;
+	int64_t j, startPos, endPos, length;
+	uint8_t *src=NULL;
+	uint8_t *dest=NULL;
+	uint16_t code, prev;
+
+	for(i=0;i<data->numContigs;i++) {
+		/* Our part of the contig, starting on a byte */
+		length = data->lengths[i];
+		startPos = (length*data->threadID/data->numThreads) & ~((int64_t)1);
+		endPos = (data->threadID == data->numThreads - 1)?length:((length*(data->threadID+1)/data->numThreads) & ~((int64_t)1));
+		src = (uint8_t*)data->sequences[i];
+		dest = (uint8_t*)data->contigs[i].sequence;
+
+		if(NTSpace == data->space) {
+			for(j=startPos;j+1<endPos;j+=2) {
+				code = tables->pair[(src[j] << 8) | src[j+1]];
+				if(RGBINARY_PACK_INVALID == code) {
+					RGBinaryPackError(FnName, src + j, NTSpace);
+				}
+				dest[j/2] = code;
+			}
+			if(j < endPos) {
+				/* The last base of an odd length contig */
+				code = tables->pair[(src[j] << 8) | 'a'];
+				if(RGBINARY_PACK_INVALID == code) {
+					RGBinaryPackError(FnName, src + j, NTSpace);
+				}
+				dest[j/2] = code & 0xF0;
+			}
+		}
+		else {
+			prev = (0 == startPos)?COLOR_SPACE_START_NT:tables->transform[src[startPos-1]];
+			for(j=startPos;j<endPos;j++) {
+				code = tables->color[(prev << 8) | tables->transform[src[j]]];
+				if(RGBINARY_PACK_INVALID == code) {
+					RGBinaryPackError(FnName, src + j, ColorSpace);
+				}
+				if(0 == (j & 1)) {
+					dest[j/2] = code << 4;
+				}
+				else {
+					dest[j/2] |= code;
+				}
+				prev = tables->transform[src[j]];
+			}
+		}
+	}
+
+	return arg;
+}
+
+/* TODO */
+/* Finds the base that could not be packed and exits */
+void RGBinaryPackError(char *FnName,
+		uint8_t *src,
+		int32_t space)
+{
+	char original = TransformFromIUPAC(src[0]);
+	if(NTSpace == space && 0 <= RGBinaryGetPackCode(original)) {
+		/* The next base */
+		original = TransformFromIUPAC(src[1]);
 	}
+	fprintf(stderr, "Base:[%c]\n", original);
+	PrintError(FnName, "original", "Not a valid base pair", Exit, OutOfRange);
 }
 
 /* TODO */
@@ -288,6 +581,8 @@ void RGBinaryReadBinaryHeader(RGBinary *rg,
 	assert(rg->numContigs > 0);
 	assert(rg->space == NTSpace|| rg->space == ColorSpace);
 	rg->packed = RGBinaryPacked;
+	rg->map = NULL;
+	rg->mapLength = 0;
 
 	/* Allocate memory for the contigs */
 	rg->contigs = malloc(sizeof(RGBinaryContig)*rg->numContigs);
@@ -329,12 +624,30 @@ void RGBinaryReadBinary(RGBinary *rg,
 	int32_t numCharsPerByte;
 	int64_t numPosRead=0;
 	char *brgFileName=NULL;
+	char *mmapFileName=NULL;
+	struct stat brgStat, mmapStat;
 	/* We assume that we can hold 2 [acgt] (nts) in each byte */
 	assert(ALPHABET_SIZE==4);
 	numCharsPerByte=ALPHABET_SIZE/2;
 
 	brgFileName=GetBRGFileName(fastaFileName, space);
 
+	/* Use the memory mapped reference genome if it exists and is not
+	 * older than the reference genome it was converted from */
+	mmapFileName=GetBRGMMapFileName(fastaFileName, space);
+	if(0 == stat(mmapFileName, &mmapStat)) {
+		if(0 == stat(brgFileName, &brgStat) && mmapStat.st_mtime < brgStat.st_mtime) {
+			PrintError(FnName, mmapFileName, "The memory mapped reference genome is older than the reference genome and will be ignored", Warn, OutOfRange);
+		}
+		else {
+			RGBinaryReadBinaryMMap(rg, mmapFileName);
+			free(mmapFileName);
+			free(brgFileName);
+			return;
+		}
+	}
+	free(mmapFileName);
+
 	if(VERBOSE>=0) {
 		fprintf(stderr, "%s", BREAK_LINE);
 		fprintf(stderr, "Reading in reference genome from %s.\n", brgFileName);
@@ -379,6 +692,238 @@ void RGBinaryReadBinary(RGBinary *rg,
 	free(brgFileName);
 }
 
+/* TODO */
+/* Reads from the data at offset in the memory map */
+static int32_t RGBinaryMMapRead(RGBinary *rg,
+		int64_t *offset,
+		void *dest,
+		int64_t length)
+{
+	if(rg->mapLength < (*offset) + length) {
+		return 0;
+	}
+	memcpy(dest, rg->map + (*offset), length);
+	(*offset) += length;
+	return 1;
+}
+
+/* TODO */
+/* Maps the uncompressed reference genome read-only.  The sequences point
+ * into the map, so the pages are shared by all processes using the same
+ * file. */
+void RGBinaryReadBinaryMMap(RGBinary *rg,
+		char *mmapFileName)
+{
+	char *FnName="RGBinaryReadBinaryMMap";
+	int fd;
+	struct stat st;
+
+	if(VERBOSE>=0) {
+		fprintf(stderr, "%s", BREAK_LINE);
+		fprintf(stderr, "Mapping in reference genome from %s.\n", mmapFileName);
+	}
+
+	if((fd=open(mmapFileName, O_RDONLY)) < 0) {
+		PrintError(FnName, mmapFileName, "Could not open mmapFileName for reading", Exit, OpenFileError);
+	}
+	if(0 != fstat(fd, &st)) {
+		PrintError(FnName, mmapFileName, "Could not get the size of mmapFileName", Exit, ReadFileError);
+	}
+	rg->mapLength = st.st_size;
+	rg->map = mmap(NULL, rg->mapLength, PROT_READ, MAP_SHARED, fd, 0);
+	if(MAP_FAILED == rg->map) {
+		PrintError(FnName, mmapFileName, "Could not map mmapFileName", Exit, ReadFileError);
+	}
+	close(fd);
+
+	RGBinaryReadBinaryMap(rg);
+}
+
+/* TODO */
+/* Reads the reference genome from the uncompressed image in rg->map, as
+ * written by RGBinaryWriteBinaryMap.  The sequences point into the map. */
+void RGBinaryReadBinaryMap(RGBinary *rg)
+{
+	char *FnName="RGBinaryReadBinaryMap";
+	int32_t i;
+	int64_t offset=0, sequenceOffset=0;
+	int64_t numPosRead=0;
+
+	/* Read RGBinary information */
+	if(0 == RGBinaryMMapRead(rg, &offset, &rg->id, sizeof(int32_t)) ||
+			0 == RGBinaryMMapRead(rg, &offset, &rg->packageVersionLength, sizeof(int32_t))) {
+		PrintError(FnName, NULL, "Could not read RGBinary information", Exit, ReadFileError);
+	}
+	/* Check id */
+	if(BFAST_ID != rg->id) {
+		PrintError(FnName, "rg->id", "The id did not match", Exit, OutOfRange);
+	}
+	assert(0<rg->packageVersionLength);
+	rg->packageVersion = malloc(sizeof(char)*(rg->packageVersionLength+1));
+	if(NULL==rg->packageVersion) {
+		PrintError(FnName, "rg->packageVersion", "Could not allocate memory", Exit, MallocMemory);
+	}
+	if(0 == RGBinaryMMapRead(rg, &offset, rg->packageVersion, sizeof(char)*rg->packageVersionLength) ||
+			0 == RGBinaryMMapRead(rg, &offset, &rg->numContigs, sizeof(int32_t)) ||
+			0 == RGBinaryMMapRead(rg, &offset, &rg->space, sizeof(int32_t))) {
+		PrintError(FnName, NULL, "Could not read RGBinary information", Exit, ReadFileError);
+	}
+	rg->packageVersion[rg->packageVersionLength]='\0';
+	CheckPackageCompatibility(rg->packageVersion,
+			BFASTReferenceGenomeFile);
+
+	assert(rg->numContigs > 0);
+	assert(rg->space == NTSpace|| rg->space == ColorSpace);
+	rg->packed = RGBinaryPacked;
+
+	/* Allocate memory for the contigs */
+	rg->contigs = malloc(sizeof(RGBinaryContig)*rg->numContigs);
+	if(NULL==rg->contigs) {
+		PrintError(FnName, "rg->contigs", "Could not allocate memory", Exit, MallocMemory);
+	}
+
+	/* Read each contig info */
+	for(i=0;i<rg->numContigs;i++) {
+		if(0 == RGBinaryMMapRead(rg, &offset, &rg->contigs[i].contigNameLength, sizeof(int32_t))) {
+			PrintError(FnName, NULL, "Could not read contig name length", Exit, ReadFileError);
+		}
+		assert(rg->contigs[i].contigNameLength > 0);
+		rg->contigs[i].contigName = malloc(sizeof(char)*(rg->contigs[i].contigNameLength+1));
+		if(NULL==rg->contigs[i].contigName) {
+			PrintError(FnName, "contigName", "Could not allocate memory", Exit, MallocMemory);
+		}
+		if(0 == RGBinaryMMapRead(rg, &offset, rg->contigs[i].contigName, sizeof(char)*rg->contigs[i].contigNameLength) ||
+				0 == RGBinaryMMapRead(rg, &offset, &rg->contigs[i].sequenceLength, sizeof(int32_t)) ||
+				0 == RGBinaryMMapRead(rg, &offset, &rg->contigs[i].numBytes, sizeof(uint32_t)) ||
+				0 == RGBinaryMMapRead(rg, &offset, &sequenceOffset, sizeof(int64_t))) {
+			PrintError(FnName, NULL, "Could not read RGContig information", Exit, ReadFileError);
+		}
+		rg->contigs[i].contigName[rg->contigs[i].contigNameLength]='\0';
+		/* It should be packed */
+		assert(ALPHABET_SIZE/2 == (rg->contigs[i].sequenceLength + (rg->contigs[i].sequenceLength % 2))/rg->contigs[i].numBytes);
+		if(rg->mapLength < sequenceOffset + rg->contigs[i].numBytes) {
+			PrintError(FnName, NULL, "Could not read sequence", Exit, ReadFileError);
+		}
+		rg->contigs[i].sequence = rg->map + sequenceOffset;
+
+		numPosRead += rg->contigs[i].sequenceLength;
+	}
+
+	if(VERBOSE>=0) {
+		fprintf(stderr, "In total read %d contigs for a total of %lld bases\n",
+				rg->numContigs,
+				(long long int)numPosRead);
+		fprintf(stderr, "%s", BREAK_LINE);
+	}
+}
+
+/* TODO */
+/* Writes the reference genome uncompressed, with each sequence starting
+ * on a BFAST_RG_MMAP_ALIGNMENT boundary, for RGBinaryReadBinaryMMap */
+void RGBinaryWriteBinaryMMap(RGBinary *rg,
+		int32_t space,
+		char *fastaFileName)
+{
+	char *FnName="RGBinaryWriteBinaryMMap";
+	int fd;
+	char *map=NULL;
+	int64_t mapLength;
+	char *mmapFileName=NULL;
+	char tmpFileName[MAX_FILENAME_LENGTH]="\0";
+
+	mmapFileName=GetBRGMMapFileName(fastaFileName, space);
+	/* Write to a temporary file so a partial file is never mapped */
+	sprintf(tmpFileName, "%s.tmp", mmapFileName);
+
+	if(0 <= VERBOSE) {
+		fprintf(stderr, "%s", BREAK_LINE);
+		fprintf(stderr, "Outputting to %s\n", mmapFileName);
+	}
+
+	if((fd=open(tmpFileName, O_RDWR | O_CREAT | O_TRUNC, 0644)) < 0) {
+		PrintError(FnName, tmpFileName, "Could not open tmpFileName for writing", Exit, OpenFileError);
+	}
+	mapLength = RGBinaryWriteBinaryMap(rg, NULL);
+	if(0 != ftruncate(fd, mapLength)) {
+		PrintError(FnName, tmpFileName, "Could not set the size of tmpFileName", Exit, WriteFileError);
+	}
+	map = mmap(NULL, mapLength, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if(MAP_FAILED == map) {
+		PrintError(FnName, tmpFileName, "Could not map tmpFileName", Exit, WriteFileError);
+	}
+	RGBinaryWriteBinaryMap(rg, map);
+	if(0 != munmap(map, mapLength) || 0 != close(fd)) {
+		PrintError(FnName, tmpFileName, "Could not write tmpFileName", Exit, WriteFileError);
+	}
+
+	if(0 != rename(tmpFileName, mmapFileName)) {
+		PrintError(FnName, mmapFileName, "Could not rename the temporary file", Exit, WriteFileError);
+	}
+
+	free(mmapFileName);
+
+	if(0 <= VERBOSE) {
+		fprintf(stderr, "Output complete.\n");
+		fprintf(stderr, "%s", BREAK_LINE);
+	}
+}
+
+/* TODO */
+/* Writes to the data at offset in the map, or only moves the offset if
+ * there is no map */
+static void RGBinaryMapWrite(char *map,
+		int64_t *offset,
+		void *src,
+		int64_t length)
+{
+	if(NULL != map) {
+		memcpy(map + (*offset), src, length);
+	}
+	(*offset) += length;
+}
+
+/* TODO */
+/* Writes the uncompressed image of the reference genome to map, which must
+ * be zeroed, and returns its length.  With no map, only the length is
+ * returned. */
+int64_t RGBinaryWriteBinaryMap(RGBinary *rg,
+		char *map)
+{
+	int32_t i;
+	int64_t offset=0, sequenceOffset=0;
+	assert(RGBinaryPacked == rg->packed);
+
+	/* The sequences start after the header */
+	sequenceOffset = 4*sizeof(int32_t) + rg->packageVersionLength*sizeof(char);
+	for(i=0;i<rg->numContigs;i++) {
+		sequenceOffset += 3*sizeof(int32_t) + rg->contigs[i].contigNameLength*sizeof(char) + sizeof(int64_t);
+	}
+
+	/* Output RGBinary information */
+	RGBinaryMapWrite(map, &offset, &rg->id, sizeof(int32_t));
+	RGBinaryMapWrite(map, &offset, &rg->packageVersionLength, sizeof(int32_t));
+	RGBinaryMapWrite(map, &offset, rg->packageVersion, sizeof(char)*rg->packageVersionLength);
+	RGBinaryMapWrite(map, &offset, &rg->numContigs, sizeof(int32_t));
+	RGBinaryMapWrite(map, &offset, &rg->space, sizeof(int32_t));
+	/* Output each contig */
+	for(i=0;i<rg->numContigs;i++) {
+		sequenceOffset = ((sequenceOffset + BFAST_RG_MMAP_ALIGNMENT - 1) / BFAST_RG_MMAP_ALIGNMENT) * BFAST_RG_MMAP_ALIGNMENT;
+		RGBinaryMapWrite(map, &offset, &rg->contigs[i].contigNameLength, sizeof(int32_t));
+		RGBinaryMapWrite(map, &offset, rg->contigs[i].contigName, sizeof(char)*rg->contigs[i].contigNameLength);
+		RGBinaryMapWrite(map, &offset, &rg->contigs[i].sequenceLength, sizeof(int32_t));
+		RGBinaryMapWrite(map, &offset, &rg->contigs[i].numBytes, sizeof(uint32_t));
+		RGBinaryMapWrite(map, &offset, &sequenceOffset, sizeof(int64_t));
+		sequenceOffset += rg->contigs[i].numBytes;
+	}
+	/* Output each sequence, the padding is already zero */
+	for(i=0;i<rg->numContigs;i++) {
+		offset = ((offset + BFAST_RG_MMAP_ALIGNMENT - 1) / BFAST_RG_MMAP_ALIGNMENT) * BFAST_RG_MMAP_ALIGNMENT;
+		RGBinaryMapWrite(map, &offset, rg->contigs[i].sequence, sizeof(char)*rg->contigs[i].numBytes);
+	}
+
+	return offset;
+}
+
 void RGBinaryWriteBinaryHeader(RGBinary *rg,
 		gzFile fpRG)
 {
@@ -461,6 +1006,16 @@ void RGBinaryDelete(RGBinary *rg)
 {
 	int32_t i;
 
+	/* Unmap the sequences */
+	if(NULL != rg->map) {
+		for(i=0;i<rg->numContigs;i++) {
+			rg->contigs[i].sequence=NULL;
+		}
+		munmap(rg->map, rg->mapLength);
+		rg->map = NULL;
+		rg->mapLength = 0;
+	}
+
 	/* Free each contig */
 	for(i=0;i<rg->numContigs;i++) {
 		free(rg->contigs[i].sequence);
@@ -961,16 +1516,23 @@ void RGBinaryPrintInfo(char *brgFileName)
 	FILE *fp=stdout;
 	int64_t totalBases=0;
 
-	/* Open output file */
-	if((fpRG=gzopen(brgFileName, "rb"))==0) {
-		PrintError(FnName, brgFileName, "Could not open brgFileNamefor reading", Exit, OpenFileError);
+	if(strlen(BFAST_RG_MMAP_FILE_EXTENSION) < strlen(brgFileName) &&
+			0 == strcmp(BFAST_RG_MMAP_FILE_EXTENSION, brgFileName + strlen(brgFileName) - strlen(BFAST_RG_MMAP_FILE_EXTENSION))) {
+		/* Only the header pages are touched */
+		RGBinaryReadBinaryMMap(&rg, brgFileName);
 	}
+	else {
+		/* Open output file */
+		if((fpRG=gzopen(brgFileName, "rb"))==0) {
+			PrintError(FnName, brgFileName, "Could not open brgFileNamefor reading", Exit, OpenFileError);
+		}
 
-	/* Read in the reference genome */
-	RGBinaryReadBinaryHeader(&rg, fpRG);
+		/* Read in the reference genome */
+		RGBinaryReadBinaryHeader(&rg, fpRG);
 
-	/* Close the output file */
-	gzclose(fpRG);
+		/* Close the output file */
+		gzclose(fpRG);
+	}
 
 	/* Print details */
 	for(i=0;i<rg.numContigs;i++) {
@@ -1006,11 +1568,19 @@ void RGBinaryUnPack(RGBinary *rg)
 			tempSequence[j-1] = RGBinaryGetBase(rg, i+1, j);
 		}
 		/* Free sequence and copy over */
-		free(rg->contigs[i].sequence);
+		if(NULL == rg->map) {
+			free(rg->contigs[i].sequence);
+		}
 		rg->contigs[i].sequence=tempSequence;
 		tempSequence=NULL;
 		rg->contigs[i].numBytes = rg->contigs[i].sequenceLength;
 	}
+	/* The sequences no longer point into the map */
+	if(NULL != rg->map) {
+		munmap(rg->map, rg->mapLength);
+		rg->map = NULL;
+		rg->mapLength = 0;
+	}
 
 	rg->packed = RGBinaryUnPacked;
 }
@@ -5,10 +5,53 @@
 #include <zlib.h>
 #include "BLibDefinitions.h"
 
-void RGBinaryRead(char*, RGBinary*, int32_t);
+#define RGBINARY_PACK_INVALID 0xFFFF
+
+/* Lookup tables for packing bases */
+typedef struct {
+	uint8_t transform[256]; /* IUPAC codes to bases */
+	uint16_t pair[65536]; /* two nucleotides to a byte */
+	uint16_t color[65536]; /* previous and current base to four bits */
+} RGBinaryPackTables;
+
+/* Contigs read but not yet packed */
+typedef struct {
+	char **names;
+	char **sequences;
+	int64_t *lengths;
+	int64_t *capacities;
+	int32_t numContigs;
+} RGBinaryPackBatch;
+
+typedef struct {
+	char **sequences;
+	int64_t *lengths;
+	RGBinaryContig *contigs;
+	int32_t numContigs;
+	int32_t space;
+	RGBinaryPackTables *tables;
+	int32_t threadID;
+	int32_t numThreads;
+} RGBinaryPackThreadData;
+
+void RGBinaryRead(char*, RGBinary*, int32_t, int32_t);
+int32_t RGBinaryGetPackCode(char);
+void RGBinaryPackTablesInitialize(RGBinaryPackTables*);
+void RGBinaryPackBatchInitialize(RGBinaryPackBatch*);
+void RGBinaryPackBatchAdd(RGBinaryPackBatch*, char*);
+void RGBinaryPackBatchAppend(RGBinaryPackBatch*, char*, int64_t);
+void RGBinaryPackBatchPop(RGBinaryPackBatch*);
+int64_t RGBinaryPackBatchPack(RGBinaryPackBatch*, RGBinary*, int32_t, RGBinaryPackTables*, int32_t);
+void RGBinaryPackBatchFree(RGBinaryPackBatch*);
+void *RGBinaryPackThread(void*);
+void RGBinaryPackError(char*, uint8_t*, int32_t);
 void RGBinaryReadBinaryHeader(RGBinary*, gzFile);
 void RGBinaryReadBinary(RGBinary*, int32_t, char*);
+void RGBinaryReadBinaryMMap(RGBinary*, char*);
+void RGBinaryReadBinaryMap(RGBinary*);
 void RGBinaryWriteBinary(RGBinary*, int32_t, char*);
+void RGBinaryWriteBinaryMMap(RGBinary*, int32_t, char*);
+int64_t RGBinaryWriteBinaryMap(RGBinary*, char*);
 void RGBinaryWriteBinaryHeader(RGBinary*, gzFile);
 void RGBinaryDelete(RGBinary*);
 void RGBinaryInsertBase(char*, int32_t, char);
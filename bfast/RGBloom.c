@@ -0,0 +1,545 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+#include <config.h>
+
+#include "BError.h"
+#include "BLib.h"
+#include "BLibDefinitions.h"
+#include "RGBinary.h"
+#include "RGIndex.h"
+#include "RGBloom.h"
+
+/* The filter holds the key of an index at every position of the
+ * reference, taken with the mask of the index.  A read is looked up in the
+ * same way as the index searches it: the key at each offset of the read and
+ * of its reverse compliment (in color space, its reverse).  Since a Bloom
+ * filter has no false negatives, a read with none of its keys in the filter
+ * cannot be found by the index.
+ *
+ * The filter is split into blocks of one cache line.  The hash of a key
+ * picks a block, and every bit of the key is set within that block.  It is
+ * sized from an estimate of the number of distinct keys.
+ *
+ * The file is:
+ * int32_t id, int32_t space, int32_t index number, int32_t width, the mask
+ * (int32_t each), int32_t number of hashes, int32_t bits per block,
+ * int64_t number of blocks, then the blocks.
+ * */
+
+#define RGBLOOM_CHUNK_LENGTH 1048576
+#define RGBLOOM_PROBE_BITS 9 /* log2 of BFAST_BLOOM_BLOCK_BITS */
+#define RGBLOOM_ESTIMATE_BITS 14 /* 2^14 registers, about 1% error */
+
+/* TODO */
+static uint64_t RGBloomHash(uint64_t key)
+{
+	key ^= key >> 33;
+	key *= 0xff51afd7ed558ccdULL;
+	key ^= key >> 33;
+	key *= 0xc4ceb9fe1a85ec53ULL;
+	key ^= key >> 33;
+	return key;
+}
+
+/* TODO */
+/* Gets the hash of the key at the start of the sequence (0-3, 4 for N).
+ * Returns zero if the key is not valid, that is it has an N where the mask
+ * is one.  Each base of the key takes two bits, zero where the mask is
+ * zero, so a key of at most 32 bases is hashed once and can be rolled
+ * along the reference (see RGBloomCreateScan). */
+static int32_t RGBloomGetKey(RGBloom *bloom,
+		int8_t *seq,
+		uint64_t *hash)
+{
+	uint64_t key=0;
+	int32_t i;
+
+	(*hash) = 0;
+	for(i=0;i<bloom->width;i++) {
+		key <<= 2;
+		if(1 == bloom->mask[i]) {
+			if(3 < seq[i]) {
+				return 0;
+			}
+			key |= seq[i];
+		}
+		if(0 == (i+1) % 32 && i+1 < bloom->width) {
+			(*hash) = RGBloomHash((*hash) ^ key);
+			key = 0;
+		}
+	}
+	(*hash) = RGBloomHash((*hash) ^ key);
+	return 1;
+}
+
+/* TODO */
+/* The block of the key, by multiplying rather than by taking a modulus */
+static int64_t RGBloomGetBlock(RGBloom *bloom, uint64_t hash)
+{
+	return (int64_t)(((hash >> 32) * (uint64_t)bloom->numBlocks) >> 32);
+}
+
+/* TODO */
+static void RGBloomAdd(RGBloom *bloom, int64_t block, uint64_t hash)
+{
+	uint64_t *words = (uint64_t*)(bloom->bits + block*(BFAST_BLOOM_BLOCK_BITS/8));
+	uint64_t probes = RGBloomHash(hash);
+	int32_t i, bit;
+
+	for(i=0;i<bloom->numHashes;i++) {
+		bit = probes & (BFAST_BLOOM_BLOCK_BITS - 1);
+		probes >>= RGBLOOM_PROBE_BITS;
+		words[bit >> 6] |= ((uint64_t)1) << (bit & 63);
+	}
+}
+
+/* TODO */
+static int32_t RGBloomContains(RGBloom *bloom, uint64_t hash)
+{
+	uint64_t *words = (uint64_t*)(bloom->bits + RGBloomGetBlock(bloom, hash)*(BFAST_BLOOM_BLOCK_BITS/8));
+	uint64_t probes = RGBloomHash(hash);
+	int32_t i, bit;
+
+	for(i=0;i<bloom->numHashes;i++) {
+		bit = probes & (BFAST_BLOOM_BLOCK_BITS - 1);
+		probes >>= RGBLOOM_PROBE_BITS;
+		if(0 == (words[bit >> 6] & (((uint64_t)1) << (bit & 63)))) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/* TODO */
+/* Counts the key in the (HyperLogLog) estimate, or adds it if it is in a
+ * block of this thread */
+static void RGBloomCreateKey(RGBloomThreadData *data, uint64_t hash)
+{
+	uint64_t rest;
+	int64_t block;
+	uint8_t rank;
+
+	if(NULL != data->registers) {
+		/* The register is picked by the top bits, the rank is the position
+		 * of the first one in the rest */
+		rest = hash << RGBLOOM_ESTIMATE_BITS;
+		for(rank=1;rank <= 64 - RGBLOOM_ESTIMATE_BITS && 0 == (rest >> 63);rank++) {
+			rest <<= 1;
+		}
+		if(data->registers[hash >> (64 - RGBLOOM_ESTIMATE_BITS)] < rank) {
+			data->registers[hash >> (64 - RGBLOOM_ESTIMATE_BITS)] = rank;
+		}
+		data->numKeys++;
+	}
+	else {
+		block = RGBloomGetBlock(data->bloom, hash);
+		if(data->startBlock <= block && block < data->endBlock) {
+			RGBloomAdd(data->bloom, block, hash);
+			data->numKeys++;
+		}
+	}
+}
+
+/* TODO */
+/* Counts or adds the keys starting from startPos to endPos of the contig */
+static void RGBloomCreateScan(RGBloomThreadData *data,
+		int8_t *seq,
+		int32_t contig,
+		int32_t startPos,
+		int32_t endPos)
+{
+	RGBloom *bloom = data->bloom;
+	uint64_t hash, window, nWindow;
+	uint8_t code;
+	int32_t start, length, j;
+
+	/* In chunks, overlapping so that every key is within a chunk */
+	for(start=startPos;start<=endPos;start+=RGBLOOM_CHUNK_LENGTH-bloom->width+1) {
+		length = GETMIN(RGBLOOM_CHUNK_LENGTH, endPos + bloom->width - start);
+		for(j=0;j<length;j++) {
+			code = RGBinaryGetFourBit(data->rg, contig, start + j);
+			seq[j] = (2 == (code >> 2)) ? 4 : (code & 0x03);
+		}
+		if(bloom->width <= 32) {
+			/* Roll the key along the chunk, with a bit for each N */
+			window = nWindow = 0;
+			for(j=0;j<length;j++) {
+				window = (window << 2) | (seq[j] & 0x03);
+				nWindow = (nWindow << 1) | ((3 < seq[j]) ? 1 : 0);
+				if(bloom->width <= j + 1 && 0 == (nWindow & data->nMask)) {
+					RGBloomCreateKey(data, RGBloomHash(window & data->keyMask));
+				}
+			}
+		}
+		else {
+			for(j=0;j+bloom->width<=length;j++) {
+				if(1 == RGBloomGetKey(bloom, seq + j, &hash)) {
+					RGBloomCreateKey(data, hash);
+				}
+			}
+		}
+	}
+}
+
+/* TODO */
+/* When counting, each thread counts the keys of its part of every contig.
+ * When adding, each thread goes over all the keys but sets the bits of its
+ * own blocks only, since hashing a key costs less than the cache miss of
+ * setting its bits. */
+void *RGBloomCreateThread(void *arg)
+{
+	char *FnName="RGBloomCreateThread";
+	RGBloomThreadData *data = (RGBloomThreadData*)arg;
+	int8_t *seq=NULL;
+	int64_t numPositions;
+	int32_t contig, startPos, endPos;
+
+	seq = malloc(sizeof(int8_t)*RGBLOOM_CHUNK_LENGTH);
+	if(NULL == seq) {
+		PrintError(FnName, "seq", "Could not allocate memory", Exit, MallocMemory);
+	}
+
+	for(contig=1;contig<=data->rg->numContigs;contig++) {
+		/* The number of positions at which a key starts */
+		numPositions = data->rg->contigs[contig-1].sequenceLength - data->bloom->width + 1;
+		if(NULL != data->registers) {
+			startPos = 1 + numPositions*data->threadID/data->numThreads;
+			endPos = numPositions*(data->threadID+1)/data->numThreads;
+		}
+		else {
+			startPos = 1;
+			endPos = numPositions;
+		}
+		if(startPos <= endPos) {
+			RGBloomCreateScan(data, seq, contig, startPos, endPos);
+		}
+	}
+
+	free(seq);
+	return arg;
+}
+
+/* TODO */
+/* The HyperLogLog estimate of the number of distinct keys */
+static int64_t RGBloomEstimate(uint8_t *registers)
+{
+	double m = (double)(1 << RGBLOOM_ESTIMATE_BITS);
+	double sum=0.0, estimate;
+	int32_t i, numZeros=0;
+
+	for(i=0;i<(1 << RGBLOOM_ESTIMATE_BITS);i++) {
+		sum += ldexp(1.0, -registers[i]);
+		if(0 == registers[i]) {
+			numZeros++;
+		}
+	}
+	estimate = (0.7213/(1.0 + 1.079/m))*m*m/sum;
+	if(estimate <= 2.5*m && 0 < numZeros) {
+		/* Few keys, so count the empty registers */
+		estimate = m*log(m/numZeros);
+	}
+	return (int64_t)(estimate + 0.5);
+}
+
+/* TODO */
+/* Creates the filter of the index with the given layout from the reference
+ * genome */
+void RGBloomCreate(RGBloom *bloom,
+		RGBinary *rg,
+		RGIndexLayout *layout,
+		int32_t indexNumber,
+		int32_t numThreads)
+{
+	char *FnName="RGBloomCreate";
+	RGBloomThreadData *data=NULL;
+	uint8_t *registers=NULL;
+	uint64_t keyMask=0, nMask=0;
+	int64_t numKeys=0, numDistinct, numBitsSet=0, i;
+	int32_t j;
+
+	RGBloomInitialize(bloom);
+	bloom->space = rg->space;
+	bloom->indexNumber = indexNumber;
+	bloom->width = layout->width;
+	bloom->mask = malloc(sizeof(int32_t)*bloom->width);
+	if(NULL == bloom->mask) {
+		PrintError(FnName, "bloom->mask", "Could not allocate memory", Exit, MallocMemory);
+	}
+	for(j=0;j<bloom->width;j++) {
+		bloom->mask[j] = layout->mask[j];
+		if(1 == bloom->mask[j] && bloom->width <= 32) {
+			keyMask |= ((uint64_t)3) << (2*(bloom->width - 1 - j));
+			nMask |= ((uint64_t)1) << (bloom->width - 1 - j);
+		}
+	}
+	bloom->numHashes = BFAST_BLOOM_NUM_HASHES;
+
+	data = malloc(sizeof(RGBloomThreadData)*numThreads);
+	if(NULL == data) {
+		PrintError(FnName, "data", "Could not allocate memory", Exit, MallocMemory);
+	}
+	registers = calloc(((int64_t)numThreads) << RGBLOOM_ESTIMATE_BITS, sizeof(uint8_t));
+	if(NULL == registers) {
+		PrintError(FnName, "registers", "Could not allocate memory", Exit, MallocMemory);
+	}
+	for(j=0;j<numThreads;j++) {
+		data[j].bloom = bloom;
+		data[j].rg = rg;
+		data[j].keyMask = keyMask;
+		data[j].nMask = nMask;
+		data[j].registers = registers + (((int64_t)j) << RGBLOOM_ESTIMATE_BITS);
+		data[j].startBlock = data[j].endBlock = 0;
+		data[j].numKeys = 0;
+		data[j].threadID = j;
+		data[j].numThreads = numThreads;
+	}
+
+	/* Size the filter for the distinct keys */
+	if(VERBOSE >= 0) {
+		fprintf(stderr, "Counting the keys of index #%d.\n",
+				indexNumber);
+	}
+	RGIndexRunThreads(RGBloomCreateThread, data, sizeof(RGBloomThreadData), numThreads, numThreads);
+	for(j=0;j<numThreads;j++) {
+		for(i=0;i<(1 << RGBLOOM_ESTIMATE_BITS);i++) {
+			registers[i] = GETMAX(registers[i], data[j].registers[i]);
+		}
+		numKeys += data[j].numKeys;
+	}
+	numDistinct = GETMIN(numKeys, RGBloomEstimate(registers));
+	bloom->numBlocks = GETMAX(1, (numDistinct*BFAST_BLOOM_BITS_PER_KEY + BFAST_BLOOM_BLOCK_BITS - 1)/BFAST_BLOOM_BLOCK_BITS);
+	if((((int64_t)1) << 32) <= bloom->numBlocks) {
+		PrintError(FnName, "bloom->numBlocks", "Too many keys for the Bloom filter", Exit, OutOfRange);
+	}
+	if(0 != posix_memalign((void**)&bloom->bits, BFAST_CACHE_LINE_SIZE, bloom->numBlocks*(BFAST_BLOOM_BLOCK_BITS/8))) {
+		PrintError(FnName, "bloom->bits", "Could not allocate memory", Exit, MallocMemory);
+	}
+	memset(bloom->bits, 0, bloom->numBlocks*(BFAST_BLOOM_BLOCK_BITS/8));
+
+	if(VERBOSE >= 0) {
+		fprintf(stderr, "Creating the Bloom filter of index #%d for about %lld distinct keys (%lld bytes).\n",
+				indexNumber,
+				(long long int)numDistinct,
+				(long long int)(bloom->numBlocks*(BFAST_BLOOM_BLOCK_BITS/8)));
+	}
+
+	/* Add the keys, each thread setting the bits of its own blocks */
+	for(j=0;j<numThreads;j++) {
+		data[j].registers = NULL;
+		data[j].startBlock = bloom->numBlocks*j/numThreads;
+		data[j].endBlock = bloom->numBlocks*(j+1)/numThreads;
+		data[j].numKeys = 0;
+	}
+	RGIndexRunThreads(RGBloomCreateThread, data, sizeof(RGBloomThreadData), numThreads, numThreads);
+	for(j=0,numKeys=0;j<numThreads;j++) {
+		numKeys += data[j].numKeys;
+	}
+
+	if(VERBOSE >= 0) {
+		for(i=0;i<bloom->numBlocks*(BFAST_BLOOM_BLOCK_BITS/8);i++) {
+			for(j=0;j<8;j++) {
+				numBitsSet += (bloom->bits[i] >> j) & 1;
+			}
+		}
+		fprintf(stderr, "Added %lld keys, setting %.2lf%% of the bits.\n",
+				(long long int)numKeys,
+				100.0*numBitsSet/(bloom->numBlocks*BFAST_BLOOM_BLOCK_BITS));
+	}
+
+	free(registers);
+	free(data);
+}
+
+/* TODO */
+void RGBloomWrite(RGBloom *bloom,
+		char *fastaFileName)
+{
+	char *FnName="RGBloomWrite";
+	char *bloomFileName=NULL;
+	int32_t id = BFAST_ID;
+	int32_t blockBits = BFAST_BLOOM_BLOCK_BITS;
+	FILE *fp=NULL;
+
+	bloomFileName = GetBloomFileName(fastaFileName, bloom->space, bloom->indexNumber);
+	if(VERBOSE >= 0) {
+		fprintf(stderr, "Writing the Bloom filter to %s.\n",
+				bloomFileName);
+	}
+	if(!(fp=fopen(bloomFileName, "wb"))) {
+		PrintError(FnName, bloomFileName, "Could not open file for writing", Exit, OpenFileError);
+	}
+	if(1 != fwrite(&id, sizeof(int32_t), 1, fp) ||
+			1 != fwrite(&bloom->space, sizeof(int32_t), 1, fp) ||
+			1 != fwrite(&bloom->indexNumber, sizeof(int32_t), 1, fp) ||
+			1 != fwrite(&bloom->width, sizeof(int32_t), 1, fp) ||
+			bloom->width != fwrite(bloom->mask, sizeof(int32_t), bloom->width, fp) ||
+			1 != fwrite(&bloom->numHashes, sizeof(int32_t), 1, fp) ||
+			1 != fwrite(&blockBits, sizeof(int32_t), 1, fp) ||
+			1 != fwrite(&bloom->numBlocks, sizeof(int64_t), 1, fp) ||
+			bloom->numBlocks*(BFAST_BLOOM_BLOCK_BITS/8) != fwrite(bloom->bits, sizeof(uint8_t), bloom->numBlocks*(BFAST_BLOOM_BLOCK_BITS/8), fp)) {
+		PrintError(FnName, bloomFileName, "Could not write the filter", Exit, WriteFileError);
+	}
+	fclose(fp);
+	free(bloomFileName);
+}
+
+/* TODO */
+void RGBloomRead(RGBloom *bloom,
+		char *fastaFileName,
+		int32_t space,
+		int32_t indexNumber)
+{
+	char *FnName="RGBloomRead";
+	char *bloomFileName=NULL;
+	int32_t id, blockBits, i;
+	FILE *fp=NULL;
+
+	RGBloomInitialize(bloom);
+	bloomFileName = GetBloomFileName(fastaFileName, space, indexNumber);
+	if(VERBOSE >= 0) {
+		fprintf(stderr, "Reading the Bloom filter from %s.\n",
+				bloomFileName);
+	}
+	if(!(fp=fopen(bloomFileName, "rb"))) {
+		PrintError(FnName, bloomFileName, "Could not open file for reading (was the index created with bfast index -B?)", Exit, OpenFileError);
+	}
+	if(1 != fread(&id, sizeof(int32_t), 1, fp) ||
+			1 != fread(&bloom->space, sizeof(int32_t), 1, fp) ||
+			1 != fread(&bloom->indexNumber, sizeof(int32_t), 1, fp) ||
+			1 != fread(&bloom->width, sizeof(int32_t), 1, fp)) {
+		PrintError(FnName, bloomFileName, "Could not read the header", Exit, ReadFileError);
+	}
+	if(BFAST_ID != id) {
+		PrintError(FnName, "id", "The id did not match", Exit, OutOfRange);
+	}
+	if(space != bloom->space) {
+		PrintError(FnName, bloomFileName, "The filter has a different space parity than specified", Exit, OutOfRange);
+	}
+	if(indexNumber != bloom->indexNumber ||
+			bloom->width <= 0 || SEQUENCE_LENGTH < bloom->width) {
+		PrintError(FnName, bloomFileName, "Could not understand the header", Exit, OutOfRange);
+	}
+	bloom->mask = malloc(sizeof(int32_t)*bloom->width);
+	if(NULL == bloom->mask) {
+		PrintError(FnName, "bloom->mask", "Could not allocate memory", Exit, MallocMemory);
+	}
+	if(bloom->width != fread(bloom->mask, sizeof(int32_t), bloom->width, fp) ||
+			1 != fread(&bloom->numHashes, sizeof(int32_t), 1, fp) ||
+			1 != fread(&blockBits, sizeof(int32_t), 1, fp) ||
+			1 != fread(&bloom->numBlocks, sizeof(int64_t), 1, fp)) {
+		PrintError(FnName, bloomFileName, "Could not read the header", Exit, ReadFileError);
+	}
+	for(i=0;i<bloom->width;i++) {
+		if(0 != bloom->mask[i] && 1 != bloom->mask[i]) {
+			PrintError(FnName, bloomFileName, "Could not understand the header", Exit, OutOfRange);
+		}
+	}
+	if(BFAST_BLOOM_BLOCK_BITS != blockBits) {
+		PrintError(FnName, bloomFileName, "The filter has a different layout (create it again with bfast index -B)", Exit, OutOfRange);
+	}
+	if(bloom->numHashes <= 0 || (64/RGBLOOM_PROBE_BITS) < bloom->numHashes ||
+			bloom->numBlocks <= 0 || (((int64_t)1) << 32) <= bloom->numBlocks) {
+		PrintError(FnName, bloomFileName, "Could not understand the header", Exit, OutOfRange);
+	}
+	if(0 != posix_memalign((void**)&bloom->bits, BFAST_CACHE_LINE_SIZE, bloom->numBlocks*(BFAST_BLOOM_BLOCK_BITS/8))) {
+		PrintError(FnName, "bloom->bits", "Could not allocate memory", Exit, MallocMemory);
+	}
+	if(bloom->numBlocks*(BFAST_BLOOM_BLOCK_BITS/8) != fread(bloom->bits, sizeof(uint8_t), bloom->numBlocks*(BFAST_BLOOM_BLOCK_BITS/8), fp)) {
+		PrintError(FnName, bloomFileName, "Could not read the filter", Exit, ReadFileError);
+	}
+	fclose(fp);
+	free(bloomFileName);
+}
+
+/* TODO */
+/* Exits if the filter was not made with the mask of the index, for example
+ * if the index was created again without -B */
+void RGBloomCheckIndex(RGBloom *bloom,
+		RGIndex *index)
+{
+	char *FnName="RGBloomCheckIndex";
+	int32_t i;
+
+	if(bloom->width != index->width) {
+		PrintError(FnName, "bloom->width", "The Bloom filter was not made for this index (create it again with bfast index -B)", Exit, OutOfRange);
+	}
+	for(i=0;i<bloom->width;i++) {
+		if(bloom->mask[i] != index->mask[i]) {
+			PrintError(FnName, "bloom->mask", "The Bloom filter was not made for this index (create it again with bfast index -B)", Exit, OutOfRange);
+		}
+	}
+}
+
+/* TODO */
+void RGBloomDelete(RGBloom *bloom)
+{
+	free(bloom->mask);
+	free(bloom->bits);
+	RGBloomInitialize(bloom);
+}
+
+/* TODO */
+void RGBloomInitialize(RGBloom *bloom)
+{
+	bloom->space = NTSpace;
+	bloom->indexNumber = 0;
+	bloom->width = 0;
+	bloom->mask = NULL;
+	bloom->numHashes = 0;
+	bloom->numBlocks = 0;
+	bloom->bits = NULL;
+}
+
+/* TODO */
+/* Returns zero if fewer than minHits of the keys of the read are in the
+ * filter, on either strand.  A read with fewer keys than that must have
+ * them all in the filter, and a read too short to have any is kept. */
+int32_t RGBloomCheckRead(RGBloom *bloom,
+		char *read,
+		int32_t readLength,
+		int32_t minHits)
+{
+	int8_t seq[SEQUENCE_LENGTH+1];
+	int8_t reverseSeq[SEQUENCE_LENGTH+1];
+	uint64_t hash;
+	int32_t i, found, numKeys, numHits;
+	int32_t readOffset = 0;
+
+	if(ColorSpace == bloom->space) {
+		/* First letter is adapter, second letter is the color (unusable) */
+		readOffset = 2;
+	}
+	readLength -= readOffset;
+	if(readLength < bloom->width) {
+		return 1;
+	}
+	assert(readLength <= SEQUENCE_LENGTH);
+
+	ConvertSequenceToIntegers(read + readOffset, seq, readLength);
+	if(ColorSpace == bloom->space) {
+		/* In color space, the reverse compliment is just the reverse of the colors */
+		ReverseReadFourBit(seq, reverseSeq, readLength);
+	}
+	else {
+		GetReverseComplimentFourBit(seq, reverseSeq, readLength);
+	}
+
+	/* Count the keys, and those in the filter on either strand */
+	for(i=numKeys=numHits=0;i+bloom->width<=readLength;i++) {
+		found = -1;
+		if(1 == RGBloomGetKey(bloom, seq + i, &hash)) {
+			found = RGBloomContains(bloom, hash);
+		}
+		if(1 != found && 1 == RGBloomGetKey(bloom, reverseSeq + readLength - bloom->width - i, &hash)) {
+			found = RGBloomContains(bloom, hash);
+		}
+		if(0 <= found) {
+			numKeys++;
+			numHits += found;
+		}
+	}
+	return (GETMIN(minHits, numKeys) <= numHits) ? 1 : 0;
+}
@@ -0,0 +1,28 @@
+#ifndef RGBLOOM_H_
+#define RGBLOOM_H_
+
+#include "BLibDefinitions.h"
+
+typedef struct {
+	RGBloom *bloom;
+	RGBinary *rg;
+	uint64_t keyMask; /* two bits per masked base of the key */
+	uint64_t nMask; /* one bit per masked base of the key */
+	uint8_t *registers; /* when counting, the estimate of the distinct keys */
+	int64_t startBlock; /* when adding, the blocks set by this thread */
+	int64_t endBlock;
+	int64_t numKeys;
+	int32_t threadID;
+	int32_t numThreads;
+} RGBloomThreadData;
+
+void RGBloomCreate(RGBloom*, RGBinary*, RGIndexLayout*, int32_t, int32_t);
+void *RGBloomCreateThread(void*);
+void RGBloomWrite(RGBloom*, char*);
+void RGBloomRead(RGBloom*, char*, int32_t, int32_t);
+void RGBloomCheckIndex(RGBloom*, RGIndex*);
+void RGBloomDelete(RGBloom*);
+void RGBloomInitialize(RGBloom*);
+int32_t RGBloomCheckRead(RGBloom*, char*, int32_t, int32_t);
+
+#endif
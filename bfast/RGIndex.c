@@ -12,6 +12,8 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
 #include "BLibDefinitions.h"
 #include "BError.h"
 #include "BLib.h"
@@ -34,6 +36,8 @@ void RGIndexCreate(char *fastaFileName,
 		int32_t numThreads,
 		int32_t repeatMasker,
 		int32_t includeNs,
+		int32_t update,
+		int64_t memoryLimit,
 		char *tmpDir) 
 {
 
@@ -59,6 +63,8 @@ void RGIndexCreate(char *fastaFileName,
 				numThreads,
 				repeatMasker,
 				includeNs,
+				update,
+				memoryLimit,
 				tmpDir);
 	}
 	else {
@@ -76,6 +82,8 @@ void RGIndexCreate(char *fastaFileName,
 				numThreads,
 				repeatMasker,
 				includeNs,
+				update,
+				memoryLimit,
 				tmpDir);
 	}
 }
@@ -94,6 +102,8 @@ void RGIndexCreateSingle(char *fastaFileName,
 		int32_t numThreads,
 		int32_t repeatMasker,
 		int32_t includeNs,
+		int32_t update,
+		int64_t memoryLimit,
 		char *tmpDir) 
 {
 	//char *FnName = "RGIndexCreateSingle";
@@ -101,6 +111,7 @@ void RGIndexCreateSingle(char *fastaFileName,
 	RGIndex index;
 	RGBinary rg;
 	gzFile gzOut;
+	int32_t indexStartContig, indexStartPos;
 
 	/* Get brg */
 	RGBinaryReadBinary(&rg, space, fastaFileName);
@@ -109,7 +120,8 @@ void RGIndexCreateSingle(char *fastaFileName,
 	assert(4 == ALPHABET_SIZE);
 
 	if(VERBOSE >=0) {
-		fprintf(stderr, "Creating the index...\n");
+		fprintf(stderr, "%s the index...\n",
+				(1 == update) ? "Updating" : "Creating");
 	}
 
 	/* Adjust bounds */
@@ -118,6 +130,22 @@ void RGIndexCreateSingle(char *fastaFileName,
 			&startPos,
 			&endContig,
 			&endPos);
+	indexStartContig = startContig;
+	indexStartPos = startPos;
+	if(1 == update) {
+		/* Only add the contigs not in the existing index */
+		RGIndexGetUpdateRange(fastaFileName,
+				&rg,
+				layout,
+				space,
+				indexNumber,
+				repeatMasker,
+				NULL,
+				&indexStartContig,
+				&indexStartPos,
+				&startContig,
+				&startPos);
+	}
 
 	/* Initialize the index */
 	RGIndexInitializeFull(&index,
@@ -126,15 +154,20 @@ void RGIndexCreateSingle(char *fastaFileName,
 			space,
 			1,
 			indexNumber,
-			startContig,
-			startPos,
+			indexStartContig,
+			indexStartPos,
 			endContig,
 			endPos,
 			repeatMasker);
 
 	/* Open output file before creation, so that if it exists we
 	 * know before all the work is performed. */
-	gzOut = RGIndexOpenForWriting(fastaFileName, &index); 
+	if(1 == update) {
+		gzOut = RGIndexOpenForUpdating(fastaFileName, &index); 
+	}
+	else {
+		gzOut = RGIndexOpenForWriting(fastaFileName, &index); 
+	}
 
 	/* Add locations to the index */
 	if(VERBOSE >= 0) {
@@ -153,7 +186,8 @@ void RGIndexCreateSingle(char *fastaFileName,
 					e->exons[i].endContig,
 					e->exons[i].endPos,
 					repeatMasker,
-					includeNs);
+					includeNs,
+					1);
 		}
 	}
 	else {
@@ -165,7 +199,8 @@ void RGIndexCreateSingle(char *fastaFileName,
 				endContig,
 				endPos,
 				repeatMasker,
-				includeNs);
+				includeNs,
+				1);
 	}
 
 	if(VERBOSE >= 0) {
@@ -175,16 +210,37 @@ void RGIndexCreateSingle(char *fastaFileName,
 		fprintf(stderr, "\n");
 	}
 
-	assert(index.length > 0);
+	assert(index.length > 0 || 1 == update);
 
 	/* Sort the nodes in the index */
-	RGIndexSort(&index, &rg, numThreads, tmpDir);
+	if(0 < index.length) {
+		RGIndexSort(&index, 
+				&rg, 
+				RGIndexGetNumPartitions(numThreads), 
+				numThreads, 
+				RGIndexGetSortMemoryLimit(&index, memoryLimit),
+				1, 
+				tmpDir);
+	}
+
+	/* Merge with the existing index */
+	if(1 == update) {
+		RGIndexAppend(&index,
+				&rg,
+				fastaFileName,
+				numThreads,
+				memoryLimit,
+				tmpDir);
+	}
 
 	/* Create hash table from the index */
-	RGIndexCreateHash(&index, &rg);
+	RGIndexCreateHash(&index, &rg, 1);
 
 	/* Write */ 
 	RGIndexPrint(gzOut, &index);
+	if(1 == update) {
+		RGIndexFinishUpdating(fastaFileName, &index);
+	}
 
 	if(VERBOSE >= 0) {
 		fprintf(stderr, "Index created.\n");
@@ -212,6 +268,8 @@ void RGIndexCreateSplit(char *fastaFileName,
 		int32_t numThreads,
 		int32_t repeatMasker,
 		int32_t includeNs,
+		int32_t update,
+		int64_t memoryLimit,
 		char *tmpDir) 
 {
 	char *FnName = "RGIndexCreateSplit";
@@ -221,10 +279,18 @@ void RGIndexCreateSplit(char *fastaFileName,
 	int32_t numFiles = pow(ALPHABET_SIZE, layout->depth);
 	FILE **tmpFPs=NULL;
 	char **tmpFileNames=NULL;
-	uint8_t contig_8;
-	uint32_t contig_32;
-	uint32_t position;
 	gzFile *gzOuts=NULL;
+	int64_t j, entrySize, maxOpenFiles;
+	int32_t numScatterThreads, numBinThreads;
+	Range *segments=NULL;
+	int32_t numSegments=0;
+	RGIndexBinQueue queue;
+	ThreadRGIndexBinData *data=NULL;
+	pthread_t *threads=NULL;
+	int32_t errCode;
+	void *status=NULL;
+	int32_t indexStartContig, indexStartPos;
+	int64_t *prevLengths=NULL;
 
 	/* Get brg */
 	RGBinaryReadBinary(&rg, space, fastaFileName);
@@ -234,7 +300,8 @@ void RGIndexCreateSplit(char *fastaFileName,
 	assert(4 == ALPHABET_SIZE);
 
 	if(VERBOSE >=0) {
-		fprintf(stderr, "Creating the index...\n");
+		fprintf(stderr, "%s the index...\n",
+				(1 == update) ? "Updating" : "Creating");
 	}
 
 	/* Adjust bounds */
@@ -243,6 +310,26 @@ void RGIndexCreateSplit(char *fastaFileName,
 			&startPos,
 			&endContig,
 			&endPos);
+	indexStartContig = startContig;
+	indexStartPos = startPos;
+	if(1 == update) {
+		/* Only add the contigs not in the existing index */
+		prevLengths = malloc(sizeof(int64_t)*numFiles);
+		if(NULL == prevLengths) {
+			PrintError(FnName, "prevLengths", "Could not allocate memory", Exit, MallocMemory);
+		}
+		RGIndexGetUpdateRange(fastaFileName,
+				&rg,
+				layout,
+				space,
+				indexNumber,
+				repeatMasker,
+				prevLengths,
+				&indexStartContig,
+				&indexStartPos,
+				&startContig,
+				&startPos);
+	}
 
 	gzOuts = malloc(sizeof(gzFile)*numFiles);
 	if(NULL == gzOuts) {
@@ -258,29 +345,44 @@ void RGIndexCreateSplit(char *fastaFileName,
 				space,
 				i+1,
 				indexNumber,
-				startContig,
-				startPos,
+				indexStartContig,
+				indexStartPos,
 				endContig,
 				endPos,
 				repeatMasker);
 		/* Open file */
-		gzOuts[i] = RGIndexOpenForWriting(fastaFileName, &index); 
+		if(1 == update) {
+			gzOuts[i] = RGIndexOpenForUpdating(fastaFileName, &index); 
+		}
+		else {
+			gzOuts[i] = RGIndexOpenForWriting(fastaFileName, &index); 
+		}
 		/* Delete */
 		RGIndexDelete(&index);
 	}
 
+	/* Each scatter thread writes its own set of bins, so make sure we
+	 * stay within the limit on open files. */
+	maxOpenFiles = sysconf(_SC_OPEN_MAX);
+	numScatterThreads = numThreads;
+	while(1 < numScatterThreads &&
+			0 < maxOpenFiles &&
+			maxOpenFiles < ((int64_t)numScatterThreads + 1)*numFiles + RGINDEX_RESERVED_FILES) {
+		numScatterThreads--;
+	}
+
 	/* Bin and create from each bin ... */
-	tmpFPs = malloc(sizeof(FILE*)*numFiles);
+	tmpFPs = malloc(sizeof(FILE*)*numFiles*numScatterThreads);
 	if(NULL == tmpFPs) {
 		PrintError(FnName, "tmpFPs", "Could not allocate memory", Exit, MallocMemory);	
 	}	
-	tmpFileNames = malloc(sizeof(char*)*numFiles);	
+	tmpFileNames = malloc(sizeof(char*)*numFiles*numScatterThreads);	
 	if(NULL == tmpFileNames) {		
 		PrintError(FnName, "tmpFileNames", "Could not allocate memory", Exit, MallocMemory);
 	}
 
 	/* Open tmp files */
-	for(i=0;i<numFiles;i++) {
+	for(i=0;i<numFiles*numScatterThreads;i++) {
 		tmpFPs[i] = OpenTmpFile(tmpDir, &tmpFileNames[i]);
 	}
 
@@ -300,137 +402,697 @@ void RGIndexCreateSplit(char *fastaFileName,
 	/* Create bins */
 	if(UseExons == useExons) { /* Use only bases within the exons */
 		for(i=0;i<e->numExons;i++) { /* For each exon */
-			RGIndexCreateHelper(&index,
-					&rg,
-					tmpFPs,
+			RGIndexGetSegments(&rg,
 					e->exons[i].startContig,
 					e->exons[i].startPos,
 					e->exons[i].endContig,
 					e->exons[i].endPos,
-					repeatMasker,
-					includeNs);
+					&segments,
+					&numSegments);
 		}
 	}
 	else {
-		RGIndexCreateHelper(&index,
-				&rg,
-				tmpFPs,
+		RGIndexGetSegments(&rg,
 				startContig,
 				startPos,
 				endContig,
 				endPos,
-				repeatMasker,
-				includeNs);
+				&segments,
+				&numSegments);
 	}
+	RGIndexScatter(&index,
+			&rg,
+			tmpFPs,
+			numFiles,
+			numScatterThreads,
+			segments,
+			numSegments,
+			repeatMasker,
+			includeNs);
 	if(VERBOSE >= 0) {
 		PrintContigPos(stderr, 
 				endContig,
 				endPos);
 		fprintf(stderr, "\n");
 	}
+	free(segments);
+	segments=NULL;
+
+	/* Get the size of each bin */
+	queue.bins = malloc(sizeof(RGIndexBin)*numFiles);
+	if(NULL == queue.bins) {
+		PrintError(FnName, "queue.bins", "Could not allocate memory", Exit, MallocMemory);
+	}
+	entrySize = (Contig_8 == index.contigType) ? (sizeof(uint8_t) + sizeof(uint32_t)) : (sizeof(uint32_t) + sizeof(uint32_t));
+	for(i=0;i<numFiles;i++) {
+		queue.bins[i].bin = i;
+		queue.bins[i].length = 0;
+		for(j=0;j<numScatterThreads;j++) {
+			if(0 != fseek(tmpFPs[j*numFiles + i], 0, SEEK_END)) {
+				PrintError(FnName, "tmpFPs", "Could not seek in file", Exit, OutOfRange);
+			}
+			queue.bins[i].length += ftell(tmpFPs[j*numFiles + i])/entrySize;
+		}
+		/* The entries, the merge buffer and the hash, including the 
+		 * entries of the existing index when updating */
+		queue.bins[i].memory = 2*entrySize*(queue.bins[i].length + ((1 == update) ? prevLengths[i] : 0)) + sizeof(uint32_t)*index.hashLength;
+		queue.bins[i].started = 0;
+	}
+	/* Largest bins first */
+	qsort(queue.bins, numFiles, sizeof(RGIndexBin), RGIndexBinCompare);
+	queue.numBins = numFiles;
+	queue.numStarted = 0;
+	queue.memoryLimit = memoryLimit;
+	queue.memoryUsed = 0;
+	pthread_mutex_init(&queue.lock, NULL);
+	pthread_cond_init(&queue.released, NULL);
 
 	/* Delete dummy index */
 	RGIndexDelete(&index);
 
-	/* Process each bin */
-	for(i=0;i<numFiles;i++) {
-		if(VERBOSE >= 0) {
-			fprintf(stderr, "%s", BREAK_LINE);
-			fprintf(stderr, "Creating index (bin %d/%d)\n",
-					(int)(i+1), numFiles);
+	/* Process the bins in parallel, splitting the remaining threads
+	 * among the sorts. */
+	numBinThreads = (numThreads < numFiles) ? numThreads : numFiles;
+	data = malloc(sizeof(ThreadRGIndexBinData)*numBinThreads);
+	if(NULL == data) {
+		PrintError(FnName, "data", "Could not allocate memory", Exit, MallocMemory);
+	}
+	threads = malloc(sizeof(pthread_t)*numBinThreads);
+	if(NULL == threads) {
+		PrintError(FnName, "threads", "Could not allocate memory", Exit, MallocMemory);
+	}
+	for(i=0;i<numBinThreads;i++) {
+		data[i].queue = &queue;
+		data[i].rg = &rg;
+		data[i].layout = layout;
+		data[i].space = space;
+		data[i].indexNumber = indexNumber;
+		data[i].startContig = indexStartContig;
+		data[i].startPos = indexStartPos;
+		data[i].endContig = endContig;
+		data[i].endPos = endPos;
+		data[i].repeatMasker = repeatMasker;
+		data[i].fastaFileName = fastaFileName;
+		data[i].update = update;
+		data[i].tmpFPs = tmpFPs;
+		data[i].tmpFileNames = tmpFileNames;
+		data[i].numFiles = numFiles;
+		data[i].numScatterThreads = numScatterThreads;
+		data[i].gzOuts = gzOuts;
+		data[i].numPartitions = RGIndexGetNumPartitions(numThreads);
+		data[i].numSortThreads = numThreads/numBinThreads;
+		data[i].showProgress = (1 == numBinThreads) ? 1 : 0;
+		data[i].tmpDir = tmpDir;
+		data[i].threadID = i;
+	}
+
+	/* Create threads */
+	for(i=0;i<numBinThreads;i++) {
+		/* Start thread */
+		errCode = pthread_create(&threads[i], /* thread struct */
+				NULL, /* default thread attributes */
+				RGIndexCreateBins, /* start routine */
+				(void*)(&data[i])); /* data to routine */
+		if(0!=errCode) {
+			PrintError(FnName, "pthread_create: errCode", "Could not start thread", Exit, ThreadError);
+		}
+	}
+
+	/* Wait for the threads to finish */
+	for(i=0;i<numBinThreads;i++) {
+		/* Wait for the given thread to return */
+		errCode = pthread_join(threads[i],
+				&status);
+		/* Check the return code of the thread */
+		if(0!=errCode) {
+			PrintError(FnName, "pthread_join: errCode", "Thread returned an error", Exit, ThreadError);
 		}
-		/* Initialize */
-		RGIndexInitializeFull(&index,
-				&rg,
-				layout,
-				space,
-				i+1,
-				indexNumber,
-				startContig,
-				startPos,
-				endContig,
-				endPos,
-				repeatMasker);
+	}
 
-		/* Read in from tmp file */
-		index.length=0;
-		fseek(tmpFPs[i], 0, SEEK_SET);
-		if(Contig_8 == index.contigType) {
-			while(fread(&contig_8, sizeof(uint8_t), 1, tmpFPs[i]) == 1 &&
-					fread(&position, sizeof(uint32_t), 1, tmpFPs[i]) == 1) {
-				/* Insert */
-				index.length++;
-
-				/* Reallocate memory */
-				index.positions = realloc(index.positions, sizeof(uint32_t)*index.length);
-				if(NULL == index.positions) {
-					PrintError("RGBinaryCreate", "index.positions", "Could not reallocate memory", Exit, ReallocMemory);
-				}
-				index.contigs_8 = realloc(index.contigs_8, sizeof(uint8_t)*index.length);
-				if(NULL == index.contigs_8) {
-					PrintError("RGBinaryCreate", "index.contigs_8", "Could not reallocate memory", Exit, ReallocMemory);
-				}
+	if(VERBOSE >= 0) {
+		fprintf(stderr, "%s", BREAK_LINE);
+	}
 
-				/* Copy over */
-				index.positions[index.length-1] = position;
-				index.contigs_8[index.length-1] = contig_8;
+	/* Free memory */
+	pthread_mutex_destroy(&queue.lock);
+	pthread_cond_destroy(&queue.released);
+	free(queue.bins);
+	free(data);
+	free(threads);
+	free(gzOuts);
+	free(tmpFPs);
+	free(tmpFileNames);
+	free(prevLengths);
+	RGBinaryDelete(&rg);
+}
+
+/* TODO */
+/* Splits a range into one range per contig, in the same order the bases
+ * would be visited by RGIndexCreateHelper. */
+void RGIndexGetSegments(RGBinary *rg,
+		int32_t startContig,
+		int32_t startPos,
+		int32_t endContig,
+		int32_t endPos,
+		Range **segments,
+		int32_t *numSegments)
+{
+	char *FnName="RGIndexGetSegments";
+	int32_t curContig;
+
+	for(curContig=startContig;curContig<=endContig;curContig++) {
+		(*numSegments)++;
+		(*segments) = realloc((*segments), sizeof(Range)*(*numSegments));
+		if(NULL == (*segments)) {
+			PrintError(FnName, "segments", "Could not reallocate memory", Exit, ReallocMemory);
+		}
+		(*segments)[(*numSegments)-1].contigStart = curContig;
+		(*segments)[(*numSegments)-1].contigEnd = curContig;
+		(*segments)[(*numSegments)-1].positionStart = (curContig==startContig)?startPos:1;
+		(*segments)[(*numSegments)-1].positionEnd = (curContig==endContig)?endPos:(rg->contigs[curContig-1].sequenceLength);
+	}
+}
+
+/* TODO */
+/* Bins the keys starting in each segment.  The segments are divided 
+ * evenly among the threads by the number of key start positions, and 
+ * each thread writes to its own set of bins so that concatenating the
+ * threads' bins in order gives the same entries as a serial pass. */
+void RGIndexScatter(RGIndex *index,
+		RGBinary *rg,
+		FILE **tmpFPs,
+		int32_t numFiles,
+		int32_t numThreads,
+		Range *segments,
+		int32_t numSegments,
+		int32_t repeatMasker,
+		int32_t includeNs)
+{
+	char *FnName="RGIndexScatter";
+	ThreadRGIndexScatterData *data=NULL;
+	pthread_t *threads=NULL;
+	int32_t errCode;
+	void *status=NULL;
+	int64_t i, total, quota, available;
+	int32_t curSegment, curPos, cutPos;
+	Range *r=NULL;
+
+	data = malloc(sizeof(ThreadRGIndexScatterData)*numThreads);
+	if(NULL == data) {
+		PrintError(FnName, "data", "Could not allocate memory", Exit, MallocMemory);
+	}
+	threads = malloc(sizeof(pthread_t)*numThreads);
+	if(NULL == threads) {
+		PrintError(FnName, "threads", "Could not allocate memory", Exit, MallocMemory);
+	}
+
+	/* Count the key start positions */
+	for(i=total=0;i<numSegments;i++) {
+		if(segments[i].positionStart <= segments[i].positionEnd) {
+			total += segments[i].positionEnd - segments[i].positionStart + 1;
+		}
+	}
+
+	/* Divide the segments */
+	curSegment = 0;
+	curPos = (0 < numSegments) ? segments[0].positionStart : 0;
+	for(i=0;i<numThreads;i++) {
+		data[i].index = index;
+		data[i].rg = rg;
+		data[i].tmpFPs = tmpFPs + i*numFiles;
+		data[i].ranges = NULL;
+		data[i].numRanges = 0;
+		data[i].repeatMasker = repeatMasker;
+		data[i].includeNs = includeNs;
+		data[i].showProgress = (0 == i) ? 1 : 0;
+		data[i].threadID = i;
+
+		quota = (total*(i+1))/numThreads - (total*i)/numThreads;
+		while(0 < quota && curSegment < numSegments) {
+			available = segments[curSegment].positionEnd - curPos + 1;
+			if(available <= 0) {
+				/* Nothing in this segment */
+				curSegment++;
+				curPos = (curSegment < numSegments) ? segments[curSegment].positionStart : 0;
+				continue;
+			}
+			data[i].numRanges++;
+			data[i].ranges = realloc(data[i].ranges, sizeof(Range)*data[i].numRanges);
+			if(NULL == data[i].ranges) {
+				PrintError(FnName, "data[i].ranges", "Could not reallocate memory", Exit, ReallocMemory);
+			}
+			r = &data[i].ranges[data[i].numRanges-1];
+			r->contigStart = r->contigEnd = segments[curSegment].contigStart;
+			r->positionStart = curPos;
+			if(available <= quota) {
+				/* Take the rest of the segment */
+				r->positionEnd = segments[curSegment].positionEnd;
+				quota -= available;
+				curSegment++;
+				curPos = (curSegment < numSegments) ? segments[curSegment].positionStart : 0;
+			}
+			else {
+				/* Cut the segment, extending the end so that the keys 
+				 * starting before the cut are complete */
+				cutPos = curPos + quota - 1;
+				r->positionEnd = cutPos + index->width - 1;
+				if(segments[curSegment].positionEnd < r->positionEnd) {
+					r->positionEnd = segments[curSegment].positionEnd;
+				}
+				curPos = cutPos + 1;
+				quota = 0;
 			}
 		}
-		else {
-			while(fread(&contig_32, sizeof(uint32_t), 1, tmpFPs[i]) == 1 &&
-					fread(&position, sizeof(uint32_t), 1, tmpFPs[i]) == 1) {
+	}
 
-				/* Insert */
-				index.length++;
+	/* Create threads */
+	for(i=0;i<numThreads;i++) {
+		/* Start thread */
+		errCode = pthread_create(&threads[i], /* thread struct */
+				NULL, /* default thread attributes */
+				RGIndexScatterThread, /* start routine */
+				(void*)(&data[i])); /* data to routine */
+		if(0!=errCode) {
+			PrintError(FnName, "pthread_create: errCode", "Could not start thread", Exit, ThreadError);
+		}
+	}
 
-				/* Reallocate memory */
-				index.positions = realloc(index.positions, sizeof(uint32_t)*index.length);
-				if(NULL == index.positions) {
-					PrintError("RGBinaryCreate", "index.positions", "Could not reallocate memory", Exit, ReallocMemory);
-				}
-				index.contigs_32 = realloc(index.contigs_32, sizeof(uint32_t)*index.length);
-				if(NULL == index.contigs_32) {
-					PrintError("RGBinaryCreate", "index.contigs_32", "Could not reallocate memory", Exit, ReallocMemory);
-				}
+	/* Wait for the threads to finish */
+	for(i=0;i<numThreads;i++) {
+		/* Wait for the given thread to return */
+		errCode = pthread_join(threads[i],
+				&status);
+		/* Check the return code of the thread */
+		if(0!=errCode) {
+			PrintError(FnName, "pthread_join: errCode", "Thread returned an error", Exit, ThreadError);
+		}
+		free(data[i].ranges);
+	}
+
+	free(data);
+	free(threads);
+}
+
+/* TODO */
+void *RGIndexScatterThread(void *arg)
+{
+	ThreadRGIndexScatterData *data = (ThreadRGIndexScatterData*)arg;
+	int32_t i;
+
+	for(i=0;i<data->numRanges;i++) {
+		RGIndexCreateHelper(data->index,
+				data->rg,
+				data->tmpFPs,
+				data->ranges[i].contigStart,
+				data->ranges[i].positionStart,
+				data->ranges[i].contigEnd,
+				data->ranges[i].positionEnd,
+				data->repeatMasker,
+				data->includeNs,
+				data->showProgress);
+	}
+
+	return arg;
+}
+
+/* TODO */
+int RGIndexBinCompare(const void *a, const void *b)
+{
+	const RGIndexBin *x = (const RGIndexBin*)a;
+	const RGIndexBin *y = (const RGIndexBin*)b;
+
+	if(x->memory != y->memory) {
+		return (x->memory < y->memory) ? 1 : -1;
+	}
+	return (x->bin < y->bin) ? -1 : ((x->bin > y->bin) ? 1 : 0);
+}
 
-				/* Copy over */
-				index.positions[index.length-1] = position;
-				index.contigs_32[index.length-1] = contig_32;
+/* TODO */
+/* Returns the largest bin not yet started that fits in the remaining 
+ * memory, waiting for other bins to finish if none fit.  A bin larger
+ * than the limit is processed by itself.  Returns NULL when all bins 
+ * have been started. */
+RGIndexBin *RGIndexBinQueueGet(RGIndexBinQueue *queue)
+{
+	RGIndexBin *bin=NULL;
+	int32_t i;
+
+	pthread_mutex_lock(&queue->lock);
+	while(NULL == bin && queue->numStarted < queue->numBins) {
+		for(i=0;NULL == bin && i<queue->numBins;i++) {
+			if(0 == queue->bins[i].started &&
+					(0 == queue->memoryUsed || queue->memoryUsed + queue->bins[i].memory <= queue->memoryLimit)) {
+				bin = &queue->bins[i];
 			}
 		}
+		if(NULL == bin) {
+			pthread_cond_wait(&queue->released, &queue->lock);
+		}
+	}
+	if(NULL != bin) {
+		bin->started = 1;
+		queue->numStarted++;
+		queue->memoryUsed += bin->memory;
+	}
+	pthread_mutex_unlock(&queue->lock);
+
+	return bin;
+}
+
+/* TODO */
+void RGIndexBinQueueRelease(RGIndexBinQueue *queue, RGIndexBin *bin)
+{
+	pthread_mutex_lock(&queue->lock);
+	queue->memoryUsed -= bin->memory;
+	pthread_cond_broadcast(&queue->released);
+	pthread_mutex_unlock(&queue->lock);
+}
+
+/* TODO */
+void *RGIndexCreateBins(void *arg)
+{
+	ThreadRGIndexBinData *data = (ThreadRGIndexBinData*)arg;
+	RGIndexBin *bin=NULL;
+	RGIndex index;
+
+	while(NULL != (bin = RGIndexBinQueueGet(data->queue))) {
+		if(VERBOSE >= 0 && 1 == data->showProgress) {
+			fprintf(stderr, "%s", BREAK_LINE);
+			fprintf(stderr, "Creating index (bin %d/%d)\n",
+					bin->bin+1, data->numFiles);
+		}
+		/* Initialize */
+		RGIndexInitializeFull(&index,
+				data->rg,
+				data->layout,
+				data->space,
+				bin->bin+1,
+				data->indexNumber,
+				data->startContig,
+				data->startPos,
+				data->endContig,
+				data->endPos,
+				data->repeatMasker);
+
+		/* Read in from the tmp files */
+		RGIndexReadBin(&index,
+				data->tmpFPs,
+				data->tmpFileNames,
+				bin->bin,
+				data->numFiles,
+				data->numScatterThreads,
+				bin->length);
 
 		/* Sort the nodes in the index */
-		RGIndexSort(&index, &rg, numThreads, tmpDir);
+		if(0 < index.length) {
+			RGIndexSort(&index, 
+					data->rg, 
+					data->numPartitions, 
+					data->numSortThreads, 
+					RGIndexGetSortMemoryLimit(&index, (bin->memory < data->queue->memoryLimit) ? bin->memory : data->queue->memoryLimit),
+					data->showProgress, 
+					data->tmpDir);
+		}
+
+		/* Merge with the existing index */
+		if(1 == data->update) {
+			RGIndexAppend(&index,
+					data->rg,
+					data->fastaFileName,
+					data->numSortThreads,
+					(bin->memory < data->queue->memoryLimit) ? bin->memory : data->queue->memoryLimit,
+					data->tmpDir);
+		}
 
 		/* Create hash table from the index */
-		RGIndexCreateHash(&index, &rg);
+		RGIndexCreateHash(&index, data->rg, data->showProgress);
 
 		/* Write */
-		RGIndexPrint(gzOuts[i], &index);
-		/* TODO: output Messages */
+		RGIndexPrint(data->gzOuts[bin->bin], &index);
+		if(1 == data->update) {
+			RGIndexFinishUpdating(data->fastaFileName, &index);
+		}
 
 		if(VERBOSE >= 0) {
-			fprintf(stderr, "Index created.\n");
-			fprintf(stderr, "Index size is %.3lfGB.\n",
-					RGIndexGetSize(&index, GIGABYTES));
+			if(1 == data->showProgress) {
+				fprintf(stderr, "Index created.\n");
+				fprintf(stderr, "Index size is %.3lfGB.\n",
+						RGIndexGetSize(&index, GIGABYTES));
+			}
+			else {
+				fprintf(stderr, "Index created (bin %d/%d).  Index size is %.3lfGB.\n",
+						bin->bin+1, data->numFiles,
+						RGIndexGetSize(&index, GIGABYTES));
+			}
 		}
 
 		/* Free memory */
 		RGIndexDelete(&index);
+		RGIndexBinQueueRelease(data->queue, bin);
+	}
+
+	return arg;
+}
+
+/* TODO */
+/* Reads a bin back from each scatter thread's tmp file, in thread order,
+ * and closes the tmp files. */
+void RGIndexReadBin(RGIndex *index,
+		FILE **tmpFPs,
+		char **tmpFileNames,
+		int32_t bin,
+		int32_t numFiles,
+		int32_t numScatterThreads,
+		int64_t length)
+{
+	char *FnName="RGIndexReadBin";
+	int32_t i;
+	int64_t j, k, numRead;
+	size_t contigSize, entrySize;
+	char *buffer=NULL, *entry=NULL;
+	FILE *fp=NULL;
+
+	contigSize = (Contig_8 == index->contigType) ? sizeof(uint8_t) : sizeof(uint32_t);
+	entrySize = contigSize + sizeof(uint32_t);
+
+	/* Allocate memory */
+	index->length = length;
+	index->positions = malloc(sizeof(uint32_t)*(1 + length));
+	if(NULL == index->positions) {
+		PrintError(FnName, "index->positions", "Could not allocate memory", Exit, MallocMemory);
+	}
+	if(Contig_8 == index->contigType) {
+		index->contigs_8 = malloc(sizeof(uint8_t)*(1 + length));
+		if(NULL == index->contigs_8) {
+			PrintError(FnName, "index->contigs_8", "Could not allocate memory", Exit, MallocMemory);
+		}
+	}
+	else {
+		index->contigs_32 = malloc(sizeof(uint32_t)*(1 + length));
+		if(NULL == index->contigs_32) {
+			PrintError(FnName, "index->contigs_32", "Could not allocate memory", Exit, MallocMemory);
+		}
+	}
+	buffer = malloc(entrySize*RGINDEX_BIN_READ_LENGTH);
+	if(NULL == buffer) {
+		PrintError(FnName, "buffer", "Could not allocate memory", Exit, MallocMemory);
+	}
 
+	for(i=0, j=0;i<numScatterThreads;i++) {
+		fp = tmpFPs[i*numFiles + bin];
+		fseek(fp, 0, SEEK_SET);
+		while(0 < (numRead = fread(buffer, entrySize, RGINDEX_BIN_READ_LENGTH, fp))) {
+			if(length < j + numRead) {
+				PrintError(FnName, NULL, "Bin is larger than expected", Exit, OutOfRange);
+			}
+			for(k=0;k<numRead;k++, j++) {
+				entry = buffer + k*entrySize;
+				if(Contig_8 == index->contigType) {
+					memcpy(&index->contigs_8[j], entry, contigSize);
+				}
+				else {
+					memcpy(&index->contigs_32[j], entry, contigSize);
+				}
+				memcpy(&index->positions[j], entry + contigSize, sizeof(uint32_t));
+			}
+		}
 		/* Close the tmp file */
-		CloseTmpFile(&tmpFPs[i], &tmpFileNames[i]);
+		CloseTmpFile(&tmpFPs[i*numFiles + bin], &tmpFileNames[i*numFiles + bin]);
+	}
+	if(j != length) {
+		PrintError(FnName, NULL, "Bin is smaller than expected", Exit, OutOfRange);
 	}
 
-	if(VERBOSE >= 0) {
-		fprintf(stderr, "%s", BREAK_LINE);
+	free(buffer);
+}
+
+/* TODO */
+/* Checks that the existing index was created with the same options and
+ * ends at the end of a contig, and returns the range holding the contigs
+ * added to the reference genome since.  The start of the existing index 
+ * is kept. */
+void RGIndexGetUpdateRange(char *fastaFileName,
+		RGBinary *rg,
+		RGIndexLayout *layout,
+		int32_t space,
+		int32_t indexNumber,
+		int32_t repeatMasker,
+		int64_t *lengths,
+		int32_t *indexStartContig,
+		int32_t *indexStartPos,
+		int32_t *startContig,
+		int32_t *startPos)
+{
+	char *FnName="RGIndexGetUpdateRange";
+	int32_t numFiles = pow(ALPHABET_SIZE, layout->depth);
+	int32_t i, j, endContig=0, endPos=0;
+	char *bifName=NULL;
+	RGIndex index;
+
+	for(i=0;i<numFiles;i++) {
+		bifName = GetBIFName(fastaFileName, space, i+1, indexNumber);
+		if(0 == FileExists(bifName)) {
+			PrintError(FnName, bifName, "Could not find the index to update", Exit, OpenFileError);
+		}
+		RGIndexGetHeader(bifName, &index);
+
+		/* Check the layout */
+		if(index.space != space ||
+				index.depth != layout->depth ||
+				index.binNumber != i+1 ||
+				index.indexNumber != indexNumber ||
+				index.hashWidth != layout->hashWidth ||
+				index.width != layout->width ||
+				index.keysize != layout->keysize ||
+				index.repeatMasker != repeatMasker) {
+			PrintError(FnName, bifName, "The index was created with different options", Exit, OutOfRange);
+		}
+		for(j=0;j<index.width;j++) {
+			if(index.mask[j] != layout->mask[j]) {
+				PrintError(FnName, bifName, "The index was created with a different mask", Exit, OutOfRange);
+			}
+		}
+
+		/* Check the range */
+		if(0 == i) {
+			(*indexStartContig) = index.startContig;
+			(*indexStartPos) = index.startPos;
+			endContig = index.endContig;
+			endPos = index.endPos;
+		}
+		else if(index.startContig != (*indexStartContig) ||
+				index.startPos != (*indexStartPos) ||
+				index.endContig != endContig ||
+				index.endPos != endPos) {
+			PrintError(FnName, bifName, "The index parts do not cover the same range", Exit, OutOfRange);
+		}
+		if(NULL != lengths) {
+			lengths[i] = index.length;
+		}
+
+		free(index.mask);
+		free(index.packageVersion);
+		free(bifName);
+		bifName=NULL;
 	}
 
-	/* Free memory */
-	free(gzOuts);
-	free(tmpFPs);
-	free(tmpFileNames);
-	RGBinaryDelete(&rg);
+	/* The new contigs must follow the contigs in the index */
+	if(rg->numContigs < endContig ||
+			rg->contigs[endContig-1].sequenceLength != endPos) {
+		PrintError(FnName, NULL, "The index does not end at the end of a contig in the reference genome", Exit, OutOfRange);
+	}
+	if(rg->numContigs == endContig) {
+		PrintError(FnName, NULL, "The reference genome has no contigs after the end of the index", Exit, OutOfRange);
+	}
+	(*startContig) = endContig + 1;
+	(*startPos) = 1;
+}
+
+/* TODO */
+/* Merges the sorted entries for the new contigs with the entries of the
+ * existing index.  Keys found in both keep the existing entries first. */
+void RGIndexAppend(RGIndex *index,
+		RGBinary *rg,
+		char *fastaFileName,
+		int32_t numThreads,
+		int64_t memoryLimit,
+		char *tmpDir)
+{
+	char *FnName="RGIndexAppend";
+	RGIndex prev;
+	char *bifName=NULL;
+	int64_t i, length;
+	int64_t starts[2], ends[2];
+
+	/* Read in the existing index */
+	bifName = GetBIFName(fastaFileName, index->space, index->binNumber, index->indexNumber);
+	RGIndexRead(&prev, bifName);
+	free(bifName);
+	bifName=NULL;
+	/* The hash will be rebuilt */
+	free(prev.starts);
+	prev.starts=NULL;
+
+	/* Make room for the new entries after the existing entries */
+	length = prev.length + index->length;
+	prev.positions = realloc(prev.positions, sizeof(uint32_t)*length);
+	if(NULL == prev.positions) {
+		PrintError(FnName, "prev.positions", "Could not reallocate memory", Exit, ReallocMemory);
+	}
+	memcpy(prev.positions + prev.length, index->positions, sizeof(uint32_t)*index->length);
+	free(index->positions);
+	index->positions = prev.positions;
+	if(Contig_8 == index->contigType) {
+		assert(Contig_8 == prev.contigType);
+		prev.contigs_8 = realloc(prev.contigs_8, sizeof(uint8_t)*length);
+		if(NULL == prev.contigs_8) {
+			PrintError(FnName, "prev.contigs_8", "Could not reallocate memory", Exit, ReallocMemory);
+		}
+		memcpy(prev.contigs_8 + prev.length, index->contigs_8, sizeof(uint8_t)*index->length);
+		free(index->contigs_8);
+		index->contigs_8 = prev.contigs_8;
+	}
+	else if(Contig_8 == prev.contigType) {
+		/* The new contigs do not fit in one byte */
+		index->contigs_32 = realloc(index->contigs_32, sizeof(uint32_t)*length);
+		if(NULL == index->contigs_32) {
+			PrintError(FnName, "index->contigs_32", "Could not reallocate memory", Exit, ReallocMemory);
+		}
+		memmove(index->contigs_32 + prev.length, index->contigs_32, sizeof(uint32_t)*index->length);
+		for(i=0;i<prev.length;i++) {
+			index->contigs_32[i] = prev.contigs_8[i];
+		}
+		free(prev.contigs_8);
+	}
+	else {
+		prev.contigs_32 = realloc(prev.contigs_32, sizeof(uint32_t)*length);
+		if(NULL == prev.contigs_32) {
+			PrintError(FnName, "prev.contigs_32", "Could not reallocate memory", Exit, ReallocMemory);
+		}
+		memcpy(prev.contigs_32 + prev.length, index->contigs_32, sizeof(uint32_t)*index->length);
+		free(index->contigs_32);
+		index->contigs_32 = prev.contigs_32;
+	}
+
+	/* Merge */
+	starts[0] = 0;
+	ends[0] = prev.length-1;
+	starts[1] = prev.length;
+	ends[1] = length-1;
+	index->length = length;
+	if(starts[1] <= ends[1]) {
+		RGIndexMergeRuns(index,
+				rg,
+				starts,
+				ends,
+				2,
+				numThreads,
+				RGIndexGetSortMemoryLimit(index, memoryLimit),
+				tmpDir);
+	}
+
+	free(prev.mask);
+	free(prev.packageVersion);
 }
 
 /* TODO */
@@ -446,7 +1108,8 @@ void RGIndexCreateHelper(RGIndex *index,
 		int32_t endContig,
 		int32_t endPos,
 		int32_t repeatMasker,
-		int32_t includeNs)
+		int32_t includeNs,
+		int32_t showProgress)
 {
 	/* For storing the bases */
 	char *FnName="RGIndexCreateHelper";
@@ -490,7 +1153,7 @@ void RGIndexCreateHelper(RGIndex *index,
 
 		/* For each position */
 		for(curPos=curStartPos;curPos<=curEndPos;curPos++) {
-			if(VERBOSE >= 0) {
+			if(VERBOSE >= 0 && 1 == showProgress) {
 				if(curPos%RGINDEX_ROTATE_NUM==0) {
 					PrintContigPos(stderr, 
 							curContig,
@@ -609,7 +1272,7 @@ void RGIndexCreateHelper(RGIndex *index,
 								PrintError(FnName, "curContig and keyStartPos", "Could not write to file", Exit, WriteFileError);							}						}					}				}
 			}
 		}
-		if(VERBOSE >= 0) {
+		if(VERBOSE >= 0 && 1 == showProgress) {
 			PrintContigPos(stderr, 
 					curContig,
 					curPos);
@@ -618,7 +1281,7 @@ void RGIndexCreateHelper(RGIndex *index,
 }
 
 /* TODO */
-void RGIndexCreateHash(RGIndex *index, RGBinary *rg)
+void RGIndexCreateHash(RGIndex *index, RGBinary *rg, int32_t showProgress)
 {
 	char *FnName = "RGIndexCreateHash";
 	uint32_t curHash, prevHash, prevStart;
@@ -641,14 +1304,14 @@ void RGIndexCreateHash(RGIndex *index, RGBinary *rg)
 	}
 
 	/* Go through index and update the hash */
-	if(VERBOSE >= 0) {
+	if(VERBOSE >= 0 && 1 == showProgress) {
 		fprintf(stderr, "Creating a hash.\nPass 1 out of 2.  Out of %u, currently on:\n0",
 				(uint32_t)index->length);
 	}
 
 	prevHash = UINT_MAX;
 	for(i=0;i<index->length;i++) {
-		if(VERBOSE >= 0 && i%RGINDEX_ROTATE_NUM==0) {
+		if(VERBOSE >= 0 && 1 == showProgress && i%RGINDEX_ROTATE_NUM==0) {
 			fprintf(stderr, "\r%lld", 
 					(long long int)i);
 		}
@@ -673,7 +1336,7 @@ void RGIndexCreateHash(RGIndex *index, RGBinary *rg)
 	   }
 	   */
 
-	if(VERBOSE >= 0) {
+	if(VERBOSE >= 0 && 1 == showProgress) {
 		fprintf(stderr, "\r%lld\n", 
 				(long long int)i);
 		fprintf(stderr, "Pass 2 of 2.  Out of %lld, currently on:\n0",
@@ -684,7 +1347,7 @@ void RGIndexCreateHash(RGIndex *index, RGBinary *rg)
 	for(i=index->hashLength-1, prevStart=UINT_MAX;
 			0<=i;
 			i--) {
-		if(VERBOSE >=0 && (index->hashLength-i)%RGINDEX_ROTATE_NUM == 0) {
+		if(VERBOSE >= 0 && 1 == showProgress && (index->hashLength-i)%RGINDEX_ROTATE_NUM == 0) {
 			fprintf(stderr, "\r%lld", 
 					(long long int)(index->hashLength-i));
 		}
@@ -695,7 +1358,7 @@ void RGIndexCreateHash(RGIndex *index, RGBinary *rg)
 			prevStart = index->starts[i];
 		}
 	}
-	if(VERBOSE >=0) {
+	if(VERBOSE >= 0 && 1 == showProgress) {
 		fprintf(stderr, "\r%lld\n", 
 				(long long int)(index->hashLength));
 	}
@@ -714,175 +1377,100 @@ void RGIndexCreateHash(RGIndex *index, RGBinary *rg)
 	   i++;
 	   }
 	   */
-	if(VERBOSE >= 0) {
+	if(VERBOSE >= 0 && 1 == showProgress) {
 		fprintf(stderr, "\rHash created.\n");
 	}
 }
 
 /* TODO */
-void RGIndexSort(RGIndex *index, RGBinary *rg, int32_t numThreads, char* tmpDir)
+/* Sorts the index in numPartitions pieces which are then merged 
+ * together.  The result depends only on the number of partitions, so 
+ * the pieces may be sorted with fewer threads than partitions. */
+void RGIndexSort(RGIndex *index, RGBinary *rg, int32_t numPartitions, int32_t numThreads, int64_t memoryLimit, int32_t showProgress, char* tmpDir)
 {
 	char *FnName = "RGIndexSort";
-	int64_t i, j;
+	int64_t i;
 	ThreadRGIndexSortData *sortData=NULL;
-	ThreadRGIndexMergeData *mergeData=NULL;
-	pthread_t *threads=NULL;
-	int32_t errCode;
-	void *status=NULL;
+	int64_t *starts=NULL, *ends=NULL;
 	double curPercentComplete = 0.0;
-	int32_t curNumThreads = numThreads;
-	int32_t curMergeIteration, curThread;
 
-	/* Only use threads if we want to divide and conquer */
-	if(numThreads > 1) {
-		if(VERBOSE >= 0) {
+	/* Only use partitions if we want to divide and conquer */
+	if(numPartitions > 1) {
+		if(VERBOSE >= 0 && 1 == showProgress) {
 			fprintf(stderr, "Sorting by thread...\n");
 		}
-		/* Should check that the number of threads is a power of 4 since we split
+		/* Should check that the number of partitions is a power of 2 since we split
 		 * in half in both sorts. */
-		assert(IsAPowerOfTwo(numThreads)==1);
+		assert(IsAPowerOfTwo(numPartitions)==1);
 
 		/* Allocate memory for the thread arguments */
-		sortData = malloc(sizeof(ThreadRGIndexSortData)*numThreads);
+		sortData = malloc(sizeof(ThreadRGIndexSortData)*numPartitions);
 		if(NULL==sortData) {
 			PrintError(FnName, "sortData", "Could not allocate memory", Exit, MallocMemory);
 		}
-		/* Allocate memory for the thread point32_ters */
-		threads = malloc(sizeof(pthread_t)*numThreads);
-		if(NULL==threads) {
-			PrintError(FnName, "threads", "Could not allocate memory", Exit, MallocMemory);
-		}
 
 		/* Merge sort with tmp file I/O */
 
 		/* Initialize sortData */
-		for(i=0;i<numThreads;i++) {
+		for(i=0;i<numPartitions;i++) {
 			sortData[i].index = index;
 			sortData[i].rg = rg;
 			sortData[i].threadID = i;
-			sortData[i].low = i*(index->length/numThreads);
-			sortData[i].high = (i+1)*(index->length/numThreads)-1;
+			sortData[i].low = i*(index->length/numPartitions);
+			sortData[i].high = (i+1)*(index->length/numPartitions)-1;
 			sortData[i].showPercentComplete = 0;
 			sortData[i].tmpDir = tmpDir;
-			/* Divide the maximum overhead by the number of threads */
-			sortData[i].mergeMemoryLimit = MERGE_MEMORY_LIMIT/((int64_t)numThreads); 
-			sortData[i].mergeMemoryLimit = 1500000;
+			/* Divide the memory by the number of threads */
+			sortData[i].mergeMemoryLimit = memoryLimit/((int64_t)numThreads); 
 			assert(sortData[i].low >= 0 && sortData[i].high < index->length);
 		}
 		sortData[0].low = 0;
-		sortData[numThreads-1].high = index->length-1;
-		sortData[numThreads-1].showPercentComplete = 1;
+		sortData[numPartitions-1].high = index->length-1;
+		sortData[numPartitions-1].showPercentComplete = showProgress;
 
 		/* Check that we split correctly */
-		for(i=1;i<numThreads;i++) {
+		for(i=1;i<numPartitions;i++) {
 			assert(sortData[i-1].high < sortData[i].low);
 		}
 
-		/* Create threads */
-		for(i=0;i<numThreads;i++) {
-			/* Start thread */
-			errCode = pthread_create(&threads[i], /* thread struct */
-					NULL, /* default thread attributes */
-					RGIndexMergeSort, /* start routine */
-					(void*)(&sortData[i])); /* sortData to routine */
-			if(0!=errCode) {
-				PrintError(FnName, "pthread_create: errCode", "Could not start thread", Exit, ThreadError);
-			}
-		}
-
-		/* Wait for the threads to finish */
-		for(i=0;i<numThreads;i++) {
-			/* Wait for the given thread to return */
-			errCode = pthread_join(threads[i],
-					&status);
-			/* Check the return code of the thread */
-			if(0!=errCode) {
-				PrintError(FnName, "pthread_join: errCode", "Thread returned an error", Exit, ThreadError);
-			}
-			if(i==numThreads-1 && VERBOSE >= 0) {
-				fprintf(stderr, "\rWaiting for other threads to complete...");
-			}
+		/* Sort each partition */
+		RGIndexRunThreads(RGIndexMergeSort, 
+				sortData, 
+				sizeof(ThreadRGIndexSortData), 
+				numPartitions, 
+				numThreads);
+		if(VERBOSE >= 0 && 1 == showProgress) {
+			fprintf(stderr, "\rWaiting for other threads to complete...");
 		}
 
-		/* Free memory for the threads */
-		free(threads);
-		threads=NULL;
-
 		/* Now we must merge the results from the threads */
-		/* Merge intelligently i.e. merge recursively so 
-		 * there are only nlogn merges where n is the 
-		 * number of threads. */
-		curNumThreads = numThreads;
-		if(VERBOSE >= 0) {
+		if(VERBOSE >= 0 && 1 == showProgress) {
 			fprintf(stderr, "\rMerging sorts from threads...                          \n");
-			fprintf(stderr, "Out of %d required merges, currently on:\n0", Log2(numThreads));
 		}
-		for(i=1, curMergeIteration=1;i<numThreads;i=i*2, curMergeIteration++) { /* The number of merge iterations */
-			if(VERBOSE >= 0) {
-				fprintf(stderr, "\r%d", curMergeIteration);
-			}
-			curNumThreads /= 2; /* The number of threads to spawn */
-			/* Allocate memory for the thread arguments */
-			mergeData = malloc(sizeof(ThreadRGIndexMergeData)*curNumThreads);
-			if(NULL==mergeData) {
-				PrintError(FnName, "mergeData", "Could not allocate memory", Exit, MallocMemory);
-			}
-			/* Allocate memory for the thread point32_ters */
-			threads = malloc(sizeof(pthread_t)*curNumThreads);
-			if(NULL==threads) {
-				PrintError(FnName, "threads", "Could not allocate memory", Exit, MallocMemory);
-			}
-			/* Initialize data for threads */
-			for(j=0,curThread=0;j<numThreads;j+=2*i,curThread++) {
-				mergeData[curThread].index = index;
-				mergeData[curThread].rg = rg;
-				mergeData[curThread].threadID = curThread;
-				/* Use the same bounds as was used in the sort */
-				mergeData[curThread].low = sortData[j].low;
-				mergeData[curThread].mid = sortData[i+j].low-1;
-				mergeData[curThread].high = sortData[j+2*i-1].high;
-				mergeData[curThread].mergeMemoryLimit = MERGE_MEMORY_LIMIT/((int64_t)curNumThreads); 
-				mergeData[curThread].tmpDir = tmpDir;
-			}
-			/* Check that we split correctly */
-			for(j=1;j<curNumThreads;j++) {
-				if(mergeData[j-1].high >= mergeData[j].low) {
-					PrintError(FnName, NULL, "mergeData[j-1].high >= mergeData[j].low", Exit, OutOfRange);
-				}
-			}
-
-			/* Create threads */
-			for(j=0;j<curNumThreads;j++) {
-				/* Start thread */
-				errCode = pthread_create(&threads[j], /* thread struct */
-						NULL, /* default thread attributes */
-						RGIndexMerge, /* start routine */
-						(void*)(&mergeData[j])); /* sortData to routine */
-				if(0!=errCode) {
-					PrintError(FnName, "pthread_create: errCode", "Could not start thread", Exit, ThreadError);
-				}
-			}
-
-			/* Wait for the threads to finish */
-			for(j=0;j<curNumThreads;j++) {
-				/* Wait for the given thread to return */
-				errCode = pthread_join(threads[j],
-						&status);
-				/* Check the return code of the thread */
-				if(0!=errCode) {
-					PrintError(FnName, "pthread_join: errCode", "Thread returned an error", Exit, ThreadError);
-				}
-			}
-
-			/* Free memory for the merge data */
-			free(mergeData);
-			mergeData=NULL;
-			/* Free memory for the threads */
-			free(threads);
-			threads=NULL;
+		starts = malloc(sizeof(int64_t)*numPartitions);
+		if(NULL==starts) {
+			PrintError(FnName, "starts", "Could not allocate memory", Exit, MallocMemory);
 		}
-		if(VERBOSE >= 0) {
-			fprintf(stderr, "\nMerge complete.\n");
+		ends = malloc(sizeof(int64_t)*numPartitions);
+		if(NULL==ends) {
+			PrintError(FnName, "ends", "Could not allocate memory", Exit, MallocMemory);
+		}
+		for(i=0;i<numPartitions;i++) {
+			starts[i] = sortData[i].low;
+			ends[i] = sortData[i].high;
+		}
+		RGIndexMergeRuns(index,
+				rg,
+				starts,
+				ends,
+				numPartitions,
+				numThreads,
+				memoryLimit,
+				tmpDir);
+		free(starts);
+		free(ends);
+		if(VERBOSE >= 0 && 1 == showProgress) {
+			fprintf(stderr, "Merge complete.\n");
 		}
 
 		/* Free memory for sort data */
@@ -890,23 +1478,23 @@ void RGIndexSort(RGIndex *index, RGBinary *rg, int32_t numThreads, char* tmpDir)
 		sortData=NULL;
 	}
 	else {
-		if(VERBOSE >= 0) {
+		if(VERBOSE >= 0 && 1 == showProgress) {
 			fprintf(stderr, "Sorting...\n");
 		}
-		if(VERBOSE >= 0) {
+		if(VERBOSE >= 0 && 1 == showProgress) {
 			fprintf(stderr, "\r0 percent complete");
 		}
 		RGIndexMergeSortHelper(index,
 				rg,
 				0,
 				index->length-1,
-				1,
+				showProgress,
 				&curPercentComplete,
 				0,
 				index->length-1,
-				MERGE_MEMORY_LIMIT,
+				memoryLimit,
 				tmpDir);
-		if(VERBOSE >= 0) {
+		if(VERBOSE >= 0 && 1 == showProgress) {
 			fprintf(stderr, "\r100.00 percent complete\n");
 		}
 	}
@@ -921,10 +1509,85 @@ void RGIndexSort(RGIndex *index, RGBinary *rg, int32_t numThreads, char* tmpDir)
 			assert(RGIndexCompareAt(index, rg, i-1, i, 0) <= 0);
 		}
 	}
-	*/
-	if(VERBOSE >= 0) {
-		fprintf(stderr, "Sorted.\n");
-	}
+	*/
+	if(VERBOSE >= 0 && 1 == showProgress) {
+		fprintf(stderr, "Sorted.\n");
+	}
+}
+
+/* TODO */
+/* Returns the memory left for merging once the index and its hash 
+ * are accounted for */
+int64_t RGIndexGetSortMemoryLimit(RGIndex *index, int64_t memoryLimit)
+{
+	int64_t size;
+
+	size = index->length*((Contig_8 == index->contigType) ? (sizeof(uint8_t) + sizeof(uint32_t)) : (sizeof(uint32_t) + sizeof(uint32_t)));
+	size += sizeof(uint32_t)*index->hashLength;
+
+	return (size < memoryLimit) ? (memoryLimit - size) : 0;
+}
+
+/* TODO */
+/* Returns the largest power of two not greater than the number of threads */
+int32_t RGIndexGetNumPartitions(int32_t numThreads)
+{
+	int32_t numPartitions = 1;
+
+	while(2*numPartitions <= numThreads) {
+		numPartitions *= 2;
+	}
+	return numPartitions;
+}
+
+/* TODO */
+/* Runs the tasks, at most numThreads at a time */
+void RGIndexRunThreads(void *(*startRoutine)(void*),
+		void *data,
+		size_t dataSize,
+		int32_t numTasks,
+		int32_t numThreads)
+{
+	char *FnName = "RGIndexRunThreads";
+	pthread_t *threads=NULL;
+	int32_t errCode;
+	void *status=NULL;
+	int32_t i, j, numBatch;
+
+	/* Allocate memory for the thread pointers */
+	threads = malloc(sizeof(pthread_t)*numThreads);
+	if(NULL==threads) {
+		PrintError(FnName, "threads", "Could not allocate memory", Exit, MallocMemory);
+	}
+
+	for(i=0;i<numTasks;i+=numBatch) {
+		numBatch = (numTasks - i < numThreads) ? (numTasks - i) : numThreads;
+
+		/* Create threads */
+		for(j=0;j<numBatch;j++) {
+			/* Start thread */
+			errCode = pthread_create(&threads[j], /* thread struct */
+					NULL, /* default thread attributes */
+					startRoutine, /* start routine */
+					(void*)((char*)data + (i+j)*dataSize)); /* data to routine */
+			if(0!=errCode) {
+				PrintError(FnName, "pthread_create: errCode", "Could not start thread", Exit, ThreadError);
+			}
+		}
+
+		/* Wait for the threads to finish */
+		for(j=0;j<numBatch;j++) {
+			/* Wait for the given thread to return */
+			errCode = pthread_join(threads[j],
+					&status);
+			/* Check the return code of the thread */
+			if(0!=errCode) {
+				PrintError(FnName, "pthread_join: errCode", "Thread returned an error", Exit, ThreadError);
+			}
+		}
+	}
+
+	free(threads);
 }
 
 /* TODO */
@@ -1096,23 +1759,6 @@ void RGIndexMergeSortHelper(RGIndex *index,
 			tmpDir);
 }
 
-/* TODO */
-void *RGIndexMerge(void *arg)
-{
-	ThreadRGIndexMergeData *data = (ThreadRGIndexMergeData*)arg;
-
-	/* Merge the data */
-	RGIndexMergeHelper(data->index,
-			data->rg,
-			data->low,
-			data->mid,
-			data->high,
-			data->mergeMemoryLimit,
-			data->tmpDir);
-
-	return arg;
-}
-
 /* TODO */
 void RGIndexMergeHelper(RGIndex *index,
 		RGBinary *rg,
@@ -1125,27 +1771,31 @@ void RGIndexMergeHelper(RGIndex *index,
 	/*
 	   char *FnName = "RGIndexMergeHelper";
 	   */
+	int64_t starts[2]={low, mid+1};
+	int64_t ends[2]={mid, high};
 
 	/* Merge the two lists */
 	/* Since we want to keep space requirement small, use an upper bound on memory,
 	 * so that we use tmp files when memory requirements become to large */
 	if(index->contigType == Contig_8) {
-		if((high-low+1)*(sizeof(uint32_t) + sizeof(uint8_t)) <= mergeMemoryLimit) {
+		if((high-low+1)*(sizeof(uint32_t) + sizeof(uint8_t)) <= mergeMemoryLimit ||
+				high-low+1 <= RGINDEX_MERGE_BUFFER_LENGTH) {
 			/* Use memory */
 			RGIndexMergeHelperInMemoryContig_8(index, rg, low, mid, high);
 		}
 		else {
 			/* Use tmp files */
-			RGIndexMergeHelperFromDiskContig_8(index, rg, low, mid, high, tmpDir);
+			RGIndexMergeRuns(index, rg, starts, ends, 2, 1, mergeMemoryLimit, tmpDir);
 		}
 	}
 	else {
-		if((high-low+1)*(sizeof(uint32_t) + sizeof(uint32_t)) <= mergeMemoryLimit) {
+		if((high-low+1)*(sizeof(uint32_t) + sizeof(uint32_t)) <= mergeMemoryLimit ||
+				high-low+1 <= RGINDEX_MERGE_BUFFER_LENGTH) {
 			RGIndexMergeHelperInMemoryContig_32(index, rg, low, mid, high);
 		}
 		else {
 			/* Use tmp files */
-			RGIndexMergeHelperFromDiskContig_32(index, rg, low, mid, high, tmpDir);
+			RGIndexMergeRuns(index, rg, starts, ends, 2, 1, mergeMemoryLimit, tmpDir);
 		}
 	}
 	/* Test merge */
@@ -1306,414 +1956,509 @@ void RGIndexMergeHelperInMemoryContig_32(RGIndex *index,
 	tmpContigs_32=NULL;
 }
 
-static inline int32_t RGIndexMergeHelperFromDiskContigRead(void *contigs, void *positions, size_t contigsSize, size_t positionsSize, FILE *fpContigs, FILE *fpPositions, int32_t length)
-{
-  if(length != fread(contigs, contigsSize, length, fpContigs) ||
-     length != fread(positions, positionsSize, length, fpPositions)) {
-      return -1;
-  }
-
-  return length;
-}
-
-typedef struct {
-    FILE *fpContigs;
-    char *fnContigs;
-    FILE *fpPositions;
-    char *fnPositions;
-    uint8_t curContig;
-    uint32_t curPosition;
-    uint8_t *contigs;
-    uint32_t *positions;
-    uint32_t index;
-    uint32_t length; // # of entries in memory
-    uint32_t numLeft; // # of entries left to process
-    int32_t eof;
-    int32_t hasMore;
-} RGIndexMergeHelper_8_t;
-
-static void RGIndexMergeHelperFromDiskGetNext_8(RGIndexMergeHelper_8_t *buffer)
-{
-  char *FnName = "RGIndexMergeHelperFromDiskGetNext_8"; 
-  if(buffer->index < buffer->length) {
-      buffer->curContig = buffer->contigs[buffer->index];
-      buffer->curPosition = buffer->positions[buffer->index];
-      buffer->index++;
-      buffer->hasMore = 1;
-  }
-  else if(1 == buffer->eof) {
-      // do nothing
-      buffer->curContig = 0;
-      buffer->curPosition = 0;
-      buffer->hasMore = 0;
-  }
-  else { // buffer->index == buffer->length && 0 == buffer->eof
-      buffer->numLeft -= buffer->length;
-      buffer->length = (buffer->numLeft < buffer->length) ? buffer->numLeft : buffer->length;
-      if(0 == buffer->length) {
-          buffer->curContig = 0;
-          buffer->curPosition = 0;
-          buffer->hasMore = 0;
-      }
-      else {
-          if(buffer->length != RGIndexMergeHelperFromDiskContigRead(buffer->contigs, buffer->positions, sizeof(uint8_t), sizeof(uint32_t), buffer->fpContigs, buffer->fpPositions, buffer->length)) {
-              PrintError(FnName, NULL, "Could not read in buffer", Exit, ReadFileError);
-          }
-          buffer->curContig = buffer->contigs[0];
-          buffer->curPosition = buffer->positions[0];
-          buffer->index=1;
-          buffer->hasMore = 1;
-      }
-  }
-}
- 
+static inline uint32_t RGIndexMergeRunsGetContig(void *contigs, size_t contigSize, int64_t i)
+{
+	return (sizeof(uint8_t) == contigSize) ? ((uint8_t*)contigs)[i] : ((uint32_t*)contigs)[i];
+}
+
+static inline void RGIndexMergeRunsSetContig(void *contigs, size_t contigSize, int64_t i, uint32_t contig)
+{
+	if(sizeof(uint8_t) == contigSize) {
+		((uint8_t*)contigs)[i] = contig;
+	}
+	else {
+		((uint32_t*)contigs)[i] = contig;
+	}
+}
+
 /* TODO */
-void RGIndexMergeHelperFromDiskContig_8(RGIndex *index,
+/* Merges sorted runs that lie next to each other in the index.  Ties 
+ * are taken from the earlier run, so the result is the same as merging
+ * the runs pairwise.  The output is divided among the threads by 
+ * cutting every run at the same keys.  If a copy of the runs does not
+ * fit in the memory limit, the runs are written to tmp files and read
+ * back through double buffers while being merged straight into the 
+ * index. */
+void RGIndexMergeRuns(RGIndex *index,
 		RGBinary *rg,
-		int64_t low,
-		int64_t mid,
-		int64_t high,
+		int64_t *starts,
+		int64_t *ends,
+		int32_t numRuns,
+		int32_t numThreads,
+		int64_t mergeMemoryLimit, /* In bytes */
 		char *tmpDir)
 {
-	char *FnName = "RGIndexMergeHelperFromDiskContig_8";
-	int64_t i=0;
-	int64_t ctr=0;
-        RGIndexMergeHelper_8_t lowerBuffer;
-        RGIndexMergeHelper_8_t upperBuffer;
+	char *FnName="RGIndexMergeRuns";
+	int64_t low = starts[0];
+	int64_t high = ends[numRuns-1];
+	int64_t length = high - low + 1;
+	size_t contigSize = (Contig_8 == index->contigType) ? sizeof(uint8_t) : sizeof(uint32_t);
+	void *contigs = (Contig_8 == index->contigType) ? (void*)index->contigs_8 : (void*)index->contigs_32;
+	int64_t *cuts=NULL;
+	ThreadRGIndexMergeRunsData *data=NULL;
+	void *tmpContigs=NULL;
+	uint32_t *tmpPositions=NULL;
+	FILE *fpContigs=NULL, *fpPositions=NULL;
+	char *fnContigs=NULL, *fnPositions=NULL;
+	int32_t fromDisk;
+	int64_t bufferLength=0, offset;
+	int32_t i, j;
 
-	assert(index->contigType == Contig_8);
-	assert(index->contigs_8 != NULL);
+	if(length <= 0) {
+		return;
+	}
+	while(1 < numThreads && length/numThreads < RGINDEX_MERGE_MIN_THREAD_LENGTH) {
+		numThreads--;
+	}
+	fromDisk = (RGINDEX_MERGE_BUFFER_LENGTH < length && 
+			mergeMemoryLimit < length*((int64_t)(contigSize + sizeof(uint32_t)))) ? 1 : 0;
 
-	/* Merge the two lists */
-	/* Since we want to keep space requirement small, use an upper bound on memory,
-	 * so that we use tmp files when memory requirements become to large */
-	/* Use tmp files */
-
-        /* Init lower */
-	lowerBuffer.fpContigs = OpenTmpFile(tmpDir, &lowerBuffer.fnContigs);
-	lowerBuffer.fpPositions = OpenTmpFile(tmpDir, &lowerBuffer.fnPositions);
-        lowerBuffer.length = RGINDEX_MERGE_BUFFER_LENGTH;
-        lowerBuffer.contigs = malloc(sizeof(uint8_t)*lowerBuffer.length);
-        if(NULL == lowerBuffer.contigs) {
-            PrintError(FnName, "lowerBuffer.contigs", "Could not allocate memory", Exit, MallocMemory);
-        }
-        lowerBuffer.positions = malloc(sizeof(uint32_t)*lowerBuffer.length);
-        if(NULL == lowerBuffer.positions) {
-            PrintError(FnName, "lowerBuffer.positions", "Could not allocate memory", Exit, MallocMemory);
-        }
-        lowerBuffer.index = RGINDEX_MERGE_BUFFER_LENGTH;
-        lowerBuffer.numLeft = mid - low + 1 + RGINDEX_MERGE_BUFFER_LENGTH; // NB: RGINDEX_MERGE_BUFFER_LENGTH will be subtracted on the first call to read in
-        lowerBuffer.eof = 0;
-	
-        /* Init upper */
-	upperBuffer.fpContigs = OpenTmpFile(tmpDir, &upperBuffer.fnContigs);
-	upperBuffer.fpPositions = OpenTmpFile(tmpDir, &upperBuffer.fnPositions);
-        upperBuffer.length = RGINDEX_MERGE_BUFFER_LENGTH;
-        upperBuffer.contigs = malloc(sizeof(uint8_t)*upperBuffer.length);
-        if(NULL == upperBuffer.contigs) {
-            PrintError(FnName, "upperBuffer.contigs", "Could not allocate memory", Exit, MallocMemory);
-        }
-        upperBuffer.positions = malloc(sizeof(uint32_t)*upperBuffer.length);
-        if(NULL == upperBuffer.positions) {
-            PrintError(FnName, "upperBuffer.positions", "Could not allocate memory", Exit, MallocMemory);
-        }
-        upperBuffer.index = RGINDEX_MERGE_BUFFER_LENGTH;
-        upperBuffer.numLeft = high - mid + RGINDEX_MERGE_BUFFER_LENGTH; // NB: RGINDEX_MERGE_BUFFER_LENGTH will be subtracted on the first call to read in
-        upperBuffer.eof = 0;
-	   
-	/* Print to tmp files */
-        if((mid - low + 1) != fwrite(index->contigs_8 + low, sizeof(uint8_t), (mid - low + 1), lowerBuffer.fpContigs)) {
-            PrintError(FnName, "index->contigs_8", "Could not write contigs_8 to tmp lower file", Exit, WriteFileError);
-        }
-        if((mid - low + 1) != fwrite(index->positions + low, sizeof(uint32_t), (mid - low + 1), lowerBuffer.fpPositions)) {
-            PrintError(FnName, "index->positions", "Could not write positions to tmp lower file", Exit, WriteFileError);
-	}
-        if((high - mid) != fwrite(index->contigs_8 + mid + 1, sizeof(uint8_t), (high - mid), upperBuffer.fpContigs)) {
-            PrintError(FnName, "index->contigs_8", "Could not write contigs_8 to tmp upper file", Exit, WriteFileError);
-        }
-        if((high - mid) != fwrite(index->positions + mid + 1, sizeof(uint32_t), (high - mid), upperBuffer.fpPositions)) {
-            PrintError(FnName, "index->positions", "Could not write positions to tmp upper file", Exit, WriteFileError);
-        }
-
-	/* Move to beginning of the files */
-	fseek(lowerBuffer.fpContigs, 0 , SEEK_SET);
-	fseek(lowerBuffer.fpPositions, 0 , SEEK_SET);
-	fseek(upperBuffer.fpContigs, 0 , SEEK_SET);
-	fseek(upperBuffer.fpPositions, 0 , SEEK_SET);
-
-	/* Merge tmp files back into index */
-	/* Get first contig/pos */
-        RGIndexMergeHelperFromDiskGetNext_8(&lowerBuffer);
-        RGIndexMergeHelperFromDiskGetNext_8(&upperBuffer);
-
-        assert(0 == lowerBuffer.eof);
-        assert(0 == upperBuffer.eof);
+	/* Divide the runs among the threads */
+	cuts = malloc(sizeof(int64_t)*(numThreads+1)*numRuns);
+	if(NULL == cuts) {
+		PrintError(FnName, "cuts", "Could not allocate memory", Exit, MallocMemory);
+	}
+	RGIndexMergeRunsGetCuts(index, rg, starts, ends, numRuns, numThreads, cuts);
 
-	for(i=low, ctr=0;
-			i<=high &&
-                        1 == lowerBuffer.hasMore &&
-                        1 == upperBuffer.hasMore;
-			i++, ctr++) {
-		if(RGIndexCompareContigPos(index,
-					rg,
-                                        lowerBuffer.curContig,
-                                        lowerBuffer.curPosition,
-                                        upperBuffer.curContig,
-                                        upperBuffer.curPosition,
-					0)<=0) {
-			/* Copy lower */
-			index->contigs_8[i] = lowerBuffer.curContig;
-			index->positions[i] = lowerBuffer.curPosition;
-                        /* Get next */
-                        RGIndexMergeHelperFromDiskGetNext_8(&lowerBuffer);
+	if(0 == fromDisk) {
+		tmpContigs = malloc(contigSize*length);
+		if(NULL == tmpContigs) {
+			PrintError(FnName, "tmpContigs", "Could not allocate memory", Exit, MallocMemory);
+		}
+		tmpPositions = malloc(sizeof(uint32_t)*length);
+		if(NULL == tmpPositions) {
+			PrintError(FnName, "tmpPositions", "Could not allocate memory", Exit, MallocMemory);
+		}
+	}
+	else {
+		/* Print to tmp files */
+		fpContigs = OpenTmpFile(tmpDir, &fnContigs);
+		fpPositions = OpenTmpFile(tmpDir, &fnPositions);
+		if(length != fwrite((char*)contigs + low*contigSize, contigSize, length, fpContigs) ||
+				0 != fflush(fpContigs)) {
+			PrintError(FnName, "contigs", "Could not write contigs to tmp file", Exit, WriteFileError);
+		}
+		if(length != fwrite(index->positions + low, sizeof(uint32_t), length, fpPositions) ||
+				0 != fflush(fpPositions)) {
+			PrintError(FnName, "index->positions", "Could not write positions to tmp file", Exit, WriteFileError);
+		}
+		/* Two buffers per run per thread */
+		bufferLength = mergeMemoryLimit/(2*numRuns*numThreads*((int64_t)(contigSize + sizeof(uint32_t))));
+		bufferLength -= bufferLength % RGINDEX_MERGE_ALIGNMENT;
+		if(bufferLength < RGINDEX_MERGE_MIN_BUFFER_LENGTH) {
+			bufferLength = RGINDEX_MERGE_MIN_BUFFER_LENGTH;
+		}
+		else if(RGINDEX_MERGE_BUFFER_LENGTH < bufferLength) {
+			bufferLength = RGINDEX_MERGE_BUFFER_LENGTH;
+		}
+	}
+
+	data = malloc(sizeof(ThreadRGIndexMergeRunsData)*numThreads);
+	if(NULL == data) {
+		PrintError(FnName, "data", "Could not allocate memory", Exit, MallocMemory);
+	}
+	for(i=0;i<numThreads;i++) {
+		data[i].index = index;
+		data[i].rg = rg;
+		data[i].numRuns = numRuns;
+		data[i].begins = cuts + i*numRuns;
+		data[i].ends = cuts + (i+1)*numRuns;
+		data[i].fromDisk = fromDisk;
+		data[i].fdContigs = (1 == fromDisk) ? fileno(fpContigs) : -1;
+		data[i].fdPositions = (1 == fromDisk) ? fileno(fpPositions) : -1;
+		data[i].fileLow = low;
+		data[i].bufferLength = bufferLength;
+		for(j=0, offset=0;j<numRuns;j++) {
+			offset += data[i].begins[j] - starts[j];
+		}
+		if(0 == fromDisk) {
+			data[i].outContigs = tmpContigs;
+			data[i].outPositions = tmpPositions;
+			data[i].outOffset = offset;
 		}
 		else {
-			index->contigs_8[i] = upperBuffer.curContig;
-			index->positions[i] = upperBuffer.curPosition;
-                        /* Get next */
-                        RGIndexMergeHelperFromDiskGetNext_8(&upperBuffer);
-		}
-	}
-        while(1 == lowerBuffer.hasMore && 0 == upperBuffer.hasMore) {
-            /* Copy lower */
-            index->contigs_8[i] = lowerBuffer.curContig;
-            index->positions[i] = lowerBuffer.curPosition;
-            /* Get next */
-            RGIndexMergeHelperFromDiskGetNext_8(&lowerBuffer);
-            i++;
-            ctr++;
-	}
-        while(0 == lowerBuffer.hasMore && 1 == upperBuffer.hasMore) {
-            /* Copy upper */
-            index->contigs_8[i] = upperBuffer.curContig;
-            index->positions[i] = upperBuffer.curPosition;
-            /* Get next */
-            RGIndexMergeHelperFromDiskGetNext_8(&upperBuffer);
-            i++;
-            ctr++;
-	}
-	assert(ctr == (high - low + 1));
-	assert(i == high + 1);
-
-        /* Free memory */
-        free(lowerBuffer.contigs);
-        free(lowerBuffer.positions);
-        free(upperBuffer.contigs);
-        free(upperBuffer.positions);
-
-	/* Close tmp files */
-	CloseTmpFile(&lowerBuffer.fpContigs, &lowerBuffer.fnContigs);
-	CloseTmpFile(&lowerBuffer.fpPositions, &lowerBuffer.fnPositions);
-	CloseTmpFile(&upperBuffer.fpContigs, &upperBuffer.fnContigs);
-	CloseTmpFile(&upperBuffer.fpPositions, &upperBuffer.fnPositions);
-        //HERE
-        /* Test merge */
-        /*
-        for(i=low+1;i<=high;i++) {
-            assert(RGIndexCompareAt(index, rg, i-1, i, 0) <= 0);
-        }
-        */
-}
-
-typedef struct {
-    FILE *fpContigs;
-    char *fnContigs;
-    FILE *fpPositions;
-    char *fnPositions;
-    uint32_t curContig;
-    uint32_t curPosition;
-    uint32_t *contigs;
-    uint32_t *positions;
-    uint32_t index;
-    uint32_t length; // # of entries in memory
-    uint32_t numLeft; // # of entries left to process
-    int32_t eof;
-    int32_t hasMore;
-} RGIndexMergeHelper_32_t;
-
-static void RGIndexMergeHelperFromDiskGetNext_32(RGIndexMergeHelper_32_t *buffer)
-{
-  char *FnName = "RGIndexMergeHelperFromDiskGetNext_32"; 
-  if(buffer->index < buffer->length) {
-      buffer->curContig = buffer->contigs[buffer->index];
-      buffer->curPosition = buffer->positions[buffer->index];
-      buffer->index++;
-      buffer->hasMore = 1;
-  }
-  else if(1 == buffer->eof) {
-      // do nothing
-      buffer->curContig = 0;
-      buffer->curPosition = 0;
-      buffer->hasMore = 0;
-  }
-  else {
-      buffer->numLeft -= buffer->length;
-      buffer->length = (buffer->numLeft < buffer->length) ? buffer->numLeft : buffer->length;
-      if(0 == buffer->length) {
-          buffer->curContig = 0;
-          buffer->curPosition = 0;
-          buffer->hasMore = 0;
-      }
-      else {
-          if(buffer->length != RGIndexMergeHelperFromDiskContigRead(buffer->contigs, buffer->positions, sizeof(uint32_t), sizeof(uint32_t), buffer->fpContigs, buffer->fpPositions, buffer->length)) {
-              PrintError(FnName, NULL, "Could not read in buffer", Exit, ReadFileError);
-          }
-          buffer->curContig = buffer->contigs[0];
-          buffer->curPosition = buffer->positions[0];
-          buffer->index = 1;
-          buffer->hasMore = 1;
-      }
-  }
-}
- 
+			data[i].outContigs = contigs;
+			data[i].outPositions = (uint32_t*)index->positions;
+			data[i].outOffset = low + offset;
+		}
+		data[i].threadID = i;
+	}
+
+	/* Merge */
+	RGIndexRunThreads(RGIndexMergeRunsThread,
+			data,
+			sizeof(ThreadRGIndexMergeRunsData),
+			numThreads,
+			numThreads);
+
+	if(0 == fromDisk) {
+		/* Copy back */
+		memcpy((char*)contigs + low*contigSize, tmpContigs, contigSize*length);
+		memcpy(index->positions + low, tmpPositions, sizeof(uint32_t)*length);
+		free(tmpContigs);
+		free(tmpPositions);
+	}
+	else {
+		/* Close tmp files */
+		CloseTmpFile(&fpContigs, &fnContigs);
+		CloseTmpFile(&fpPositions, &fnPositions);
+	}
+
+	free(data);
+	free(cuts);
+}
+
+/* TODO */
+/* Cuts each run for each thread.  The cuts for thread t are at the 
+ * t/numThreads quantile of the longest run: the earlier runs are cut
+ * after any equal keys and the later runs before them. */
+void RGIndexMergeRunsGetCuts(RGIndex *index,
+		RGBinary *rg,
+		int64_t *starts,
+		int64_t *ends,
+		int32_t numRuns,
+		int32_t numThreads,
+		int64_t *cuts)
+{
+	int32_t i, j, longest=0;
+	int64_t splitter;
+
+	for(j=0;j<numRuns;j++) {
+		cuts[j] = starts[j];
+		cuts[numThreads*numRuns + j] = ends[j] + 1;
+		if(ends[longest] - starts[longest] < ends[j] - starts[j]) {
+			longest = j;
+		}
+	}
+	for(i=1;i<numThreads;i++) {
+		splitter = starts[longest] + ((ends[longest] - starts[longest] + 1)*i)/numThreads;
+		for(j=0;j<numRuns;j++) {
+			if(j == longest) {
+				cuts[i*numRuns + j] = splitter;
+			}
+			else {
+				cuts[i*numRuns + j] = RGIndexMergeRunsSearch(index,
+						rg,
+						starts[j],
+						ends[j],
+						splitter,
+						(j < longest) ? 1 : 0);
+			}
+		}
+	}
+}
+
 /* TODO */
-void RGIndexMergeHelperFromDiskContig_32(RGIndex *index,
+/* Returns the first entry in [low, high] that is greater than (upper) 
+ * or not less than (lower) the splitter, or high+1 if there is none. */
+int64_t RGIndexMergeRunsSearch(RGIndex *index,
 		RGBinary *rg,
 		int64_t low,
-		int64_t mid,
 		int64_t high,
-		char *tmpDir)
+		int64_t splitter,
+		int32_t upper)
 {
-	char *FnName = "RGIndexMergeHelperFromDiskContig_32";
-	int64_t i=0;
-	int64_t ctr=0;
-        RGIndexMergeHelper_32_t lowerBuffer;
-        RGIndexMergeHelper_32_t upperBuffer;
-
+	int64_t mid;
+	int32_t cmp;
 
-	assert(index->contigType == Contig_32);
-	assert(index->contigs_32 != NULL);
+	high++;
+	while(low < high) {
+		mid = low + (high - low)/2;
+		cmp = RGIndexCompareAt(index, rg, mid, splitter, 0);
+		if(cmp < 0 || (1 == upper && 0 == cmp)) {
+			low = mid + 1;
+		}
+		else {
+			high = mid;
+		}
+	}
+	return low;
+}
 
-	/* Merge the two lists */
-	/* Since we want to keep space requirement small, use an upper bound on memory,
-	 * so that we use tmp files when memory requirements become to large */
-	/* Use tmp files */
-
-        /* Init lower */
-	lowerBuffer.fpContigs = OpenTmpFile(tmpDir, &lowerBuffer.fnContigs);
-	lowerBuffer.fpPositions = OpenTmpFile(tmpDir, &lowerBuffer.fnPositions);
-        lowerBuffer.length = RGINDEX_MERGE_BUFFER_LENGTH;
-        lowerBuffer.contigs = malloc(sizeof(uint32_t)*lowerBuffer.length);
-        if(NULL == lowerBuffer.contigs) {
-            PrintError(FnName, "lowerBuffer.contigs", "Could not allocate memory", Exit, MallocMemory);
-        }
-        lowerBuffer.positions = malloc(sizeof(uint32_t)*lowerBuffer.length);
-        if(NULL == lowerBuffer.positions) {
-            PrintError(FnName, "lowerBuffer.positions", "Could not allocate memory", Exit, MallocMemory);
-        }
-        lowerBuffer.index = RGINDEX_MERGE_BUFFER_LENGTH;
-        lowerBuffer.numLeft = mid - low + 1 + RGINDEX_MERGE_BUFFER_LENGTH; // NB: RGINDEX_MERGE_BUFFER_LENGTH will be subtracted on the first call to read in
-        lowerBuffer.eof = 0;
-	
-        /* Init upper */
-	upperBuffer.fpContigs = OpenTmpFile(tmpDir, &upperBuffer.fnContigs);
-	upperBuffer.fpPositions = OpenTmpFile(tmpDir, &upperBuffer.fnPositions);
-        upperBuffer.length = RGINDEX_MERGE_BUFFER_LENGTH;
-        upperBuffer.contigs = malloc(sizeof(uint32_t)*upperBuffer.length);
-        if(NULL == upperBuffer.contigs) {
-            PrintError(FnName, "upperBuffer.contigs", "Could not allocate memory", Exit, MallocMemory);
-        }
-        upperBuffer.positions = malloc(sizeof(uint32_t)*upperBuffer.length);
-        if(NULL == upperBuffer.positions) {
-            PrintError(FnName, "upperBuffer.positions", "Could not allocate memory", Exit, MallocMemory);
-        }
-        upperBuffer.index = RGINDEX_MERGE_BUFFER_LENGTH;
-        upperBuffer.numLeft = high - mid + RGINDEX_MERGE_BUFFER_LENGTH; // NB: RGINDEX_MERGE_BUFFER_LENGTH will be subtracted on the first call to read in
-        upperBuffer.eof = 0;
-
-	/* Print to tmp files */
-        if((mid - low + 1) != fwrite(index->contigs_32 + low, sizeof(uint32_t), (mid - low + 1), lowerBuffer.fpContigs)) {
-            PrintError(FnName, "index->contigs_32", "Could not write contigs_32 to tmp lower file", Exit, WriteFileError);
-        }
-        if((mid - low + 1) != fwrite(index->positions + low, sizeof(uint32_t), (mid - low + 1), lowerBuffer.fpPositions)) {
-            PrintError(FnName, "index->positions", "Could not write positions to tmp lower file", Exit, WriteFileError);
-	}
-        if((high - mid) != fwrite(index->contigs_32 + mid + 1, sizeof(uint32_t), (high - mid), upperBuffer.fpContigs)) {
-            PrintError(FnName, "index->contigs_32", "Could not write contigs_32 to tmp upper file", Exit, WriteFileError);
-        }
-        if((high - mid) != fwrite(index->positions + mid + 1, sizeof(uint32_t), (high - mid), upperBuffer.fpPositions)) {
-            PrintError(FnName, "index->positions", "Could not write positions to tmp upper file", Exit, WriteFileError);
-        }
-
-	/* Move to beginning of the files */
-	fseek(lowerBuffer.fpContigs, 0 , SEEK_SET);
-	fseek(lowerBuffer.fpPositions, 0 , SEEK_SET);
-	fseek(upperBuffer.fpContigs, 0 , SEEK_SET);
-	fseek(upperBuffer.fpPositions, 0 , SEEK_SET);
-
-	/* Merge tmp files back into index */
-	/* Get first contig/pos */
-        RGIndexMergeHelperFromDiskGetNext_32(&lowerBuffer);
-        RGIndexMergeHelperFromDiskGetNext_32(&upperBuffer);
+/* TODO */
+void *RGIndexMergeRunsThread(void *arg)
+{
+	char *FnName="RGIndexMergeRunsThread";
+	ThreadRGIndexMergeRunsData *data = (ThreadRGIndexMergeRunsData*)arg;
+	size_t contigSize = (Contig_8 == data->index->contigType) ? sizeof(uint8_t) : sizeof(uint32_t);
+	void *contigs = (Contig_8 == data->index->contigType) ? (void*)data->index->contigs_8 : (void*)data->index->contigs_32;
+	RGIndexMergeRun *r=NULL;
+	int32_t *heap=NULL;
+	int32_t numHeap=0;
+	int32_t i, j, errCode;
+	int64_t out;
+	pthread_t reader;
+	void *status=NULL;
 
-	for(i=low, ctr=0;
-			i<=high &&
-                        1 == lowerBuffer.hasMore &&
-                        1 == upperBuffer.hasMore;
-			i++, ctr++) {
-		if(RGIndexCompareContigPos(index,
-					rg,
-                                        lowerBuffer.curContig,
-                                        lowerBuffer.curPosition,
-                                        upperBuffer.curContig,
-                                        upperBuffer.curPosition,
-					0)<=0) {
-			/* Copy lower */
-			index->contigs_32[i] = lowerBuffer.curContig;
-			index->positions[i] = lowerBuffer.curPosition;
-                        /* Get next */
-                        RGIndexMergeHelperFromDiskGetNext_32(&lowerBuffer);
+	data->runs = malloc(sizeof(RGIndexMergeRun)*data->numRuns);
+	if(NULL == data->runs) {
+		PrintError(FnName, "data->runs", "Could not allocate memory", Exit, MallocMemory);
+	}
+	heap = malloc(sizeof(int32_t)*data->numRuns);
+	if(NULL == heap) {
+		PrintError(FnName, "heap", "Could not allocate memory", Exit, MallocMemory);
+	}
+
+	/* Initialize the runs */
+	for(j=0;j<data->numRuns;j++) {
+		r = &data->runs[j];
+		r->next = data->begins[j];
+		r->end = data->ends[j];
+		r->cur = 0;
+		r->pos = 0;
+		if(0 == data->fromDisk) {
+			/* Read straight from the index */
+			r->contigs[0] = (char*)contigs + r->next*contigSize;
+			r->positions[0] = (uint32_t*)data->index->positions + r->next;
+			r->length[0] = r->end - r->next;
+			r->next = r->end;
 		}
 		else {
-			index->contigs_32[i] = upperBuffer.curContig;
-			index->positions[i] = upperBuffer.curPosition;
-                        /* Get next */
-                        RGIndexMergeHelperFromDiskGetNext_32(&upperBuffer);
-		}
-	}
-        while(1 == lowerBuffer.hasMore && 0 == upperBuffer.hasMore) {
-            /* Copy lower */
-            index->contigs_32[i] = lowerBuffer.curContig;
-            index->positions[i] = lowerBuffer.curPosition;
-            /* Get next */
-            RGIndexMergeHelperFromDiskGetNext_32(&lowerBuffer);
-            i++;
-            ctr++;
-	}
-        while(0 == lowerBuffer.hasMore && 1 == upperBuffer.hasMore) {
-            /* Copy upper */
-            index->contigs_32[i] = upperBuffer.curContig;
-            index->positions[i] = upperBuffer.curPosition;
-            /* Get next */
-            RGIndexMergeHelperFromDiskGetNext_32(&upperBuffer);
-            i++;
-            ctr++;
-	}
-	assert(ctr == (high - low + 1));
-	assert(i == high + 1);
-
-        /* Free memory */
-        free(lowerBuffer.contigs);
-        free(lowerBuffer.positions);
-        free(upperBuffer.contigs);
-        free(upperBuffer.positions);
-
-	/* Close tmp files */
-	CloseTmpFile(&lowerBuffer.fpContigs, &lowerBuffer.fnContigs);
-	CloseTmpFile(&lowerBuffer.fpPositions, &lowerBuffer.fnPositions);
-	CloseTmpFile(&upperBuffer.fpContigs, &upperBuffer.fnContigs);
-	CloseTmpFile(&upperBuffer.fpPositions, &upperBuffer.fnPositions);
-	/* Test merge */
-	/*
-	   for(i=low+1;i<=high;i++) {
-	   assert(RGIndexCompareAt(index, rg, i-1, i, 0) <= 0);
-	   }
-	   */
+			/* Both buffers are empty, the current one having been used */
+			for(i=0;i<2;i++) {
+				if(0 != posix_memalign(&r->contigs[i], RGINDEX_MERGE_ALIGNMENT, contigSize*data->bufferLength) ||
+						0 != posix_memalign((void**)&r->positions[i], RGINDEX_MERGE_ALIGNMENT, sizeof(uint32_t)*data->bufferLength)) {
+					PrintError(FnName, "r->contigs[i] and r->positions[i]", "Could not allocate memory", Exit, MallocMemory);
+				}
+				r->length[i] = 0;
+				r->state[i] = MergeBufferEmpty;
+			}
+			r->state[r->cur] = MergeBufferReady;
+		}
+	}
+
+	/* Start reading ahead */
+	if(1 == data->fromDisk) {
+		data->done = 0;
+		pthread_mutex_init(&data->lock, NULL);
+		pthread_cond_init(&data->changed, NULL);
+		errCode = pthread_create(&reader,
+				NULL,
+				RGIndexMergeRunsReader,
+				(void*)data);
+		if(0!=errCode) {
+			PrintError(FnName, "pthread_create: errCode", "Could not start thread", Exit, ThreadError);
+		}
+	}
+
+	/* Build the heap */
+	for(j=0;j<data->numRuns;j++) {
+		if(1 == RGIndexMergeRunsAdvance(data, &data->runs[j])) {
+			heap[numHeap] = j;
+			numHeap++;
+			RGIndexMergeRunsSiftUp(data, heap, numHeap-1);
+		}
+	}
+
+	/* Merge */
+	out = data->outOffset;
+	while(0 < numHeap) {
+		r = &data->runs[heap[0]];
+		RGIndexMergeRunsSetContig(data->outContigs, 
+				contigSize, 
+				out, 
+				RGIndexMergeRunsGetContig(r->contigs[r->cur], contigSize, r->pos));
+		data->outPositions[out] = r->positions[r->cur][r->pos];
+		out++;
+		r->pos++;
+		if(0 == RGIndexMergeRunsAdvance(data, r)) {
+			numHeap--;
+			heap[0] = heap[numHeap];
+		}
+		RGIndexMergeRunsSiftDown(data, heap, numHeap, 0);
+	}
+
+	/* Stop reading ahead */
+	if(1 == data->fromDisk) {
+		pthread_mutex_lock(&data->lock);
+		data->done = 1;
+		pthread_cond_broadcast(&data->changed);
+		pthread_mutex_unlock(&data->lock);
+		errCode = pthread_join(reader, &status);
+		if(0!=errCode) {
+			PrintError(FnName, "pthread_join: errCode", "Thread returned an error", Exit, ThreadError);
+		}
+		pthread_mutex_destroy(&data->lock);
+		pthread_cond_destroy(&data->changed);
+		for(j=0;j<data->numRuns;j++) {
+			for(i=0;i<2;i++) {
+				free(data->runs[j].contigs[i]);
+				free(data->runs[j].positions[i]);
+			}
+		}
+	}
+
+	free(heap);
+	free(data->runs);
+	data->runs=NULL;
+
+	return arg;
+}
+
+/* TODO */
+/* Makes sure the run has a current entry, switching to its other 
+ * buffer if needed.  Returns 0 when the run has no more entries. */
+int32_t RGIndexMergeRunsAdvance(ThreadRGIndexMergeRunsData *data, RGIndexMergeRun *r)
+{
+	int32_t hasMore=0;
+
+	if(r->pos < r->length[r->cur]) {
+		return 1;
+	}
+	else if(0 == data->fromDisk) {
+		return 0;
+	}
+
+	pthread_mutex_lock(&data->lock);
+	while(MergeBufferReady != r->state[1 - r->cur] &&
+			(r->next < r->end || MergeBufferFilling == r->state[1 - r->cur])) {
+		pthread_cond_wait(&data->changed, &data->lock);
+	}
+	if(MergeBufferReady == r->state[1 - r->cur]) {
+		/* Switch buffers and let the reader refill the used one */
+		r->state[r->cur] = MergeBufferEmpty;
+		r->cur = 1 - r->cur;
+		r->pos = 0;
+		pthread_cond_broadcast(&data->changed);
+		hasMore = 1;
+	}
+	pthread_mutex_unlock(&data->lock);
+
+	return hasMore;
+}
+
+/* TODO */
+/* Fills the empty buffers of the runs being merged from disk */
+void *RGIndexMergeRunsReader(void *arg)
+{
+	ThreadRGIndexMergeRunsData *data = (ThreadRGIndexMergeRunsData*)arg;
+	size_t contigSize = (Contig_8 == data->index->contigType) ? sizeof(uint8_t) : sizeof(uint32_t);
+	RGIndexMergeRun *r=NULL;
+	int32_t j, b;
+	int64_t start, length;
+
+	pthread_mutex_lock(&data->lock);
+	while(1) {
+		/* Find a run with an empty buffer */
+		for(j=0, r=NULL;NULL == r && j<data->numRuns;j++) {
+			if(data->runs[j].next < data->runs[j].end &&
+					MergeBufferEmpty == data->runs[j].state[1 - data->runs[j].cur]) {
+				r = &data->runs[j];
+			}
+		}
+		if(NULL == r) {
+			if(1 == data->done) {
+				break;
+			}
+			pthread_cond_wait(&data->changed, &data->lock);
+			continue;
+		}
+
+		b = 1 - r->cur;
+		r->state[b] = MergeBufferFilling;
+		start = r->next;
+		length = (r->end - r->next < data->bufferLength) ? (r->end - r->next) : data->bufferLength;
+		r->next += length;
+		pthread_mutex_unlock(&data->lock);
+
+		RGIndexMergeRunsRead(data->fdContigs, r->contigs[b], contigSize*length, (start - data->fileLow)*contigSize);
+		RGIndexMergeRunsRead(data->fdPositions, r->positions[b], sizeof(uint32_t)*length, (start - data->fileLow)*sizeof(uint32_t));
+
+		pthread_mutex_lock(&data->lock);
+		r->length[b] = length;
+		r->state[b] = MergeBufferReady;
+		pthread_cond_broadcast(&data->changed);
+	}
+	pthread_mutex_unlock(&data->lock);
+
+	return arg;
+}
+
+/* TODO */
+void RGIndexMergeRunsRead(int fd, void *buffer, int64_t size, int64_t offset)
+{
+	char *FnName="RGIndexMergeRunsRead";
+	ssize_t numRead;
+
+	while(0 < size) {
+		numRead = pread(fd, buffer, size, offset);
+		if(numRead <= 0) {
+			PrintError(FnName, NULL, "Could not read in buffer", Exit, ReadFileError);
+		}
+		buffer = (char*)buffer + numRead;
+		size -= numRead;
+		offset += numRead;
+	}
+}
+
+/* TODO */
+/* Orders the runs by their current entry, then by run */
+int32_t RGIndexMergeRunsCompare(ThreadRGIndexMergeRunsData *data, int32_t a, int32_t b)
+{
+	size_t contigSize = (Contig_8 == data->index->contigType) ? sizeof(uint8_t) : sizeof(uint32_t);
+	RGIndexMergeRun *x = &data->runs[a];
+	RGIndexMergeRun *y = &data->runs[b];
+	int32_t cmp;
+
+	cmp = RGIndexCompareContigPos(data->index,
+			data->rg,
+			RGIndexMergeRunsGetContig(x->contigs[x->cur], contigSize, x->pos),
+			x->positions[x->cur][x->pos],
+			RGIndexMergeRunsGetContig(y->contigs[y->cur], contigSize, y->pos),
+			y->positions[y->cur][y->pos],
+			0);
+	if(0 != cmp) {
+		return cmp;
+	}
+	return (a < b) ? -1 : 1;
+}
+
+/* TODO */
+void RGIndexMergeRunsSiftUp(ThreadRGIndexMergeRunsData *data, int32_t *heap, int32_t i)
+{
+	int32_t parent, tmp;
+
+	while(0 < i) {
+		parent = (i - 1)/2;
+		if(RGIndexMergeRunsCompare(data, heap[parent], heap[i]) <= 0) {
+			break;
+		}
+		tmp = heap[parent]; heap[parent] = heap[i]; heap[i] = tmp;
+		i = parent;
+	}
+}
+
+/* TODO */
+void RGIndexMergeRunsSiftDown(ThreadRGIndexMergeRunsData *data, int32_t *heap, int32_t numHeap, int32_t i)
+{
+	int32_t child, tmp;
+
+	while(2*i + 1 < numHeap) {
+		child = 2*i + 1;
+		if(child + 1 < numHeap && 
+				RGIndexMergeRunsCompare(data, heap[child+1], heap[child]) < 0) {
+			child++;
+		}
+		if(RGIndexMergeRunsCompare(data, heap[i], heap[child]) <= 0) {
+			break;
+		}
+		tmp = heap[child]; heap[child] = heap[i]; heap[i] = tmp;
+		i = child;
+	}
 }
 
 /* TODO */
 void RGIndexDelete(RGIndex *index)
 {
+	/* Unmap the arrays */
+	if(NULL != index->map) {
+		index->contigs_8 = NULL;
+		index->contigs_32 = NULL;
+		index->positions = NULL;
+		index->starts = NULL;
+		munmap(index->map, index->mapLength);
+	}
+
 	/* Free memory and initialize */
 	if(index->contigType == Contig_8) {
 		free(index->contigs_8);
@@ -1871,6 +2616,162 @@ void RGIndexRead(RGIndex *index, char *rgIndexFileName)
 	}
 }
 
+/* TODO */
+/* Writes to the data at offset in the map, or only moves the offset if
+ * there is no map */
+static void RGIndexMapWrite(char *map,
+		int64_t *offset,
+		void *src,
+		int64_t length)
+{
+	if(NULL != map) {
+		memcpy(map + (*offset), src, length);
+	}
+	(*offset) += length;
+}
+
+/* TODO */
+/* Reads from the data at offset in the map */
+static int32_t RGIndexMapRead(RGIndex *index,
+		int64_t *offset,
+		void *dest,
+		int64_t length)
+{
+	if(index->mapLength < (*offset) + length) {
+		return 0;
+	}
+	memcpy(dest, index->map + (*offset), length);
+	(*offset) += length;
+	return 1;
+}
+
+/* TODO */
+/* Writes the uncompressed image of the index to map, which must be zeroed,
+ * and returns its length.  The header is followed by the positions, the
+ * contigs and the starts, each starting on a BFAST_RG_MMAP_ALIGNMENT
+ * boundary.  With no map, only the length is returned, so only the header
+ * of the index is needed. */
+int64_t RGIndexWriteMap(RGIndex *index,
+		char *map)
+{
+	int64_t offset=0;
+	int64_t positionsOffset=0, contigsOffset=0, startsOffset=0;
+	int64_t contigsLength = (index->contigType==Contig_8)?(sizeof(uint8_t)*index->length):(sizeof(uint32_t)*index->length);
+
+	/* The arrays start after the header */
+	positionsOffset = 15*sizeof(int32_t) + 2*sizeof(int64_t) + index->packageVersionLength*sizeof(char) + 
+		index->width*sizeof(int32_t) + 3*sizeof(int64_t);
+	positionsOffset = ((positionsOffset + BFAST_RG_MMAP_ALIGNMENT - 1) / BFAST_RG_MMAP_ALIGNMENT) * BFAST_RG_MMAP_ALIGNMENT;
+	contigsOffset = positionsOffset + sizeof(uint32_t)*index->length;
+	contigsOffset = ((contigsOffset + BFAST_RG_MMAP_ALIGNMENT - 1) / BFAST_RG_MMAP_ALIGNMENT) * BFAST_RG_MMAP_ALIGNMENT;
+	startsOffset = contigsOffset + contigsLength;
+	startsOffset = ((startsOffset + BFAST_RG_MMAP_ALIGNMENT - 1) / BFAST_RG_MMAP_ALIGNMENT) * BFAST_RG_MMAP_ALIGNMENT;
+
+	/* Header, in the same order as the index file */
+	RGIndexMapWrite(map, &offset, &index->id, sizeof(int32_t));
+	RGIndexMapWrite(map, &offset, &index->packageVersionLength, sizeof(int32_t));
+	RGIndexMapWrite(map, &offset, index->packageVersion, sizeof(char)*index->packageVersionLength);
+	RGIndexMapWrite(map, &offset, &index->length, sizeof(int64_t));
+	RGIndexMapWrite(map, &offset, &index->contigType, sizeof(int32_t));
+	RGIndexMapWrite(map, &offset, &index->startContig, sizeof(int32_t));
+	RGIndexMapWrite(map, &offset, &index->startPos, sizeof(int32_t));
+	RGIndexMapWrite(map, &offset, &index->endContig, sizeof(int32_t));
+	RGIndexMapWrite(map, &offset, &index->endPos, sizeof(int32_t));
+	RGIndexMapWrite(map, &offset, &index->width, sizeof(int32_t));
+	RGIndexMapWrite(map, &offset, &index->keysize, sizeof(int32_t));
+	RGIndexMapWrite(map, &offset, &index->repeatMasker, sizeof(int32_t));
+	RGIndexMapWrite(map, &offset, &index->space, sizeof(int32_t));
+	RGIndexMapWrite(map, &offset, &index->depth, sizeof(int32_t));
+	RGIndexMapWrite(map, &offset, &index->binNumber, sizeof(int32_t));
+	RGIndexMapWrite(map, &offset, &index->indexNumber, sizeof(int32_t));
+	RGIndexMapWrite(map, &offset, &index->hashWidth, sizeof(uint32_t));
+	RGIndexMapWrite(map, &offset, &index->hashLength, sizeof(int64_t));
+	RGIndexMapWrite(map, &offset, index->mask, sizeof(int32_t)*index->width);
+	RGIndexMapWrite(map, &offset, &positionsOffset, sizeof(int64_t));
+	RGIndexMapWrite(map, &offset, &contigsOffset, sizeof(int64_t));
+	RGIndexMapWrite(map, &offset, &startsOffset, sizeof(int64_t));
+	assert(offset <= positionsOffset);
+
+	/* The arrays, the padding is already zero */
+	offset = positionsOffset;
+	RGIndexMapWrite(map, &offset, index->positions, sizeof(uint32_t)*index->length);
+	offset = contigsOffset;
+	RGIndexMapWrite(map, &offset, (index->contigType==Contig_8)?((void*)index->contigs_8):((void*)index->contigs_32), contigsLength);
+	offset = startsOffset;
+	RGIndexMapWrite(map, &offset, index->starts, sizeof(uint32_t)*index->hashLength);
+
+	return offset;
+}
+
+/* TODO */
+/* Reads the index from the uncompressed image in index->map, as written by
+ * RGIndexWriteMap.  The positions, contigs and starts point into the map. */
+void RGIndexReadMap(RGIndex *index)
+{
+	char *FnName="RGIndexReadMap";
+	int64_t offset=0;
+	int64_t positionsOffset=0, contigsOffset=0, startsOffset=0;
+
+	if(0 == RGIndexMapRead(index, &offset, &index->id, sizeof(int32_t)) ||
+			0 == RGIndexMapRead(index, &offset, &index->packageVersionLength, sizeof(int32_t))) {
+		PrintError(FnName, NULL, "Could not read header", Exit, ReadFileError);
+	}
+	if(BFAST_ID != index->id) {
+		PrintError(FnName, "index->id", "The id did not match", Exit, OutOfRange);
+	}
+	index->packageVersion = malloc(sizeof(char)*(index->packageVersionLength+1));
+	if(NULL==index->packageVersion) {
+		PrintError(FnName, "index->packageVersion", "Could not allocate memory", Exit, MallocMemory);
+	}
+	if(0 == RGIndexMapRead(index, &offset, index->packageVersion, sizeof(char)*index->packageVersionLength) ||
+			0 == RGIndexMapRead(index, &offset, &index->length, sizeof(int64_t)) ||
+			0 == RGIndexMapRead(index, &offset, &index->contigType, sizeof(int32_t)) ||
+			0 == RGIndexMapRead(index, &offset, &index->startContig, sizeof(int32_t)) ||
+			0 == RGIndexMapRead(index, &offset, &index->startPos, sizeof(int32_t)) ||
+			0 == RGIndexMapRead(index, &offset, &index->endContig, sizeof(int32_t)) ||
+			0 == RGIndexMapRead(index, &offset, &index->endPos, sizeof(int32_t)) ||
+			0 == RGIndexMapRead(index, &offset, &index->width, sizeof(int32_t)) ||
+			0 == RGIndexMapRead(index, &offset, &index->keysize, sizeof(int32_t)) ||
+			0 == RGIndexMapRead(index, &offset, &index->repeatMasker, sizeof(int32_t)) ||
+			0 == RGIndexMapRead(index, &offset, &index->space, sizeof(int32_t)) ||
+			0 == RGIndexMapRead(index, &offset, &index->depth, sizeof(int32_t)) ||
+			0 == RGIndexMapRead(index, &offset, &index->binNumber, sizeof(int32_t)) ||
+			0 == RGIndexMapRead(index, &offset, &index->indexNumber, sizeof(int32_t)) ||
+			0 == RGIndexMapRead(index, &offset, &index->hashWidth, sizeof(uint32_t)) ||
+			0 == RGIndexMapRead(index, &offset, &index->hashLength, sizeof(int64_t))) {
+		PrintError(FnName, NULL, "Could not read header", Exit, ReadFileError);
+	}
+	index->packageVersion[index->packageVersionLength]='\0';
+	CheckPackageCompatibility(index->packageVersion, BFASTIndexFile);
+	assert(0 < index->width);
+	index->mask = malloc(sizeof(int32_t)*index->width);
+	if(NULL==index->mask) {
+		PrintError(FnName, "index->mask", "Could not allocate memory", Exit, MallocMemory);
+	}
+	if(0 == RGIndexMapRead(index, &offset, index->mask, sizeof(int32_t)*index->width) ||
+			0 == RGIndexMapRead(index, &offset, &positionsOffset, sizeof(int64_t)) ||
+			0 == RGIndexMapRead(index, &offset, &contigsOffset, sizeof(int64_t)) ||
+			0 == RGIndexMapRead(index, &offset, &startsOffset, sizeof(int64_t))) {
+		PrintError(FnName, NULL, "Could not read header", Exit, ReadFileError);
+	}
+	assert(index->contigType == Contig_8 || index->contigType == Contig_32);
+
+	/* Point into the map */
+	if(index->mapLength < positionsOffset + (int64_t)sizeof(uint32_t)*index->length ||
+			index->mapLength < contigsOffset + (int64_t)((index->contigType==Contig_8)?sizeof(uint8_t):sizeof(uint32_t))*index->length ||
+			index->mapLength < startsOffset + (int64_t)sizeof(uint32_t)*index->hashLength) {
+		PrintError(FnName, NULL, "The index is truncated", Exit, ReadFileError);
+	}
+	index->positions = (int32_t*)(index->map + positionsOffset);
+	if(index->contigType == Contig_8) {
+		index->contigs_8 = (uint8_t*)(index->map + contigsOffset);
+	}
+	else {
+		index->contigs_32 = (uint32_t*)(index->map + contigsOffset);
+	}
+	index->starts = (uint32_t*)(index->map + startsOffset);
+}
+
 /* TODO */
 /* Debugging function */
 void RGIndexPrintInfo(char *inputFileName)
@@ -1970,6 +2871,9 @@ void RGIndexGetHeader(char *inputFileName, RGIndex *index)
 void RGIndexReadHeader(gzFile fp, RGIndex *index) 
 {
 	char *FnName = "RGIndexReadHeader";
+	/* The arrays will not be mapped */
+	index->map = NULL;
+	index->mapLength = 0;
 	/* Read in header */
 	if(gzread64(fp, &index->id, sizeof(int32_t))!=sizeof(int32_t) ||
 			gzread64(fp, &index->packageVersionLength, sizeof(int32_t))!=sizeof(int32_t)) {
@@ -2736,6 +3640,9 @@ void RGIndexInitialize(RGIndex *index)
 	index->hashWidth = 0;
 	index->hashLength = 0;
 	index->starts = NULL;
+
+	index->map = NULL;
+	index->mapLength = 0;
 }
 
 void RGIndexInitializeFull(RGIndex *index,
@@ -2826,3 +3733,49 @@ gzFile RGIndexOpenForWriting(char *fastaFileName, RGIndex *index)
 
 	return gz;
 }
+
+/* TODO */
+/* Opens a tmp file next to the index being updated, so the existing 
+ * index can be read while the updated index is written. */
+gzFile RGIndexOpenForUpdating(char *fastaFileName, RGIndex *index) 
+{
+	char *FnName="RGIndexOpenForUpdating";
+	gzFile gz;
+	char *bifName=NULL;
+	char tmpName[MAX_FILENAME_LENGTH]="\0";
+	int fd;
+
+	bifName=GetBIFName(fastaFileName, index->space, index->binNumber, index->indexNumber);
+	sprintf(tmpName, "%s%s", bifName, RGINDEX_UPDATE_SUFFIX);
+	if((fd = open(tmpName, 
+					O_WRONLY | O_CREAT | O_EXCL, 
+					S_IRUSR | S_IRGRP | S_IROTH | S_IWUSR | S_IWGRP)) < 0) {
+		/* File exists */
+		PrintError(FnName, tmpName, "Could not open tmpName for writing", Exit, OpenFileError);
+	}
+
+	if(!(gz=gzdopen(fd, "wb"))) {
+		PrintError(FnName, tmpName, "Could not open tmpName for writing", Exit, OpenFileError);
+	}
+
+	free(bifName);
+
+	return gz;
+}
+
+/* TODO */
+/* Replaces the existing index with the updated index */
+void RGIndexFinishUpdating(char *fastaFileName, RGIndex *index) 
+{
+	char *FnName="RGIndexFinishUpdating";
+	char *bifName=NULL;
+	char tmpName[MAX_FILENAME_LENGTH]="\0";
+
+	bifName=GetBIFName(fastaFileName, index->space, index->binNumber, index->indexNumber);
+	sprintf(tmpName, "%s%s", bifName, RGINDEX_UPDATE_SUFFIX);
+	if(0 != rename(tmpName, bifName)) {
+		PrintError(FnName, bifName, "Could not replace the index", Exit, WriteFileError);
+	}
+
+	free(bifName);
+}
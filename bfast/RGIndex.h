@@ -3,30 +3,145 @@
 
 #include <stdio.h>
 #include <zlib.h>
+#include <pthread.h>
 #include "RGBinary.h"
 #include "RGRanges.h"
 #include "BLibDefinitions.h"
 
-void RGIndexCreate(char*, RGIndexLayout*, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, RGIndexExons*, int32_t, int32_t, int32_t, char*);
-void RGIndexCreateSingle(char*, RGIndexLayout*, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, RGIndexExons*, int32_t, int32_t, int32_t, char*);
-void RGIndexCreateSplit(char*, RGIndexLayout*, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, RGIndexExons*, int32_t, int32_t, int32_t, char*);
-void RGIndexCreateHelper(RGIndex*, RGBinary*, FILE**, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t);
-void RGIndexCreateHash(RGIndex*, RGBinary*);
-void RGIndexSort(RGIndex*, RGBinary*, int32_t, char*);
+/* A bin of a split index, with its estimated memory use */
+typedef struct {
+	int32_t bin;
+	int64_t length;
+	int64_t memory;
+	int32_t started;
+} RGIndexBin;
+
+/* The bins waiting to be sorted, largest first */
+typedef struct {
+	RGIndexBin *bins;
+	int32_t numBins;
+	int32_t numStarted;
+	int64_t memoryLimit;
+	int64_t memoryUsed;
+	pthread_mutex_t lock;
+	pthread_cond_t released;
+} RGIndexBinQueue;
+
+typedef struct {
+	RGIndex *index;
+	RGBinary *rg;
+	FILE **tmpFPs;
+	Range *ranges;
+	int32_t numRanges;
+	int32_t repeatMasker;
+	int32_t includeNs;
+	int32_t showProgress;
+	int32_t threadID;
+} ThreadRGIndexScatterData;
+
+typedef struct {
+	RGIndexBinQueue *queue;
+	RGBinary *rg;
+	RGIndexLayout *layout;
+	int32_t space;
+	int32_t indexNumber;
+	int32_t startContig;
+	int32_t startPos;
+	int32_t endContig;
+	int32_t endPos;
+	int32_t repeatMasker;
+	char *fastaFileName;
+	int32_t update;
+	FILE **tmpFPs;
+	char **tmpFileNames;
+	int32_t numFiles;
+	int32_t numScatterThreads;
+	gzFile *gzOuts;
+	int32_t numPartitions;
+	int32_t numSortThreads;
+	int32_t showProgress;
+	char *tmpDir;
+	int32_t threadID;
+} ThreadRGIndexBinData;
+
+/* A sorted run being merged, read through two buffers */
+typedef struct {
+	int64_t next; /* the next entry to read */
+	int64_t end; /* one past the last entry */
+	void *contigs[2];
+	uint32_t *positions[2];
+	int64_t length[2];
+	int32_t state[2];
+	int32_t cur; /* the buffer being merged */
+	int64_t pos; /* the current entry in that buffer */
+} RGIndexMergeRun;
+
+typedef struct {
+	RGIndex *index;
+	RGBinary *rg;
+	RGIndexMergeRun *runs;
+	int32_t numRuns;
+	int64_t *begins;
+	int64_t *ends;
+	/* Tmp files, if merging from disk */
+	int32_t fromDisk;
+	int fdContigs;
+	int fdPositions;
+	int64_t fileLow;
+	int64_t bufferLength;
+	/* Output */
+	void *outContigs;
+	uint32_t *outPositions;
+	int64_t outOffset;
+	/* Read ahead */
+	pthread_mutex_t lock;
+	pthread_cond_t changed;
+	int32_t done;
+	int32_t threadID;
+} ThreadRGIndexMergeRunsData;
+
+void RGIndexCreate(char*, RGIndexLayout*, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, RGIndexExons*, int32_t, int32_t, int32_t, int32_t, int64_t, char*);
+void RGIndexCreateSingle(char*, RGIndexLayout*, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, RGIndexExons*, int32_t, int32_t, int32_t, int32_t, int64_t, char*);
+void RGIndexCreateSplit(char*, RGIndexLayout*, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, RGIndexExons*, int32_t, int32_t, int32_t, int32_t, int64_t, char*);
+void RGIndexGetSegments(RGBinary*, int32_t, int32_t, int32_t, int32_t, Range**, int32_t*);
+void RGIndexScatter(RGIndex*, RGBinary*, FILE**, int32_t, int32_t, Range*, int32_t, int32_t, int32_t);
+void *RGIndexScatterThread(void*);
+int RGIndexBinCompare(const void*, const void*);
+RGIndexBin *RGIndexBinQueueGet(RGIndexBinQueue*);
+void RGIndexBinQueueRelease(RGIndexBinQueue*, RGIndexBin*);
+void *RGIndexCreateBins(void*);
+void RGIndexReadBin(RGIndex*, FILE**, char**, int32_t, int32_t, int32_t, int64_t);
+void RGIndexGetUpdateRange(char*, RGBinary*, RGIndexLayout*, int32_t, int32_t, int32_t, int64_t*, int32_t*, int32_t*, int32_t*, int32_t*);
+void RGIndexAppend(RGIndex*, RGBinary*, char*, int32_t, int64_t, char*);
+void RGIndexCreateHelper(RGIndex*, RGBinary*, FILE**, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t);
+void RGIndexCreateHash(RGIndex*, RGBinary*, int32_t);
+void RGIndexSort(RGIndex*, RGBinary*, int32_t, int32_t, int64_t, int32_t, char*);
+int64_t RGIndexGetSortMemoryLimit(RGIndex*, int64_t);
+int32_t RGIndexGetNumPartitions(int32_t);
+void RGIndexRunThreads(void *(*)(void*), void*, size_t, int32_t, int32_t);
 void *RGIndexMergeSort(void*);
 void RGIndexMergeSortHelper(RGIndex*, RGBinary*, int64_t, int64_t, int32_t, double*, int64_t, int64_t, int64_t, char*);
 void RGIndexShellSort(RGIndex*, RGBinary*, int64_t, int64_t);
-void *RGIndexMerge(void*);
 void RGIndexMergeHelper(RGIndex*, RGBinary*, int64_t, int64_t, int64_t, int64_t, char*);
 void RGIndexMergeHelperInMemoryContig_8(RGIndex*, RGBinary*, int64_t, int64_t, int64_t);
 void RGIndexMergeHelperInMemoryContig_32(RGIndex*, RGBinary*, int64_t, int64_t, int64_t);
-void RGIndexMergeHelperFromDiskContig_8(RGIndex*, RGBinary*, int64_t, int64_t, int64_t, char*);
-void RGIndexMergeHelperFromDiskContig_32(RGIndex*, RGBinary*, int64_t, int64_t, int64_t, char*);
+void RGIndexMergeRuns(RGIndex*, RGBinary*, int64_t*, int64_t*, int32_t, int32_t, int64_t, char*);
+void RGIndexMergeRunsGetCuts(RGIndex*, RGBinary*, int64_t*, int64_t*, int32_t, int32_t, int64_t*);
+int64_t RGIndexMergeRunsSearch(RGIndex*, RGBinary*, int64_t, int64_t, int64_t, int32_t);
+void *RGIndexMergeRunsThread(void*);
+int32_t RGIndexMergeRunsAdvance(ThreadRGIndexMergeRunsData*, RGIndexMergeRun*);
+void *RGIndexMergeRunsReader(void*);
+void RGIndexMergeRunsRead(int, void*, int64_t, int64_t);
+int32_t RGIndexMergeRunsCompare(ThreadRGIndexMergeRunsData*, int32_t, int32_t);
+void RGIndexMergeRunsSiftUp(ThreadRGIndexMergeRunsData*, int32_t*, int32_t);
+void RGIndexMergeRunsSiftDown(ThreadRGIndexMergeRunsData*, int32_t*, int32_t, int32_t);
 
 void RGIndexDelete(RGIndex*);
 double RGIndexGetSize(RGIndex*, int32_t);
 void RGIndexPrint(gzFile, RGIndex*);
 void RGIndexRead(RGIndex*, char*);
+int64_t RGIndexWriteMap(RGIndex*, char*);
+void RGIndexReadMap(RGIndex*);
 void RGIndexPrintInfo(char*);
 void RGIndexPrintHeader(gzFile, RGIndex*);
 void RGIndexGetHeader(char*, RGIndex*);
@@ -45,5 +160,7 @@ void RGIndexPrintReadMasked(RGIndex*, char*, int, FILE*);
 void RGIndexInitialize(RGIndex*);
 void RGIndexInitializeFull(RGIndex*, RGBinary*, RGIndexLayout*, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t);
 gzFile RGIndexOpenForWriting(char*, RGIndex*);
+gzFile RGIndexOpenForUpdating(char*, RGIndex*);
+void RGIndexFinishUpdating(char*, RGIndex*);
 #endif
 
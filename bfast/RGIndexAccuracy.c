@@ -4,6 +4,7 @@
 #include <assert.h>
 #include <time.h>
 #include <limits.h>
+#include <pthread.h>
 
 #include "BError.h"
 #include "BLibDefinitions.h"
@@ -12,10 +13,14 @@
 
 /* Is a utility that tests, searches for, and compares layouts for indexes against certain events,
  * such as errors, mismatches and insertions.
+ * 
+ * Every sampled read is drawn from its own random stream, derived from the seed, the event 
+ * being sampled and the sample number.  Thus the results are reproducible for a given seed,
+ * do not depend on the number of threads, and all candidate index sets are evaluated against 
+ * the same reads.
  * */
 
 #define SAMPLE_ROTATE_NUM 10
-char Colors[5] = "01234";
 
 /* TODO */
 void RunSearchForRGIndexAccuracies(int readLength,
@@ -27,100 +32,220 @@ void RunSearchForRGIndexAccuracies(int readLength,
 		int accuracyThreshold,
 		int space,
 		int maxNumMismatches,
-		int maxNumColorErrors)
+		int maxNumColorErrors,
+		uint64_t seed,
+		int numThreads,
+		int exact)
 {
-	int i, j;
-	RGIndexAccuracySet curSet, bestSet;
-	RGIndexAccuracy curRGIndexAccuracy;
-	AccuracyProfile curP, bestP;
-
-	/* Seed random number */
-	srand(time(NULL));
+	char *FnName="RunSearchForRGIndexAccuracies";
+	int i, j, errCode;
+	uint64_t state;
+	RGIndexAccuracySet curSet, bestSet, nextSet;
+	RGIndexAccuracy *candidates=NULL;
+	AccuracyProfile bestP;
+	int bestIndex;
+	RGIndexAccuracySearchThreadData *data=NULL;
+	pthread_t *threads=NULL;
+	void *status=NULL;
+
+	/* Allocate memory for the candidates and the threads */
+	candidates = malloc(sizeof(RGIndexAccuracy)*numRGIndexAccuraciesToSample);
+	if(NULL == candidates) {
+		PrintError(FnName, "candidates", "Could not allocate memory", Exit, MallocMemory);
+	}
+	data = malloc(sizeof(RGIndexAccuracySearchThreadData)*numThreads);
+	if(NULL == data) {
+		PrintError(FnName, "data", "Could not allocate memory", Exit, MallocMemory);
+	}
+	threads = malloc(sizeof(pthread_t)*numThreads);
+	if(NULL == threads) {
+		PrintError(FnName, "threads", "Could not allocate memory", Exit, MallocMemory);
+	}
 
 	/* Initialize index set */
 	RGIndexAccuracySetInitialize(&curSet);
-	RGIndexAccuracySetInitialize(&bestSet);
 
 	/* Will always seed with contiguous 1s mask */
 	RGIndexAccuracySetSeed(&curSet,
 			keySize);
-	RGIndexAccuracySetSeed(&bestSet,
-			keySize);
 
-	fprintf(stderr, "Currently on [index set size, sample number]\n0");
+	fprintf(stderr, "Currently on index set size:\n0");
 	for(i=2;i<=maxRGIndexAccuracySetSize;i++) { /* Add one index to the set */
-		/* Initialize */
-		RGIndexAccuracyInitialize(&curRGIndexAccuracy);
-		AccuracyProfileInitialize(&curP);
-		AccuracyProfileInitialize(&bestP);
+		fprintf(stderr, "\r%-3d", i);
 
 		/* Sample the space of possible indexes */
+		state = RGIndexAccuracyRandomSeed(seed, RGINDEXACCURACY_MASK_STREAM, i);
 		for(j=0;j<numRGIndexAccuraciesToSample;j++) { 
-			if(j%SAMPLE_ROTATE_NUM == 0) {
-				fprintf(stderr, "\r%-3d,%-9d",
-						i,
-						j);
-			}
-			/* Initialze cur */
-			RGIndexAccuracyInitialize(&curRGIndexAccuracy);
-			AccuracyProfileInitialize(&curP);
-
+			RGIndexAccuracyInitialize(&candidates[j]);
 			/* Get random index */
 			do {
-				RGIndexAccuracyFree(&curRGIndexAccuracy);
-				RGIndexAccuracyGetRandom(&curRGIndexAccuracy,
+				RGIndexAccuracyFree(&candidates[j]);
+				RGIndexAccuracyGetRandom(&candidates[j],
 						keySize,
-						maxKeyWidth);
+						maxKeyWidth,
+						&state);
 			}
-			while(1==RGIndexAccuracySetContains(&curSet, &curRGIndexAccuracy));
-
-			/* Push random index onto the current set */
-			RGIndexAccuracySetPush(&curSet,
-					&curRGIndexAccuracy);
-			/* Check if this is the first time */
-			if(bestSet.numRGIndexAccuracies < curSet.numRGIndexAccuracies) {
-				RGIndexAccuracySetPush(&bestSet, &curRGIndexAccuracy);
+			while(1==RGIndexAccuracySetContains(&curSet, &candidates[j]));
+		}
+
+		/* Find the best index in each block of candidates */
+		for(j=0;j<numThreads;j++) {
+			data[j].set = &curSet;
+			data[j].candidates = candidates;
+			data[j].startIndex = (int)(((int64_t)numRGIndexAccuraciesToSample)*j/numThreads);
+			data[j].endIndex = (int)(((int64_t)numRGIndexAccuraciesToSample)*(j+1)/numThreads);
+			data[j].readLength = readLength;
+			data[j].numEventsToSample = numEventsToSample;
+			data[j].space = space;
+			data[j].maxNumMismatches = maxNumMismatches;
+			data[j].maxNumColorErrors = maxNumColorErrors;
+			data[j].accuracyThreshold = accuracyThreshold;
+			data[j].seed = seed;
+			data[j].exact = exact;
+			data[j].bestIndex = -1;
+			AccuracyProfileInitialize(&data[j].bestP);
+			data[j].threadID = j;
+		}
+		for(j=0;j<numThreads;j++) {
+			errCode = pthread_create(&threads[j], /* thread struct */
+					NULL, /* default thread attributes */
+					RGIndexAccuracySearchThread, /* start routine */
+					&data[j]); /* data to routine */
+			if(0!=errCode) {
+				PrintError(FnName, "pthread_create: errCode", "Could not start thread", Exit, ThreadError);
+			}
+		}
+		for(j=0;j<numThreads;j++) {
+			errCode = pthread_join(threads[j],
+					&status);
+			if(0!=errCode) {
+				PrintError(FnName, "pthread_join: errCode", "Thread returned an error", Exit, ThreadError);
+			}
+		}
+
+		/* Merge the blocks in order, keeping the first best index as if 
+		 * the candidates were examined one at a time */
+		bestIndex = -1;
+		AccuracyProfileInitialize(&bestP);
+		RGIndexAccuracySetInitialize(&bestSet);
+		RGIndexAccuracySetInitialize(&nextSet);
+		for(j=0;j<numThreads;j++) {
+			if(data[j].bestIndex < 0) {
+				continue;
+			}
+			if(bestIndex < 0) {
+				bestIndex = data[j].bestIndex;
+				AccuracyProfileCopy(&bestP, &data[j].bestP);
+				RGIndexAccuracySetCopy(&bestSet, &curSet);
+				RGIndexAccuracySetPush(&bestSet, &candidates[bestIndex]);
 			}
 			else {
-				assert(j>0);
-				assert(bestSet.numRGIndexAccuracies == curSet.numRGIndexAccuracies);
-				/* Compare accuracy profile */
+				RGIndexAccuracySetCopy(&nextSet, &curSet);
+				RGIndexAccuracySetPush(&nextSet, &candidates[data[j].bestIndex]);
 				if(AccuracyProfileCompare(&bestSet, 
 							&bestP,
-							&curSet, 
-							&curP,
+							&nextSet, 
+							&data[j].bestP,
 							readLength,
 							numEventsToSample,
 							space,
 							maxNumMismatches,
 							maxNumColorErrors,
-							accuracyThreshold) < 0) {
-					/* Copy index over to the current best set */
+							accuracyThreshold,
+							seed,
+							numThreads,
+							exact) < 0) {
+					bestIndex = data[j].bestIndex;
+					AccuracyProfileCopy(&bestP, &data[j].bestP);
 					RGIndexAccuracySetPop(&bestSet);
-					RGIndexAccuracySetPush(&bestSet, &curRGIndexAccuracy);
-					AccuracyProfileCopy(&bestP, &curP);
+					RGIndexAccuracySetPush(&bestSet, &candidates[bestIndex]);
 				}
+				RGIndexAccuracySetFree(&nextSet);
 			}
-			/* Pop the index off the current set */
-			RGIndexAccuracySetPop(&curSet);
-			/* Free cur index */
-			RGIndexAccuracyFree(&curRGIndexAccuracy);
-			/* Free profile */
-			AccuracyProfileFree(&curP);
+			AccuracyProfileFree(&data[j].bestP);
 		}
-		/* Free accuracy profile */
-		AccuracyProfileFree(&bestP);
+		assert(0 <= bestIndex);
+
 		/* Copy best index over to cur set */
-		RGIndexAccuracySetPush(&curSet, &bestSet.indexes[bestSet.numRGIndexAccuracies-1]);
+		RGIndexAccuracySetPush(&curSet, &candidates[bestIndex]);
+
+		/* Free */
+		AccuracyProfileFree(&bestP);
+		RGIndexAccuracySetFree(&bestSet);
+		for(j=0;j<numRGIndexAccuraciesToSample;j++) { 
+			RGIndexAccuracyFree(&candidates[j]);
+		}
 	}
 	fprintf(stderr, "\r--------------completed\n");
 
 	/* Print */
-	RGIndexAccuracySetPrint(&bestSet, stdout);
+	RGIndexAccuracySetPrint(&curSet, stdout);
+
+	/* Free */
+	RGIndexAccuracySetFree(&curSet);
+	free(candidates);
+	free(data);
+	free(threads);
+}
+
+/* TODO */
+void *RGIndexAccuracySearchThread(void *arg)
+{
+	RGIndexAccuracySearchThreadData *data = (RGIndexAccuracySearchThreadData*)arg;
+	int j;
+	RGIndexAccuracySet curSet, bestSet;
+	AccuracyProfile curP;
+
+	/* Each thread works on its own copy of the set */
+	RGIndexAccuracySetInitialize(&curSet);
+	RGIndexAccuracySetInitialize(&bestSet);
+	RGIndexAccuracySetCopy(&curSet, data->set);
+	RGIndexAccuracySetCopy(&bestSet, data->set);
+
+	for(j=data->startIndex;j<data->endIndex;j++) {
+		AccuracyProfileInitialize(&curP);
+
+		/* Push the index onto the current set */
+		RGIndexAccuracySetPush(&curSet, &data->candidates[j]);
+		/* Check if this is the first time */
+		if(data->bestIndex < 0) {
+			RGIndexAccuracySetPush(&bestSet, &data->candidates[j]);
+			data->bestIndex = j;
+		}
+		else {
+			assert(bestSet.numRGIndexAccuracies == curSet.numRGIndexAccuracies);
+			/* Compare accuracy profile */
+			if(AccuracyProfileCompare(&bestSet, 
+						&data->bestP,
+						&curSet, 
+						&curP,
+						data->readLength,
+						data->numEventsToSample,
+						data->space,
+						data->maxNumMismatches,
+						data->maxNumColorErrors,
+						data->accuracyThreshold,
+						data->seed,
+						1,
+						data->exact) < 0) {
+				/* Copy index over to the current best set */
+				RGIndexAccuracySetPop(&bestSet);
+				RGIndexAccuracySetPush(&bestSet, &data->candidates[j]);
+				AccuracyProfileCopy(&data->bestP, &curP);
+				data->bestIndex = j;
+			}
+		}
+		/* Pop the index off the current set */
+		RGIndexAccuracySetPop(&curSet);
+		/* Free profile */
+		AccuracyProfileFree(&curP);
+	}
 
 	/* Free */
 	RGIndexAccuracySetFree(&curSet);
 	RGIndexAccuracySetFree(&bestSet);
+
+	return arg;
 }
 
 /* TODO */
@@ -130,7 +255,10 @@ void RunEvaluateRGIndexAccuracies(char *inputFileName,
 		int space,
 		int maxNumMismatches,
 		int maxInsertionLength,
-		int maxNumColorErrors)
+		int maxNumColorErrors,
+		uint64_t seed,
+		int numThreads,
+		int exact)
 {
 	char *FnName="RunEvaluateRGIndexAccuracies";
 	int setSize, i;
@@ -139,9 +267,6 @@ void RunEvaluateRGIndexAccuracies(char *inputFileName,
 
 	assert(space == 1 || maxNumColorErrors == 0);
 
-	/* Seed random number */
-	srand(time(NULL));
-
 	RGIndexAccuracySetInitialize(&curSet);
 
 	/* Read in */
@@ -186,7 +311,10 @@ void RunEvaluateRGIndexAccuracies(char *inputFileName,
 						readLength,
 						numEventsToSample,
 						maxNumMismatches,
-						maxInsertionLength);
+						maxInsertionLength,
+						seed,
+						numThreads,
+						exact);
 				break;
 			case ColorSpace:
 				RunEvaluateRGIndexAccuraciesColorSpace(&curSet,
@@ -194,7 +322,10 @@ void RunEvaluateRGIndexAccuracies(char *inputFileName,
 						numEventsToSample,
 						maxNumMismatches,
 						maxInsertionLength,
-						maxNumColorErrors);
+						maxNumColorErrors,
+						seed,
+						numThreads,
+						exact);
 				break;
 			default:
 				PrintError(FnName, "space", "Could not understand space", Exit, OutOfRange);
@@ -210,12 +341,23 @@ void RunEvaluateRGIndexAccuraciesNTSpace(RGIndexAccuracySet *set,
 		int readLength,
 		int numEventsToSample,
 		int maxNumMismatches,
-		int maxInsertionLength)
+		int maxInsertionLength,
+		uint64_t seed,
+		int numThreads,
+		int exact)
 {
 	int i, j;
+	AccuracyProfile p;
 
 	assert(numEventsToSample > 0);
 
+	/* Get the mismatch accuracies exactly */
+	AccuracyProfileInitialize(&p);
+	if(1 == exact) {
+		AccuracyProfileAllocate(&p, maxNumMismatches, 0, 100);
+		AccuracyProfileGetExact(&p, set, readLength, NTSpace);
+	}
+
 	/* Print the header */
 	fprintf(stdout, "N Masks = %d\n", set->numRGIndexAccuracies);
 	fprintf(stdout, "%-5s\t", "MM"); /* # of Mismatches */
@@ -230,15 +372,22 @@ void RunEvaluateRGIndexAccuraciesNTSpace(RGIndexAccuracySet *set,
 	/* Mismatches including zero */
 	for(i=0;i<=maxNumMismatches;i++) {
 		fprintf(stdout, "%-5d\t", i);
-		fprintf(stdout, "%1.3lf\t",
-				GetNumCorrect(set,
-					readLength,
-					numEventsToSample,
-					i,
-					0,
-					NoIndelType,
-					0,
-					NTSpace)/((double)numEventsToSample));
+		if(1 == exact) {
+			fprintf(stdout, "%1.3lf\t", p.accuracy[i]/100.0);
+		}
+		else {
+			fprintf(stdout, "%1.3lf\t",
+					GetNumCorrect(set,
+						readLength,
+						numEventsToSample,
+						i,
+						0,
+						NoIndelType,
+						0,
+						NTSpace,
+						seed,
+						numThreads)/((double)numEventsToSample));
+		}
 		/* Deletion with Mismatches */
 		fprintf(stdout, "%1.3lf\t",
 				GetNumCorrect(set,
@@ -248,7 +397,9 @@ void RunEvaluateRGIndexAccuraciesNTSpace(RGIndexAccuracySet *set,
 					0,
 					DeletionType,
 					0,
-					NTSpace)/((double)numEventsToSample));
+					NTSpace,
+					seed,
+					numThreads)/((double)numEventsToSample));
 		/* Insertions with Mismatches */
 		for(j=1;j<=maxInsertionLength;j++) {
 			fprintf(stdout, "%1.3lf\t",
@@ -259,11 +410,15 @@ void RunEvaluateRGIndexAccuraciesNTSpace(RGIndexAccuracySet *set,
 						0,
 						InsertionType,
 						j,
-						NTSpace)/((double)numEventsToSample));
+						NTSpace,
+						seed,
+						numThreads)/((double)numEventsToSample));
 		}
 		fprintf(stdout, "\n");
 	}
 	fflush(stdout);
+
+	AccuracyProfileFree(&p);
 }
 
 void RunEvaluateRGIndexAccuraciesColorSpace(RGIndexAccuracySet *set,
@@ -271,11 +426,22 @@ void RunEvaluateRGIndexAccuraciesColorSpace(RGIndexAccuracySet *set,
 		int numEventsToSample,
 		int maxNumMismatches,
 		int maxInsertionLength,
-		int maxNumColorErrors)
+		int maxNumColorErrors,
+		uint64_t seed,
+		int numThreads,
+		int exact)
 {
 	int i, j;
+	AccuracyProfile p;
 	assert(numEventsToSample > 0);
 
+	/* Get the SNP and color error accuracies exactly */
+	AccuracyProfileInitialize(&p);
+	if(1 == exact) {
+		AccuracyProfileAllocate(&p, maxNumMismatches, maxNumColorErrors, 100);
+		AccuracyProfileGetExact(&p, set, readLength, ColorSpace);
+	}
+
 	/* Print the header */
 	fprintf(stdout, "N Masks = %d\n", set->numRGIndexAccuracies);
 	fprintf(stdout, "%-5s\t", "CE"); /* # of Color Errors */
@@ -293,15 +459,22 @@ void RunEvaluateRGIndexAccuraciesColorSpace(RGIndexAccuracySet *set,
 		fprintf(stdout, "%-5d\t", i);
 		/* SNPs with color errors - include no SNPs */
 		for(j=0;j<=maxNumMismatches;j++) {
-			fprintf(stdout, "%1.3lf\t",
-					GetNumCorrect(set,
-						readLength,
-						numEventsToSample,
-						j,
-						i,
-						NoIndelType,
-						0,
-						ColorSpace)/((double)numEventsToSample));
+			if(1 == exact) {
+				fprintf(stdout, "%1.3lf\t", p.accuracy[i*(maxNumMismatches+1) + j]/100.0);
+			}
+			else {
+				fprintf(stdout, "%1.3lf\t",
+						GetNumCorrect(set,
+							readLength,
+							numEventsToSample,
+							j,
+							i,
+							NoIndelType,
+							0,
+							ColorSpace,
+							seed,
+							numThreads)/((double)numEventsToSample));
+			}
 		}
 		/* Deletion with color errors */
 		fprintf(stdout, "%1.3lf\t",
@@ -312,7 +485,9 @@ void RunEvaluateRGIndexAccuraciesColorSpace(RGIndexAccuracySet *set,
 					i,
 					DeletionType,
 					0,
-					ColorSpace)/((double)numEventsToSample));
+					ColorSpace,
+					seed,
+					numThreads)/((double)numEventsToSample));
 		/* Insertions with color errors */
 		for(j=1;j<=maxInsertionLength;j++) {
 			fprintf(stdout, "%1.3lf\t",
@@ -323,16 +498,22 @@ void RunEvaluateRGIndexAccuraciesColorSpace(RGIndexAccuracySet *set,
 						i,
 						InsertionType,
 						j,
-						ColorSpace)/((double)numEventsToSample));
+						ColorSpace,
+						seed,
+						numThreads)/((double)numEventsToSample));
 		}
 		fprintf(stdout, "\n");
 	}
+
+	AccuracyProfileFree(&p);
 }
 
 int32_t RunEvaluateRGIndexes(RGIndexAccuracySet *set,
 		int readLength,
 		int numEventsToSample,
-		int space)
+		int space,
+		uint64_t seed,
+		int numThreads)
 {
 	/*
 	   char *FnName="RunEvaluateRGIndexes";
@@ -341,9 +522,6 @@ int32_t RunEvaluateRGIndexes(RGIndexAccuracySet *set,
 	int found = 0;
 	int numCorrect = 0;
 
-	/* Seed random number */
-	srand(time(NULL));
-
 	numMismatches=found=numCorrect=0;
 	while(0 == found) {
 		numCorrect = GetNumCorrect(set,
@@ -353,7 +531,9 @@ int32_t RunEvaluateRGIndexes(RGIndexAccuracySet *set,
 				(ColorSpace==space)?(numMismatches+1):0,
 				NoIndelType,
 				0,
-				space);
+				space,
+				seed,
+				numThreads);
 		if(((double)numCorrect*100)/numEventsToSample < RGINDEXACCURACY_MIN_PERCENT_FOUND) {
 			found = 1;
 		}
@@ -372,104 +552,241 @@ int32_t GetNumCorrect(RGIndexAccuracySet *set,
 		int numColorErrors,
 		int indelType,
 		int insertionLength,
-		int space)
+		int space,
+		uint64_t seed,
+		int numThreads)
 {
 	char *FnName="GetNumCorrect";
 	assert(space == 1 || numColorErrors == 0);
 	assert(insertionLength <= 0 || indelType == InsertionType);
 
+	int32_t i, errCode;
+	int32_t numCorrect = 0;
+	GetNumCorrectThreadData *data=NULL;
+	pthread_t *threads=NULL;
+	void *status=NULL;
+
+	if(numThreads <= 1) {
+		/* Do not bother with threads */
+		for(i=0;i<numEventsToSample;i++) {
+			numCorrect += GetNumCorrectSample(set,
+					readLength,
+					i,
+					numSNPs,
+					numColorErrors,
+					indelType,
+					insertionLength,
+					space,
+					seed);
+		}
+		return numCorrect;
+	}
+
+	data = malloc(sizeof(GetNumCorrectThreadData)*numThreads);
+	if(NULL == data) {
+		PrintError(FnName, "data", "Could not allocate memory", Exit, MallocMemory);
+	}
+	threads = malloc(sizeof(pthread_t)*numThreads);
+	if(NULL == threads) {
+		PrintError(FnName, "threads", "Could not allocate memory", Exit, MallocMemory);
+	}
+
+	/* Each thread samples a contiguous range of events */
+	for(i=0;i<numThreads;i++) {
+		data[i].set = set;
+		data[i].readLength = readLength;
+		data[i].startSample = (int)(((int64_t)numEventsToSample)*i/numThreads);
+		data[i].endSample = (int)(((int64_t)numEventsToSample)*(i+1)/numThreads);
+		data[i].numSNPs = numSNPs;
+		data[i].numColorErrors = numColorErrors;
+		data[i].indelType = indelType;
+		data[i].insertionLength = insertionLength;
+		data[i].space = space;
+		data[i].seed = seed;
+		data[i].numCorrect = 0;
+		data[i].threadID = i;
+	}
+	for(i=0;i<numThreads;i++) {
+		errCode = pthread_create(&threads[i], /* thread struct */
+				NULL, /* default thread attributes */
+				GetNumCorrectThread, /* start routine */
+				&data[i]); /* data to routine */
+		if(0!=errCode) {
+			PrintError(FnName, "pthread_create: errCode", "Could not start thread", Exit, ThreadError);
+		}
+	}
+	for(i=0;i<numThreads;i++) {
+		errCode = pthread_join(threads[i],
+				&status);
+		if(0!=errCode) {
+			PrintError(FnName, "pthread_join: errCode", "Thread returned an error", Exit, ThreadError);
+		}
+		numCorrect += data[i].numCorrect;
+	}
+
+	free(data);
+	free(threads);
+
+	return numCorrect;
+}
+
+void *GetNumCorrectThread(void *arg)
+{
+	GetNumCorrectThreadData *data = (GetNumCorrectThreadData*)arg;
 	int32_t i;
+
+	for(i=data->startSample;i<data->endSample;i++) {
+		data->numCorrect += GetNumCorrectSample(data->set,
+				data->readLength,
+				i,
+				data->numSNPs,
+				data->numColorErrors,
+				data->indelType,
+				data->insertionLength,
+				data->space,
+				data->seed);
+	}
+
+	return arg;
+}
+
+/* Returns one if the given sample is found by the set, zero otherwise */
+int32_t GetNumCorrectSample(RGIndexAccuracySet *set,
+		int readLength,
+		int sampleIndex,
+		int numSNPs,
+		int numColorErrors,
+		int indelType,
+		int insertionLength,
+		int space,
+		uint64_t seed)
+{
+	char *FnName="GetNumCorrectSample";
 	int32_t numCorrect = 0;
 	int32_t breakpoint;
+	uint64_t state;
 	Read curRead, r1, r2;
 
-	for(i=0;i<numEventsToSample;i++) {
-		ReadInitialize(&curRead);
-		ReadInitialize(&r1);
-		ReadInitialize(&r2);
-		/* Get random read with SNPs and ColorErrors */
-		ReadGetRandom(&curRead,
-				readLength,
-				numSNPs,
-				numColorErrors,
-				space);
-		/* Get the breakpoint:
-		 * SNPs - no breakpoint (0)
-		 * Deletion - breakpoint within the read 
-		 * Insertion - breakpoint within the read, including start
-		 * */
-		switch(indelType) {
-			case NoIndelType:
-				/* Only SNPs and color errors */
-				assert(insertionLength == 0);
-				/* Check read */
-				numCorrect += RGIndexAccuracySetCheckRead(set, &curRead);
-				break;
-			case DeletionType:
-				assert(insertionLength == 0);
-				/* Get where the break point occured for the deletion */
-				breakpoint = ( rand()%(readLength - 1) ) + 1;
-				assert(breakpoint > 0);
-				assert(readLength - breakpoint > 0);
-				/* Split read into two reads based on the breakpoint */
-				ReadSplit(&curRead, &r1, &r2, breakpoint, 0);
-				/* In color space, unless we are deleting at the end of a run of ex. As,
-				 * the color at the break point represents the composition of the "deleted colors".
-				 * Thus we should flip the color at the breakpoint */
+	/* The random stream of this sample */
+	state = RGIndexAccuracyRandomSeed(seed,
+			RGINDEXACCURACY_EVENT_STREAM(space, indelType, insertionLength, numColorErrors, numSNPs),
+			sampleIndex);
+
+	ReadInitialize(&curRead);
+	ReadInitialize(&r1);
+	ReadInitialize(&r2);
+	/* Get random read with SNPs and ColorErrors */
+	ReadGetRandom(&curRead,
+			readLength,
+			numSNPs,
+			numColorErrors,
+			space,
+			&state);
+	/* Get the breakpoint:
+	 * SNPs - no breakpoint (0)
+	 * Deletion - breakpoint within the read 
+	 * Insertion - breakpoint within the read, including start
+	 * */
+	switch(indelType) {
+		case NoIndelType:
+			/* Only SNPs and color errors */
+			assert(insertionLength == 0);
+			/* Check read */
+			numCorrect = RGIndexAccuracySetCheckRead(set, &curRead);
+			break;
+		case DeletionType:
+			assert(insertionLength == 0);
+			/* Get where the break point occured for the deletion */
+			breakpoint = RGIndexAccuracyRandomInt(&state, readLength - 1) + 1;
+			assert(breakpoint > 0);
+			assert(readLength - breakpoint > 0);
+			/* Split read into two reads based on the breakpoint */
+			ReadSplit(&curRead, &r1, &r2, breakpoint, 0);
+			/* In color space, unless we are deleting at the end of a run of ex. As,
+			 * the color at the break point represents the composition of the "deleted colors".
+			 * Thus we should flip the color at the breakpoint */
+			if(space==1) {
+				/* A color error at the break point */
+				if(r1.length > 0) {
+					READ_PROFILE_SET(&r1, r1.length-1);
+				}
+			}
+			/* Check either end of the read after split */
+			if(1==RGIndexAccuracySetCheckRead(set, &r1) ||
+					1==RGIndexAccuracySetCheckRead(set, &r2)) {
+				numCorrect = 1;
+			}
+			/* Free read */
+			ReadFree(&r1);
+			ReadFree(&r2);
+			break;
+		case InsertionType:
+			assert(insertionLength > 0);
+			if(readLength > insertionLength) {
+				/* Get where the insertion occured relative to the start of hte read */
+				breakpoint = RGIndexAccuracyRandomInt(&state, readLength-insertionLength);
+				/* Split read into two reads */
+				ReadSplit(&curRead, &r1, &r2, breakpoint, insertionLength);
+				/* In color space, unless we are inserting at the end of a run of ex. As,
+				 * an insertion of length "n" will cause "n+1" colors to be inserted.
+				 * Thus we should flip the color before and after the breakpoint */
 				if(space==1) {
-					/* A color error at the break point */
+					/* A color error before the break point */
 					if(r1.length > 0) {
-						r1.profile[r1.length-1] = 1;
+						READ_PROFILE_SET(&r1, r1.length-1);
+					}
+					/* A color error after the break point */
+					if(r2.length > 0) {
+						READ_PROFILE_SET(&r2, 0);
 					}
 				}
-				/* Check either end of the read after split */
+				/* Check either end of the read after split, substracting the insertion */
 				if(1==RGIndexAccuracySetCheckRead(set, &r1) ||
 						1==RGIndexAccuracySetCheckRead(set, &r2)) {
-					numCorrect++;
+					numCorrect = 1;
 				}
 				/* Free read */
 				ReadFree(&r1);
 				ReadFree(&r2);
-				break;
-			case InsertionType:
-				assert(insertionLength > 0);
-				if(readLength > insertionLength) {
-					/* Get where the insertion occured relative to the start of hte read */
-					breakpoint = (rand()%(readLength-insertionLength));
-					/* Split read into two reads */
-					ReadSplit(&curRead, &r1, &r2, breakpoint, insertionLength);
-					/* In color space, unless we are inserting at the end of a run of ex. As,
-					 * an insertion of length "n" will cause "n+1" colors to be inserted.
-					 * Thus we should flip the color before and after the breakpoint */
-					if(space==1) {
-						/* A color error before the break point */
-						if(r1.length > 0) {
-							r1.profile[r1.length-1] = 1;
-						}
-						/* A color error after the break point */
-						if(r2.length > 0) {
-							r2.profile[0] = 1;
-						}
-					}
-					/* Check either end of the read after split, substracting the insertion */
-					if(1==RGIndexAccuracySetCheckRead(set, &r1) ||
-							1==RGIndexAccuracySetCheckRead(set, &r2)) {
-						numCorrect++;
-					}
-					/* Free read */
-					ReadFree(&r1);
-					ReadFree(&r2);
-				}
-				break;
-			default:
-				PrintError(FnName, "indelType", "Could not understand indel type", Exit, OutOfRange);
-		}
-		/* Free read */
-		ReadFree(&curRead);
+			}
+			break;
+		default:
+			PrintError(FnName, "indelType", "Could not understand indel type", Exit, OutOfRange);
 	}
+	/* Free read */
+	ReadFree(&curRead);
+
 	return numCorrect;
 }
 
+/* A splitmix64 generator: cheap, and each state is an independent stream */
+uint64_t RGIndexAccuracyRandom(uint64_t *state)
+{
+	uint64_t z = ((*state) += 0x9E3779B97F4A7C15ULL);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+/* Returns a random integer in [0,n) */
+int32_t RGIndexAccuracyRandomInt(uint64_t *state, 
+		int32_t n)
+{
+	assert(0 < n);
+	return (int32_t)(RGIndexAccuracyRandom(state) % ((uint64_t)n));
+}
+
+/* Derives the state for the given stream and index from the seed */
+uint64_t RGIndexAccuracyRandomSeed(uint64_t seed,
+		uint64_t stream,
+		uint64_t index)
+{
+	uint64_t state = seed;
+	state = RGIndexAccuracyRandom(&state) ^ stream;
+	state = RGIndexAccuracyRandom(&state) ^ index;
+	return RGIndexAccuracyRandom(&state);
+}
+
 void RGIndexAccuracyMismatchProfileInitialize(RGIndexAccuracyMismatchProfile *p) 
 {
 	p->maxReadLength = -1;
@@ -505,7 +822,9 @@ void RGIndexAccuracyMismatchProfileAdd(RGIndexAccuracyMismatchProfile *p,
 		p->maxMismatches[readLength] = RunEvaluateRGIndexes(set,  
 				readLength,
 				RGINDEXACCURACY_NUM_TO_SAMPLE,
-				space);
+				space,
+				RGINDEXACCURACY_SEED,
+				1);
 	}
 }
 
@@ -759,6 +1078,7 @@ void RGIndexAccuracySetSeed(RGIndexAccuracySet *set,
 		PrintError(FnName, "set->indexes", "Could not allocate memory", Exit, MallocMemory);
 	}
 	/* Allocate index */
+	RGIndexAccuracyInitialize(&set->indexes[set->numRGIndexAccuracies-1]);
 	RGIndexAccuracyAllocate(&set->indexes[set->numRGIndexAccuracies-1],
 			keySize,
 			keySize);
@@ -768,6 +1088,16 @@ void RGIndexAccuracySetSeed(RGIndexAccuracySet *set,
 	}
 }
 
+void RGIndexAccuracySetCopy(RGIndexAccuracySet *dest,
+		RGIndexAccuracySet *src)
+{
+	int i;
+	RGIndexAccuracySetFree(dest);
+	for(i=0;i<src->numRGIndexAccuracies;i++) {
+		RGIndexAccuracySetPush(dest, &src->indexes[i]);
+	}
+}
+
 void RGIndexAccuracySetInitialize(RGIndexAccuracySet *set) 
 {
 	set->indexes=NULL;
@@ -874,20 +1204,25 @@ int32_t RGIndexAccuracyCheckRead(RGIndexAccuracy *index,
 		Read *r)
 {
 	int i, j;
-	int success;
+	int numOffsets;
+	uint64_t failed, valid;
 
 	if(index->keyWidth > r->length) {
 		return 0;
 	}
 
-	for(i=0;i<r->length - index->keyWidth + 1;i++) { /* For all possible offsets */
-		success = 1;
-		for(j=0;1==success && j<index->keyWidth;j++) { /* Go over the index mask */
-			if(index->mask[j] == 1 && r->profile[j+i] == 1) {
-				success = 0;
+	/* Check 64 offsets at a time: bit k of failed is set if offset 
+	 * i+k covers a base that can not be indexed */
+	numOffsets = r->length - index->keyWidth + 1;
+	for(i=0;i<numOffsets;i+=64) { /* For all possible offsets */
+		failed = 0;
+		for(j=0;j<index->keyWidth;j++) { /* Go over the index mask */
+			if(index->mask[j] == 1) {
+				failed |= ReadGetProfileWord(r, i+j);
 			}
 		}
-		if(1==success) {
+		valid = (64 <= numOffsets - i)?(~((uint64_t)0)):((((uint64_t)1) << (numOffsets - i)) - 1);
+		if(0 != (~failed & valid)) {
 			return 1;
 		}
 	}
@@ -912,7 +1247,8 @@ void RGIndexAccuracyCopy(RGIndexAccuracy *dest, RGIndexAccuracy *src)
 
 void RGIndexAccuracyGetRandom(RGIndexAccuracy *index,
 		int keySize,
-		int maxKeyWidth)
+		int maxKeyWidth,
+		uint64_t *state)
 {
 	char *FnName="RGIndexAccuracyGetRandom";
 	int i, j, k;
@@ -934,7 +1270,7 @@ void RGIndexAccuracyGetRandom(RGIndexAccuracy *index,
 	}
 
 	/* Choose a number of zeros to insert into the bins */
-	numLeft = rand()%(maxKeyWidth - keySize + 1);
+	numLeft = RGIndexAccuracyRandomInt(state, maxKeyWidth - keySize + 1);
 	assert(numLeft >=0 && numLeft <= maxKeyWidth - keySize);
 
 	/* Allocate memory for the index */
@@ -945,7 +1281,7 @@ void RGIndexAccuracyGetRandom(RGIndexAccuracy *index,
 	/* Insert into bins */
 	while(numLeft > 0) {
 		/* choose a bin between 1 and keySize-1 */
-		i = (rand()%numBins); /* Note: this is not truly inform, but a good approximation */
+		i = RGIndexAccuracyRandomInt(state, numBins); /* Note: this is not truly inform, but a good approximation */
 		assert(i>=0 && i<numBins);
 		bins[i]++;
 		numLeft--;
@@ -1022,7 +1358,10 @@ int AccuracyProfileCompare(RGIndexAccuracySet *setA,
 		int space,
 		int maxNumMismatches,
 		int maxNumColorErrors,
-		int accuracyThreshold)
+		int accuracyThreshold,
+		uint64_t seed,
+		int numThreads,
+		int exact)
 {
 	int i, j, ctr;
 
@@ -1045,12 +1384,22 @@ int AccuracyProfileCompare(RGIndexAccuracySet *setA,
 	assert(a->length == b->length);
 	assert(a->numColorErrors == b->numColorErrors);
 	assert(a->numSNPs == b->numSNPs);
-	assert(a->numReads > 0);
-	assert(b->numReads > 0);
+	assert(1 == exact || a->numReads > 0);
+	assert(1 == exact || b->numReads > 0);
 	assert(a->accuracyThreshold == accuracyThreshold);
 	assert(b->accuracyThreshold == accuracyThreshold);
 	assert(a->accuracyThreshold == b->accuracyThreshold);
 
+	/* The exact profile is cheap enough to compute all at once */
+	if(1 == exact) {
+		if(a->accuracy[0] < 0.0) {
+			AccuracyProfileGetExact(a, setA, readLength, space);
+		}
+		if(b->accuracy[0] < 0.0) {
+			AccuracyProfileGetExact(b, setB, readLength, space);
+		}
+	}
+
 	/* Optimization - check num above threshold */
 	if(a->numAboveThreshold < b->numAboveThreshold) {
 		return -1;
@@ -1073,7 +1422,9 @@ int AccuracyProfileCompare(RGIndexAccuracySet *setA,
 								i,
 								NoIndelType,
 								0,
-								space)/a->numReads;
+								space,
+								seed,
+								numThreads)/a->numReads;
 					}
 					if(b->accuracy[ctr] < 0.0) {
 						b->accuracy[ctr] = 100.0*GetNumCorrect(setB,
@@ -1083,7 +1434,9 @@ int AccuracyProfileCompare(RGIndexAccuracySet *setA,
 								i,
 								NoIndelType,
 								0,
-								space)/b->numReads;
+								space,
+								seed,
+								numThreads)/b->numReads;
 					}
 					/* Compare */
 					if(a->accuracy[ctr] < accuracyThreshold || b->accuracy[ctr] < accuracyThreshold) {
@@ -1108,6 +1461,298 @@ int AccuracyProfileCompare(RGIndexAccuracySet *setA,
 	}
 }
 
+/* Computes the accuracy profile exactly, rather than by sampling reads.  We go
+ * over the read one base at a time, keeping the probability of each pattern of 
+ * unindexable bases in the last window, for each number of SNPs and color errors 
+ * so far.  Patterns where a mask in the set fits are found, and are dropped.  
+ * What is left at the end are the reads we miss.
+ *
+ * In color space, a SNP changes the two colors that cover the base, though two 
+ * adjacent SNPs leave the color between them unchanged one third of the time.  
+ * A color error on a color changed by SNPs restores the color one third of the 
+ * time.  An error in the adaptor is not observed.
+ * */
+void AccuracyProfileGetExact(AccuracyProfile *a,
+		RGIndexAccuracySet *set,
+		int readLength,
+		int space)
+{
+	char *FnName="AccuracyProfileGetExact";
+	int32_t i, p, s, f, bit, k, c;
+	int32_t numSNPs, numColorErrors, numCounts, maxF, windowWidth;
+	uint64_t *maskBits=NULL;
+	uint64_t windowMask, state, key;
+	double prob, pd, total;
+	double *src=NULL, *dest=NULL, *miss=NULL;
+	RGIndexAccuracyExactTable cur, next, tmp;
+
+	assert(0 < a->length);
+	assert(space == 1 || a->numColorErrors == 0);
+	numSNPs = a->numSNPs;
+	numColorErrors = a->numColorErrors;
+	numCounts = (numSNPs + 1)*(numColorErrors + 1);
+
+	/* Get the masks, with bit zero being the last base of the window */
+	maskBits = malloc(sizeof(uint64_t)*set->numRGIndexAccuracies);
+	if(NULL == maskBits) {
+		PrintError(FnName, "maskBits", "Could not allocate memory", Exit, MallocMemory);
+	}
+	windowWidth = 1;
+	for(i=0;i<set->numRGIndexAccuracies;i++) {
+		if(RGINDEXACCURACY_EXACT_MAX_WIDTH < set->indexes[i].keyWidth) {
+			PrintError(FnName, "keyWidth", "Key width is too large to compute the accuracy exactly", Exit, OutOfRange);
+		}
+		windowWidth = (windowWidth < set->indexes[i].keyWidth)?(set->indexes[i].keyWidth):windowWidth;
+		maskBits[i] = 0;
+		for(k=0;k<set->indexes[i].keyWidth;k++) {
+			if(1 == set->indexes[i].mask[k]) {
+				maskBits[i] |= ((uint64_t)1) << (set->indexes[i].keyWidth - 1 - k);
+			}
+		}
+	}
+	windowMask = (((uint64_t)1) << windowWidth) - 1;
+
+	miss = malloc(sizeof(double)*numCounts);
+	if(NULL == miss) {
+		PrintError(FnName, "miss", "Could not allocate memory", Exit, MallocMemory);
+	}
+
+	RGIndexAccuracyExactTableInitialize(&cur, numCounts);
+	RGIndexAccuracyExactTableInitialize(&next, numCounts);
+
+	/* Nothing observed yet, with or without an error in the adaptor */
+	dest = RGIndexAccuracyExactTableAdd(&cur, 0);
+	dest[0] = 1.0;
+	if(1 == space && 0 < numColorErrors) {
+		dest[numSNPs+1] = 1.0;
+	}
+
+	for(p=0;p<readLength;p++) { /* For each base */
+		RGIndexAccuracyExactTableClear(&next);
+		/* A color error is on the color after the base */
+		maxF = (1 == space && p + 1 < readLength)?1:0;
+		for(i=0;i<cur.capacity;i++) {
+			if(RGINDEXACCURACY_EXACT_EMPTY == cur.keys[i]) {
+				continue;
+			}
+			for(s=0;s<=1;s++) { /* SNP at this base */
+				for(f=0;f<=maxF;f++) { /* Color error after this base */
+					for(bit=0;bit<=1;bit++) { /* Can not index this base */
+						/* Get the probability of the base */
+						if(0 == space) {
+							prob = (bit == s)?1.0:0.0;
+						}
+						else {
+							/* Probability the SNPs changed the color */
+							if(1 == s && 1 == (cur.keys[i] & 1)) {
+								pd = 2.0/3.0;
+							}
+							else if(1 == s || 1 == (cur.keys[i] & 1)) {
+								pd = 1.0;
+							}
+							else {
+								pd = 0.0;
+							}
+							if(1 == f) {
+								prob = (1 == bit)?(1.0 - pd/3.0):(pd/3.0);
+							}
+							else {
+								prob = (1 == bit)?pd:(1.0 - pd);
+							}
+						}
+						if(prob <= 0.0) {
+							continue;
+						}
+
+						/* Check if a mask fits */
+						state = cur.keys[i] >> 1;
+						state = ((state << 1) | bit) & windowMask;
+						for(k=0;k<set->numRGIndexAccuracies;k++) {
+							if(set->indexes[k].keyWidth - 1 <= p &&
+									0 == (state & maskBits[k])) {
+								break;
+							}
+						}
+						if(k < set->numRGIndexAccuracies) {
+							/* Found */
+							continue;
+						}
+
+						/* Skip if we would have too many SNPs or color errors */
+						src = RGIndexAccuracyExactTableGet(&cur, i);
+						for(c=0,total=0.0;c+f<=numColorErrors;c++) {
+							for(k=0;k+s<=numSNPs;k++) {
+								total += src[c*(numSNPs+1) + k];
+							}
+						}
+						if(total <= 0.0) {
+							continue;
+						}
+
+						/* Add */
+						key = (state << 1) | ((1 == space)?s:0);
+						dest = RGIndexAccuracyExactTableAdd(&next, key);
+						src = RGIndexAccuracyExactTableGet(&cur, i);
+						for(c=0;c+f<=numColorErrors;c++) {
+							for(k=0;k+s<=numSNPs;k++) {
+								dest[(c+f)*(numSNPs+1) + k + s] += prob*src[c*(numSNPs+1) + k];
+							}
+						}
+					}
+				}
+			}
+		}
+		/* Swap */
+		tmp = cur;
+		cur = next;
+		next = tmp;
+	}
+
+	/* Sum the reads we missed */
+	for(i=0;i<numCounts;i++) {
+		miss[i] = 0.0;
+	}
+	for(i=0;i<cur.capacity;i++) {
+		if(RGINDEXACCURACY_EXACT_EMPTY != cur.keys[i]) {
+			src = RGIndexAccuracyExactTableGet(&cur, i);
+			for(k=0;k<numCounts;k++) {
+				miss[k] += src[k];
+			}
+		}
+	}
+
+	/* Divide by the number of ways to place the SNPs and color errors */
+	for(c=0;c<=numColorErrors;c++) {
+		for(k=0;k<=numSNPs;k++) {
+			total = RGIndexAccuracyBinomial(readLength, k)*RGIndexAccuracyBinomial(readLength, c);
+			a->accuracy[c*(numSNPs+1) + k] = (total <= 0.0)?0.0:(100.0*(1.0 - miss[c*(numSNPs+1) + k]/total));
+		}
+	}
+
+	/* Free memory */
+	RGIndexAccuracyExactTableFree(&cur);
+	RGIndexAccuracyExactTableFree(&next);
+	free(maskBits);
+	free(miss);
+}
+
+double RGIndexAccuracyBinomial(int n, 
+		int k)
+{
+	int i;
+	double r = 1.0;
+	if(k < 0 || n < k) {
+		return 0.0;
+	}
+	for(i=1;i<=k;i++) {
+		r = r*(n - k + i)/i;
+	}
+	return r;
+}
+
+void RGIndexAccuracyExactTableInitialize(RGIndexAccuracyExactTable *t,
+		int32_t numCounts)
+{
+	t->numCounts = numCounts;
+	t->size = 0;
+	t->capacity = 0;
+	t->keys = NULL;
+	t->counts = NULL;
+	RGIndexAccuracyExactTableResize(t, RGINDEXACCURACY_EXACT_MIN_CAPACITY);
+}
+
+/* Returns the counts for the key, adding it if necessary */
+double *RGIndexAccuracyExactTableAdd(RGIndexAccuracyExactTable *t,
+		uint64_t key)
+{
+	int64_t i, j;
+
+	if(t->capacity <= 2*(t->size + 1)) {
+		RGIndexAccuracyExactTableResize(t, 2*t->capacity);
+	}
+
+	/* Linear probing */
+	for(i=RGIndexAccuracyExactTableHash(key) & (t->capacity - 1);
+			RGINDEXACCURACY_EXACT_EMPTY != t->keys[i] && key != t->keys[i];
+			i=(i+1) & (t->capacity - 1)) {
+	}
+	if(RGINDEXACCURACY_EXACT_EMPTY == t->keys[i]) {
+		t->keys[i] = key;
+		for(j=0;j<t->numCounts;j++) {
+			t->counts[i*t->numCounts + j] = 0.0;
+		}
+		t->size++;
+	}
+	return RGIndexAccuracyExactTableGet(t, i);
+}
+
+double *RGIndexAccuracyExactTableGet(RGIndexAccuracyExactTable *t,
+		int64_t i)
+{
+	return t->counts + i*t->numCounts;
+}
+
+uint64_t RGIndexAccuracyExactTableHash(uint64_t key)
+{
+	key ^= key >> 33;
+	key *= 0xFF51AFD7ED558CCDULL;
+	key ^= key >> 33;
+	return key;
+}
+
+void RGIndexAccuracyExactTableResize(RGIndexAccuracyExactTable *t,
+		int64_t capacity)
+{
+	char *FnName="RGIndexAccuracyExactTableResize";
+	RGIndexAccuracyExactTable old = (*t);
+	int64_t i, j;
+	double *dest=NULL;
+
+	t->capacity = capacity;
+	t->size = 0;
+	t->keys = malloc(sizeof(uint64_t)*t->capacity);
+	if(NULL == t->keys) {
+		PrintError(FnName, "t->keys", "Could not allocate memory", Exit, MallocMemory);
+	}
+	t->counts = malloc(sizeof(double)*t->capacity*t->numCounts);
+	if(NULL == t->counts) {
+		PrintError(FnName, "t->counts", "Could not allocate memory", Exit, MallocMemory);
+	}
+	for(i=0;i<t->capacity;i++) {
+		t->keys[i] = RGINDEXACCURACY_EXACT_EMPTY;
+	}
+
+	/* Copy over */
+	for(i=0;i<old.capacity;i++) {
+		if(RGINDEXACCURACY_EXACT_EMPTY != old.keys[i]) {
+			dest = RGIndexAccuracyExactTableAdd(t, old.keys[i]);
+			for(j=0;j<t->numCounts;j++) {
+				dest[j] = old.counts[i*old.numCounts + j];
+			}
+		}
+	}
+	free(old.keys);
+	free(old.counts);
+}
+
+void RGIndexAccuracyExactTableClear(RGIndexAccuracyExactTable *t)
+{
+	int64_t i;
+	for(i=0;i<t->capacity;i++) {
+		t->keys[i] = RGINDEXACCURACY_EXACT_EMPTY;
+	}
+	t->size = 0;
+}
+
+void RGIndexAccuracyExactTableFree(RGIndexAccuracyExactTable *t)
+{
+	free(t->keys);
+	free(t->counts);
+	t->keys = NULL;
+	t->counts = NULL;
+	t->size = t->capacity = 0;
+}
+
 void AccuracyProfileCopy(AccuracyProfile *dest, AccuracyProfile *src) 
 {
 	int i;
@@ -1175,163 +1820,169 @@ void ReadSplit(Read *curRead,
 		int breakpoint,
 		int insertionLength)
 {
-	int i, ctr;
-
 	/* Read 1 */
 	if(breakpoint > 0) {
 		ReadAllocate(r1, breakpoint);
-	}
-	for(i=0;i<breakpoint;i++) {
-		assert(i < r1->length);
-		r1->profile[i] = curRead->profile[i];
+		ReadCopyProfile(r1, curRead, 0);
 	}
 	/* Read 2 */
 	if(curRead->length - breakpoint - insertionLength > 0) {
 		ReadAllocate(r2, curRead->length - breakpoint - insertionLength);
+		ReadCopyProfile(r2, curRead, breakpoint + insertionLength);
 	}
-	for(i=breakpoint+insertionLength, ctr=0;
-			i<curRead->length;
-			i++,ctr++) {
-		assert(ctr < r2->length);
-		r2->profile[ctr] = curRead->profile[i];
+}
+
+/* Copies the profile of src starting at the given base into dest */
+void ReadCopyProfile(Read *dest,
+		Read *src,
+		int start)
+{
+	int i;
+	assert(start + dest->length <= src->length);
+	for(i=0;64*i < dest->length;i++) {
+		dest->profile[i] = ReadGetProfileWord(src, start + 64*i);
+		if(dest->length - 64*i < 64) {
+			dest->profile[i] &= (((uint64_t)1) << (dest->length - 64*i)) - 1;
+		}
+	}
+}
+
+/* Returns the 64 bits of the profile starting at the given base */
+uint64_t ReadGetProfileWord(Read *r,
+		int start)
+{
+	int word = start >> 6;
+	int shift = start & 63;
+	uint64_t bits = 0;
+
+	if(word < READ_PROFILE_NUM_WORDS) {
+		bits = r->profile[word] >> shift;
+		if(0 < shift && word + 1 < READ_PROFILE_NUM_WORDS) {
+			bits |= r->profile[word+1] << (64 - shift);
+		}
 	}
+	return bits;
 }
 
-/* Zeros are valid bases, Ones we can't index */
+/* Set bits are bases we can't index */
 void ReadGetRandom(Read *r, 
 		int readLength,
 		int numSNPs,
 		int numColorErrors,
-		int space)
+		int space,
+		uint64_t *state)
 {
-	char *FnName="ReadGetRandom";
 	int i;
 	int numSNPsLeft = numSNPs;
 	int numColorErrorsLeft = numColorErrors;
 	int index;
-	char original;
-	char *read=NULL;
-	char *originalColorSpace = NULL;
-	int tmpReadLength = 0;
+	uint8_t bases[READ_PROFILE_MAX_LENGTH];
+	uint8_t originalColors[READ_PROFILE_MAX_LENGTH+1];
+	uint8_t colors[READ_PROFILE_MAX_LENGTH+1];
+	uint8_t used[READ_PROFILE_MAX_LENGTH];
 
 	assert(numSNPs <= readLength);
 	assert(numColorErrors <= readLength);
 
-	/* Allocate memory for a read */
+	/* Allocate memory for a read, with no SNPs or color errors */
 	ReadAllocate(r, readLength);
 
-	/* Initialize to no SNPs or color errors */
-	for(i=0;i<r->length;i++) {
-		r->profile[i] = 0;
-	}
-
 	assert(space == 1 || numColorErrors == 0);
 	if(space == 0) {
 		/* Insert random SNPS */
 		while(numSNPsLeft > 0) {
 			/* Pick a position to convert */
-			index = rand()%(r->length);
+			index = RGIndexAccuracyRandomInt(state, r->length);
 
-			if(r->profile[index] == 0) {
-				r->profile[index] = 1;
+			if(0 == READ_PROFILE_GET(r, index)) {
+				READ_PROFILE_SET(r, index);
 				numSNPsLeft--;
 			}
 		}
 	}
 	else {
-
-		read = malloc(sizeof(char)*(readLength+1));
-		if(NULL == read) {
-			PrintError(FnName, "read", "Could not allocate memory", Exit, MallocMemory);
-		}
-		originalColorSpace = malloc(sizeof(char)*(readLength+1));
-		if(NULL == originalColorSpace) {
-			PrintError(FnName, "originalColorSpace", "Could not allocate memory", Exit, MallocMemory);
-		}
-
-		/* Get a random NT read */
+		/* Bases and colors are two bit codes, where a color is the exclusive 
+		 * or of the two adjacent bases.  The first color is the adaptor. */
 		for(i=0;i<readLength;i++) {
-			read[i] = DNA[rand()%4];
+			bases[i] = RGIndexAccuracyRandomInt(state, 4);
+			used[i] = 0;
 		}
-		read[readLength]='\0';
-
-		/* Get the color space of the original read */
-		strcpy(originalColorSpace, read);
-		tmpReadLength = readLength;
-		ConvertReadToColorSpace(&originalColorSpace,
-				&tmpReadLength);
+		ReadGetColors(bases, readLength, originalColors);
 
 		/* Insert random SNPs */
 		while(numSNPsLeft > 0) {
 			/* Pick a position to convert */
-			index = rand()%(r->length);
+			index = RGIndexAccuracyRandomInt(state, r->length);
 
-			if(r->profile[index] == 0) {
-				r->profile[index] = 1;
+			if(0 == used[index]) {
+				used[index] = 1;
 				numSNPsLeft--;
 				/* Modify base to a new base */
-				for(original = read[index];
-						original == read[index];
-						read[index] = DNA[rand()%4]) {
-				}
+				bases[index] = (bases[index] + 1 + RGIndexAccuracyRandomInt(state, 3)) & 3;
 			}
 		}
 		/* Convert to color space */
-		tmpReadLength = readLength;
-		ConvertReadToColorSpace(&read,
-				&tmpReadLength);
+		ReadGetColors(bases, readLength, colors);
 		/* Insert color errors */
 		while(numColorErrorsLeft > 0) {
 			/* Pick a position to convert */
-			index = rand()%(r->length);
+			index = RGIndexAccuracyRandomInt(state, r->length);
 
-			if(r->profile[index] != 2) {
-				r->profile[index] = 2;
+			if(2 != used[index]) {
+				used[index] = 2;
 				numColorErrorsLeft--;
-				/* Modify base to a new color */
-				for(original = read[index];
-						original == read[index];
-						read[index] = Colors[rand()%4]) {
+				/* Modify to a new color, an error in the adaptor is not observed */
+				if(0 < index) {
+					colors[index] = (colors[index] + 1 + RGIndexAccuracyRandomInt(state, 3)) & 3;
 				}
 			}
 		}
 		/* Compare the two profiles to get an end profile */
 		for(i=0;i<r->length;i++) {
-			if(originalColorSpace[i+1] == read[i+1]) {
-				r->profile[i] = 0;
-			}
-			else {
-				r->profile[i] = 1;
+			if(originalColors[i+1] != colors[i+1]) {
+				READ_PROFILE_SET(r, i);
 			}
 		}
+	}
+}
 
-		free(read);
-		read = NULL;
-		free(originalColorSpace);
-		originalColorSpace = NULL;
+/* Gets the colors of the bases, preceded by the adaptor */
+void ReadGetColors(uint8_t *bases,
+		int length,
+		uint8_t *colors)
+{
+	int i;
+	uint8_t prev = COLOR_SPACE_START_NT_INT;
+
+	colors[0] = 4;
+	for(i=0;i<length;i++) {
+		colors[i+1] = prev ^ bases[i];
+		prev = bases[i];
 	}
 }
 
 void ReadInitialize(Read *r)
 {
+	int i;
 	r->length = 0;
-	r->profile = NULL;
+	for(i=0;i<READ_PROFILE_NUM_WORDS;i++) {
+		r->profile[i] = 0;
+	}
 }
 
 void ReadAllocate(Read *r, 
 		int readLength)
 {
 	char *FnName = "ReadAllocate";
-	r->length = readLength;
-	r->profile = malloc(sizeof(int32_t)*r->length);
-	if(NULL == r->profile) {
-		PrintError(FnName, "r->profile", "Could not allocate memory", Exit, MallocMemory);
+	if(READ_PROFILE_MAX_LENGTH < readLength) {
+		PrintError(FnName, "readLength", "Read length is too large", Exit, OutOfRange);
 	}
+	ReadInitialize(r);
+	r->length = readLength;
 }
 
 void ReadFree(Read *r)
 {
-	free(r->profile);
 	ReadInitialize(r);
 }
 
@@ -1339,7 +1990,7 @@ void ReadPrint(Read *r, FILE *fp)
 {
 	int i;
 	for(i=0;i<r->length;i++) {
-		fprintf(fp, "%1d", r->profile[i]);
+		fprintf(fp, "%1d", (int)READ_PROFILE_GET(r, i));
 	}
 	fprintf(fp, "\n");
 }
@@ -5,14 +5,78 @@
 
 #define RGINDEXACCURACY_MIN_PERCENT_FOUND 95
 #define RGINDEXACCURACY_NUM_TO_SAMPLE 100000 
+#define RGINDEXACCURACY_SEED 1
+#define RGINDEXACCURACY_EXACT_MAX_WIDTH 63
+#define RGINDEXACCURACY_EXACT_MIN_CAPACITY 1024
+#define RGINDEXACCURACY_EXACT_EMPTY (~((uint64_t)0))
+
+/* Random streams */
+#define RGINDEXACCURACY_MASK_STREAM (((uint64_t)1) << 63)
+#define RGINDEXACCURACY_EVENT_STREAM(_space, _indelType, _insertionLength, _numColorErrors, _numSNPs) \
+	((((uint64_t)(_space)) << 56) | (((uint64_t)(_indelType)) << 48) | (((uint64_t)(_insertionLength)) << 32) | \
+	 (((uint64_t)(_numColorErrors)) << 16) | ((uint64_t)(_numSNPs)))
+
+/* Read profile bits */
+#define READ_PROFILE_GET(_r, _i) (((_r)->profile[(_i) >> 6] >> ((_i) & 63)) & 1)
+#define READ_PROFILE_SET(_r, _i) ((_r)->profile[(_i) >> 6] |= (((uint64_t)1) << ((_i) & 63)))
+
+typedef struct {
+	RGIndexAccuracySet *set;
+	int readLength;
+	int startSample;
+	int endSample;
+	int numSNPs;
+	int numColorErrors;
+	int indelType;
+	int insertionLength;
+	int space;
+	uint64_t seed;
+	int32_t numCorrect;
+	int threadID;
+} GetNumCorrectThreadData;
+
+typedef struct {
+	RGIndexAccuracySet *set;
+	RGIndexAccuracy *candidates;
+	int startIndex;
+	int endIndex;
+	int readLength;
+	int numEventsToSample;
+	int space;
+	int maxNumMismatches;
+	int maxNumColorErrors;
+	int accuracyThreshold;
+	uint64_t seed;
+	int exact;
+	/* Best candidate in this block */
+	int bestIndex;
+	AccuracyProfile bestP;
+	int threadID;
+} RGIndexAccuracySearchThreadData;
+
+/* Probabilities of patterns of unindexable bases, for the exact accuracy */
+typedef struct {
+	uint64_t *keys;
+	double *counts;
+	int32_t numCounts;
+	int64_t size;
+	int64_t capacity;
+} RGIndexAccuracyExactTable;
 
 /* Functions */
-void RunSearchForRGIndexAccuracies(int, int, int, int, int, int, int, int, int, int);
-void RunEvaluateRGIndexAccuracies(char*, int, int, int, int, int, int);
-void RunEvaluateRGIndexAccuraciesNTSpace(RGIndexAccuracySet*, int, int, int, int);
-void RunEvaluateRGIndexAccuraciesColorSpace(RGIndexAccuracySet*, int, int, int, int, int);
-int32_t RunEvaluteRGIndexes(RGIndexAccuracySet*, int, int, int);
-int32_t GetNumCorrect(RGIndexAccuracySet*, int, int, int, int, int, int, int);
+void RunSearchForRGIndexAccuracies(int, int, int, int, int, int, int, int, int, int, uint64_t, int, int);
+void *RGIndexAccuracySearchThread(void*);
+void RunEvaluateRGIndexAccuracies(char*, int, int, int, int, int, int, uint64_t, int, int);
+void RunEvaluateRGIndexAccuraciesNTSpace(RGIndexAccuracySet*, int, int, int, int, uint64_t, int, int);
+void RunEvaluateRGIndexAccuraciesColorSpace(RGIndexAccuracySet*, int, int, int, int, int, uint64_t, int, int);
+int32_t RunEvaluateRGIndexes(RGIndexAccuracySet*, int, int, int, uint64_t, int);
+int32_t GetNumCorrect(RGIndexAccuracySet*, int, int, int, int, int, int, int, uint64_t, int);
+void *GetNumCorrectThread(void*);
+int32_t GetNumCorrectSample(RGIndexAccuracySet*, int, int, int, int, int, int, int, uint64_t);
+/* Random numbers */
+uint64_t RGIndexAccuracyRandom(uint64_t*);
+int32_t RGIndexAccuracyRandomInt(uint64_t*, int32_t);
+uint64_t RGIndexAccuracyRandomSeed(uint64_t, uint64_t, uint64_t);
 /* RGIndexAccuracyMismatchProfile */
 void RGIndexAccuracyMismatchProfileInitialize(RGIndexAccuracyMismatchProfile*);
 void RGIndexAccuracyMismatchProfileAdd(RGIndexAccuracyMismatchProfile*, RGIndexAccuracySet*, int32_t, int32_t);
@@ -25,6 +89,7 @@ int32_t RGIndexAccuracySetCheckRead(RGIndexAccuracySet*, Read*);
 void RGIndexAccuracySetPush(RGIndexAccuracySet*, RGIndexAccuracy*);
 void RGIndexAccuracySetPop(RGIndexAccuracySet*);
 void RGIndexAccuracySetSeed(RGIndexAccuracySet*, int);
+void RGIndexAccuracySetCopy(RGIndexAccuracySet*, RGIndexAccuracySet*);
 void RGIndexAccuracySetInitialize(RGIndexAccuracySet*);
 void RGIndexAccuracySetFree(RGIndexAccuracySet*);
 void RGIndexAccuracySetPrint(RGIndexAccuracySet*, FILE*);
@@ -36,7 +101,7 @@ void RGIndexAccuracySetCopyFromRGIndex(RGIndexAccuracySet*, RGIndex*);
 int RGIndexAccuracyCompare(RGIndexAccuracy*, RGIndexAccuracy*);
 int32_t RGIndexAccuracyCheckRead(RGIndexAccuracy*, Read*);
 void RGIndexAccuracyCopy(RGIndexAccuracy*, RGIndexAccuracy*);
-void RGIndexAccuracyGetRandom(RGIndexAccuracy*, int, int);
+void RGIndexAccuracyGetRandom(RGIndexAccuracy*, int, int, uint64_t*);
 void RGIndexAccuracyAllocate(RGIndexAccuracy*, int, int);
 void RGIndexAccuracyInitialize(RGIndexAccuracy*);
 void RGIndexAccuracyFree(RGIndexAccuracy*);
@@ -44,14 +109,26 @@ void RGIndexAccuracyPrint(RGIndexAccuracy*, FILE*);
 int RGIndexAccuracyRead(RGIndexAccuracy*, FILE*);
 void RGIndexAccuracyCopyFrom(RGIndexAccuracy*, RGIndex*, int32_t);
 /* Accuracy Profile functions */
-int AccuracyProfileCompare(RGIndexAccuracySet*, AccuracyProfile*, RGIndexAccuracySet*, AccuracyProfile*, int, int, int, int, int, int);
+int AccuracyProfileCompare(RGIndexAccuracySet*, AccuracyProfile*, RGIndexAccuracySet*, AccuracyProfile*, int, int, int, int, int, int, uint64_t, int, int);
+void AccuracyProfileGetExact(AccuracyProfile*, RGIndexAccuracySet*, int, int);
+double RGIndexAccuracyBinomial(int, int);
+void RGIndexAccuracyExactTableInitialize(RGIndexAccuracyExactTable*, int32_t);
+double *RGIndexAccuracyExactTableAdd(RGIndexAccuracyExactTable*, uint64_t);
+double *RGIndexAccuracyExactTableGet(RGIndexAccuracyExactTable*, int64_t);
+uint64_t RGIndexAccuracyExactTableHash(uint64_t);
+void RGIndexAccuracyExactTableResize(RGIndexAccuracyExactTable*, int64_t);
+void RGIndexAccuracyExactTableClear(RGIndexAccuracyExactTable*);
+void RGIndexAccuracyExactTableFree(RGIndexAccuracyExactTable*);
 void AccuracyProfileCopy(AccuracyProfile*, AccuracyProfile*);
 void AccuracyProfileAllocate(AccuracyProfile*, int, int, int);
 void AccuracyProfileInitialize(AccuracyProfile*);
 void AccuracyProfileFree(AccuracyProfile*);
 /* Read functions */
 void ReadSplit(Read*, Read*, Read*, int, int);
-void ReadGetRandom(Read*, int, int, int, int);
+void ReadCopyProfile(Read*, Read*, int);
+uint64_t ReadGetProfileWord(Read*, int);
+void ReadGetRandom(Read*, int, int, int, int, uint64_t*);
+void ReadGetColors(uint8_t*, int, uint8_t*);
 void ReadInitialize(Read*);
 void ReadAllocate(Read*, int);
 void ReadFree(Read*);
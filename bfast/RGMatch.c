@@ -1,6 +1,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <assert.h>
+#include <limits.h>
 #include <math.h>
 #include <sys/types.h>
 #include <string.h>
@@ -15,7 +16,7 @@ int32_t RGMatchRead(gzFile fp,
 		RGMatch *m)
 {
 	char *FnName = "RGMatchRead";
-	int32_t i, numEntries;
+	int32_t numEntries;
 
 	/* Read in the read length */
 	if(gzread64(fp, &m->readLength, sizeof(int32_t))!=sizeof(int32_t)||
@@ -72,10 +73,8 @@ int32_t RGMatchRead(gzFile fp,
 	if(gzread64(fp, m->strands, sizeof(char)*m->numEntries)!=sizeof(char)*m->numEntries) {
 		PrintError(FnName, "m->strands", "Could not read in strand", Exit, ReadFileError);
 	}
-	for(i=0;i<m->numEntries;i++) {
-		if(gzread64(fp, m->masks[i], sizeof(char)*GETMASKNUMBYTES(m))!=sizeof(char)*GETMASKNUMBYTES(m)) {
-			PrintError(FnName, "m->masks[i]", "Could not read in mask", Exit, ReadFileError);
-		}
+	if(gzread64(fp, m->masks, sizeof(char)*GETMASKNUMBYTES(m)*m->numEntries)!=sizeof(char)*GETMASKNUMBYTES(m)*m->numEntries) {
+		PrintError(FnName, "m->masks", "Could not read in masks", Exit, ReadFileError);
 	}
 
 	return 1;
@@ -90,6 +89,7 @@ int32_t RGMatchReadText(FILE *fp,
 	char read[SEQUENCE_LENGTH]="\0";
 	char qual[SEQUENCE_LENGTH]="\0";
 	char mask[SEQUENCE_LENGTH]="\0";
+	char *curMask=NULL;
 
 	/* Read the read and qual */
 	if(fscanf(fp, "%s %s",
@@ -137,8 +137,9 @@ int32_t RGMatchReadText(FILE *fp,
 					mask)==EOF) {
 			PrintError(FnName, NULL, "Could not read in match", Exit, EndOfFile);
 		}
-		free(m->masks[i]); // since we reallocated
-		m->masks[i] = RGMatchStringToMask(mask, m->readLength);
+		curMask = RGMatchStringToMask(mask, m->readLength);
+		memcpy(GETMASK(m, i), curMask, sizeof(char)*GETMASKNUMBYTES(m));
+		free(curMask);
 	}
 
 	return 1;
@@ -152,7 +153,6 @@ void RGMatchPrint(gzFile fp,
 	assert(fp!=NULL);
 	assert(m->readLength > 0);
 	assert(m->qualLength > 0);
-	int32_t i;
 
 	/* Print the matches to the output file */
 	/* Print read length, read, maximum reached, and number of entries. */
@@ -171,10 +171,8 @@ void RGMatchPrint(gzFile fp,
 			gzwrite64(fp, m->strands, sizeof(char)*m->numEntries)!=sizeof(char)*m->numEntries) {
 		PrintError(FnName, NULL, "Could not write contigs, positions and strands", Exit, WriteFileError);
 	}
-	for(i=0;i<m->numEntries;i++) {
-		if(gzwrite64(fp, m->masks[i], sizeof(char)*GETMASKNUMBYTES(m))!=sizeof(char)*GETMASKNUMBYTES(m)) {
-			PrintError(FnName, NULL, "Could not write masks[i]", Exit, WriteFileError);
-		}
+	if(gzwrite64(fp, m->masks, sizeof(char)*GETMASKNUMBYTES(m)*m->numEntries)!=sizeof(char)*GETMASKNUMBYTES(m)*m->numEntries) {
+		PrintError(FnName, NULL, "Could not write masks", Exit, WriteFileError);
 	}
 }
 
@@ -200,7 +198,7 @@ void RGMatchPrintText(FILE *fp,
 
 	for(i=0;i<m->numEntries;i++) {
 		assert(m->contigs[i] > 0);
-		maskString=RGMatchMaskToString(m->masks[i], m->readLength);
+		maskString=RGMatchMaskToString(GETMASK(m, i), m->readLength);
 		if(0 > fprintf(fp, "\t%u\t%d\t%c\t%s",
 					m->contigs[i],
 					m->positions[i],
@@ -235,11 +233,17 @@ void RGMatchPrintFastq(FILE *fp,
 }
 
 /* TODO */
+/* Only the entries appended since the last call are sorted, and are then
+ * merged with the entries that were already sorted */
 void RGMatchRemoveDuplicates(RGMatch *m,
 		int32_t maxNumMatches)
 {
-	int32_t i;
-	int32_t prevIndex=0;
+	char *FnName="RGMatchRemoveDuplicates";
+	int32_t i, j, cur, numBytes, numSorted, numNew;
+	uint64_t curKey, prevKey=0;
+	uint64_t *keys=NULL;
+	int32_t *order=NULL;
+	RGMatch sorted;
 
 	/* Check to see if the max has been reached.  If so free all matches and return.
 	 * We should remove duplicates before checking against maxNumMatches. */
@@ -250,31 +254,94 @@ void RGMatchRemoveDuplicates(RGMatch *m,
 	}
 
 	if(m->numEntries > 0) {
-
-		/* Quick sort the data structure */
-		RGMatchQuickSort(m, 0, m->numEntries-1);
-
-		/* Remove duplicates */
-		prevIndex=0;
-		for(i=1;i<m->numEntries;i++) {
-			if(RGMatchCompareAtIndex(m, prevIndex, m, i)==0) {
-				/* union of masks */
-				RGMatchUnionMasks(m, prevIndex, i);
-				RGMatchUnionOffsets(m, prevIndex, i);
+		numBytes = GETMASKNUMBYTES(m);
+		numSorted = m->numSorted;
+		numNew = m->numEntries - numSorted;
+		assert(0 <= numSorted && 0 <= numNew);
+
+		if(0 < numNew) {
+			/* Sort the new entries by key */
+			keys = malloc(sizeof(uint64_t)*numNew);
+			if(NULL == keys) {
+				PrintError(FnName, "keys", "Could not allocate memory", Exit, MallocMemory);
 			}
-			else {
-				prevIndex++;
-				/* Copy to prevIndex (incremented) */
-				RGMatchCopyAtIndex(m, prevIndex, m, i);
+			order = malloc(sizeof(int32_t)*numNew);
+			if(NULL == order) {
+				PrintError(FnName, "order", "Could not allocate memory", Exit, MallocMemory);
 			}
-		}
+			for(i=0;i<numNew;i++) {
+				assert(m->contigs[numSorted+i] <= INT_MAX);
+				keys[i] = GETMATCHKEY(m, numSorted+i);
+				order[i] = numSorted+i;
+			}
+			RGMatchSortKeys(keys, order, numNew);
+
+			/* Gather the sorted and new entries in order, removing duplicates */
+			RGMatchInitialize(&sorted);
+			sorted.readLength = m->readLength;
+			RGMatchAllocate(&sorted, m->numEntries);
+			if(NULL != m->offsetsStart) {
+				RGMatchAllocateOffsets(&sorted);
+				RGMatchReallocateOffsets(&sorted, m->offsetsStart[m->numEntries]);
+			}
+			sorted.numEntries = 0;
+			for(i=j=0;i<numSorted || j<numNew;) {
+				if(j == numNew || (i < numSorted && GETMATCHKEY(m, i) <= keys[j])) {
+					cur = i;
+					curKey = GETMATCHKEY(m, i);
+					i++;
+				}
+				else {
+					cur = order[j];
+					curKey = keys[j];
+					j++;
+				}
+				if(0 == sorted.numEntries || curKey != prevKey) {
+					sorted.contigs[sorted.numEntries] = m->contigs[cur];
+					sorted.positions[sorted.numEntries] = m->positions[cur];
+					sorted.strands[sorted.numEntries] = m->strands[cur];
+					memcpy(GETMASK(&sorted, sorted.numEntries), GETMASK(m, cur), sizeof(char)*numBytes);
+					sorted.numEntries++;
+					if(NULL != m->offsetsStart) {
+						sorted.offsetsStart[sorted.numEntries] = sorted.offsetsStart[sorted.numEntries-1];
+					}
+				}
+				else {
+					/* union of masks */
+					RGMatchUnionMasks(GETMASK(&sorted, sorted.numEntries-1), GETMASK(m, cur), numBytes);
+				}
+				/* union of offsets */
+				if(NULL != m->offsetsStart && 0 < GETNUMOFFSETS(m, cur)) {
+					memcpy(sorted.offsets + sorted.offsetsStart[sorted.numEntries], 
+							GETOFFSETS(m, cur), 
+							sizeof(int32_t)*GETNUMOFFSETS(m, cur));
+					sorted.offsetsStart[sorted.numEntries] += GETNUMOFFSETS(m, cur);
+				}
+				prevKey = curKey;
+			}
+			free(keys);
+			keys=NULL;
+			free(order);
+			order=NULL;
 
-		/* Reallocate pair */
-		/* does not make sense if there are no entries */
-		RGMatchReallocate(m, prevIndex+1);
+			/* Swap in the gathered entries, keeping the read */
+			RGMatchClearMatches(m);
+			m->numEntries = sorted.numEntries;
+			m->contigs = sorted.contigs;
+			m->positions = sorted.positions;
+			m->strands = sorted.strands;
+			m->masks = sorted.masks;
+			m->offsetsStart = sorted.offsetsStart;
+			m->offsets = sorted.offsets;
+
+			/* Reallocate pair */
+			/* does not make sense if there are no entries */
+			RGMatchReallocate(m, m->numEntries);
+			m->numSorted = m->numEntries;
+		}
 
 		/* Check to see if we have too many matches */
-		if(NULL == m->offsets && maxNumMatches < m->numEntries) {
+		if(NULL == m->offsetsStart && maxNumMatches < m->numEntries) {
 			/* Clear the entries but don't free the read */
 			RGMatchClearMatches(m);
 			m->maxReached = -1;
@@ -283,121 +350,79 @@ void RGMatchRemoveDuplicates(RGMatch *m,
 }
 
 /* TODO */
-void RGMatchQuickSort(RGMatch *m, int32_t low, int32_t high)
+/* Sorts the keys, moving order along with them.  Uses insertion sort for 
+ * a few keys and a LSD radix sort otherwise, skipping any digits that are
+ * the same for all keys */
+void RGMatchSortKeys(uint64_t *keys, int32_t *order, int32_t numKeys)
 {
-	int32_t i;
-	int32_t pivot=-1;
-	RGMatch *temp=NULL;
-
-
-	if(low < high) {
-
-		if(high - low + 1 <= RGMATCH_SHELL_SORT_MAX) {
-			RGMatchShellSort(m, low, high);
-			return;
-		}
-
-		/* Allocate memory for the temp used for swapping */
-		temp=malloc(sizeof(RGMatch));
-		if(NULL == temp) {
-			PrintError("RGMatchQuickSort", "temp", "Could not allocate memory", Exit, MallocMemory);
-		}
-		RGMatchInitialize(temp);
-		temp->readLength = m->readLength;
-		RGMatchAllocate(temp, 1);
-		if(NULL != m->offsets) {
-			temp->numOffsets = malloc(sizeof(int32_t));
-			if(NULL == temp->numOffsets) {
-				PrintError("RGMatchQuickSort", "temp->numOffsets", "Could not allocate memory", Exit, MallocMemory);
+	char *FnName="RGMatchSortKeys";
+	int32_t i, j, shift, curOrder;
+	uint64_t curKey, digitMask;
+	int32_t counts[1 << RGMATCH_RADIX_BITS];
+	uint64_t *srcKeys=NULL, *destKeys=NULL, *tmpKeys=NULL;
+	int32_t *srcOrder=NULL, *destOrder=NULL, *tmpOrder=NULL;
+
+	if(numKeys <= RGMATCH_INSERTION_SORT_MAX) {
+		for(i=1;i<numKeys;i++) {
+			curKey = keys[i];
+			curOrder = order[i];
+			for(j=i;0 < j && curKey < keys[j-1];j--) {
+				keys[j] = keys[j-1];
+				order[j] = order[j-1];
 			}
-			temp->numOffsets[0]=0;
-			temp->offsets = malloc(sizeof(int32_t*)); // include offsets just in case
-			if(NULL == temp->offsets) {
-				PrintError("RGMatchQuickSort", "temp->offsets", "Could not allocate memory", Exit, MallocMemory);
-			}
-			temp->offsets[0]=NULL;
+			keys[j] = curKey;
+			order[j] = curOrder;
 		}
+		return;
+	}
 
-		pivot = (low+high)/2;
-
-		RGMatchCopyAtIndex(temp, 0, m, pivot);
-		RGMatchCopyAtIndex(m, pivot, m, high);
-		RGMatchCopyAtIndex(m, high, temp, 0);
-
-		pivot = low;
-
-		for(i=low;i<high;i++) {
-			if(RGMatchCompareAtIndex(m, i, m, high) <= 0) {
-				if(i!=pivot) {
-					RGMatchCopyAtIndex(temp, 0, m, i);
-					RGMatchCopyAtIndex(m, i, m, pivot);
-					RGMatchCopyAtIndex(m, pivot, temp, 0);
-				}
-				pivot++;
-			}
-		}
-		RGMatchCopyAtIndex(temp, 0, m, pivot);
-		RGMatchCopyAtIndex(m, pivot, m, high);
-		RGMatchCopyAtIndex(m, high, temp, 0);
-
-		/* Free temp before the recursive call, otherwise we have a worst
-		 * case of O(n) space (NOT IN PLACE) 
-		 * */
-		RGMatchFree(temp);
-		free(temp);
-		temp=NULL;
-
-		RGMatchQuickSort(m, low, pivot-1);
-		RGMatchQuickSort(m, pivot+1, high);
+	tmpKeys = malloc(sizeof(uint64_t)*numKeys);
+	if(NULL == tmpKeys) {
+		PrintError(FnName, "tmpKeys", "Could not allocate memory", Exit, MallocMemory);
+	}
+	tmpOrder = malloc(sizeof(int32_t)*numKeys);
+	if(NULL == tmpOrder) {
+		PrintError(FnName, "tmpOrder", "Could not allocate memory", Exit, MallocMemory);
 	}
-}
 
-/* TODO */
-void RGMatchShellSort(RGMatch *m, int32_t low, int32_t high)
-{
-	char *FnName="RGMatchShellSort";
-	int32_t i, j, inc;
-	RGMatch *temp=NULL;
-
-	inc = ROUND((high - low + 1) / 2);
-
-	/* Allocate memory for the temp used for swapping */
-	temp=malloc(sizeof(RGMatch));
-	if(NULL == temp) {
-		PrintError(FnName, "temp", "Could not allocate memory", Exit, MallocMemory);
-	}
-	RGMatchInitialize(temp);
-	temp->readLength = m->readLength;
-	RGMatchAllocate(temp, 1);
-	if(NULL != m->offsets) {
-		temp->numOffsets = malloc(sizeof(int32_t));
-		if(NULL == temp->numOffsets) {
-			PrintError("RGMatchQuickSort", "temp->numOffsets", "Could not allocate memory", Exit, MallocMemory);
+	digitMask = (1 << RGMATCH_RADIX_BITS) - 1;
+	srcKeys = keys; srcOrder = order;
+	destKeys = tmpKeys; destOrder = tmpOrder;
+	for(shift=0;shift<64;shift+=RGMATCH_RADIX_BITS) {
+		for(i=0;i<(1 << RGMATCH_RADIX_BITS);i++) {
+			counts[i] = 0;
 		}
-		temp->numOffsets[0]=0;
-		temp->offsets = malloc(sizeof(int32_t*)); // include offsets just in case
-		if(NULL == temp->offsets) {
-			PrintError("RGMatchQuickSort", "temp->offsets", "Could not allocate memory", Exit, MallocMemory);
+		for(i=0;i<numKeys;i++) {
+			counts[(srcKeys[i] >> shift) & digitMask]++;
 		}
-		temp->offsets[0]=NULL;
-	}
-
-	while(0 < inc) {
-		for(i=inc + low;i<=high;i++) {
-			RGMatchCopyAtIndex(temp, 0, m, i);
-			j = i;
-			while(inc + low <= j && RGMatchCompareAtIndex(temp, 0, m, j - inc) < 0) {
-				RGMatchCopyAtIndex(m, j, m, j - inc);
-				j -= inc;
-			}
-			RGMatchCopyAtIndex(m, j, temp, 0);
+		if(numKeys == counts[(srcKeys[0] >> shift) & digitMask]) {
+			continue;
+		}
+		/* Get where each digit starts */
+		for(i=j=0;i<(1 << RGMATCH_RADIX_BITS);i++) {
+			curOrder = counts[i];
+			counts[i] = j;
+			j += curOrder;
 		}
-		inc = ROUND(inc / SHELL_SORT_GAP_DIVIDE_BY);
+		for(i=0;i<numKeys;i++) {
+			j = counts[(srcKeys[i] >> shift) & digitMask]++;
+			destKeys[j] = srcKeys[i];
+			destOrder[j] = srcOrder[i];
+		}
+		/* Swap */
+		tmpKeys = srcKeys; srcKeys = destKeys; destKeys = tmpKeys;
+		tmpOrder = srcOrder; srcOrder = destOrder; destOrder = tmpOrder;
+	}
+	if(srcKeys != keys) {
+		memcpy(keys, srcKeys, sizeof(uint64_t)*numKeys);
+		memcpy(order, srcOrder, sizeof(int32_t)*numKeys);
+		free(srcKeys);
+		free(srcOrder);
+	}
+	else {
+		free(destKeys);
+		free(destOrder);
 	}
-
-	RGMatchFree(temp);
-	free(temp);
-	temp=NULL;
 }
 
 /* TODO */
@@ -421,7 +446,7 @@ int32_t RGMatchCompareAtIndex(RGMatch *mOne, int32_t indexOne, RGMatch *mTwo, in
 void RGMatchAppend(RGMatch *dest, RGMatch *src)
 {
 	char *FnName = "RGMatchAppend";
-	int32_t i, start;
+	int32_t start;
 
 	/* Make sure we are not appending to ourselves */
 	assert(src != dest);
@@ -458,26 +483,12 @@ void RGMatchAppend(RGMatch *dest, RGMatch *src)
 		assert(start <= dest->numEntries);
 
 		// Must allocate if we had no entries
-		if(0 == start && NULL != src->offsets && NULL == dest->offsets) {
-			dest->numOffsets = malloc(sizeof(int32_t)*dest->numEntries);
-			if(NULL == dest->numOffsets) {
-				PrintError(FnName, "dest->numOffsets", "Could not allocate memory", Exit, MallocMemory);
-			}
-			dest->offsets = malloc(sizeof(int32_t*)*dest->numEntries);
-			if(NULL == dest->offsets) {
-				PrintError(FnName, "dest->offsets", "Could not allocate memory", Exit, MallocMemory);
-			}
-			// initialize
-			for(i=0;i<dest->numEntries;i++) {
-				dest->numOffsets[i] = 0;
-				dest->offsets[i] = NULL;
-			}
+		if(0 == start && NULL != src->offsetsStart && NULL == dest->offsetsStart) {
+			RGMatchAllocateOffsets(dest);
 		}
 
 		/* Copy over the entries */
-		for(i=start;i<dest->numEntries;i++) {
-			RGMatchCopyAtIndex(dest, i, src, i-start);
-		}
+		RGMatchCopyEntries(dest, start, src);
 	}
 	else {
 		/* Clear matches and set max reached flag */
@@ -486,43 +497,118 @@ void RGMatchAppend(RGMatch *dest, RGMatch *src)
 }
 
 /* TODO */
-void RGMatchCopyAtIndex(RGMatch *dest, int32_t destIndex, RGMatch *src, int32_t srcIndex)
+/* Same as calling RGMatchAppend with each src in turn, but the entries
+ * are reallocated only once */
+void RGMatchAppendAll(RGMatch *dest, RGMatch **srcs, int32_t numSrcs)
 {
-	char *FnName="RGMatchCopyAtIndex";
-	int32_t i;
-	assert(srcIndex >= 0 && srcIndex < src->numEntries);
-	assert(destIndex >= 0 && destIndex < dest->numEntries);
-
-	if(src != dest || srcIndex != destIndex) {
-		dest->positions[destIndex] = src->positions[srcIndex];
-		dest->contigs[destIndex] = src->contigs[srcIndex];
-		dest->strands[destIndex] = src->strands[srcIndex];
-		assert(GETMASKNUMBYTES(dest) == GETMASKNUMBYTES(src));
-		assert(NULL != dest->masks[destIndex]);
-		assert(NULL != src->masks[srcIndex]);
-		for(i=0;i<GETMASKNUMBYTES(dest);i++) {
-			dest->masks[destIndex][i] = src->masks[srcIndex][i];
+	char *FnName = "RGMatchAppendAll";
+	int32_t i, start, first, numEntries, hasOffsets;
+
+	assert(NULL != dest);
+	assert(0 < numSrcs);
+
+	/* Check to see if we need to copy over the read as well */
+	if(dest->readLength <= 0) {
+		assert(dest->read == NULL);
+		assert(dest->qual == NULL);
+		dest->readLength = srcs[0]->readLength;
+		dest->qualLength = srcs[0]->qualLength;
+		/* Allocate memory */
+		dest->read = malloc(sizeof(char)*(dest->readLength+1));
+		if(NULL==dest->read) {
+			PrintError(FnName, "dest->read", "Could not allocate memory", Exit, MallocMemory);
+		}   
+		dest->qual = malloc(sizeof(char)*(dest->qualLength+1));
+		if(NULL==dest->qual) {
+			PrintError(FnName, "dest->qual", "Could not allocate memory", Exit, MallocMemory);
+		}
+		/* Copy over */
+		strcpy(dest->read, srcs[0]->read);
+		strcpy(dest->qual, srcs[0]->qual);
+	}
+
+	if(dest->maxReached < 0) {
+		RGMatchClearMatches(dest);
+		return;
+	}
+
+	/* A src that reached the max clears everything appended before it */
+	for(i=first=0;i<numSrcs;i++) {
+		assert(srcs[i] != dest);
+		if(srcs[i]->maxReached < 0) {
+			first = i+1;
 		}
-		if(NULL != src->offsets) {
-			assert(NULL != dest->offsets);
-			free(dest->offsets[destIndex]);
-			dest->numOffsets[destIndex]=src->numOffsets[srcIndex];
-			dest->offsets[destIndex] = malloc(sizeof(int32_t)*dest->numOffsets[destIndex]);
-			if(NULL == dest->offsets[destIndex]) {
-				PrintError(FnName, "dest->offsets[destIndex]", "Could not allocate memory", Exit, MallocMemory);
+	}
+	if(0 < first) {
+		RGMatchClearMatches(dest);
+	}
+
+	/* Allocate memory for the entries */
+	start = numEntries = dest->numEntries;
+	for(i=first,hasOffsets=0;i<numSrcs;i++) {
+		numEntries += srcs[i]->numEntries;
+		if(NULL != srcs[i]->offsetsStart) {
+			hasOffsets = 1;
+		}
+	}
+	RGMatchReallocate(dest, numEntries);
+
+	// Must allocate if we had no entries
+	if(0 == start && 1 == hasOffsets && NULL == dest->offsetsStart && 0 < dest->numEntries) {
+		RGMatchAllocateOffsets(dest);
+	}
+
+	/* Copy over the entries */
+	for(i=first;i<numSrcs;i++) {
+		RGMatchCopyEntries(dest, start, srcs[i]);
+		start += srcs[i]->numEntries;
+	}
+	assert(start == dest->numEntries);
+}
+
+/* TODO */
+/* Copies all the entries of src into dest starting at destIndex.  The
+ * entries of dest from destIndex onwards must not have any offsets yet. */
+void RGMatchCopyEntries(RGMatch *dest, int32_t destIndex, RGMatch *src)
+{
+	int32_t i, numOffsets;
+	assert(src != dest);
+	assert(destIndex >= 0 && destIndex + src->numEntries <= dest->numEntries);
+	assert(GETMASKNUMBYTES(dest) == GETMASKNUMBYTES(src));
+
+	if(src->numEntries <= 0) {
+		return;
+	}
+	dest->numSorted = GETMIN(dest->numSorted, destIndex);
+
+	memcpy(dest->contigs + destIndex, src->contigs, sizeof(uint32_t)*src->numEntries);
+	memcpy(dest->positions + destIndex, src->positions, sizeof(int32_t)*src->numEntries);
+	memcpy(dest->strands + destIndex, src->strands, sizeof(char)*src->numEntries);
+	memcpy(GETMASK(dest, destIndex), src->masks, sizeof(char)*GETMASKNUMBYTES(src)*src->numEntries);
+
+	if(NULL != dest->offsetsStart) {
+		assert(dest->offsetsStart[destIndex] == dest->offsetsStart[dest->numEntries]);
+		numOffsets = (NULL == src->offsetsStart) ? 0 : src->offsetsStart[src->numEntries];
+		if(0 < numOffsets) {
+			RGMatchReallocateOffsets(dest, dest->offsetsStart[destIndex] + numOffsets);
+			memcpy(dest->offsets + dest->offsetsStart[destIndex], src->offsets, sizeof(int32_t)*numOffsets);
+			for(i=1;i<=src->numEntries;i++) {
+				dest->offsetsStart[destIndex+i] = dest->offsetsStart[destIndex] + src->offsetsStart[i];
 			}
-			for(i=0;i<src->numOffsets[srcIndex];i++) {
-				dest->offsets[destIndex][i] = src->offsets[srcIndex][i];
+			for(i=destIndex+src->numEntries+1;i<=dest->numEntries;i++) {
+				dest->offsetsStart[i] = dest->offsetsStart[destIndex+src->numEntries];
 			}
 		}
 	}
+	else {
+		assert(NULL == src->offsetsStart);
+	}
 }
 
 /* TODO */
 void RGMatchAllocate(RGMatch *m, int32_t numEntries)
 {
 	char *FnName = "RGMatchAllocate";
-	int32_t i;
 	assert(m->numEntries==0);
 	m->numEntries = numEntries;
 	assert(m->positions==NULL);
@@ -540,16 +626,50 @@ void RGMatchAllocate(RGMatch *m, int32_t numEntries)
 	if(NULL == m->strands) {
 		PrintError(FnName, "m->strands", "Could not allocate memory", Exit, MallocMemory);
 	}
-	m->masks = malloc(sizeof(char*)*numEntries); 
+	assert(m->masks==NULL);
+	m->masks = calloc(GETMASKNUMBYTES(m)*numEntries, sizeof(char)); 
 	if(NULL == m->masks) {
 		PrintError(FnName, "m->masks", "Could not allocate memory", Exit, MallocMemory);
 	}
-	for(i=0;i<m->numEntries;i++) {
-		m->masks[i] = calloc(GETMASKNUMBYTES(m), sizeof(char)); 
-		if(NULL == m->masks[i]) {
-			PrintError(FnName, "m->masks[i]", "Could not allocate memory", Exit, MallocMemory);
+}
+
+/* TODO */
+/* Gives each entry an empty list of offsets */
+void RGMatchAllocateOffsets(RGMatch *m)
+{
+	char *FnName = "RGMatchAllocateOffsets";
+	assert(NULL == m->offsetsStart);
+	assert(NULL == m->offsets);
+	m->offsetsStart = calloc(m->numEntries+1, sizeof(int32_t));
+	if(NULL == m->offsetsStart) {
+		PrintError(FnName, "m->offsetsStart", "Could not allocate memory", Exit, MallocMemory);
+	}
+}
+
+/* TODO */
+/* Resizes the offsets shared by all entries */
+void RGMatchReallocateOffsets(RGMatch *m, int32_t numOffsets)
+{
+	char *FnName = "RGMatchReallocateOffsets";
+	if(0 < numOffsets) {
+		m->offsets = realloc(m->offsets, sizeof(int32_t)*numOffsets);
+		if(NULL == m->offsets) {
+			PrintError(FnName, "m->offsets", "Could not reallocate memory", Exit, ReallocMemory);
 		}
 	}
+	else {
+		free(m->offsets);
+		m->offsets=NULL;
+	}
+}
+
+/* TODO */
+void RGMatchFreeOffsets(RGMatch *m)
+{
+	free(m->offsetsStart);
+	m->offsetsStart=NULL;
+	free(m->offsets);
+	m->offsets=NULL;
 }
 
 /* TODO */
@@ -560,6 +680,7 @@ void RGMatchReallocate(RGMatch *m, int32_t numEntries)
 	if(numEntries > 0) {
 		prevNumEntries = m->numEntries;
 		m->numEntries = numEntries;
+		m->numSorted = GETMIN(m->numSorted, numEntries);
 		m->positions = realloc(m->positions, sizeof(int32_t)*numEntries); 
 		if(numEntries > 0 && NULL == m->positions) {
 			/*
@@ -575,37 +696,22 @@ void RGMatchReallocate(RGMatch *m, int32_t numEntries)
 		if(numEntries > 0 && NULL == m->strands) {
 			PrintError(FnName, "m->strands", "Could not reallocate memory", Exit, ReallocMemory);
 		}
-		for(i=numEntries;i<prevNumEntries;i++) {
-			free(m->masks[i]);
-		}
-		m->masks = realloc(m->masks, sizeof(char*)*numEntries); 
+		m->masks = realloc(m->masks, sizeof(char)*GETMASKNUMBYTES(m)*numEntries); 
 		if(NULL == m->masks) {
 			PrintError(FnName, "m->masks", "Could not reallocate memory", Exit, ReallocMemory);
 		}
-		for(i=prevNumEntries;i<m->numEntries;i++) {
-			m->masks[i] = calloc(GETMASKNUMBYTES(m), sizeof(char)); 
-			if(NULL == m->masks[i]) {
-				PrintError(FnName, "m->masks[i]", "Could not allocate memory", Exit, MallocMemory);
-			}
+		if(prevNumEntries < numEntries) {
+			memset(GETMASK(m, prevNumEntries), 0, sizeof(char)*GETMASKNUMBYTES(m)*(numEntries - prevNumEntries));
 		}
-		if(NULL != m->offsets) {
-			for(i=numEntries;i<prevNumEntries;i++) {
-				free(m->offsets[i]);
-				m->offsets[i]=NULL;
-				m->numOffsets[i]=0;
+		if(NULL != m->offsetsStart) {
+			m->offsetsStart = realloc(m->offsetsStart, sizeof(int32_t)*(numEntries+1));
+			if(NULL == m->offsetsStart) {
+				PrintError(FnName, "m->offsetsStart", "Could not reallocate memory", Exit, ReallocMemory);
 			}
-			m->numOffsets = realloc(m->numOffsets, sizeof(int32_t)*numEntries);
-			if(NULL == m->numOffsets) {
-				PrintError(FnName, "m->numOffsets", "Could not allocate memory", Exit, MallocMemory);
-			}
-			m->offsets = realloc(m->offsets, sizeof(int32_t*)*numEntries);
-			if(NULL == m->offsets) {
-				PrintError(FnName, "m->offsets", "Could not allocate memory", Exit, MallocMemory);
-			}
-			for(i=prevNumEntries;i<m->numEntries;i++) {
-				m->numOffsets[i]=0;
-				m->offsets[i]=NULL;
+			for(i=prevNumEntries;i<numEntries;i++) {
+				m->offsetsStart[i+1] = m->offsetsStart[prevNumEntries];
 			}
+			RGMatchReallocateOffsets(m, m->offsetsStart[numEntries]);
 		}
 	}
 	else {
@@ -618,7 +724,6 @@ void RGMatchReallocate(RGMatch *m, int32_t numEntries)
 /* Does not free read */
 void RGMatchClearMatches(RGMatch *m) 
 {
-	int32_t i;
 	/* Free */
 	free(m->contigs);
 	free(m->positions);
@@ -626,45 +731,23 @@ void RGMatchClearMatches(RGMatch *m)
 	m->contigs=NULL;
 	m->positions=NULL;
 	m->strands=NULL;
-	for(i=0;i<m->numEntries;i++) {
-		free(m->masks[i]);
-	}
 	free(m->masks);
 	m->masks=NULL;
-	if(NULL != m->offsets) {
-		free(m->numOffsets);
-		m->numOffsets=NULL;
-		for(i=0;i<m->numEntries;i++) {
-			free(m->offsets[i]);
-		}
-		free(m->offsets);
-		m->offsets=NULL;
-	}
+	RGMatchFreeOffsets(m);
 	m->numEntries=0;
+	m->numSorted=0;
 }
 
 /* TODO */
 void RGMatchFree(RGMatch *m) 
 {
-	int32_t i;
 	free(m->read);
 	free(m->qual);
 	free(m->contigs);
 	free(m->positions);
 	free(m->strands);
-	for(i=0;i<m->numEntries;i++) {
-		free(m->masks[i]);
-	}
 	free(m->masks);
-	if(NULL != m->offsets) {
-		free(m->numOffsets);
-		m->numOffsets=NULL;
-		for(i=0;i<m->numEntries;i++) {
-			free(m->offsets[i]);
-		}
-		free(m->offsets);
-		m->offsets=NULL;
-	}
+	RGMatchFreeOffsets(m);
 	RGMatchInitialize(m);
 }
 
@@ -677,11 +760,12 @@ void RGMatchInitialize(RGMatch *m)
 	m->qual=NULL;
 	m->maxReached=0;
 	m->numEntries=0;
+	m->numSorted=0;
 	m->contigs=NULL;
 	m->positions=NULL;
 	m->strands=NULL;
 	m->masks=NULL;
-	m->numOffsets=NULL;
+	m->offsetsStart=NULL;
 	m->offsets=NULL;
 }
 
@@ -723,7 +807,7 @@ int32_t RGMatchCheck(RGMatch *m, RGBinary *rg)
 
 	/* Check mask */
 	for(i=0;i<m->numEntries;i++) {
-		char *mask = RGMatchMaskToString(m->masks[i], m->readLength);
+		char *mask = RGMatchMaskToString(GETMASK(m, i), m->readLength);
 		char reference[SEQUENCE_LENGTH]="\0";
 
 		if(m->strands[i] == FORWARD) {
@@ -925,28 +1009,99 @@ void RGMatchUpdateMask(char *mask, int32_t pos)
 	mask[curByte] |= (0x01 << curByteIndex);
 }
 
-void RGMatchUnionMasks(RGMatch *m, int32_t dest, int32_t src)
+/* ORs the src mask into the dest mask a word at a time */
+void RGMatchUnionMasks(char *dest, char *src, int32_t numBytes)
 {
 	int32_t i;
-	for(i=0;i<GETMASKNUMBYTES(m);i++) {
-		m->masks[dest][i] |= m->masks[src][i];
+	uint64_t destWord, srcWord;
+	for(i=0;i + (int32_t)sizeof(uint64_t) <= numBytes;i+=sizeof(uint64_t)) {
+		memcpy(&destWord, dest + i, sizeof(uint64_t));
+		memcpy(&srcWord, src + i, sizeof(uint64_t));
+		destWord |= srcWord;
+		memcpy(dest + i, &destWord, sizeof(uint64_t));
+	}
+	for(;i<numBytes;i++) {
+		dest[i] |= src[i];
 	}
 }
 
-void RGMatchUnionOffsets(RGMatch *m, int32_t dest, int32_t src)
+/* TODO */
+/* Keeps the matches whose keys (offsets) were not found too often across
+ * all bins, rebuilding their masks from the kept offsets */
+void RGMatchMergeIndexBinsFinalize(RGMatch *m,
+		RGIndex *index,
+		int32_t maxKeyMatches,
+		double keyMissFraction,
+		int32_t maxNumMatches)
 {
-	char *FnName="RGMatchUnionOffsets";
-	int32_t i, prevNumOffsets;
+	int32_t j, k, l, n;
+	int32_t numKeyMatches[SEQUENCE_LENGTH];
 
-	if(NULL == m->offsets) return;
+	RGMatchRemoveDuplicates(m, maxNumMatches);
 
-	prevNumOffsets=m->numOffsets[dest];
-	m->numOffsets[dest] += m->numOffsets[src];
-	m->offsets[dest] = realloc(m->offsets[dest], sizeof(int32_t)*m->numOffsets[dest]);
-	if(NULL == m->offsets[dest]) {
-		PrintError(FnName, "m->offsets[dest]", "Could not allocate memory", Exit, MallocMemory);
+	for(j=0;j<m->readLength;j++) { // initialize
+		numKeyMatches[j]=0;
+	}
+	for(j=0;j<m->numEntries;j++) { // count # of matches per offset
+		for(k=0;k<GETNUMOFFSETS(m, j);k++) {
+			numKeyMatches[GETOFFSETS(m, j)[k]]++;
+		}
 	}
-	for(i=0;i<m->numOffsets[src];i++) {
-		m->offsets[dest][i+prevNumOffsets] = m->offsets[src][i];
+	for(j=k=0;j<m->numEntries;j++) {
+		// Find any offset that is below the bound
+                                int keyMissCount = 0;
+		for(l=0;l<GETNUMOFFSETS(m, j);l++) {
+			if(numKeyMatches[GETOFFSETS(m, j)[l]] <= maxKeyMatches) {
+                                            keyMissCount++;
+                                            break;
+                                        }
+		}
+                                if(keyMissFraction < ((double)keyMissCount / GETNUMOFFSETS(m, j))) {
+                                    m->maxReached = -1;
+                                    k = 0; 
+                                    break;
+                                }
+                                else if(0 < keyMissCount) {
+                                        m->maxReached = (int)((double)255.0 * keyMissCount / GETNUMOFFSETS(m, j));
+			if(k != j) {
+				m->contigs[k] = m->contigs[j];
+				m->positions[k] = m->positions[j];
+				m->strands[k] = m->strands[j];
+			}
+			// Zero out mask
+			memset(GETMASK(m, k), 0, sizeof(char)*GETMASKNUMBYTES(m));
+			// Copy over masks based on kept offsets
+			for(l=0;l<GETNUMOFFSETS(m, j);l++) { // for each offset
+				if(numKeyMatches[GETOFFSETS(m, j)[l]] <= maxKeyMatches) {
+					// Add ot the mask
+					for(n=0;n<index->width;n++) {
+						if(FORWARD == m->strands[j]) {
+							if(1 == index->mask[n]) {
+								int32_t offset = GETOFFSETS(m, j)[l] + n; 
+								// Color space already adjusted
+								//if(ColorSpace == index->space) offset++;
+								RGMatchUpdateMask(GETMASK(m, k), offset); 
+							}
+						}
+						else {
+							if(1 == index->mask[index->width - n - 1]) {
+								int32_t offset = GETOFFSETS(m, j)[l] + n; 
+								// Color space already adjusted
+								//if(ColorSpace == index->space) offset--;
+								RGMatchUpdateMask(GETMASK(m, k), offset); 
+							}
+						}
+					}
+				}
+			}
+			k++;
+		}
 	}
+	// remove offsets
+	RGMatchFreeOffsets(m);
+	// reallocate
+	RGMatchReallocate(m, k); // important that k is preserved up to this point
+	// check if there were too many matches by removing duplicates
+	// this will also union the masks
+	RGMatchRemoveDuplicates(m, maxNumMatches);
 }
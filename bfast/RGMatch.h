@@ -11,12 +11,15 @@ void RGMatchPrint(gzFile, RGMatch*);
 void RGMatchPrintText(FILE*, RGMatch*);
 void RGMatchPrintFastq(FILE*, char*, RGMatch*);
 void RGMatchRemoveDuplicates(RGMatch*, int32_t);
-void RGMatchQuickSort(RGMatch*, int32_t, int32_t);
-void RGMatchShellSort(RGMatch*, int32_t, int32_t);
+void RGMatchSortKeys(uint64_t*, int32_t*, int32_t);
 int32_t RGMatchCompareAtIndex(RGMatch*, int32_t, RGMatch*, int32_t);
 void RGMatchAppend(RGMatch*, RGMatch*);
-void RGMatchCopyAtIndex(RGMatch*, int32_t, RGMatch*, int32_t);
+void RGMatchAppendAll(RGMatch*, RGMatch**, int32_t);
+void RGMatchCopyEntries(RGMatch*, int32_t, RGMatch*);
 void RGMatchAllocate(RGMatch*, int32_t);
+void RGMatchAllocateOffsets(RGMatch*);
+void RGMatchReallocateOffsets(RGMatch*, int32_t);
+void RGMatchFreeOffsets(RGMatch*);
 void RGMatchReallocate(RGMatch*, int32_t);
 void RGMatchClearMatches(RGMatch*);
 void RGMatchFree(RGMatch*);
@@ -26,8 +29,8 @@ void RGMatchFilterOutOfRange(RGMatch*, int32_t);
 char *RGMatchMaskToString(char*, int32_t);
 char *RGMatchStringToMask(char*, int32_t);
 void RGMatchUpdateMask(char*, int32_t);
-void RGMatchUnionMasks(RGMatch*, int32_t, int32_t);
-void RGMatchUnionOffsets(RGMatch*, int32_t, int32_t);
+void RGMatchUnionMasks(char*, char*, int32_t);
+void RGMatchMergeIndexBinsFinalize(RGMatch*, RGIndex*, int32_t, double, int32_t);
 
 #endif
 
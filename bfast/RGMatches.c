@@ -6,6 +6,7 @@
 #include <string.h>
 #include <time.h>
 #include <limits.h>
+#include <pthread.h>
 
 #include "BLibDefinitions.h"
 #include "BLib.h"
@@ -76,25 +77,18 @@ int32_t RGMatchesReadWithOffsets(gzFile fp,
 
 	/* Read each end */
 	for(i=0;i<m->numEnds;i++) {
-		m->ends[i].numOffsets = malloc(sizeof(int32_t)*m->ends[i].numEntries);
-		if(NULL == m->ends[i].numOffsets) {
-			PrintError(FnName, "numOffsets", "Could not allocate memory", Exit, MallocMemory);
-		}
-		m->ends[i].offsets = malloc(sizeof(int32_t*)*m->ends[i].numEntries);
-		if(NULL == m->ends[i].offsets) {
-			PrintError(FnName, "offsets", "Could not allocate memory", Exit, MallocMemory);
-		}
-		if(gzread64(fp, m->ends[i].numOffsets, sizeof(int32_t)*m->ends[i].numEntries) != sizeof(int32_t)*m->ends[i].numEntries) {
+		RGMatchAllocateOffsets(&m->ends[i]);
+		/* The number of offsets per entry are stored, so sum them to get
+		 * where each entry starts */
+		if(gzread64(fp, m->ends[i].offsetsStart + 1, sizeof(int32_t)*m->ends[i].numEntries) != sizeof(int32_t)*m->ends[i].numEntries) {
 			PrintError(FnName, "numOffsets", "Could not read from file", Exit, ReadFileError);
 		}
 		for(j=0;j<m->ends[i].numEntries;j++) {
-			m->ends[i].offsets[j] = malloc(sizeof(int32_t)*m->ends[i].numOffsets[j]);
-			if(NULL == m->ends[i].offsets[j]) {
-				PrintError(FnName, "offsets", "Could not allocate memory", Exit, MallocMemory);
-			}
-			if(gzread64(fp, m->ends[i].offsets[j], sizeof(int32_t)*m->ends[i].numOffsets[j]) != sizeof(int32_t)*m->ends[i].numOffsets[j]) {
-				PrintError(FnName, "offsets[j]", "Could not read from file", Exit, ReadFileError);
-			}
+			m->ends[i].offsetsStart[j+1] += m->ends[i].offsetsStart[j];
+		}
+		RGMatchReallocateOffsets(&m->ends[i], m->ends[i].offsetsStart[m->ends[i].numEntries]);
+		if(gzread64(fp, m->ends[i].offsets, sizeof(int32_t)*m->ends[i].offsetsStart[m->ends[i].numEntries]) != sizeof(int32_t)*m->ends[i].offsetsStart[m->ends[i].numEntries]) {
+			PrintError(FnName, "offsets", "Could not read from file", Exit, ReadFileError);
 		}
 	}
 
@@ -171,19 +165,29 @@ void RGMatchesPrintWithOffsets(gzFile fp,
 		RGMatches *m)
 {
 	char *FnName = "RGMatchesPrintWithOffsets";
-	int32_t i, j;
+	int32_t i, j, totalOffsets;
+	int32_t *numOffsets=NULL;
 	assert(fp!=NULL);
 
 	RGMatchesPrint(fp, m);
 
 	for(i=0;i<m->numEnds;i++) {
-		if(gzwrite64(fp, m->ends[i].numOffsets, sizeof(int32_t)*m->ends[i].numEntries) != sizeof(int32_t)*m->ends[i].numEntries) {
-			PrintError(FnName, "numOffsets", "Could not write to file", Exit, WriteFileError);
+		/* Store the number of offsets per entry */
+		numOffsets = malloc(sizeof(int32_t)*(m->ends[i].numEntries+1));
+		if(NULL == numOffsets) {
+			PrintError(FnName, "numOffsets", "Could not allocate memory", Exit, MallocMemory);
 		}
 		for(j=0;j<m->ends[i].numEntries;j++) {
-			if(gzwrite64(fp, m->ends[i].offsets[j], sizeof(int32_t)*m->ends[i].numOffsets[j]) != sizeof(int32_t)*m->ends[i].numOffsets[j]) {
-				PrintError(FnName, "offsets[j]", "Could not write to file", Exit, WriteFileError);
-			}
+			numOffsets[j] = GETNUMOFFSETS(&m->ends[i], j);
+		}
+		if(gzwrite64(fp, numOffsets, sizeof(int32_t)*m->ends[i].numEntries) != sizeof(int32_t)*m->ends[i].numEntries) {
+			PrintError(FnName, "numOffsets", "Could not write to file", Exit, WriteFileError);
+		}
+		free(numOffsets);
+		numOffsets=NULL;
+		totalOffsets = (NULL == m->ends[i].offsetsStart) ? 0 : m->ends[i].offsetsStart[m->ends[i].numEntries];
+		if(gzwrite64(fp, m->ends[i].offsets, sizeof(int32_t)*totalOffsets) != sizeof(int32_t)*totalOffsets) {
+			PrintError(FnName, "offsets", "Could not write to file", Exit, WriteFileError);
 		}
 	}
 }
@@ -246,105 +250,140 @@ int32_t RGMatchesMergeFilesAndOutput(gzFile *tempFPs,
 		int32_t numFiles,
 		gzFile outputFP,
 		int32_t maxNumMatches,
-		int32_t queueLength)
+		int32_t queueLength,
+		int32_t numThreads)
+{
+	return RGMatchesMergeBatches(tempFPs,
+			numFiles,
+			0,
+			outputFP,
+			NULL,
+			0,
+			0.0,
+			maxNumMatches,
+			queueLength,
+			numThreads);
+}
+
+/* TODO */
+/* Each file holds the same reads in the same order, so the matches for
+ * a read are found at the same index in every file.  A batch is read
+ * with one thread per file, merged read-by-read across numThreads
+ * threads, and then written in order while the next batch is being
+ * read.  If index is not NULL, the files are the bins of that index
+ * and were written with offsets.
+ * */
+int32_t RGMatchesMergeBatches(gzFile *tempFPs,
+		int32_t numFiles,
+		int32_t withOffsets,
+		gzFile outputFP,
+		RGIndex *index,
+		int32_t maxKeyMatches,
+		double keyMissFraction,
+		int32_t maxNumMatches,
+		int32_t queueLength,
+		int32_t numThreads)
 {
-	char *FnName="RGMatchesMergeFilesAndOutput";
-	int32_t i, j, k, minRead;
-	int32_t counter;
+	char *FnName="RGMatchesMergeBatches";
+	int32_t i, cur, errCode;
+	int32_t counter, numRead[2];
 	int32_t numMatches=0;
-	int32_t numFinished = 0;
-	RGMatches *matchQueue=NULL;
+	RGMatches *matchQueues[2]={NULL, NULL};
 	int32_t matchQueueLength = (queueLength / numFiles);
-	
+	ThreadRGMatchesReadData *readData=NULL;
+	ThreadRGMatchesMergeData *mergeData=NULL;
+	pthread_t *readThreads=NULL;
+	pthread_t *mergeThreads=NULL;
+	void *status=NULL;
+
 	if(matchQueueLength < 1) {
 		matchQueueLength = 1;
 	}
 
 	// Allocate
-	matchQueue = malloc(sizeof(RGMatches)*matchQueueLength*numFiles);
-	if(NULL == matchQueue) {
-		PrintError(FnName, "matchQueue", "Could not allocate memory", Exit, MallocMemory);
+	for(cur=0;cur<2;cur++) {
+		matchQueues[cur] = malloc(sizeof(RGMatches)*matchQueueLength*numFiles);
+		if(NULL == matchQueues[cur]) {
+			PrintError(FnName, "matchQueues[cur]", "Could not allocate memory", Exit, MallocMemory);
+		}
+		// Initialize
+		for(i=0;i<matchQueueLength*numFiles;i++) {
+			RGMatchesInitialize(&matchQueues[cur][i]);
+		}
 	}
-
-	// Initialize
-	for(i=0;i<matchQueueLength*numFiles;i++) {
-		RGMatchesInitialize(&matchQueue[i]);
+	readData = malloc(sizeof(ThreadRGMatchesReadData)*numFiles);
+	readThreads = malloc(sizeof(pthread_t)*numFiles);
+	mergeData = malloc(sizeof(ThreadRGMatchesMergeData)*numThreads);
+	mergeThreads = malloc(sizeof(pthread_t)*numThreads);
+	if(NULL == readData || NULL == readThreads || NULL == mergeData || NULL == mergeThreads) {
+		PrintError(FnName, "thread data", "Could not allocate memory", Exit, MallocMemory);
 	}
 
-	/* Read in each sequence/match one at a time */
+	/* Read in the first batch */
+	cur = 0;
 	counter = 0;
 	if(VERBOSE >=0) {
 		fputs("\r[0]", stderr);
 	}
-	while(0 == numFinished) {
-            // HERE
+	numRead[cur] = RGMatchesMergeBatchesRead(tempFPs, numFiles, withOffsets, matchQueues[cur], matchQueueLength, readData, readThreads, 0);
+
+	while(0 < numRead[cur]) {
 		if(VERBOSE >= 0) {
 			fprintf(stderr, "\r[%d]", counter);
 		}
 
-		// Read matchQueueLength matches for each file
-		minRead = -1;
-		for(i=j=k=0;i<numFiles;i++) {
-			for(j=0;j<matchQueueLength;j++,k++) {
-				assert(k < matchQueueLength*numFiles);
-				if(RGMatchesRead(tempFPs[i], &matchQueue[k])==EOF) {
-					if(minRead < 0) {
-						minRead = j;
-					}
-					else if(j != minRead) {
-						PrintError(FnName, "j != minRead", "Did not read in the correct # of entries", Exit, OutOfRange);
-					}
-					numFinished++;
-					break;
-				}
+		/* Merge */
+		for(i=0;i<numThreads;i++) {
+			mergeData[i].matchQueue = matchQueues[cur];
+			mergeData[i].matchQueueLength = matchQueueLength;
+			mergeData[i].numFiles = numFiles;
+			mergeData[i].numReads = numRead[cur];
+			mergeData[i].index = index;
+			mergeData[i].maxKeyMatches = maxKeyMatches;
+			mergeData[i].keyMissFraction = keyMissFraction;
+			mergeData[i].maxNumMatches = maxNumMatches;
+			mergeData[i].threadID = i;
+			mergeData[i].numThreads = numThreads;
+			mergeData[i].numMatches = 0;
+			errCode = pthread_create(&mergeThreads[i], NULL, RGMatchesMergeThread, &mergeData[i]);
+			if(0!=errCode) {
+				PrintError(FnName, "pthread_create: errCode", "Could not start thread", Exit, ThreadError);
 			}
 		}
-		if(minRead < 0) {
-			minRead = matchQueueLength;
-		}
-		// We must finish all at the same time
-		assert(numFinished == 0 || numFinished == numFiles);
-
-
-		// Merge
-		for(i=j=k=0;i<minRead;i++) {
-			k = minRead + i; // store in first minRead matches 
-			// Append
-			for(j=1;j<numFiles;j++,k+=minRead) {
-				if(0 != strcmp(matchQueue[i].readName, matchQueue[k].readName)) {
-					PrintError(FnName, NULL, "Read names do not match", Exit, OutOfRange);
-				}
-				RGMatchesAppend(&matchQueue[i], &matchQueue[k]); 
-				// Free
-				RGMatchesFree(&matchQueue[k]);
-			}
-			// Remove duplicates
-			RGMatchesRemoveDuplicates(&matchQueue[i], maxNumMatches);
-			// Count matches
-			for(j=0;j<matchQueue[i].numEnds;j++) {
-				if(0 < matchQueue[i].ends[j].numEntries) {
-					numMatches++;
-					break;
-				}
+		for(i=0;i<numThreads;i++) {
+			errCode = pthread_join(mergeThreads[i], &status);
+			if(0!=errCode) {
+				PrintError(FnName, "pthread_join: errCode", "Thread returned an error", Exit, ThreadError);
 			}
+			numMatches += mergeData[i].numMatches;
 		}
 
+		/* Start reading the next batch */
+		RGMatchesMergeBatchesRead(tempFPs, numFiles, withOffsets, matchQueues[1-cur], matchQueueLength, readData, readThreads, 1);
+
 		// Print
-		for(i=0;i<minRead;i++) {
-			RGMatchesPrint(outputFP, &matchQueue[i]);
+		for(i=0;i<numRead[cur];i++) {
+			RGMatchesPrint(outputFP, &matchQueues[cur][i]);
 		}
 
 		// Free rest in the queue
-		for(i=0;i<minRead;i++) {
-			RGMatchesFree(&matchQueue[i]);
+		for(i=0;i<numRead[cur];i++) {
+			RGMatchesFree(&matchQueues[cur][i]);
 		}
+		counter += numRead[cur];
 
-		counter += minRead;
-
+		/* Wait for the next batch */
+		cur = 1-cur;
+		numRead[cur] = RGMatchesMergeBatchesRead(tempFPs, numFiles, withOffsets, matchQueues[cur], matchQueueLength, readData, readThreads, 2);
 	}
 
 	// Free
-	free(matchQueue);
+	free(matchQueues[0]);
+	free(matchQueues[1]);
+	free(readData);
+	free(readThreads);
+	free(mergeData);
+	free(mergeThreads);
 
 	if(VERBOSE >=0) {
 		fprintf(stderr, "\r[%d]... completed.\n", counter);
@@ -353,6 +392,138 @@ int32_t RGMatchesMergeFilesAndOutput(gzFile *tempFPs,
 	return numMatches;
 }
 
+/* TODO */
+/* Reads the next batch with one thread per file.  Mode 0 starts and waits
+ * for the threads, mode 1 only starts them, and mode 2 only waits for them.
+ * Returns the number of reads in the batch when waiting. */
+int32_t RGMatchesMergeBatchesRead(gzFile *tempFPs,
+		int32_t numFiles,
+		int32_t withOffsets,
+		RGMatches *matchQueue,
+		int32_t matchQueueLength,
+		ThreadRGMatchesReadData *readData,
+		pthread_t *readThreads,
+		int32_t mode)
+{
+	char *FnName="RGMatchesMergeBatchesRead";
+	int32_t i, errCode;
+	void *status=NULL;
+
+	if(2 != mode) {
+		for(i=0;i<numFiles;i++) {
+			readData[i].fp = tempFPs[i];
+			readData[i].withOffsets = withOffsets;
+			readData[i].matchQueue = matchQueue + i*matchQueueLength;
+			readData[i].matchQueueLength = matchQueueLength;
+			readData[i].numRead = 0;
+			errCode = pthread_create(&readThreads[i], NULL, RGMatchesReadThread, &readData[i]);
+			if(0!=errCode) {
+				PrintError(FnName, "pthread_create: errCode", "Could not start thread", Exit, ThreadError);
+			}
+		}
+	}
+	if(1 == mode) {
+		return 0;
+	}
+
+	for(i=0;i<numFiles;i++) {
+		errCode = pthread_join(readThreads[i], &status);
+		if(0!=errCode) {
+			PrintError(FnName, "pthread_join: errCode", "Thread returned an error", Exit, ThreadError);
+		}
+	}
+	// We must finish all at the same time
+	for(i=1;i<numFiles;i++) {
+		if(readData[i].numRead != readData[0].numRead) {
+			PrintError(FnName, "readData[i].numRead", "Did not read in the correct # of entries", Exit, OutOfRange);
+		}
+	}
+	return readData[0].numRead;
+}
+
+/* TODO */
+void *RGMatchesReadThread(void *arg)
+{
+	ThreadRGMatchesReadData *data = (ThreadRGMatchesReadData*)arg;
+	int32_t i;
+
+	for(i=0;i<data->matchQueueLength;i++) {
+		RGMatchesInitialize(&data->matchQueue[i]);
+		if(EOF == ((1 == data->withOffsets) ? RGMatchesReadWithOffsets(data->fp, &data->matchQueue[i]) : RGMatchesRead(data->fp, &data->matchQueue[i]))) {
+			break;
+		}
+	}
+	data->numRead = i;
+
+	return arg;
+}
+
+/* TODO */
+void *RGMatchesMergeThread(void *arg)
+{
+	char *FnName="RGMatchesMergeThread";
+	ThreadRGMatchesMergeData *data = (ThreadRGMatchesMergeData*)arg;
+	RGMatches *matchQueue = data->matchQueue;
+	int32_t matchQueueLength = data->matchQueueLength;
+	int32_t numFiles = data->numFiles;
+	int32_t i, j;
+	RGMatches matches;
+	RGMatches **srcs=NULL;
+
+	srcs = malloc(sizeof(RGMatches*)*numFiles);
+	if(NULL == srcs) {
+		PrintError(FnName, "srcs", "Could not allocate memory", Exit, MallocMemory);
+	}
+
+	for(i=data->threadID;i<data->numReads;i+=data->numThreads) {
+		for(j=0;j<numFiles;j++) {
+			srcs[j] = &matchQueue[j*matchQueueLength + i];
+			if(0 != strcmp(srcs[0]->readName, srcs[j]->readName)) {
+				PrintError(FnName, NULL, "Read names do not match", Exit, OutOfRange);
+			}
+		}
+
+		if(NULL == data->index) {
+			// Append to the first file's matches
+			if(1 < numFiles) {
+				RGMatchesAppendAll(srcs[0], srcs+1, numFiles-1);
+			}
+			// Remove duplicates
+			RGMatchesRemoveDuplicates(srcs[0], data->maxNumMatches);
+			// Free
+			for(j=1;j<numFiles;j++) {
+				RGMatchesFree(srcs[j]);
+			}
+		}
+		else {
+			// Append each bin
+			RGMatchesInitialize(&matches);
+			RGMatchesAppendAll(&matches, srcs, numFiles);
+			for(j=0;j<numFiles;j++) {
+				RGMatchesFree(srcs[j]);
+			}
+			RGMatchesMergeIndexBinsFinalize(&matches,
+					data->index,
+					data->maxKeyMatches,
+					data->keyMissFraction,
+					data->maxNumMatches);
+			(*srcs[0]) = matches;
+		}
+
+		// Count matches
+		for(j=0;j<srcs[0]->numEnds;j++) {
+			if(0 < srcs[0]->ends[j].numEntries) {
+				data->numMatches++;
+				break;
+			}
+		}
+	}
+
+	free(srcs);
+
+	return arg;
+}
+
 /* TODO */
 void RGMatchesAppend(RGMatches *dest, RGMatches *src)
 {
@@ -396,6 +567,44 @@ void RGMatchesAppend(RGMatches *dest, RGMatches *src)
 	}
 }
 
+/* TODO */
+/* Same as calling RGMatchesAppend with each src in turn */
+void RGMatchesAppendAll(RGMatches *dest, RGMatches **srcs, int32_t numSrcs)
+{
+	char *FnName = "RGMatchesAppendAll";
+	int32_t i, j;
+	RGMatch **srcEnds=NULL;
+
+	assert(0 < numSrcs);
+
+	/* Check to see if we need to add in the read name */
+	if(dest->readNameLength <= 0) {
+		RGMatchesAppend(dest, srcs[0]);
+		srcs++;
+		numSrcs--;
+		if(0 == numSrcs) {
+			return;
+		}
+	}
+
+	srcEnds = malloc(sizeof(RGMatch*)*numSrcs);
+	if(NULL == srcEnds) {
+		PrintError(FnName, "srcEnds", "Could not allocate memory", Exit, MallocMemory);
+	}
+
+	/* Append the matches */
+	for(i=0;i<dest->numEnds;i++) {
+		for(j=0;j<numSrcs;j++) {
+			assert(srcs[j] != dest);
+			assert(srcs[j]->numEnds == dest->numEnds);
+			srcEnds[j] = &srcs[j]->ends[i];
+		}
+		RGMatchAppendAll(&dest->ends[i], srcEnds, numSrcs);
+	}
+
+	free(srcEnds);
+}
+
 /* TODO */
 void RGMatchesReallocate(RGMatches *m,
 		int32_t numEnds)
@@ -519,6 +728,8 @@ void RGMatchesMirrorPairedEnd(RGMatches *m,
 		for(i=0;i<m->ends[1].numEntries;i++) {
 			m->ends[1].positions[i] = GETMAX(1, GETMIN(m->ends[1].positions[i], rg->contigs[m->ends[1].contigs[i]-1].sequenceLength));
 		}
+		/* The adjusted entries may no longer be sorted */
+		m->ends[0].numSorted = m->ends[1].numSorted = 0;
 	}
 }
 
@@ -561,149 +772,37 @@ int32_t RGMatchesMergeIndexBins(gzFile *tempOutputIndexBinFPs,
 		RGIndex *index,
 		int32_t maxKeyMatches,
                 double keyMissFraction,
-		int32_t maxNumMatches) 
+		int32_t maxNumMatches,
+		int32_t queueLength,
+		int32_t numThreads) 
 {
-	char *FnName="RGMatchesMergeIndexBins";
-	int32_t i, j, k, l, m, numMatches=0;
-	int32_t counter;
-	RGMatches matches;
-	RGMatches tempMatches;
-	int32_t numFinished = 0;
-	int32_t numKeyMatches[SEQUENCE_LENGTH];
-
-	/* Initialize matches */
-	RGMatchesInitialize(&matches);
-	RGMatchesInitialize(&tempMatches);
-
-	/* Read in each sequence/match one at a time */
-	counter = 0;
-	if(VERBOSE >=0) {
-		fprintf(stderr, "\r[%d]", 0);
-	}
-	while(numFinished == 0) {
-		if(VERBOSE >=0 && counter%RGMATCH_MERGE_ROTATE_NUM == 0) {
-			fprintf(stderr, "\r[%d]", counter);
-		}
-		counter++;
-
-		/* Read matches for one read from each file */ 
-		for(i=0;i<numBins;i++) {
-			if(RGMatchesReadWithOffsets(tempOutputIndexBinFPs[i],
-						&tempMatches)==EOF) {
-				numFinished++;
-			}
-			else {
-				if(matches.readName != NULL &&
-						strcmp(matches.readName, tempMatches.readName)!=0) {
-					PrintError(FnName, NULL, "Read names do not match", Exit, OutOfRange);
-				}
-
-				/* Append temp matches to matches */
-				RGMatchesAppend(&matches, &tempMatches);
-			}
-
-			/* Free temp matches */
-			RGMatchesFree(&tempMatches);
-		}
-		/* We must finish all at the same time */
-		assert(numFinished == 0 || numFinished == numBins);
-
-		if(numFinished == 0) {
-			/* Finalize each end */
-			for(i=0;i<matches.numEnds;i++) {
-				RGMatchRemoveDuplicates(&matches.ends[i], maxNumMatches);
+	return RGMatchesMergeBatches(tempOutputIndexBinFPs,
+			numBins,
+			1,
+			tempOutputIndexFP,
+			index,
+			maxKeyMatches,
+			keyMissFraction,
+			maxNumMatches,
+			queueLength,
+			numThreads);
+}
 
-				for(j=0;j<matches.ends[i].readLength;j++) { // initialize
-					numKeyMatches[j]=0;
-				}
-				for(j=0;j<matches.ends[i].numEntries;j++) { // count # of matches per offset
-					for(k=0;k<matches.ends[i].numOffsets[j];k++) {
-						numKeyMatches[matches.ends[i].offsets[j][k]]++;
-					}
-				}
-				for(j=k=0;j<matches.ends[i].numEntries;j++) {
-					// Find any offset that is below the bound
-                                        int keyMissCount = 0;
-					for(l=0;l<matches.ends[i].numOffsets[j];l++) {
-						if(numKeyMatches[matches.ends[i].offsets[j][l]] <= maxKeyMatches) {
-                                                    keyMissCount++;
-                                                    break;
-                                                }
-					}
-                                        if(keyMissFraction < ((double)keyMissCount / matches.ends[i].numOffsets[j])) {
-                                            matches.ends[i].maxReached = -1;
-                                            k = 0; 
-                                            break;
-                                        }
-                                        else if(0 < keyMissCount) {
-                                                matches.ends[i].maxReached = (int)((double)255.0 * keyMissCount / matches.ends[i].numOffsets[j]);
-						if(k != j) {
-							matches.ends[i].contigs[k] = matches.ends[i].contigs[j];
-							matches.ends[i].positions[k] = matches.ends[i].positions[j];
-							matches.ends[i].strands[k] = matches.ends[i].strands[j];
-						}
-						// Zero out mask
-						for(l=0;l<GETMASKNUMBYTESFROMLENGTH(matches.ends[i].readLength);l++) {
-							matches.ends[i].masks[k][l] = 0;
-						}
-						// Copy over masks based on kept offsets
-						for(l=0;l<matches.ends[i].numOffsets[j];l++) { // for each offset
-							if(numKeyMatches[matches.ends[i].offsets[j][l]] <= maxKeyMatches) {
-								// Add ot the mask
-								for(m=0;m<index->width;m++) {
-									if(FORWARD == matches.ends[i].strands[j]) {
-										if(1 == index->mask[m]) {
-											int32_t offset = matches.ends[i].offsets[j][l] + m; 
-											// Color space already adjusted
-											//if(ColorSpace == index->space) offset++;
-											RGMatchUpdateMask(matches.ends[i].masks[k], offset); 
-										}
-									}
-									else {
-										if(1 == index->mask[index->width - m - 1]) {
-											int32_t offset = matches.ends[i].offsets[j][l] + m; 
-											// Color space already adjusted
-											//if(ColorSpace == index->space) offset--;
-											RGMatchUpdateMask(matches.ends[i].masks[k], offset); 
-										}
-									}
-								}
-							}
-						}
-						k++;
-					}
-				}
-				// remove offsets
-				for(j=0;j<matches.ends[i].numEntries;j++) {
-					free(matches.ends[i].offsets[j]);
-					matches.ends[i].offsets[j]=NULL;
-				}
-				free(matches.ends[i].numOffsets);
-				matches.ends[i].numOffsets=NULL;
-				free(matches.ends[i].offsets);
-				matches.ends[i].offsets=NULL;
-				// reallocate
-				RGMatchReallocate(&matches.ends[i], k); // important that k is preserved up to this point
-				// check if there were too many matches by removing duplicates
-				// this will also union the masks
-				RGMatchRemoveDuplicates(&matches.ends[i], maxNumMatches);
-			}
-			for(i=0;i<matches.numEnds;i++) {
-				if(0 < matches.ends[i].numEntries) {
-					numMatches++;
-					break;
-				}
-			}
-			RGMatchesPrint(tempOutputIndexFP,
-					&matches);
-		}
-		/* Free memory */
-		RGMatchesFree(&matches);
-	}
+/* TODO */
+/* Finalizes each end with RGMatchMergeIndexBinsFinalize */
+void RGMatchesMergeIndexBinsFinalize(RGMatches *m,
+		RGIndex *index,
+		int32_t maxKeyMatches,
+		double keyMissFraction,
+		int32_t maxNumMatches)
+{
+	int32_t i;
 
-	if(VERBOSE >=0) {
-		fprintf(stderr, "\r[%d]... completed.\n", counter-1);
+	for(i=0;i<m->numEnds;i++) {
+		RGMatchMergeIndexBinsFinalize(&m->ends[i],
+				index,
+				maxKeyMatches,
+				keyMissFraction,
+				maxNumMatches);
 	}
-
-	return numMatches;
 }
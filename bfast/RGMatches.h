@@ -3,8 +3,33 @@
 
 #include <stdio.h>
 #include <zlib.h>
+#include <pthread.h>
 #include "BLibDefinitions.h"
 
+/* For reading one input file per thread when merging */
+typedef struct {
+	gzFile fp;
+	int32_t withOffsets;
+	RGMatches *matchQueue;
+	int32_t matchQueueLength;
+	int32_t numRead;
+} ThreadRGMatchesReadData;
+
+/* For merging the matches of a batch of reads across threads */
+typedef struct {
+	RGMatches *matchQueue;
+	int32_t matchQueueLength;
+	int32_t numFiles;
+	int32_t numReads;
+	RGIndex *index;
+	int32_t maxKeyMatches;
+	double keyMissFraction;
+	int32_t maxNumMatches;
+	int32_t threadID;
+	int32_t numThreads;
+	int32_t numMatches;
+} ThreadRGMatchesMergeData;
+
 int32_t RGMatchesRead(gzFile, RGMatches*);
 int32_t RGMatchesReadWithOffsets(gzFile, RGMatches*);
 int32_t RGMatchesReadText(FILE*, RGMatches*);
@@ -13,10 +38,11 @@ void RGMatchesPrintWithOffsets(gzFile, RGMatches*);
 void RGMatchesPrintText(FILE*, RGMatches*);
 void RGMatchesPrintFastq(FILE*, RGMatches*);
 void RGMatchesRemoveDuplicates(RGMatches*, int32_t);
-int32_t RGMatchesMergeFilesAndOutput(gzFile*, int32_t, gzFile, int32_t, int32_t);
+int32_t RGMatchesMergeFilesAndOutput(gzFile*, int32_t, gzFile, int32_t, int32_t, int32_t);
 int32_t RGMatchesMergeThreadTempFilesIntoOutputTempFile(gzFile*, int32_t, gzFile);
 int32_t RGMatchesCompareAtIndex(RGMatches*, int32_t, RGMatches*, int32_t);
 void RGMatchesAppend(RGMatches*, RGMatches*);
+void RGMatchesAppendAll(RGMatches*, RGMatches**, int32_t);
 void RGMatchesAllocate(RGMatches*, int32_t);
 void RGMatchesReallocate(RGMatches*, int32_t);
 void RGMatchesFree(RGMatches*);
@@ -24,7 +50,12 @@ void RGMatchesInitialize(RGMatches*);
 void RGMatchesMirrorPairedEnd(RGMatches*, RGBinary *rg, int32_t, int32_t, int32_t);
 void RGMatchesCheck(RGMatches*, RGBinary*);
 void RGMatchesFilterOutOfRange(RGMatches*, int32_t);
-int32_t RGMatchesMergeIndexBins(gzFile*, int32_t, gzFile, RGIndex*, int32_t, double, int32_t); 
+int32_t RGMatchesMergeIndexBins(gzFile*, int32_t, gzFile, RGIndex*, int32_t, double, int32_t, int32_t, int32_t); 
+void RGMatchesMergeIndexBinsFinalize(RGMatches*, RGIndex*, int32_t, double, int32_t);
+int32_t RGMatchesMergeBatches(gzFile*, int32_t, int32_t, gzFile, RGIndex*, int32_t, double, int32_t, int32_t, int32_t);
+int32_t RGMatchesMergeBatchesRead(gzFile*, int32_t, int32_t, RGMatches*, int32_t, ThreadRGMatchesReadData*, pthread_t*, int32_t);
+void *RGMatchesReadThread(void*);
+void *RGMatchesMergeThread(void*);
 
 #endif
 
@@ -16,7 +16,6 @@ void RGRangesCopyToRGMatch(RGRanges *r,
 		int32_t space,
 		int32_t copyOffsets)
 {
-	char *FnName="RGRangesCopyToRGMatch";
 	int64_t i, j, counter, numEntries, prevNumEntries;
 	int32_t k;
 
@@ -26,20 +25,14 @@ void RGRangesCopyToRGMatch(RGRanges *r,
 			numEntries += r->endIndex[i] - r->startIndex[i] + 1;
 		}
 		RGMatchReallocate(m, prevNumEntries + numEntries); 
-		if(1 == copyOffsets && NULL == m->offsets) {
-			assert(0 == prevNumEntries);
-			m->numOffsets = malloc(sizeof(int32_t)*m->numEntries);
-			if(NULL == m->numOffsets) {
-				PrintError(FnName, "m->numOffsets", "Could not allocate memory", Exit, MallocMemory);
-			}
-			m->offsets = malloc(sizeof(int32_t*)*m->numEntries);
-			if(NULL == m->offsets) {
-				PrintError(FnName, "m->offsets", "Could not allocate memory", Exit, MallocMemory);
-			}
-			for(i=0;i<m->numEntries;i++) {
-				m->numOffsets[i] = 0;
-				m->offsets[i] = NULL;
+		if(1 == copyOffsets) {
+			if(NULL == m->offsetsStart) {
+				assert(0 == prevNumEntries);
+				RGMatchAllocateOffsets(m);
 			}
+			/* One offset per new entry */
+			assert(m->offsetsStart[prevNumEntries] == m->offsetsStart[m->numEntries]);
+			RGMatchReallocateOffsets(m, m->offsetsStart[prevNumEntries] + numEntries);
 		}
 		/* Copy over for each range */
 		counter = prevNumEntries;
@@ -75,7 +68,7 @@ void RGRangesCopyToRGMatch(RGRanges *r,
 						if(1 == index->mask[k]) {
 							int32_t offset = r->offset[i] + k;
 							if(ColorSpace == space) offset++;
-							RGMatchUpdateMask(m->masks[counter], 
+							RGMatchUpdateMask(GETMASK(m, counter), 
 									offset);
 						}
 					}
@@ -85,24 +78,19 @@ void RGRangesCopyToRGMatch(RGRanges *r,
 						if(1 == index->mask[index->width - k - 1]) {
 							int32_t offset = r->offset[i] + k;
 							if(ColorSpace == space) offset--;
-							RGMatchUpdateMask(m->masks[counter], 
+							RGMatchUpdateMask(GETMASK(m, counter), 
 									offset);
 						}
 					}
 				}
 				// Copy offsets if necessary
 				if(1 == copyOffsets) {
-					assert(0 == m->numOffsets[counter]);
-					m->numOffsets[counter]=1;
-					m->offsets[counter] = malloc(sizeof(int32_t));
-					if(NULL == m->offsets[counter]) {
-						PrintError(FnName, "m->offsets[counter]", "Could not allocate memory", Exit, MallocMemory);
-					}
-					m->offsets[counter][0] = r->offset[i];
+					m->offsetsStart[counter+1] = m->offsetsStart[counter] + 1;
+					GETOFFSETS(m, counter)[0] = r->offset[i];
 					// Adjust for color space
 					if(ColorSpace == space) {
-						if(FORWARD == m->strands[counter]) m->offsets[counter][0]++;
-						else m->offsets[counter][0]--;
+						if(FORWARD == m->strands[counter]) GETOFFSETS(m, counter)[0]++;
+						else GETOFFSETS(m, counter)[0]--;
 					}
 				}
 				counter++;
@@ -35,7 +35,8 @@ void RGReadsFindMatches(RGIndex *index,
 		int maxKeyMatches,
                 double keyMissFraction,
 		int maxNumMatches,
-		int strands)
+		int strands,
+		BCounters *counters)
 {
 	int64_t i;
 	int readLength=0;
@@ -43,7 +44,7 @@ void RGReadsFindMatches(RGIndex *index,
 	RGReads reads;
 	RGRanges ranges;
 	int readOffset = 0;
-        int count, total;
+        int count, total, skipped;
 
         if(match->maxReached < 0) { // ignore
             return;
@@ -77,7 +78,7 @@ void RGReadsFindMatches(RGIndex *index,
 	   RGReadsRemoveDuplicates(reads);
 	   }
 	   */
-        count = total = 0;
+        count = total = skipped = 0;
 
 	if(0 < numOffsets) { /* Go through the offsets */
 		for(i=0;0 <= match->maxReached && // have not reached the maximum
@@ -96,6 +97,7 @@ void RGReadsFindMatches(RGIndex *index,
 					&ranges)) {
                           case 1:
                             count++;
+                            skipped++;
                             break;
                           case 2:
                             count++;
@@ -125,6 +127,7 @@ void RGReadsFindMatches(RGIndex *index,
 					&ranges)) {
                           case 1:
                             count++;
+                            skipped++;
                             break;
                           case 2:
                             count++;
@@ -139,6 +142,11 @@ void RGReadsFindMatches(RGIndex *index,
 		}
 	}
 
+        if(NULL != counters) {
+            counters->counts[CounterIndexLookups] += total;
+            counters->counts[CounterKeysSkipped] += skipped;
+        }
+
         if(0 == total) {
             // ignore
         }
@@ -165,6 +173,109 @@ void RGReadsFindMatches(RGIndex *index,
 	RGReadsFree(&reads);
 }
 
+/* TODO */
+/* Searches each bin of a binned index for the read, merges the matches
+ * from the bins as if the index was not binned, then adds them to the
+ * match like RGReadsFindMatches. */
+void RGReadsFindMatchesInBins(RGIndex *bins,
+		int32_t numBins,
+		RGBinary *rg,
+		RGMatch *match,
+		int *offsets,
+		int numOffsets,
+		int space,
+		int maxKeyMatches,
+		double keyMissFraction,
+		int maxNumMatches,
+		int strands,
+		BCounters *counters)
+{
+	char *FnName="RGReadsFindMatchesInBins";
+	RGMatch *binMatches=NULL;
+	RGMatch **srcs=NULL;
+	RGMatch merged;
+	int32_t i;
+
+	if(match->maxReached < 0) { // ignore
+		return;
+	}
+
+	binMatches = malloc(sizeof(RGMatch)*numBins);
+	if(NULL == binMatches) {
+		PrintError(FnName, "binMatches", "Could not allocate memory", Exit, MallocMemory);
+	}
+	srcs = malloc(sizeof(RGMatch*)*numBins);
+	if(NULL == srcs) {
+		PrintError(FnName, "srcs", "Could not allocate memory", Exit, MallocMemory);
+	}
+
+	/* Search each bin from scratch, keeping the offsets so that the keys
+	 * can be counted across bins.  The read is shared, not copied. */
+	for(i=0;i<numBins;i++) {
+		RGMatchInitialize(&binMatches[i]);
+		binMatches[i].readLength = match->readLength;
+		binMatches[i].read = match->read;
+		binMatches[i].qualLength = match->qualLength;
+		binMatches[i].qual = match->qual;
+		RGReadsFindMatches(&bins[i],
+				rg,
+				&binMatches[i],
+				1,
+				offsets,
+				numOffsets,
+				space,
+				0,
+				0,
+				0,
+				0,
+				0,
+				maxKeyMatches,
+				keyMissFraction,
+				maxNumMatches,
+				strands,
+				counters);
+		srcs[i] = &binMatches[i];
+	}
+
+	/* Merge the bins */
+	RGMatchInitialize(&merged);
+	merged.readLength = match->readLength;
+	merged.read = match->read;
+	merged.qualLength = match->qualLength;
+	merged.qual = match->qual;
+	RGMatchAppend(&merged, srcs[0]);
+	if(1 < numBins) {
+		RGMatchAppendAll(&merged, srcs+1, numBins-1);
+	}
+	RGMatchMergeIndexBinsFinalize(&merged,
+			&bins[numBins-1],
+			maxKeyMatches,
+			keyMissFraction,
+			maxNumMatches);
+
+	/* Add to the match */
+	if(merged.maxReached < 0) {
+		RGMatchClearMatches(match);
+		match->maxReached = -1;
+	}
+	else {
+		RGMatchAppend(match, &merged);
+		match->maxReached = merged.maxReached;
+		RGMatchRemoveDuplicates(match,
+				maxNumMatches);
+	}
+
+	/* Free memory, but not the shared read */
+	for(i=0;i<numBins;i++) {
+		binMatches[i].read = binMatches[i].qual = NULL;
+		RGMatchFree(&binMatches[i]);
+	}
+	merged.read = merged.qual = NULL;
+	RGMatchFree(&merged);
+	free(binMatches);
+	free(srcs);
+}
+
 /* TODO */
 /* We may want to include enumeration of SNPs in color space */
 void RGReadsGenerateReads(char *read,
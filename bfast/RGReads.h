@@ -6,7 +6,8 @@
 #include "RGMatch.h"
 #include "RGIndex.h"
 
-void RGReadsFindMatches(RGIndex*, RGBinary*, RGMatch*, int, int*, int, int, int, int, int, int, int, int, double, int, int);
+void RGReadsFindMatches(RGIndex*, RGBinary*, RGMatch*, int, int*, int, int, int, int, int, int, int, int, double, int, int, BCounters*);
+void RGReadsFindMatchesInBins(RGIndex*, int32_t, RGBinary*, RGMatch*, int*, int, int, int, double, int, int, BCounters*);
 void RGReadsGenerateReads(char*, int, RGIndex*, RGReads*, int*, int, int, int, int, int, int, int);
 void RGReadsGeneratePerfectMatch(char*, int, int, RGIndex*, RGReads*);
 void RGReadsGenerateMismatches(char*, int, int, int, RGIndex*, RGReads*);
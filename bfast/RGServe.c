@@ -0,0 +1,435 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <config.h>
+
+#include "BError.h"
+#include "BLib.h"
+#include "BLibDefinitions.h"
+#include "RGBinary.h"
+#include "RGIndex.h"
+#include "MatchesReadInputFiles.h"
+#include "RGServe.h"
+
+/* The shared memory object starts with a header naming the reference
+ * genome and the indexes it holds:
+ *
+ * int32_t id, int32_t ready, int32_t space,
+ * int32_t fasta file name length, fasta file name, int64_t offset, int64_t length,
+ * int32_t number of indexes, then for each index
+ * int32_t index file name length, index file name, int64_t offset, int64_t length.
+ *
+ * The reference genome image (RGBinaryWriteBinaryMap) and each index image
+ * (RGIndexWriteMap) follow, each starting on a BFAST_RG_MMAP_ALIGNMENT
+ * boundary so that it can be mapped on its own.  The ready flag is set
+ * last.
+ * */
+
+#define RGSERVE_ALIGN(_x) ((((_x) + BFAST_RG_MMAP_ALIGNMENT - 1) / BFAST_RG_MMAP_ALIGNMENT) * BFAST_RG_MMAP_ALIGNMENT)
+
+/* TODO */
+static void RGServeWrite(char *map,
+		int64_t *offset,
+		void *src,
+		int64_t length)
+{
+	memcpy(map + (*offset), src, length);
+	(*offset) += length;
+}
+
+/* TODO */
+static int32_t RGServeRead(char *map,
+		int64_t mapLength,
+		int64_t *offset,
+		void *dest,
+		int64_t length)
+{
+	if(mapLength < (*offset) + length) {
+		return 0;
+	}
+	memcpy(dest, map + (*offset), length);
+	(*offset) += length;
+	return 1;
+}
+
+/* TODO */
+static char *RGServeGetPath(char *fileName)
+{
+	char *FnName="RGServeGetPath";
+	char path[PATH_MAX];
+
+	if(NULL == realpath(fileName, path)) {
+		PrintError(FnName, fileName, "Could not resolve the path", Exit, IllegalFileName);
+	}
+	return strdup(path);
+}
+
+/* TODO */
+static void RGServeCheckPageSize()
+{
+	char *FnName="RGServeCheckPageSize";
+	long pageSize = sysconf(_SC_PAGESIZE);
+
+	if(pageSize <= 0 || 0 != BFAST_RG_MMAP_ALIGNMENT % pageSize) {
+		PrintError(FnName, "pageSize", "The page size must divide the alignment of the served images", Exit, OutOfRange);
+	}
+}
+
+/* TODO */
+/* Returns the name of the shared memory object, which must start with a '/' */
+char *RGServeGetName(char *name)
+{
+	char *FnName="RGServeGetName";
+	char *shmName=NULL;
+
+	shmName = malloc(sizeof(char)*(strlen(name)+2));
+	if(NULL == shmName) {
+		PrintError(FnName, "shmName", "Could not allocate memory", Exit, MallocMemory);
+	}
+	if('/' == name[0]) {
+		strcpy(shmName, name);
+	}
+	else {
+		sprintf(shmName, "/%s", name);
+	}
+	return shmName;
+}
+
+/* TODO */
+/* Loads the reference genome and the given indexes into a new shared
+ * memory object.  The object persists until RGServeRemove. */
+void RGServeCreate(char *name,
+		char *fastaFileName,
+		int32_t space,
+		char *indexes)
+{
+	char *FnName="RGServeCreate";
+	char *shmName=NULL;
+	char *fastaPath=NULL;
+	char **indexFileNames=NULL;
+	char **indexPaths=NULL;
+	int32_t **indexIDs=NULL;
+	int32_t numIndexes, i, length, ready=0;
+	int64_t *indexOffsets=NULL, *indexLengths=NULL;
+	int64_t headerLength, rgOffset, rgLength, mapLength, offset;
+	RGBinary rg;
+	RGIndex index;
+	int fd;
+	char *map=NULL;
+
+	RGServeCheckPageSize();
+	shmName = RGServeGetName(name);
+
+	/* Find the indexes */
+	numIndexes=GetIndexFileNames(fastaFileName, space, indexes, &indexFileNames, &indexIDs);
+	if(numIndexes<=0) {
+		PrintError(FnName, "numIndexes", "Read zero indexes", Exit, OutOfRange);
+	}
+	indexPaths = malloc(sizeof(char*)*numIndexes);
+	indexOffsets = malloc(sizeof(int64_t)*numIndexes);
+	indexLengths = malloc(sizeof(int64_t)*numIndexes);
+	if(NULL == indexPaths || NULL == indexOffsets || NULL == indexLengths) {
+		PrintError(FnName, "indexPaths", "Could not allocate memory", Exit, MallocMemory);
+	}
+
+	/* Get the size of each image from the headers */
+	RGBinaryReadBinary(&rg,
+			space,
+			fastaFileName);
+	rgLength = RGBinaryWriteBinaryMap(&rg, NULL);
+	fastaPath = RGServeGetPath(fastaFileName);
+	headerLength = 4*sizeof(int32_t) + strlen(fastaPath)*sizeof(char) + 2*sizeof(int64_t) + sizeof(int32_t);
+	for(i=0;i<numIndexes;i++) {
+		indexPaths[i] = RGServeGetPath(indexFileNames[i]);
+		RGIndexInitialize(&index);
+		RGIndexGetHeader(indexFileNames[i], &index);
+		indexLengths[i] = RGIndexWriteMap(&index, NULL);
+		RGIndexDelete(&index);
+		headerLength += sizeof(int32_t) + strlen(indexPaths[i])*sizeof(char) + 2*sizeof(int64_t);
+	}
+	rgOffset = RGSERVE_ALIGN(headerLength);
+	for(i=0;i<numIndexes;i++) {
+		indexOffsets[i] = RGSERVE_ALIGN((0 == i) ? (rgOffset + rgLength) : (indexOffsets[i-1] + indexLengths[i-1]));
+	}
+	mapLength = indexOffsets[numIndexes-1] + indexLengths[numIndexes-1];
+
+	/* Create the shared memory object */
+	if((fd=shm_open(shmName, O_RDWR | O_CREAT | O_EXCL, 0644)) < 0) {
+		PrintError(FnName, shmName, "Could not create the shared memory object (it may already exist)", Exit, OpenFileError);
+	}
+	if(0 != ftruncate(fd, mapLength)) {
+		PrintError(FnName, shmName, "Could not set the size of the shared memory object", Exit, WriteFileError);
+	}
+	map = mmap(NULL, mapLength, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if(MAP_FAILED == map) {
+		PrintError(FnName, shmName, "Could not map the shared memory object", Exit, WriteFileError);
+	}
+
+	/* Header, not yet ready */
+	offset = 0;
+	RGServeWrite(map, &offset, &rg.id, sizeof(int32_t));
+	RGServeWrite(map, &offset, &ready, sizeof(int32_t));
+	RGServeWrite(map, &offset, &space, sizeof(int32_t));
+	length = strlen(fastaPath);
+	RGServeWrite(map, &offset, &length, sizeof(int32_t));
+	RGServeWrite(map, &offset, fastaPath, sizeof(char)*length);
+	RGServeWrite(map, &offset, &rgOffset, sizeof(int64_t));
+	RGServeWrite(map, &offset, &rgLength, sizeof(int64_t));
+	RGServeWrite(map, &offset, &numIndexes, sizeof(int32_t));
+	for(i=0;i<numIndexes;i++) {
+		length = strlen(indexPaths[i]);
+		RGServeWrite(map, &offset, &length, sizeof(int32_t));
+		RGServeWrite(map, &offset, indexPaths[i], sizeof(char)*length);
+		RGServeWrite(map, &offset, &indexOffsets[i], sizeof(int64_t));
+		RGServeWrite(map, &offset, &indexLengths[i], sizeof(int64_t));
+	}
+	assert(offset == headerLength);
+
+	/* Reference genome */
+	RGBinaryWriteBinaryMap(&rg, map + rgOffset);
+	RGBinaryDelete(&rg);
+
+	/* Indexes, one at a time */
+	for(i=0;i<numIndexes;i++) {
+		RGIndexInitialize(&index);
+		ReadRGIndex(indexFileNames[i], &index, space);
+		if(indexLengths[i] != RGIndexWriteMap(&index, map + indexOffsets[i])) {
+			PrintError(FnName, indexFileNames[i], "The index changed while being served", Exit, OutOfRange);
+		}
+		RGIndexDelete(&index);
+	}
+
+	/* Ready */
+	ready = BFAST_SERVE_READY;
+	memcpy(map + sizeof(int32_t), &ready, sizeof(int32_t));
+	if(0 != munmap(map, mapLength) || 0 != close(fd)) {
+		PrintError(FnName, shmName, "Could not write the shared memory object", Exit, WriteFileError);
+	}
+
+	if(VERBOSE >= 0) {
+		fprintf(stderr, "%s", BREAK_LINE);
+		fprintf(stderr, "Serving the reference genome and %d index%s as %s (%lld bytes).\n",
+				numIndexes,
+				(1 == numIndexes) ? "" : "es",
+				shmName,
+				(long long int)mapLength);
+		fprintf(stderr, "%s", BREAK_LINE);
+	}
+
+	/* Free memory */
+	for(i=0;i<numIndexes;i++) {
+		free(indexFileNames[i]);
+		free(indexIDs[i]);
+		free(indexPaths[i]);
+	}
+	free(indexFileNames);
+	free(indexIDs);
+	free(indexPaths);
+	free(indexOffsets);
+	free(indexLengths);
+	free(fastaPath);
+	free(shmName);
+}
+
+/* TODO */
+/* Removes the shared memory object.  Processes that attached to it keep
+ * their mappings. */
+void RGServeRemove(char *name)
+{
+	char *FnName="RGServeRemove";
+	char *shmName = RGServeGetName(name);
+
+	if(0 != shm_unlink(shmName)) {
+		PrintError(FnName, shmName, "Could not remove the shared memory object", Warn, OpenFileError);
+	}
+	else if(VERBOSE >= 0) {
+		fprintf(stderr, "Removed %s.\n", shmName);
+	}
+	free(shmName);
+}
+
+/* TODO */
+/* Attaches to the shared memory object and reads its header */
+void RGServeOpen(RGServe *serve,
+		char *name)
+{
+	char *FnName="RGServeOpen";
+	char *shmName=NULL;
+	struct stat st;
+	char *map=NULL;
+	int64_t mapLength, offset=0;
+	int32_t id=0, ready=0, length=0, i;
+
+	RGServeCheckPageSize();
+	shmName = RGServeGetName(name);
+
+	if((serve->fd=shm_open(shmName, O_RDONLY, 0)) < 0) {
+		PrintError(FnName, shmName, "Could not open the shared memory object (is bfast index-serve running?)", Exit, OpenFileError);
+	}
+	if(0 != fstat(serve->fd, &st)) {
+		PrintError(FnName, shmName, "Could not get the size of the shared memory object", Exit, ReadFileError);
+	}
+	mapLength = st.st_size;
+	map = mmap(NULL, mapLength, PROT_READ, MAP_SHARED, serve->fd, 0);
+	if(MAP_FAILED == map) {
+		PrintError(FnName, shmName, "Could not map the shared memory object", Exit, ReadFileError);
+	}
+
+	if(0 == RGServeRead(map, mapLength, &offset, &id, sizeof(int32_t)) ||
+			0 == RGServeRead(map, mapLength, &offset, &ready, sizeof(int32_t))) {
+		PrintError(FnName, shmName, "Could not read the header", Exit, ReadFileError);
+	}
+	if(BFAST_ID != id) {
+		PrintError(FnName, "id", "The id did not match", Exit, OutOfRange);
+	}
+	if(BFAST_SERVE_READY != ready) {
+		PrintError(FnName, shmName, "The shared memory object is still being loaded", Exit, OutOfRange);
+	}
+	if(0 == RGServeRead(map, mapLength, &offset, &serve->space, sizeof(int32_t)) ||
+			0 == RGServeRead(map, mapLength, &offset, &length, sizeof(int32_t)) ||
+			length <= 0) {
+		PrintError(FnName, shmName, "Could not read the header", Exit, ReadFileError);
+	}
+	serve->fastaFileName = malloc(sizeof(char)*(length+1));
+	if(NULL == serve->fastaFileName) {
+		PrintError(FnName, "serve->fastaFileName", "Could not allocate memory", Exit, MallocMemory);
+	}
+	if(0 == RGServeRead(map, mapLength, &offset, serve->fastaFileName, sizeof(char)*length) ||
+			0 == RGServeRead(map, mapLength, &offset, &serve->rgOffset, sizeof(int64_t)) ||
+			0 == RGServeRead(map, mapLength, &offset, &serve->rgLength, sizeof(int64_t)) ||
+			0 == RGServeRead(map, mapLength, &offset, &serve->numIndexes, sizeof(int32_t))) {
+		PrintError(FnName, shmName, "Could not read the header", Exit, ReadFileError);
+	}
+	serve->fastaFileName[length] = '\0';
+
+	serve->indexFileNames = malloc(sizeof(char*)*serve->numIndexes);
+	serve->indexOffsets = malloc(sizeof(int64_t)*serve->numIndexes);
+	serve->indexLengths = malloc(sizeof(int64_t)*serve->numIndexes);
+	if(NULL == serve->indexFileNames || NULL == serve->indexOffsets || NULL == serve->indexLengths) {
+		PrintError(FnName, "serve->indexFileNames", "Could not allocate memory", Exit, MallocMemory);
+	}
+	for(i=0;i<serve->numIndexes;i++) {
+		if(0 == RGServeRead(map, mapLength, &offset, &length, sizeof(int32_t)) ||
+				length <= 0) {
+			PrintError(FnName, shmName, "Could not read the header", Exit, ReadFileError);
+		}
+		serve->indexFileNames[i] = malloc(sizeof(char)*(length+1));
+		if(NULL == serve->indexFileNames[i]) {
+			PrintError(FnName, "serve->indexFileNames[i]", "Could not allocate memory", Exit, MallocMemory);
+		}
+		if(0 == RGServeRead(map, mapLength, &offset, serve->indexFileNames[i], sizeof(char)*length) ||
+				0 == RGServeRead(map, mapLength, &offset, &serve->indexOffsets[i], sizeof(int64_t)) ||
+				0 == RGServeRead(map, mapLength, &offset, &serve->indexLengths[i], sizeof(int64_t)) ||
+				mapLength < serve->indexOffsets[i] + serve->indexLengths[i]) {
+			PrintError(FnName, shmName, "Could not read the header", Exit, ReadFileError);
+		}
+		serve->indexFileNames[i][length] = '\0';
+	}
+	if(mapLength < serve->rgOffset + serve->rgLength) {
+		PrintError(FnName, shmName, "Could not read the header", Exit, ReadFileError);
+	}
+
+	munmap(map, mapLength);
+
+	if(VERBOSE >= 0) {
+		fprintf(stderr, "Attached to %s serving %d index%s.\n",
+				shmName,
+				serve->numIndexes,
+				(1 == serve->numIndexes) ? "" : "es");
+	}
+	free(shmName);
+}
+
+/* TODO */
+/* Maps the served reference genome, which must be the one given */
+void RGServeGetBinary(RGServe *serve,
+		RGBinary *rg,
+		char *fastaFileName,
+		int32_t space)
+{
+	char *FnName="RGServeGetBinary";
+	char *fastaPath = RGServeGetPath(fastaFileName);
+
+	if(space != serve->space || 0 != strcmp(fastaPath, serve->fastaFileName)) {
+		PrintError(FnName, fastaFileName, "The served reference genome is different", Exit, OutOfRange);
+	}
+	free(fastaPath);
+
+	if(VERBOSE>=0) {
+		fprintf(stderr, "%s", BREAK_LINE);
+		fprintf(stderr, "Mapping in the served reference genome from %s.\n", serve->fastaFileName);
+	}
+
+	rg->mapLength = serve->rgLength;
+	rg->map = mmap(NULL, rg->mapLength, PROT_READ, MAP_SHARED, serve->fd, serve->rgOffset);
+	if(MAP_FAILED == rg->map) {
+		PrintError(FnName, fastaFileName, "Could not map the served reference genome", Exit, ReadFileError);
+	}
+	RGBinaryReadBinaryMap(rg);
+}
+
+/* TODO */
+/* Maps the served index with the given file name.  Returns zero if the
+ * index is not served. */
+int32_t RGServeGetIndex(RGServe *serve,
+		RGIndex *index,
+		char *indexFileName,
+		int32_t space)
+{
+	char *FnName="RGServeGetIndex";
+	char *indexPath = RGServeGetPath(indexFileName);
+	int32_t i;
+
+	for(i=0;i<serve->numIndexes && 0 != strcmp(indexPath, serve->indexFileNames[i]);i++) {
+	}
+	free(indexPath);
+	if(serve->numIndexes <= i) {
+		return 0;
+	}
+
+	if(VERBOSE >= 0) {
+		fprintf(stderr, "Mapping in the served index %s.\n",
+				indexFileName);
+	}
+	index->mapLength = serve->indexLengths[i];
+	index->map = mmap(NULL, index->mapLength, PROT_READ, MAP_SHARED, serve->fd, serve->indexOffsets[i]);
+	if(MAP_FAILED == index->map) {
+		PrintError(FnName, indexFileName, "Could not map the served index", Exit, ReadFileError);
+	}
+	RGIndexReadMap(index);
+
+	if(index->space != space) {
+		PrintError("space", indexFileName, "The index has a different space parity than specified", Exit, OutOfRange);
+	}
+	return 1;
+}
+
+/* TODO */
+/* Detaches from the shared memory object.  The reference genome and
+ * indexes already mapped stay mapped until they are deleted. */
+void RGServeClose(RGServe *serve)
+{
+	int32_t i;
+
+	close(serve->fd);
+	serve->fd = -1;
+	for(i=0;i<serve->numIndexes;i++) {
+		free(serve->indexFileNames[i]);
+	}
+	free(serve->indexFileNames);
+	serve->indexFileNames = NULL;
+	free(serve->indexOffsets);
+	serve->indexOffsets = NULL;
+	free(serve->indexLengths);
+	serve->indexLengths = NULL;
+	free(serve->fastaFileName);
+	serve->fastaFileName = NULL;
+	serve->numIndexes = 0;
+}
@@ -0,0 +1,14 @@
+#ifndef RGSERVE_H_
+#define RGSERVE_H_
+
+#include "BLibDefinitions.h"
+
+void RGServeCreate(char*, char*, int32_t, char*);
+void RGServeRemove(char*);
+void RGServeOpen(RGServe*, char*);
+void RGServeGetBinary(RGServe*, RGBinary*, char*, int32_t);
+int32_t RGServeGetIndex(RGServe*, RGIndex*, char*, int32_t);
+void RGServeClose(RGServe*);
+char *RGServeGetName(char*);
+
+#endif
@@ -37,20 +37,26 @@ void RunAlign(
 	FILE *tmpMatchFP=NULL;
 	char *tmpLocalAlignFileName=NULL;
 	FILE *tmpLocalAlignFP=NULL;
-	int seconds, minutes, hours, startTotalTime, endTotalTime;
+	int minutes, hours;
+	double seconds;
+	int64_t startTotalTime, endTotalTime;
 
-	startTotalTime = time(NULL);
+	startTotalTime = BTimeNow();
 
 	// Open a tmp file
 	tmpMatchFP = OpenTmpFile(tmpDir, &tmpMatchFileName);
 
 	// Run Match
 	RunMatch(fastaFileName,
+			NULL,
 			NULL,
 			NULL,
 			readFileName,
 			NULL,
 			IndexesMemorySerial,
+			0,
+			0,
+			0,
 			compression,
 			space,
 			1,
@@ -63,6 +69,7 @@ void RunAlign(
 			numThreads,
 			DEFAULT_MATCHES_QUEUE_LENGTH,
 			tmpDir,
+			DEFAULT_TMP_COMPRESSION,
 			timing,
 			tmpMatchFP);
 
@@ -91,6 +98,11 @@ void RunAlign(
 			0,
 			NoMirroring,
 			0,
+			0,
+			0.0,
+			0.0,
+			INSERT_MAX_STD,
+			RESCUE_NUM_HITS,
 			timing,
 			tmpLocalAlignFP);
 
@@ -120,11 +132,16 @@ void RunAlign(
 			0.0,
 			0.0,
 			numThreads,
+			numThreads,
 			DEFAULT_LOCALALIGN_QUEUE_LENGTH,
 			SAM,
 			NULL,
 			NULL,
                         0,
+			0,
+			POSTPROCESS_SORT_DEFAULT_MEMORY_LIMIT,
+			tmpDir,
+			timing,
 			stdout);
 	RGBinaryDelete(&rg);
 
@@ -138,14 +155,10 @@ void RunAlign(
 
 	if(timing == 1) {
 		/* Output total time */
-		endTotalTime = time(NULL);
-		seconds = endTotalTime - startTotalTime;
-		hours = seconds/3600;
-		seconds -= hours*3600;
-		minutes = seconds/60;
-		seconds -= minutes*60;
+		endTotalTime = BTimeNow();
+		BTimeSplit(endTotalTime - startTotalTime, &hours, &minutes, &seconds);
 		if(0 <= VERBOSE) {
-			fprintf(stderr, "Total time elapsed: %d hours, %d minutes and %d seconds.\n",
+			fprintf(stderr, "Total time elapsed: %d hours, %d minutes and %.3lf seconds.\n",
 					hours,
 					minutes,
 					seconds
@@ -14,6 +14,7 @@
 #include "AlignedEntry.h" 
 #include "ScoringMatrix.h"
 #include "Align.h"
+#include "AlignRescue.h"
 #include "RunLocalAlign.h"
 
 /* TODO */
@@ -35,24 +36,41 @@ void RunAligner(char *fastaFileName,
 		int32_t pairedEndLength,
 		int32_t mirroringType,
 		int32_t forceMirroring,
+		int32_t rescueMates,
+		double insertSizeAvg,
+		double insertSizeStdDev,
+		double rescueNumStdDev,
+		int32_t rescueNumHits,
 		int32_t timing,
 		FILE *fpOut)
 {
 	char *FnName = "RunAligner";
 	gzFile outputFP=NULL;
 	gzFile matchFP=NULL;
-	int32_t startTime, endTime;
+	int64_t startTime, endTime;
 	RGBinary rg;
-	int32_t totalReferenceGenomeTime=0;
-	int32_t totalAlignedTime=0;
-	int32_t totalFileHandlingTime=0;
-	int32_t seconds, minutes, hours;
+	int64_t totalReferenceGenomeTime=0;
+	int64_t totalAlignedTime=0;
+	int64_t totalFileHandlingTime=0;
+	int64_t totalRescueTime=0;
+	int32_t minutes, hours;
+	double seconds;
+	int64_t startTotalTime = BTimeNow();
+	BCounters *counters=NULL; /* one per thread, then the main thread */
+	char *stageNames[4] = {"readRG", "align", "rescue", "fileHandling"};
+	int64_t stageTimes[4];
+
+	/* Aligned so that each thread has its own cache lines */
+	if(0 != posix_memalign((void**)&counters, BFAST_CACHE_LINE_SIZE, sizeof(BCounters)*(numThreads+1))) {
+		PrintError(FnName, "counters", "Could not allocate memory", Exit, MallocMemory);
+	}
+	BCountersInitialize(counters, numThreads+1);
 
-	startTime = time(NULL);
+	startTime = BTimeNow();
 	RGBinaryReadBinary(&rg,
 			NTSpace, // always NT space
 			fastaFileName);
-	endTime = time(NULL);
+	endTime = BTimeNow();
 	/* Unpack */
 	/*
 	   RGBinaryUnPack(&rg);
@@ -105,9 +123,16 @@ void RunAligner(char *fastaFileName,
 			pairedEndLength,
 			mirroringType,
 			forceMirroring,
+			rescueMates,
+			insertSizeAvg,
+			insertSizeStdDev,
+			rescueNumStdDev,
+			rescueNumHits,
 			outputFP,
 			&totalAlignedTime,
-			&totalFileHandlingTime);
+			&totalFileHandlingTime,
+			&totalRescueTime,
+			counters);
 
 	if(0 <= VERBOSE) {
 		fprintf(stderr, "%s", BREAK_LINE);
@@ -124,13 +149,9 @@ void RunAligner(char *fastaFileName,
 
 	if(1 == timing) {
 		/* Output loading reference genome time */                        
-		seconds = totalReferenceGenomeTime;
-		hours = seconds/3600;
-		seconds -= hours*3600;
-		minutes = seconds/60;
-		seconds -= minutes*60;
+		BTimeSplit(totalReferenceGenomeTime, &hours, &minutes, &seconds);
 		if(0 <= VERBOSE) {
-			fprintf(stderr, "Reference Genome loading time took: %d hours, %d minutes and %d seconds.\n"
+			fprintf(stderr, "Reference Genome loading time took: %d hours, %d minutes and %.3lf seconds.\n"
 					,
 					hours,
 					minutes,
@@ -139,34 +160,44 @@ void RunAligner(char *fastaFileName,
 		}
 
 		/* Output aligning time */
-		seconds = totalAlignedTime;
-		hours = seconds/3600;
-		seconds -= hours*3600;
-		minutes = seconds/60;
-		seconds -= minutes*60;
+		BTimeSplit(totalAlignedTime, &hours, &minutes, &seconds);
 		if(0 <= VERBOSE) {
-			fprintf(stderr, "Align time took: %d hours, %d minutes and %d seconds.\n",
+			fprintf(stderr, "Align time took: %d hours, %d minutes and %.3lf seconds.\n",
 					hours,
 					minutes,
 					seconds
 				   );
 		}
 
+		if(1 == rescueMates) {
+			/* Output mate rescue time (part of the aligning time) */
+			BTimeSplit(totalRescueTime, &hours, &minutes, &seconds);
+			if(0 <= VERBOSE) {
+				fprintf(stderr, "Mate rescue time took: %d hours, %d minutes and %.3lf seconds.\n",
+						hours,
+						minutes,
+						seconds
+					   );
+			}
+		}
+
 		/* Output file handling time */
-		seconds = totalFileHandlingTime;
-		hours = seconds/3600;
-		seconds -= hours*3600;
-		minutes = seconds/60;
-		seconds -= minutes*60;
+		BTimeSplit(totalFileHandlingTime, &hours, &minutes, &seconds);
 		if(0 <= VERBOSE) {
-			fprintf(stderr, "File handling time took: %d hours, %d minutes and %d seconds.\n",
+			fprintf(stderr, "File handling time took: %d hours, %d minutes and %.3lf seconds.\n",
 					hours,
 					minutes,
 					seconds
 				   );
 
 		}
+		stageTimes[0] = totalReferenceGenomeTime;
+		stageTimes[1] = totalAlignedTime;
+		stageTimes[2] = totalRescueTime;
+		stageTimes[3] = totalFileHandlingTime;
+		BCountersPrintJSON(stderr, "localalign", BTimeNow() - startTotalTime, stageNames, stageTimes, 4, counters, numThreads);
 	}
+	free(counters);
 }
 
 /* TODO */
@@ -188,9 +219,16 @@ void RunDynamicProgramming(gzFile matchFP,
 		int32_t pairedEndLength,
 		int32_t mirroringType,
 		int32_t forceMirroring,
+		int32_t rescueMates,
+		double insertSizeAvg,
+		double insertSizeStdDev,
+		double rescueNumStdDev,
+		int32_t rescueNumHits,
 		gzFile outputFP,
-		int32_t *totalAlignedTime,
-		int32_t *totalFileHandlingTime)
+		int64_t *totalAlignedTime,
+		int64_t *totalFileHandlingTime,
+		int64_t *totalRescueTime,
+		BCounters *counters)
 {
 	char *FnName="RunDynamicProgramming";
 	/* local variables */
@@ -201,8 +239,10 @@ void RunDynamicProgramming(gzFile matchFP,
 
 	int32_t numAligned=0;
 	int32_t numNotAligned=0;
-	int32_t startTime, endTime;
+	int64_t startTime, endTime;
 	int64_t numLocalAlignments=0;
+	int64_t numRescued=0, numRescueWindows=0;
+	int64_t maxRescueTime;
 	/* Thread specific data */
 	ThreadData *data;
 	pthread_t *threads=NULL;
@@ -214,6 +254,8 @@ void RunDynamicProgramming(gzFile matchFP,
 	int32_t matchFPctr = 1;
 	int32_t outputCtr = 0;
 	int32_t numReadsProcessed = 0, numMatchesRead = 0;
+	BCounters *mainCounters = &counters[numThreads];
+	z_off_t readOffset, writeOffset;
 
 	/* Initialize */
 	RGMatchesInitialize(&m);
@@ -241,14 +283,14 @@ void RunDynamicProgramming(gzFile matchFP,
 	}
 
 	/* Start file handling timer */
-	startTime = time(NULL);
+	startTime = BTimeNow();
 
 	/* Read in scoring matrix */
 	if(NULL != scoringMatrixFileName) {
 		ScoringMatrixRead(scoringMatrixFileName, &sm, space); 
 	}
 	/* End file handling timer */
-	endTime = time(NULL);
+	endTime = BTimeNow();
 	(*totalFileHandlingTime) += endTime - startTime;
 
 	/* Calculate mismatch score */
@@ -263,9 +305,9 @@ void RunDynamicProgramming(gzFile matchFP,
 	}
 
 	// Skip matches
-	startTime = time(NULL);
+	startTime = BTimeNow();
 	SkipMatches(matchFP, &matchFPctr, startReadNum);
-	endTime = time(NULL);
+	endTime = BTimeNow();
 	(*totalFileHandlingTime) += endTime - startTime;
 
 
@@ -275,10 +317,13 @@ void RunDynamicProgramming(gzFile matchFP,
 		fprintf(stderr, "Reads processed: 0");
 	}
 
-	startTime = time(NULL);
+	startTime = BTimeNow();
+	readOffset = gztell(matchFP);
 	while(0 != (numMatchesRead = GetMatches(matchFP, &matchFPctr, startReadNum, endReadNum, matchQueue, queueLength))) {
-		endTime = time(NULL);
+		endTime = BTimeNow();
 		(*totalFileHandlingTime) += endTime - startTime;
+		mainCounters->counts[CounterIOTime] += endTime - startTime;
+		mainCounters->counts[CounterBytesRead] += gztell(matchFP) - readOffset;
 
 		numReadsProcessed += numMatchesRead;
 		matchQueueLength = numMatchesRead;
@@ -293,6 +338,14 @@ void RunDynamicProgramming(gzFile matchFP,
 			data[i].pairedEndLength = pairedEndLength;
 			data[i].mirroringType = mirroringType;
 			data[i].forceMirroring = forceMirroring;
+			data[i].rescueMates = rescueMates;
+			data[i].insertSizeAvg = insertSizeAvg;
+			data[i].insertSizeStdDev = insertSizeStdDev;
+			data[i].rescueNumStdDev = rescueNumStdDev;
+			data[i].rescueNumHits = rescueNumHits;
+			data[i].numRescued = 0;
+			data[i].numRescueWindows = 0;
+			data[i].rescueTime = 0;
 			data[i].sm = &sm;
 			data[i].ungapped = ungapped;
 			data[i].unconstrained = unconstrained;
@@ -308,10 +361,12 @@ void RunDynamicProgramming(gzFile matchFP,
 			data[i].numNotAligned = 0;
 			data[i].matchQueue = matchQueue;
 			data[i].alignedQueue = alignedQueue;
+			data[i].counters = &counters[i];
+			data[i].computeTime = 0;
 		}
 
 		/* Create threads */
-		startTime = time(NULL);
+		startTime = BTimeNow();
 		for(i=0;i<numThreads;i++) {
 			/* Start thread */
 			errCode = pthread_create(&threads[i], /* thread struct */
@@ -341,11 +396,17 @@ void RunDynamicProgramming(gzFile matchFP,
 				PrintError(FnName, "pthread_join: errCode", "Thread returned an error", Exit, ThreadError);
 			}
 		}
-		endTime = time(NULL);
+		endTime = BTimeNow();
 		(*totalAlignedTime) += (endTime - startTime);
+		/* The threads wait on the slowest thread, and the main thread on all of them */
+		for(i=0;i<numThreads;i++) {
+			counters[i].counts[CounterWaitTime] += (endTime - startTime) - data[i].computeTime;
+		}
+		mainCounters->counts[CounterWaitTime] += endTime - startTime;
 
 		// Output to file 
-		startTime = time(NULL);
+		startTime = BTimeNow();
+		writeOffset = gztell(outputFP);
 		for(i=0;i<matchQueueLength;i++) {
 			AlignedReadPrint(&alignedQueue[i],
 					outputFP);
@@ -355,21 +416,29 @@ void RunDynamicProgramming(gzFile matchFP,
 			RGMatchesFree(&matchQueue[i]);
 			outputCtr++;
 		}
-		endTime = time(NULL);
+		endTime = BTimeNow();
 		(*totalFileHandlingTime) += endTime - startTime;
+		mainCounters->counts[CounterIOTime] += endTime - startTime;
+		mainCounters->counts[CounterBytesWritten] += gztell(outputFP) - writeOffset;
 
 		/* Sum up statistics */
-		for(i=0;i<numThreads;i++) {
+		for(i=0,maxRescueTime=0;i<numThreads;i++) {
 			numAligned += data[i].numAligned;
 			numNotAligned += data[i].numNotAligned;
 			numLocalAlignments += data[i].numLocalAlignments;
+			numRescued += data[i].numRescued;
+			numRescueWindows += data[i].numRescueWindows;
+			maxRescueTime = GETMAX(maxRescueTime, data[i].rescueTime);
 		}
+		/* The threads rescue concurrently */
+		(*totalRescueTime) += maxRescueTime;
 
 		if(VERBOSE >= 0) {
 			fprintf(stderr, "\rReads processed: %d", numReadsProcessed);
 		}
 
-		startTime = time(NULL);
+		startTime = BTimeNow();
+		readOffset = gztell(matchFP);
 	}
 
 
@@ -378,10 +447,15 @@ void RunDynamicProgramming(gzFile matchFP,
 		fprintf(stderr, "Alignment complete.\n");
 	}
 
-	endTime = time(NULL);
+	endTime = BTimeNow();
 
 	if(VERBOSE >=0) {
 		fprintf(stderr, "Performed %lld local alignments.\n", (long long int)numLocalAlignments);
+		if(1 == rescueMates) {
+			fprintf(stderr, "Rescued %lld mates after scanning %lld windows.\n", 
+					(long long int)numRescued,
+					(long long int)numRescueWindows);
+		}
 		fprintf(stderr, "Outputted alignments for %d reads.\n", numAligned);
 		fprintf(stderr, "Outputted %d reads for which there were no alignments.\n", numNotAligned); 
 		fprintf(stderr, "Outputting complete.\n");
@@ -407,6 +481,7 @@ void *RunDynamicProgrammingThread(void *arg)
 	int32_t pairedEndLength=data->pairedEndLength;
 	int32_t mirroringType=data->mirroringType;
 	int32_t forceMirroring=data->forceMirroring;
+	int32_t rescueMates=data->rescueMates;
 	ScoringMatrix *sm = data->sm;
 	int32_t ungapped=data->ungapped;
 	int32_t unconstrained=data->unconstrained;
@@ -423,6 +498,8 @@ void *RunDynamicProgrammingThread(void *arg)
 	//char *FnName = "RunDynamicProgrammingThread";
 	int32_t j, wasAligned, queueIndex;
 	AlignMatrix matrix;
+	int64_t rescueStart;
+	int64_t startTime = BTimeNow();
 	
 	/* Initialize */
 	AlignMatrixInitialize(&matrix);
@@ -437,6 +514,20 @@ void *RunDynamicProgrammingThread(void *arg)
                     if(maxNumMatches < matchQueue[queueIndex].ends[j].numEntries) {
                         matchQueue[queueIndex].ends[j].maxReached = -1;
                     }
+                    data->counters->counts[CounterCALs] += matchQueue[queueIndex].ends[j].numEntries;
+                }
+                data->counters->counts[CounterReads]++;
+                if(1 == rescueMates) {
+                        rescueStart = BTimeNow();
+                        data->numRescued += AlignRescueMates(&matchQueue[queueIndex],
+                                        rg,
+                                        space,
+                                        data->insertSizeAvg,
+                                        data->insertSizeStdDev,
+                                        data->rescueNumStdDev,
+                                        data->rescueNumHits,
+                                        &data->numRescueWindows);
+                        data->rescueTime += BTimeNow() - rescueStart;
                 }
                 if(1 == IsValidMatch(&matchQueue[queueIndex])) {
 
@@ -454,7 +545,8 @@ void *RunDynamicProgrammingThread(void *arg)
                                         pairedEndLength,
                                         mirroringType,
                                         forceMirroring,
-                                        &matrix);
+                                        &matrix,
+                                        data->counters);
 
                         for(j=wasAligned=0;j<alignedQueue[queueIndex].numEnds;j++) {
                                 if(0 < alignedQueue[queueIndex].ends[j].numEntries) {
@@ -500,6 +592,9 @@ void *RunDynamicProgrammingThread(void *arg)
 	/* Free the matrix, free your mind */
 	AlignMatrixFree(&matrix);
 
+	data->computeTime = BTimeNow() - startTime;
+	data->counters->counts[CounterComputeTime] += data->computeTime;
+
 	return arg;
 }
 
@@ -23,6 +23,14 @@ typedef struct {
 	int32_t pairedEndLength;
 	int32_t mirroringType;
 	int32_t forceMirroring;
+	int32_t rescueMates;
+	double insertSizeAvg;
+	double insertSizeStdDev;
+	double rescueNumStdDev;
+	int32_t rescueNumHits;
+	int64_t numRescued;
+	int64_t numRescueWindows;
+	int64_t rescueTime;
 	ScoringMatrix *sm;
 	int32_t ungapped;
 	int32_t unconstrained;
@@ -38,10 +46,12 @@ typedef struct {
 	int64_t numNotAligned;
 	RGMatches *matchQueue;
 	AlignedRead *alignedQueue;
+	BCounters *counters;
+	int64_t computeTime;
 } ThreadData;
 
-void RunAligner(char*, char*, char*, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, FILE*);
-void RunDynamicProgramming(gzFile, RGBinary*, char*, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, gzFile, int32_t*, int32_t*);
+void RunAligner(char*, char*, char*, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, double, double, double, int32_t, int32_t, FILE*);
+void RunDynamicProgramming(gzFile, RGBinary*, char*, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, int32_t, double, double, double, int32_t, gzFile, int64_t*, int64_t*, int64_t*, BCounters*);
 void *RunDynamicProgrammingThread(void *);
 int32_t GetMatches(gzFile, int32_t*, int32_t, int32_t, RGMatches*, int32_t);
 void SkipMatches(gzFile, int32_t*, int32_t);
@@ -14,6 +14,8 @@
 #include "RGReads.h"
 #include "RGMatch.h"
 #include "RGMatches.h"
+#include "RGServe.h"
+#include "RGBloom.h"
 #include "MatchesReadInputFiles.h"
 #include "aflib.h"
 #include "RunMatch.h"
@@ -23,9 +25,13 @@ void RunMatch(
 		char *fastaFileName,
 		char *mainIndexes,
 		char *secondaryIndexes,
+		char *serveName,
 		char *readFileName, 
 		char *offsetsInput,
 		int loadAllIndexes,
+		int prefetchMemory,
+		int stopOnUnique,
+		int minKeys,
 		int compression,
 		int space,
 		int startReadNum,
@@ -38,6 +44,7 @@ void RunMatch(
 		int numThreads,
 		int queueLength,
 		char *tmpDir,
+		int tmpCompression,
 		int timing,
 		FILE *fpOut
 		)
@@ -63,15 +70,23 @@ void RunMatch(
 	int numMatches;
 	int numReads;
 
-	time_t startTime, endTime;
-	int seconds, minutes, hours;
-	int totalReadRGTime = 0;
-	int totalDataStructureTime = 0; /* This will only give the to load and deleted the indexes (excludes searching and other things) */
-	int totalSearchTime = 0; /* This will only give the time searching (excludes load times and other things) */
-	int totalOutputTime = 0; /* This wll only give the total time to merge and output */
+	int64_t startTime, endTime;
+	int minutes, hours;
+	double seconds;
+	int64_t totalReadRGTime = 0;
+	int64_t totalDataStructureTime = 0; /* This will only give the to load and deleted the indexes (excludes searching and other things) */
+	int64_t totalSearchTime = 0; /* This will only give the time searching (excludes load times and other things) */
+	int64_t totalOutputTime = 0; /* This wll only give the total time to merge and output */
+	int64_t startTotalTime = BTimeNow();
+	BCounters *counters=NULL; /* one per thread, then the main thread */
+	char *stageNames[5] = {"readRG", "dataStructure", "search", "output", "prefetch"};
+	int64_t stageTimes[5];
 
 	RGMatches tempRGMatches;
 	RGBinary rg;
+	RGServe servedIndexes;
+	RGServe *serve=NULL;
+	RGIndexPrefetch prefetch;
 	int startChr, startPos, endChr, endPos;
 
 	/* Read in the main RGIndex File Names */
@@ -112,15 +127,30 @@ void RunMatch(
 				space);
 	}
 
-	/* Read in the reference genome */
-	startTime = time(NULL);
-	RGBinaryReadBinary(&rg,
-			space,
-			fastaFileName);
+	/* Aligned so that each thread has its own cache lines */
+	if(0 != posix_memalign((void**)&counters, BFAST_CACHE_LINE_SIZE, sizeof(BCounters)*(numThreads+1))) {
+		PrintError(FnName, "counters", "Could not allocate memory", Exit, MallocMemory);
+	}
+	BCountersInitialize(counters, numThreads+1);
+
+	/* Read in the reference genome, or attach to the served one */
+	startTime = BTimeNow();
+	if(NULL != serveName) {
+		serve = &servedIndexes;
+		RGServeOpen(serve, serveName);
+		RGServeGetBinary(serve, &rg, fastaFileName, space);
+	}
+	else {
+		RGBinaryReadBinary(&rg,
+				space,
+				fastaFileName);
+	}
 	assert(rg.space == space);
-	endTime = time(NULL);
+	endTime = BTimeNow();
 	totalReadRGTime = endTime - startTime;
 
+	RGIndexPrefetchInitialize(&prefetch, serve, space, prefetchMemory);
+
 	/* Read in the offsets */
 	numOffsets = (NULL == offsetsInput) ? 0 : ReadOffsets(offsetsInput, &offsets);
 
@@ -147,10 +177,13 @@ void RunMatch(
 			startReadNum,
 			endReadNum,
 			tmpDir,
+			tmpCompression,
 			&numReads,
 			space);
 	/* Close the read file */
 	AFILE_afclose(seqFP);
+	/* Each read is counted once, however many indexes it is searched in */
+	counters[numThreads].counts[CounterReads] += numReads;
 	if(VERBOSE >= 0) {
 		fprintf(stderr, "Will process %d reads.\n",
 				numReads);
@@ -166,9 +199,17 @@ void RunMatch(
 			mainIndexIDs,
 			numMainIndexes,
 			&rg,
+			serve,
+			&prefetch,
 			offsets,
 			numOffsets,
 			loadAllIndexes,
+			stopOnUnique,
+			fastaFileName,
+			secondaryIndexFileNames,
+			secondaryIndexIDs,
+			(0 < minKeys) ? numSecondaryIndexes : 0,
+			minKeys,
 			space,
 			keySize,
 			maxKeyMatches,
@@ -183,10 +224,12 @@ void RunMatch(
 			(0 < numSecondaryIndexes)?CopyForNextSearch:EndSearch,
 			MainIndexes,
 			tmpDir,
+			tmpCompression,
 			timing,
 			&totalDataStructureTime,
 			&totalSearchTime,
-			&totalOutputTime
+			&totalOutputTime,
+			counters
 				);
 
 	/* Do secondary index search */
@@ -202,9 +245,17 @@ void RunMatch(
 					secondaryIndexIDs,
 					numSecondaryIndexes,
 					&rg,
+					serve,
+					&prefetch,
 					offsets,
 					numOffsets,
 					loadAllIndexes,
+					stopOnUnique,
+					NULL,
+					NULL,
+					NULL,
+					0,
+					0,
 					space,
 					keySize,
 					maxKeyMatches,
@@ -219,10 +270,12 @@ void RunMatch(
 					EndSearch,
 					SecondaryIndexes,
 					tmpDir,
+					tmpCompression,
 					timing,
 					&totalDataStructureTime,
 					&totalSearchTime,
-					&totalOutputTime
+					&totalOutputTime,
+					counters
 						);
 		}
 		else {
@@ -266,6 +319,9 @@ void RunMatch(
 
 	/* Free reference genome */
 	RGBinaryDelete(&rg);
+	if(NULL != serve) {
+		RGServeClose(serve);
+	}
 
 	/* Free offsets */
 	free(offsets);
@@ -273,57 +329,64 @@ void RunMatch(
 	/* Print timing */
 	if(timing == 1) {
 		/* Read RG time */
-		seconds = totalReadRGTime;
-		hours = seconds/3600;
-		seconds -= hours*3600;
-		minutes = seconds/60;
-		seconds -= minutes*60;
-		fprintf(stderr, "Total time loading the reference genome: %d hour, %d minutes and %d seconds.\n",
+		BTimeSplit(totalReadRGTime, &hours, &minutes, &seconds);
+		fprintf(stderr, "Total time loading the reference genome: %d hour, %d minutes and %.3lf seconds.\n",
 				hours,
 				minutes,
 				seconds);
 		/* Data structure time */
-		seconds = totalDataStructureTime;
-		hours = seconds/3600;
-		seconds -= hours*3600;
-		minutes = seconds/60;
-		seconds -= minutes*60;
-		fprintf(stderr, "Total time loading and deleting index%s: %d hour, %d minutes and %d seconds.\n",
+		BTimeSplit(totalDataStructureTime, &hours, &minutes, &seconds);
+		fprintf(stderr, "Total time loading and deleting index%s: %d hour, %d minutes and %.3lf seconds.\n",
 				(1 == numMainIndexes + numSecondaryIndexes) ? "" : "es",
 				hours,
 				minutes,
 				seconds);
+		/* Prefetch time, overlapped with the search */
+		if(0 < prefetchMemory) {
+			BTimeSplit(prefetch.loadTime, &hours, &minutes, &seconds);
+			fprintf(stderr, "Total time loading indexes in the background: %d hour, %d minutes and %.3lf seconds.\n",
+					hours,
+					minutes,
+					seconds);
+		}
 		/* Search time */
-		seconds = totalSearchTime;
-		hours = seconds/3600;
-		seconds -= hours*3600;
-		minutes = seconds/60;
-		seconds -= minutes*60;
-		fprintf(stderr, "Total time searching index%s: %d hour, %d minutes and %d seconds.\n",
+		BTimeSplit(totalSearchTime, &hours, &minutes, &seconds);
+		fprintf(stderr, "Total time searching index%s: %d hour, %d minutes and %.3lf seconds.\n",
 				(1 == numMainIndexes + numSecondaryIndexes) ? "" : "es",
 				hours,
 				minutes,
 				seconds);
 		/* Output time */
-		seconds = totalOutputTime;
-		hours = seconds/3600;
-		seconds -= hours*3600;
-		minutes = seconds/60;
-		seconds -= minutes*60;
-		fprintf(stderr, "Total time merging and writing output: %d hour, %d minutes and %d seconds.\n",
+		BTimeSplit(totalOutputTime, &hours, &minutes, &seconds);
+		fprintf(stderr, "Total time merging and writing output: %d hour, %d minutes and %.3lf seconds.\n",
 				hours,
 				minutes,
 				seconds);
+		stageTimes[0] = totalReadRGTime;
+		stageTimes[1] = totalDataStructureTime;
+		stageTimes[2] = totalSearchTime;
+		stageTimes[3] = totalOutputTime;
+		stageTimes[4] = prefetch.loadTime;
+		BCountersPrintJSON(stderr, "match", BTimeNow() - startTotalTime, stageNames, stageTimes, 5, counters, numThreads);
 	}
+	free(counters);
 }
 
 int FindMatchesInIndexSet(char **indexFileNames,
 		int32_t **indexIDs,
 		int numIndexes,
 		RGBinary *rg,
+		RGServe *serve,
+		RGIndexPrefetch *prefetch,
 		int32_t *offsets,
 		int numOffsets,
 		int loadAllIndexes,
+		int stopOnUnique,
+		char *fastaFileName,
+		char **bloomIndexFileNames,
+		int32_t **bloomIndexIDs,
+		int numBloomIndexes,
+		int minKeys,
 		int space,
 		int keySize,
 		int maxKeyMatches,
@@ -338,10 +401,12 @@ int FindMatchesInIndexSet(char **indexFileNames,
 		int copyForNextSearch,
 		int indexesType,
 		char *tmpDir,
+		int tmpCompression,
 		int timing,
-		int *totalDataStructureTime,
-		int *totalSearchTime,
-		int *totalOutputTime)
+		int64_t *totalDataStructureTime,
+		int64_t *totalSearchTime,
+		int64_t *totalOutputTime,
+		BCounters *counters)
 {
 	char *FnName = "FindMatchesInIndexSet";
 	int i;
@@ -350,9 +415,13 @@ int FindMatchesInIndexSet(char **indexFileNames,
 	gzFile *tempOutputIndexFPs=NULL;
 	char **tempOutputIndexFileNames=NULL;
 	int numWritten=0, numReads=0;
+	int64_t numRejected=0;
+	RGBloom *blooms=NULL;
+	int numBlooms=0;
 	int numMatches = 0;
-	time_t startTime, endTime;
-	int seconds, minutes, hours;
+	int64_t startTime, endTime;
+	int minutes, hours;
+	double seconds;
 	AFILE tempRGMatchesAFP;
 	char *tempRGMatchesFileName=NULL;
 	int32_t numUniqueIndexes = 1;
@@ -387,7 +456,7 @@ int FindMatchesInIndexSet(char **indexFileNames,
 	 * */
 	if(CopyForNextSearch == copyForNextSearch) {
 		/* Open temporary file for the entire index search */
-		tempOutputFP=OpenTmpGZFile(tmpDir, &tempOutputFileName);
+		tempOutputFP=OpenTmpGZFile(tmpDir, &tempOutputFileName, tmpCompression);
 	}
 	else {
 		assert(EndSearch == copyForNextSearch);
@@ -402,7 +471,7 @@ int FindMatchesInIndexSet(char **indexFileNames,
 	else {
 		/* Open tmp files for each index */
 		for(i=0;i<numUniqueIndexes;i++) {
-			tempOutputIndexFPs[i] = OpenTmpGZFile(tmpDir, &tempOutputIndexFileNames[i]); 
+			tempOutputIndexFPs[i] = OpenTmpGZFile(tmpDir, &tempOutputIndexFileNames[i], tmpCompression); 
 		}
 	}
 
@@ -414,10 +483,14 @@ int FindMatchesInIndexSet(char **indexFileNames,
 		// Process all indexes at once
 		numMatches = FindMatches(indexFileNames,
 				numIndexes,
+				NULL,
 				rg,
+				serve,
+				NULL,
 				offsets,
 				numOffsets,
 				loadAllIndexes,
+				stopOnUnique,
 				space,
 				keySize,
 				maxKeyMatches,
@@ -434,7 +507,8 @@ int FindMatchesInIndexSet(char **indexFileNames,
 				timing,
 				totalDataStructureTime,
 				totalSearchTime,
-				totalOutputTime
+				totalOutputTime,
+				counters
 					);
 		if(VERBOSE >= 0) {
 			fprintf(stderr, "Searching index files 1-%d... complete\n", numIndexes);
@@ -460,10 +534,14 @@ int FindMatchesInIndexSet(char **indexFileNames,
 				}
 				numMatches = FindMatches(&indexFileNames[indexNum],
 						1,
+						(indexNum + 1 < numIndexes) ? indexFileNames[indexNum+1] : NULL,
 						rg,
+						serve,
+						prefetch,
 						offsets,
 						numOffsets,
 						loadAllIndexes,
+						stopOnUnique,
 						space,
 						keySize,
 						maxKeyMatches,
@@ -480,7 +558,8 @@ int FindMatchesInIndexSet(char **indexFileNames,
 						timing,
 						totalDataStructureTime,
 						totalSearchTime,
-						totalOutputTime
+						totalOutputTime,
+						counters
 							);
 				if(VERBOSE >= 0) {
 					fprintf(stderr, "Searching index file %d/%d (index #%d, bin #%d) complete...\n", 
@@ -500,7 +579,7 @@ int FindMatchesInIndexSet(char **indexFileNames,
 				}
 
 				for(i=0;i<numBins;i++) {
-					tempOutputIndexBinFPs[i]=OpenTmpGZFile(tmpDir, &tempOutputIndexBinFileNames[i]);
+					tempOutputIndexBinFPs[i]=OpenTmpGZFile(tmpDir, &tempOutputIndexBinFileNames[i], tmpCompression);
 				}
 
 				// search each bin
@@ -515,10 +594,14 @@ int FindMatchesInIndexSet(char **indexFileNames,
 					}
 					FindMatches(&indexFileNames[indexNum],
 							1,
+							(indexNum + 1 < numIndexes) ? indexFileNames[indexNum+1] : NULL,
 							rg,
+							serve,
+							prefetch,
 							offsets,
 							numOffsets,
 							loadAllIndexes,
+							stopOnUnique,
 							space,
 							keySize,
 							maxKeyMatches,
@@ -535,7 +618,8 @@ int FindMatchesInIndexSet(char **indexFileNames,
 							timing,
 							totalDataStructureTime,
 							totalSearchTime,
-							totalOutputTime
+							totalOutputTime,
+							counters
 								);
 					if(VERBOSE >= 0) {
 						fprintf(stderr, "Searching index file %d/%d (index #%d, bin #%d) complete...\n", 
@@ -557,27 +641,26 @@ int FindMatchesInIndexSet(char **indexFileNames,
 				RGIndexInitialize(&tempIndex);
 				RGIndexGetHeader(indexFileNames[indexNum-1], &tempIndex); // use previous
 
-				startTime=time(NULL);
+				startTime=BTimeNow();
 				numMatches = RGMatchesMergeIndexBins(tempOutputIndexBinFPs,
 						numBins,
 						tempOutputIndexFPs[uniqueIndexCtr],
 						&tempIndex,
 						maxKeyMatches,
                                                 keyMissFraction,
-						maxNumMatches);
-				endTime=time(NULL);
+						maxNumMatches,
+						queueLength,
+						numThreads);
+				endTime=BTimeNow();
 				if(VERBOSE >= 0 && timing == 1) {
-					seconds = (int)(endTime - startTime);
-					hours = seconds/3600;
-					seconds -= hours*3600;
-					minutes = seconds/60;
-					seconds -= minutes*60;
-					fprintf(stderr, "Merging matches from the index bins took: %d hours, %d minutes and %d seconds\n",
+					BTimeSplit(endTime - startTime, &hours, &minutes, &seconds);
+					fprintf(stderr, "Merging matches from the index bins took: %d hours, %d minutes and %.3lf seconds\n",
 							hours,
 							minutes,
 							seconds);
 				}
 				(*totalOutputTime)+=endTime-startTime;
+				counters[numThreads].counts[CounterIOTime]+=endTime-startTime;
 
 				// Destroy
 				for(i=0;i<numBins;i++) {
@@ -607,26 +690,24 @@ int FindMatchesInIndexSet(char **indexFileNames,
 						&tempOutputIndexFileNames[i]);
 			}
 
-			startTime=time(NULL);
+			startTime=BTimeNow();
 			/* Merge the temp index files into the all indexes file */
 			numWritten=RGMatchesMergeFilesAndOutput(tempOutputIndexFPs,
 					numUniqueIndexes,
 					tempOutputFP,
 					maxNumMatches,
-					queueLength);
-			endTime=time(NULL);
+					queueLength,
+					numThreads);
+			endTime=BTimeNow();
 			if(VERBOSE >= 0 && timing == 1) {
-				seconds = (int)(endTime - startTime);
-				hours = seconds/3600;
-				seconds -= hours*3600;
-				minutes = seconds/60;
-				seconds -= minutes*60;
-				fprintf(stderr, "Merging matches from the indexes took: %d hours, %d minutes and %d seconds\n",
+				BTimeSplit(endTime - startTime, &hours, &minutes, &seconds);
+				fprintf(stderr, "Merging matches from the indexes took: %d hours, %d minutes and %.3lf seconds\n",
 						hours,
 						minutes,
 						seconds);
 			}
 			(*totalOutputTime)+=endTime-startTime;
+			counters[numThreads].counts[CounterIOTime]+=endTime-startTime;
 
 			/* If we had more than one index, then this is the total merged number of matches */
 			numMatches = numWritten;
@@ -642,6 +723,7 @@ int FindMatchesInIndexSet(char **indexFileNames,
 	if(VERBOSE >= 0) {
 		fprintf(stderr, "Found matches for %d reads.\n", numMatches);
 	}
+	assert(NULL == prefetch || 0 == prefetch->running);
 
 	/* Close the temporary read files */
 	CloseTmpGZFile(tmpSeqFP, tmpSeqFileName, 1);
@@ -661,16 +743,44 @@ int FindMatchesInIndexSet(char **indexFileNames,
 		tempRGMatchesAFP.bz2 = NULL;
 #endif
 		tempRGMatchesAFP.c = AFILE_GZ_COMPRESSION;
-		tempRGMatchesAFP.gz = OpenTmpGZFile(tmpDir, &tempRGMatchesFileName);
+		tempRGMatchesAFP.gz = OpenTmpGZFile(tmpDir, &tempRGMatchesFileName, tmpCompression);
+
+		/* Read in the Bloom filters of the next indexes, only while they are
+		 * used */
+		startTime=BTimeNow();
+		numBlooms=ReadBloomFilters(fastaFileName,
+				bloomIndexFileNames,
+				bloomIndexIDs,
+				numBloomIndexes,
+				space,
+				&blooms);
+		endTime=BTimeNow();
+		(*totalDataStructureTime)+=endTime-startTime;
+		counters[numThreads].counts[CounterIOTime]+=endTime-startTime;
 
-		startTime=time(NULL);
+		startTime=BTimeNow();
 		assert(tempOutputFP != outputFP); // this is very important
-		numWritten=ReadTempReadsAndOutput(tempOutputFP,
-				tempOutputFileName,
+		numWritten=ReadTempReadsAndOutput(&tempOutputFP,
+				&tempOutputFileName,
 				outputFP,
-				&tempRGMatchesAFP);
-		endTime=time(NULL);
+				&tempRGMatchesAFP,
+				blooms,
+				numBlooms,
+				minKeys,
+				&numRejected);
+		endTime=BTimeNow();
 		(*totalOutputTime)+=endTime-startTime;
+		counters[numThreads].counts[CounterIOTime]+=endTime-startTime;
+		counters[numThreads].counts[CounterReadsRejected]+=numRejected;
+		if(VERBOSE >= 0 && 0 < numBlooms) {
+			fprintf(stderr, "Rejected %lld reads with fewer than %d keys in the secondary indexes.\n",
+					(long long int)numRejected,
+					minKeys);
+		}
+		for(i=0;i<numBlooms;i++) {
+			RGBloomDelete(&blooms[i]);
+		}
+		free(blooms);
 
 		/* Move to the beginning of the read file */
 		ReopenTmpGZFile(&tempRGMatchesAFP.gz, &tempRGMatchesFileName);
@@ -687,6 +797,7 @@ int FindMatchesInIndexSet(char **indexFileNames,
 				0,
 				INT_MAX,
 				tmpDir,
+				tmpCompression,
 				&numReads,
 				space);
 		/* In this case, all the reads should be valid so we should apportion all reads */
@@ -719,12 +830,49 @@ int FindMatchesInIndexSet(char **indexFileNames,
 	return numMatches;
 }
 
+/* TODO */
+/* Reads in the Bloom filter of each index, one for all the bins of an
+ * index, and checks that it was made for the index */
+int ReadBloomFilters(char *fastaFileName,
+		char **indexFileNames,
+		int32_t **indexIDs,
+		int numIndexes,
+		int space,
+		RGBloom **blooms)
+{
+	char *FnName = "ReadBloomFilters";
+	int i, numBlooms=0;
+	RGIndex index;
+
+	(*blooms) = NULL;
+	for(i=0;i<numIndexes;i++) {
+		if(0 < i && indexIDs[i][0] == indexIDs[i-1][0]) {
+			continue; /* Another bin of the same index */
+		}
+		(*blooms) = realloc((*blooms), sizeof(RGBloom)*(numBlooms+1));
+		if(NULL == (*blooms)) {
+			PrintError(FnName, "(*blooms)", "Could not reallocate memory", Exit, ReallocMemory);
+		}
+		RGBloomRead(&(*blooms)[numBlooms], fastaFileName, space, indexIDs[i][0]);
+		RGIndexInitialize(&index);
+		RGIndexGetHeader(indexFileNames[i], &index);
+		RGBloomCheckIndex(&(*blooms)[numBlooms], &index);
+		RGIndexDelete(&index);
+		numBlooms++;
+	}
+	return numBlooms;
+}
+
 int FindMatches(char **indexFileName,
 		int32_t numIndexes,
+		char *nextIndexFileName,
 		RGBinary *rg,
+		RGServe *serve,
+		RGIndexPrefetch *prefetch,
 		int32_t *offsets,
 		int numOffsets,
 		int loadAllIndexes,
+		int stopOnUnique,
 		int space,
 		int keySize,
 		int maxKeyMatches,
@@ -739,15 +887,16 @@ int FindMatches(char **indexFileName,
 		int outputOffsets,
 		char *tmpDir,
 		int timing,
-		int *totalDataStructureTime,
-		int *totalSearchTime,
-		int *totalOutputTime)
+		int64_t *totalDataStructureTime,
+		int64_t *totalSearchTime,
+		int64_t *totalOutputTime,
+		BCounters *counters)
 {
 	char *FnName = "FindMatches";
 	int i, j, k;
 	RGIndex *indexes=NULL;
 	int numMatches = 0;
-	time_t startTime, endTime;
+	int64_t startTime, endTime;
 	int errCode;
 	ThreadIndexData *data=NULL;
 	pthread_t *threads=NULL;
@@ -755,6 +904,8 @@ int FindMatches(char **indexFileName,
 	RGMatches *matchQueue=NULL;
 	int32_t matchQueueLength=queueLength;
 	int32_t returnNumMatches=0, numReadsProcessed=0;
+	BCounters *mainCounters = &counters[numThreads];
+	z_off_t readOffset, writeOffset;
 
 	/* Allocate memory for threads */
 	threads=malloc(sizeof(pthread_t)*numThreads);
@@ -777,13 +928,12 @@ int FindMatches(char **indexFileName,
 	}
 
 	/* Read in the RG Index */
-	startTime = time(NULL);
+	startTime = BTimeNow();
 	for(i=0;i<numIndexes;i++) {
-		ReadRGIndex(indexFileName[i], &indexes[i], space);
-		if(IndexesMemoryAll == loadAllIndexes && 0 < indexes[i].depth) {
-			PrintError(FnName, "index[i].depth", "Cannot use binned indexes when loading all into memory", Exit, OutOfRange);
+		/* Take the index if it was loaded in the background, otherwise wait for it */
+		if(NULL == prefetch || 0 == RGIndexPrefetchFinish(prefetch, indexFileName[i], &indexes[i])) {
+			LoadIndex(indexFileName[i], &indexes[i], serve, space);
 		}
-		/* Check that depth = 0 if we have more than one index */
 		/* Adjust if necessary */
 		if(0 < keySize &&
 				indexes[i].hashWidth <= keySize &&
@@ -799,9 +949,14 @@ int FindMatches(char **indexFileName,
 			indexes[i].keysize = keySize;
 		}
 	}
-	endTime = time(NULL);
+	endTime = BTimeNow();
 	(*totalDataStructureTime)+=endTime - startTime;	
 
+	/* Load the next index while this one is searched */
+	if(NULL != prefetch && NULL != nextIndexFileName) {
+		RGIndexPrefetchStart(prefetch, nextIndexFileName, indexes, numIndexes);
+	}
+
 	/* Set position to read from the beginning of the file */
 	ReopenTmpGZFile(tmpSeqFP, tmpSeqFileName);
 
@@ -817,10 +972,13 @@ int FindMatches(char **indexFileName,
 	}
 
 	// Run
-	startTime = time(NULL);
+	startTime = BTimeNow();
+	readOffset = gztell((*tmpSeqFP));
 	while(0!=(numMatches = GetReads((*tmpSeqFP), matchQueue, matchQueueLength, space))) { // Read in data
-		endTime = time(NULL);
+		endTime = BTimeNow();
 		(*totalOutputTime)+=endTime - startTime;
+		mainCounters->counts[CounterIOTime] += endTime - startTime;
+		mainCounters->counts[CounterBytesRead] += gztell((*tmpSeqFP)) - readOffset;
 	
 		// Initialize arguments to threads 
 		for(i=0;i<numThreads;i++) {
@@ -837,11 +995,14 @@ int FindMatches(char **indexFileName,
 			data[i].keyMissFraction = keyMissFraction;
 			data[i].maxNumMatches = maxNumMatches;
 			data[i].whichStrand = whichStrand;
+			data[i].stopOnUnique = stopOnUnique;
 			data[i].outputOffsets = outputOffsets;
 			data[i].threadID = i;
+			data[i].counters = &counters[i];
+			data[i].computeTime = 0;
 		}
 		// Spawn threads
-		startTime = time(NULL);
+		startTime = BTimeNow();
 		/* Open threads */
 		for(i=0;i<numThreads;i++) {
 			/* Start thread */
@@ -864,11 +1025,17 @@ int FindMatches(char **indexFileName,
 			}
 			returnNumMatches += data[i].numMatches;
 		}
-		endTime = time(NULL);
+		endTime = BTimeNow();
 		(*totalSearchTime)+=endTime - startTime;
+		/* The threads wait on the slowest thread, and the main thread on all of them */
+		for(i=0;i<numThreads;i++) {
+			counters[i].counts[CounterWaitTime] += (endTime - startTime) - data[i].computeTime;
+		}
+		mainCounters->counts[CounterWaitTime] += endTime - startTime;
 
 		/* Output to file */
-		startTime = time(NULL);
+		startTime = BTimeNow();
+		writeOffset = gztell(outputFP);
 		for(i=0;i<numMatches;i++) {
 			if(0 == outputOffsets) {
 				RGMatchesPrint(outputFP, 
@@ -879,8 +1046,10 @@ int FindMatches(char **indexFileName,
 						&matchQueue[i]);
 			}
 		}
-		endTime = time(NULL);
+		endTime = BTimeNow();
 		(*totalOutputTime)+=endTime - startTime;
+		mainCounters->counts[CounterIOTime] += endTime - startTime;
+		mainCounters->counts[CounterBytesWritten] += gztell(outputFP) - writeOffset;
 
 		numReadsProcessed += numMatches;
 		if(VERBOSE >= 0) {
@@ -893,10 +1062,12 @@ int FindMatches(char **indexFileName,
 		}
 
 		// For reading
-		startTime = time(NULL);
+		startTime = BTimeNow();
+		readOffset = gztell((*tmpSeqFP));
 	}
-	endTime = time(NULL);
+	endTime = BTimeNow();
 	(*totalOutputTime)+=endTime - startTime;
+	mainCounters->counts[CounterIOTime] += endTime - startTime;
 
 	if(VERBOSE >= 0) {
 		fprintf(stderr, "\rReads processed: %d\n", numReadsProcessed);
@@ -907,12 +1078,12 @@ int FindMatches(char **indexFileName,
 		fprintf(stderr, "Cleaning up index%s.\n",
 				(1 == numIndexes) ? "" : "es");
 	}
-	startTime = time(NULL);
+	startTime = BTimeNow();
 	for(i=0;i<numIndexes;i++) {
 		RGIndexDelete(&indexes[i]);
 	}
 	free(indexes);
-	endTime = time(NULL);
+	endTime = BTimeNow();
 	(*totalDataStructureTime)+=endTime - startTime;	
 
 	// Free match queue
@@ -929,8 +1100,9 @@ int FindMatches(char **indexFileName,
 void *FindMatchesThread(void *arg)
 {
 	//char *FnName="FindMatchesThread";
-	int32_t i, j, k;
+	int32_t i, j, k, numBins;
 	int foundMatch = 0;
+	RGMatch *end=NULL;
 	ThreadIndexData *data=(ThreadIndexData*)arg;
 	/* Function arguments */
 	RGMatches *matchQueue = data->matchQueue;
@@ -946,62 +1118,200 @@ void *FindMatchesThread(void *arg)
 	double keyMissFraction = data->keyMissFraction;
 	int maxNumMatches = data->maxNumMatches;
 	int whichStrand = data->whichStrand;
+	int stopOnUnique = data->stopOnUnique;
 	int outputOffsets = data->outputOffsets;
 	int threadID = data->threadID;
+	BCounters *counters = data->counters;
+	int64_t startTime = BTimeNow();
 	data->numMatches = 0;
 
-        for(i=threadID;i<matchQueueLength;i+=numThreads) {
-                /* Read */
-                foundMatch = 0;
-                for(j=0;j<matchQueue[i].numEnds;j++) {
-                        if(1 == numIndexes) {
-                                RGReadsFindMatches(&indexes[0],
-                                                rg,
-                                                &matchQueue[i].ends[j], 
-                                                outputOffsets,
-                                                offsets,
-                                                numOffsets,
-                                                space,
-                                                0,
-                                                0,
-                                                0,
-                                                0,
-                                                0,
-                                                maxKeyMatches,
-                                                keyMissFraction,
-                                                maxNumMatches,
-                                                whichStrand);
-                        }
-                        else {
-                                for(k=0;k<numIndexes && 0 <= matchQueue[i].ends[j].maxReached;k++) {
-                                        RGReadsFindMatches(&indexes[k],
-                                                        rg,
-                                                        &matchQueue[i].ends[j], 
-                                                        outputOffsets,
-                                                        offsets,
-                                                        numOffsets,
-                                                        space,
-                                                        0,
-                                                        0,
-                                                        0,
-                                                        0,
-                                                        0,
-                                                        maxKeyMatches,
-                                                        keyMissFraction,
-                                                        maxNumMatches,
-                                                        whichStrand);
-                                }
-                        }
-                        if(0 < matchQueue[i].ends[j].numEntries && 0 <= matchQueue[i].ends[j].maxReached) {
-                                foundMatch = 1;
-                        }
-                }
-                if(1 == foundMatch) {
-                        data->numMatches++;
-                        //DEBUGGING
-                        //RGMatchesCheck(&matchQueue[i], rg);
-                }
+	for(i=threadID;i<matchQueueLength;i+=numThreads) {
+		/* Read */
+		foundMatch = 0;
+		for(j=0;j<matchQueue[i].numEnds;j++) {
+			end = &matchQueue[i].ends[j];
+			/* Search each index in turn, stopping when there are too many matches */
+			for(k=0;k<numIndexes && 0 <= end->maxReached;k+=numBins) {
+				/* The bins of an index are next to each other */
+				for(numBins=1;
+						0 < indexes[k].depth && k+numBins < numIndexes && indexes[k+numBins].indexNumber == indexes[k].indexNumber;
+						numBins++) {
+				}
+				if(1 == numBins) {
+					RGReadsFindMatches(&indexes[k],
+							rg,
+							end, 
+							outputOffsets,
+							offsets,
+							numOffsets,
+							space,
+							0,
+							0,
+							0,
+							0,
+							0,
+							maxKeyMatches,
+							keyMissFraction,
+							maxNumMatches,
+							whichStrand,
+							counters);
+				}
+				else {
+					RGReadsFindMatchesInBins(&indexes[k],
+							numBins,
+							rg,
+							end,
+							offsets,
+							numOffsets,
+							space,
+							maxKeyMatches,
+							keyMissFraction,
+							maxNumMatches,
+							whichStrand,
+							counters);
+				}
+				/* One match with no keys skipped will not be improved upon */
+				if(1 == stopOnUnique && 1 == end->numEntries && 0 == end->maxReached) {
+					break;
+				}
+			}
+			if(0 < end->numEntries && 0 <= end->maxReached) {
+				foundMatch = 1;
+			}
+			counters->counts[CounterCALs] += end->numEntries;
+		}
+		if(1 == foundMatch) {
+			data->numMatches++;
+			//DEBUGGING
+			//RGMatchesCheck(&matchQueue[i], rg);
+		}
+	}
+
+	data->computeTime = BTimeNow() - startTime;
+	counters->counts[CounterComputeTime] += data->computeTime;
+
+	return arg;
+}
+
+/* TODO */
+/* Maps the index if it is served, otherwise reads it from disk */
+void LoadIndex(char *indexFileName,
+		RGIndex *index,
+		RGServe *serve,
+		int space)
+{
+	char *FnName="LoadIndex";
+
+	if(NULL == serve || 0 == RGServeGetIndex(serve, index, indexFileName, space)) {
+		if(NULL != serve) {
+			PrintError(FnName, indexFileName, "The index is not served and will be read from disk", Warn, OutOfRange);
+		}
+		ReadRGIndex(indexFileName, index, space);
+	}
+}
+
+/* TODO */
+void RGIndexPrefetchInitialize(RGIndexPrefetch *prefetch,
+		RGServe *serve,
+		int32_t space,
+		int32_t maxMemory)
+{
+	prefetch->running = 0;
+	prefetch->indexFileName = NULL;
+	RGIndexInitialize(&prefetch->index);
+	prefetch->serve = serve;
+	prefetch->space = space;
+	prefetch->maxMemory = maxMemory;
+	prefetch->loadTime = 0;
+}
+
+/* TODO */
+/* Starts loading the next index in the background, but only if it and the
+ * indexes being searched fit in the memory allowed at once. */
+void RGIndexPrefetchStart(RGIndexPrefetch *prefetch,
+		char *indexFileName,
+		RGIndex *indexes,
+		int32_t numIndexes)
+{
+	char *FnName="RGIndexPrefetchStart";
+	RGIndex header;
+	double size=0.0;
+	int32_t i;
+	int errCode;
+
+	assert(0 == prefetch->running);
+	if(prefetch->maxMemory <= 0) {
+		return;
 	}
 
+	for(i=0;i<numIndexes;i++) {
+		size += RGIndexGetSize(&indexes[i], MEGABYTES);
+	}
+	RGIndexInitialize(&header);
+	RGIndexGetHeader(indexFileName, &header);
+	size += RGIndexGetSize(&header, MEGABYTES);
+	RGIndexDelete(&header);
+	if(prefetch->maxMemory < size) {
+		if(VERBOSE >= 0) {
+			fprintf(stderr, "Not loading %s in the background (%.2lf megabytes needed).\n",
+					indexFileName,
+					size);
+		}
+		return;
+	}
+
+	prefetch->indexFileName = indexFileName;
+	RGIndexInitialize(&prefetch->index);
+	errCode = pthread_create(&prefetch->thread,
+			NULL,
+			RGIndexPrefetchThread,
+			prefetch);
+	if(0!=errCode) {
+		PrintError(FnName, "pthread_create: errCode", "Could not start thread", Exit, ThreadError);
+	}
+	prefetch->running = 1;
+}
+
+/* TODO */
+/* Waits for the index being loaded in the background.  Returns zero if it
+ * is not the given index, which must then be loaded by the caller. */
+int32_t RGIndexPrefetchFinish(RGIndexPrefetch *prefetch,
+		char *indexFileName,
+		RGIndex *index)
+{
+	char *FnName="RGIndexPrefetchFinish";
+	void *status;
+	int errCode;
+
+	if(0 == prefetch->running) {
+		return 0;
+	}
+	errCode = pthread_join(prefetch->thread, &status);
+	if(0!=errCode) {
+		PrintError(FnName, "pthread_join: errCode", "Thread returned an error", Exit, ThreadError);
+	}
+	prefetch->running = 0;
+
+	if(0 != strcmp(indexFileName, prefetch->indexFileName)) {
+		RGIndexDelete(&prefetch->index);
+		return 0;
+	}
+	(*index) = prefetch->index;
+	RGIndexInitialize(&prefetch->index);
+	return 1;
+}
+
+/* TODO */
+void *RGIndexPrefetchThread(void *arg)
+{
+	RGIndexPrefetch *prefetch = (RGIndexPrefetch*)arg;
+	int64_t startTime = BTimeNow();
+
+	LoadIndex(prefetch->indexFileName,
+			&prefetch->index,
+			prefetch->serve,
+			prefetch->space);
+	prefetch->loadTime += BTimeNow() - startTime;
+
 	return arg;
 }
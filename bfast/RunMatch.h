@@ -13,6 +13,7 @@
 #endif
 
 #include <stdio.h>
+#include <pthread.h>
 #include "BLibDefinitions.h"
 
 typedef struct {
@@ -29,18 +30,37 @@ typedef struct {
 	double keyMissFraction;
 	int maxNumMatches;
 	int whichStrand;
+	int stopOnUnique;
 	int numMatches;
 	int outputOffsets;
 	int threadID;
+	BCounters *counters;
+	int64_t computeTime;
 } ThreadIndexData;
 
+/* Loads the next index in the background while the current one is searched */
+typedef struct {
+	pthread_t thread;
+	int32_t running;
+	char *indexFileName;
+	RGIndex index;
+	RGServe *serve;
+	int32_t space;
+	int32_t maxMemory; /* in megabytes for the current and next index, zero disables */
+	int64_t loadTime; /* the total time spent loading in the background */
+} RGIndexPrefetch;
+
 void RunMatch(
 		char *fastaFileName,
 		char *mainIndexes,
 		char *secondaryIndexes,
+		char *serveName,
 		char *readFileName,
 		char *offsets,
 		int loadAllIndexes,
+		int prefetchMemory,
+		int stopOnUnique,
+		int minKeys,
 		int compression,
 		int space,
 		int startReadNum,
@@ -53,6 +73,7 @@ void RunMatch(
 		int numThreads,
 		int queueLength,
 		char *tmpDir,
+		int tmpCompression,
 		int timing,
 		FILE *fpOut
 		);
@@ -60,9 +81,17 @@ int FindMatchesInIndexSet(char **indexFileNames,
 		int32_t **indexIDs,
 		int numRGIndexes,
 		RGBinary *rg,
+		RGServe *serve,
+		RGIndexPrefetch *prefetch,
 		int32_t *offsets,
 		int numOffsets,
 		int loadAllIndexes,
+		int stopOnUnique,
+		char *fastaFileName,
+		char **bloomIndexFileNames,
+		int32_t **bloomIndexIDs,
+		int numBloomIndexes,
+		int minKeys,
 		int colorSpace,
 		int keySize,
 		int maxKeyMatches,
@@ -77,16 +106,23 @@ int FindMatchesInIndexSet(char **indexFileNames,
 		int copyForNextSearch,
 		int indexesType,
 		char *tmpDir,
+		int tmpCompression,
 		int timing,
-		int *totalDataStructureTime,
-		int *totalSearchTime,
-		int *totalOutputTime);
+		int64_t *totalDataStructureTime,
+		int64_t *totalSearchTime,
+		int64_t *totalOutputTime,
+		BCounters *counters);
+int ReadBloomFilters(char*, char**, int32_t**, int, int, RGBloom**);
 int FindMatches(char **indexFileName,
 		int32_t numIndexes,
+		char *nextIndexFileName,
 		RGBinary *rg,
+		RGServe *serve,
+		RGIndexPrefetch *prefetch,
 		int32_t *offsets,
 		int numOffsets,
 		int loadAllIndexes,
+		int stopOnUnique,
 		int colorSpace,
 		int keySize,
 		int maxKeyMatches,
@@ -101,9 +137,15 @@ int FindMatches(char **indexFileName,
 		int outputOffsets,
 		char *tmpDir,
 		int timing,
-		int *totalDataStructureTime,
-		int *totalSearchTime,
-		int *totalOutputTime);
+		int64_t *totalDataStructureTime,
+		int64_t *totalSearchTime,
+		int64_t *totalOutputTime,
+		BCounters *counters);
 void *FindMatchesThread(void *arg);
+void LoadIndex(char*, RGIndex*, RGServe*, int);
+void RGIndexPrefetchInitialize(RGIndexPrefetch*, RGServe*, int32_t, int32_t);
+void RGIndexPrefetchStart(RGIndexPrefetch*, char*, RGIndex*, int32_t);
+int32_t RGIndexPrefetchFinish(RGIndexPrefetch*, char*, RGIndex*);
+void *RGIndexPrefetchThread(void*);
 
 #endif
@@ -109,36 +109,44 @@ void ReadInputFilterAndOutput(RGBinary *rg,
 		double insertSizeAvg,
 		double insertSizeStdDev,
 		int numThreads,
+		int numFormatThreads,
 		int queueLength,
 		int outputFormat,
 		char *outputID,
 		char *readGroup,
                 int baseQualityType,
+		int sort,
+		int32_t sortMemoryLimit,
+		char *tmpDir,
+		int timing,
 		FILE *fpOut)
 {
 	char *FnName="ReadInputFilterAndOutput";
 	gzFile fp=NULL;
-	int32_t i, j;
-	int32_t numUnmapped=0, numReported=0;
+	int32_t i, k;
 	gzFile fpReportedGZ=NULL;
 	FILE *fpReported=NULL;
-	int32_t *mappedEndCounts=NULL;
-	int32_t mappedEndCountsNumEnds=-1;
-	int8_t *foundTypes=NULL;
 	char *readGroupString=NULL;
 	pthread_t *threads=NULL;
+	pthread_t readThread, writeThread;
 	int errCode;
 	void *status=NULL;
 	PostProcessThreadData *data=NULL;
+	PostProcessReadThreadData readData;
+	PostProcessWriteThreadData writeData;
+	PostProcessPipeline pipeline;
+	PostProcessBatch *batch=NULL;
 	ScoringMatrix sm;
-	int32_t matchScore ,mismatchScore, numRead, queueIndex;
-	int32_t numReadsProcessed = 0;
-	AlignedRead *alignQueue=NULL;
-	int32_t alignQueueLength = 0;
-	int32_t **numEntries=NULL;
-	int32_t *numEntriesN=NULL;
+	int32_t matchScore ,mismatchScore;
 	PEDBins bins;
-
+	PostProcessSort sorter;
+	BCounters *counters=NULL;
+	int64_t startTime, endTime, waitTime, startBatchTime;
+	int64_t totalTime = 0, pairingTime = 0, filterTime = 0, sortTime = 0;
+	char *stageNames[] = {"pairing", "filter", "read", "write", "sort"};
+	int64_t stageTimes[5];
+
+	totalTime = BTimeNow();
 	srand48(1); // to get the same behavior
 
 	/* Read in scoring matrix */
@@ -189,7 +197,13 @@ void ReadInputFilterAndOutput(RGBinary *rg,
 		}
 	}
 
-	AlignedReadConvertPrintHeader(fpReported, rg, outputFormat, readGroup);
+	AlignedReadConvertPrintHeader(fpReported, rg, outputFormat, readGroup, sort);
+
+	/* The formatted records are buffered and sorted before being written */
+	if(1 == sort) {
+		assert(SAM == outputFormat);
+		PostProcessSortInitialize(&sorter, rg, sortMemoryLimit, tmpDir, numFormatThreads);
+	}
 
 	/* Allocate memory for threads */
 	threads=malloc(sizeof(pthread_t)*numThreads);
@@ -201,49 +215,110 @@ void ReadInputFilterAndOutput(RGBinary *rg,
 	if(NULL==data) {
 		PrintError(FnName, "data", "Could not allocate memory", Exit, MallocMemory);
 	}
-
-	alignQueueLength=queueLength;
-	alignQueue=malloc(sizeof(AlignedRead)*alignQueueLength);
-	if(NULL == alignQueue) {
-		PrintError(FnName, "alignQueue", "Could not allocate memory", Exit, MallocMemory);
-	}
-	numEntries=malloc(sizeof(int32_t*)*alignQueueLength);
-	if(NULL == numEntries) {
-		PrintError(FnName, "numEntries", "Could not allocate memory", Exit, MallocMemory);
-	}
-	numEntriesN=malloc(sizeof(int32_t)*alignQueueLength);
-	if(NULL == numEntriesN) {
-		PrintError(FnName, "numEntriesN", "Could not allocate memory", Exit, MallocMemory);
+	/* One set of counters per filter thread, the last for the reader and writer,
+	 * aligned so that each thread has its own cache lines */
+	if(0 != posix_memalign((void**)&counters, BFAST_CACHE_LINE_SIZE, sizeof(BCounters)*(numThreads+1))) {
+		PrintError(FnName, "counters", "Could not allocate memory", Exit, MallocMemory);
 	}
-	foundTypes=malloc(sizeof(int8_t)*alignQueueLength);
-	if(NULL == foundTypes) {
-		PrintError(FnName, "foundTypes", "Could not allocate memory", Exit, MallocMemory);
-	}
-
-	// Initialize
-	for(i=0;i<alignQueueLength;i++) {
-		numEntries[i] = NULL;
-		numEntriesN[i] = 0;
+	BCountersInitialize(counters, numThreads+1);
+
+	/* Allocate the batches */
+	for(k=0;k<POSTPROCESS_NUM_BATCHES;k++) {
+		batch = &pipeline.batches[k];
+		batch->alignQueue=malloc(sizeof(AlignedRead)*queueLength);
+		if(NULL == batch->alignQueue) {
+			PrintError(FnName, "batch->alignQueue", "Could not allocate memory", Exit, MallocMemory);
+		}
+		batch->numEntries=malloc(sizeof(int32_t*)*queueLength);
+		if(NULL == batch->numEntries) {
+			PrintError(FnName, "batch->numEntries", "Could not allocate memory", Exit, MallocMemory);
+		}
+		batch->numEntriesN=malloc(sizeof(int32_t)*queueLength);
+		if(NULL == batch->numEntriesN) {
+			PrintError(FnName, "batch->numEntriesN", "Could not allocate memory", Exit, MallocMemory);
+		}
+		batch->foundTypes=malloc(sizeof(int8_t)*queueLength);
+		if(NULL == batch->foundTypes) {
+			PrintError(FnName, "batch->foundTypes", "Could not allocate memory", Exit, MallocMemory);
+		}
+		batch->properPairs=malloc(sizeof(int8_t)*queueLength);
+		if(NULL == batch->properPairs) {
+			PrintError(FnName, "batch->properPairs", "Could not allocate memory", Exit, MallocMemory);
+		}
+		// Initialize
+		for(i=0;i<queueLength;i++) {
+			batch->numEntries[i] = NULL;
+			batch->numEntriesN[i] = 0;
+		}
+		batch->numRead = 0;
+		batch->state = PostProcessBatchEmpty;
 	}
+	pthread_mutex_init(&pipeline.lock, NULL);
+	pthread_cond_init(&pipeline.changed, NULL);
 
 	/* Go through each read */
 	if(VERBOSE >= 0) {
 		fprintf(stderr, "Postprocessing...\n");
 	}
-	numRead = 0;
         PEDBinsInitialize(&bins, insertSizeSpecified, insertSizeAvg, insertSizeStdDev);
-	while(0 != (numRead = GetAlignedReads(fp, alignQueue, alignQueueLength))) {
+
+	/* Start reading and writing, the filtering is performed below */
+	readData.pipeline = &pipeline;
+	readData.fp = fp;
+	readData.queueLength = queueLength;
+	BCountersInitialize(&readData.counters, 1);
+	errCode = pthread_create(&readThread, NULL, PostProcessReadThread, &readData);
+	if(0!=errCode) {
+		PrintError(FnName, "pthread_create: errCode", "Could not start thread", Exit, ThreadError);
+	}
+	writeData.pipeline = &pipeline;
+	writeData.rg = rg;
+	writeData.fpReported = fpReported;
+	writeData.fpReportedGZ = fpReportedGZ;
+	writeData.outputID = outputID;
+	writeData.readGroupString = readGroupString;
+	writeData.algorithm = algorithm;
+	writeData.outputFormat = outputFormat;
+	writeData.baseQualityType = baseQualityType;
+	writeData.numFormatThreads = numFormatThreads;
+	writeData.numUnmapped = 0;
+	writeData.numReported = 0;
+	writeData.mappedEndCounts = NULL;
+	writeData.mappedEndCountsNumEnds = -1;
+	writeData.sort = (1 == sort) ? &sorter : NULL;
+	writeData.timing = timing;
+	BCountersInitialize(&writeData.counters, 1);
+	errCode = pthread_create(&writeThread, NULL, PostProcessWriteThread, &writeData);
+	if(0!=errCode) {
+		PrintError(FnName, "pthread_create: errCode", "Could not start thread", Exit, ThreadError);
+	}
+
+	for(k=0;;k++) {
+		startTime = BTimeNow();
+		batch = PostProcessPipelineWait(&pipeline, k, PostProcessBatchRead);
+		/* The filter threads are idle while waiting on the reader */
+		waitTime = BTimeNow() - startTime;
+		for(i=0;i<numThreads;i++) {
+			counters[i].counts[CounterWaitTime] += waitTime;
+		}
+		if(0 == batch->numRead) {
+			PostProcessPipelineSet(&pipeline, batch, PostProcessBatchFiltered);
+			break;
+		}
 
 		/* Get the PEDBins if necessary */
+		startTime = BTimeNow();
                 if(0 == unpaired) {
-	      	  GetPEDBins(alignQueue, numRead, strandedness, positioning, &bins);
+	      	  GetPEDBins(batch->alignQueue, batch->numRead, strandedness, positioning, numThreads, &bins);
                 }
+		endTime = BTimeNow();
+		pairingTime += endTime - startTime;
+		startBatchTime = endTime;
 
 		// Store the original # of entries for SAM output
-		for(i=0;i<numRead;i++) {
-			numEntries[i] = NULL;
-			numEntriesN[i] = 0;
-			foundTypes[i] = NoneFound;
+		for(i=0;i<batch->numRead;i++) {
+			batch->foundTypes[i] = NoneFound;
+			batch->properPairs[i] = 0;
 		}
 
 		/* Initialize thread data */
@@ -260,13 +335,16 @@ void ReadInputFilterAndOutput(RGBinary *rg,
 			data[i].mismatchScore = mismatchScore;
 			data[i].minimumMappingQuality = minimumMappingQuality; 
 			data[i].minimumNormalizedScore = minimumNormalizedScore; 
-			data[i].alignQueue =  alignQueue;
-			data[i].queueLength = numRead;
-			data[i].foundTypes = foundTypes;
-			data[i].numEntriesN = numEntriesN;
-			data[i].numEntries = numEntries;
+			data[i].alignQueue =  batch->alignQueue;
+			data[i].queueLength = batch->numRead;
+			data[i].foundTypes = batch->foundTypes;
+			data[i].properPairs = batch->properPairs;
+			data[i].numEntriesN = batch->numEntriesN;
+			data[i].numEntries = batch->numEntries;
 			data[i].threadID = i;
 			data[i].numThreads = numThreads;
+			data[i].counters = &counters[i];
+			data[i].computeTime = 0;
 		}
 
 		/* Open threads */
@@ -290,121 +368,791 @@ void ReadInputFilterAndOutput(RGBinary *rg,
 				PrintError(FnName, "pthread_join: errCode", "Thread returned an error", Exit, ThreadError);
 			}
 		}
+		endTime = BTimeNow();
+		filterTime += endTime - startBatchTime;
+		/* Time not spent filtering was spent waiting on the other threads */
+		for(i=0;i<numThreads;i++) {
+			counters[i].counts[CounterWaitTime] += (endTime - startBatchTime) - data[i].computeTime;
+		}
 
-		/* Print to Output file */
-		for(queueIndex=0;queueIndex<numRead;queueIndex++) {
-			int32_t numEnds=0;
-			if(NoneFound == foundTypes[queueIndex]) {
-				/* Free the alignments for output */
-				for(i=0;i<alignQueue[queueIndex].numEnds;i++) {
-					for(j=0;j<alignQueue[queueIndex].ends[i].numEntries;j++) {
-						AlignedEntryFree(&alignQueue[queueIndex].ends[i].entries[j]);
-					}
-					alignQueue[queueIndex].ends[i].numEntries=0;
-				}
-			}
-			else {
-				numReported++;
+		/* Hand over to the writer */
+		PostProcessPipelineSet(&pipeline, batch, PostProcessBatchFiltered);
+	}
+
+	/* Wait for the reader and writer */
+	errCode = pthread_join(readThread, &status);
+	if(0!=errCode) {
+		PrintError(FnName, "pthread_join: errCode", "Thread returned an error", Exit, ThreadError);
+	}
+	errCode = pthread_join(writeThread, &status);
+	if(0!=errCode) {
+		PrintError(FnName, "pthread_join: errCode", "Thread returned an error", Exit, ThreadError);
+	}
+
+	/* Merge the sorted records into the output */
+	if(1 == sort) {
+		startTime = BTimeNow();
+		PostProcessSortFinish(&sorter, fpReported);
+		PostProcessSortFree(&sorter);
+		sortTime = BTimeNow() - startTime;
+	}
+
+        /* Free */
+        PEDBinsFree(&bins);
+	if(0 <= VERBOSE) {
+		fprintf(stderr, "Alignment complete.\n");
+	}
+
+
+	/* Close output files, if necessary */
+	if(BAF == outputFormat) {
+		gzclose(fpReportedGZ);
+	}
+	else {
+		fclose(fpReported);
+	}
+	/* Close the input file */
+	gzclose(fp);
+
+	if(VERBOSE>=0) {
+		fprintf(stderr, "%s", BREAK_LINE);
+		fprintf(stderr, "Found %10lld reads with no ends mapped.\n", 
+				(long long int)writeData.numUnmapped);
+		if(!(writeData.mappedEndCountsNumEnds < 1 || writeData.numUnmapped == writeData.mappedEndCounts[0])) {
+			fprintf(stderr, "%d < 1 || %d == %d\n",
+					writeData.mappedEndCountsNumEnds,
+					(int)writeData.numUnmapped,
+					writeData.mappedEndCounts[0]);
+		}
+		assert(writeData.mappedEndCountsNumEnds < 1 || writeData.numUnmapped == writeData.mappedEndCounts[0]);
+		for(i=1;i<=writeData.mappedEndCountsNumEnds;i++) {
+			if(1 == i) fprintf(stderr, "Found %10d reads with %2d end mapped.\n", writeData.mappedEndCounts[i], i);
+			else fprintf(stderr, "Found %10d reads with %2d ends mapped.\n", writeData.mappedEndCounts[i], i);
+		}
+		fprintf(stderr, "Found %10lld reads with at least one end mapping.\n",
+				(long long int)writeData.numReported);
+		fprintf(stderr, "%s", BREAK_LINE);
+	}
+	if(1 == timing) {
+		/* The reader and writer are reported together */
+		for(i=0;i<NumCounters;i++) {
+			counters[numThreads].counts[i] = readData.counters.counts[i] + writeData.counters.counts[i];
+		}
+		stageTimes[0] = pairingTime;
+		stageTimes[1] = filterTime;
+		stageTimes[2] = readData.counters.counts[CounterIOTime];
+		stageTimes[3] = writeData.counters.counts[CounterIOTime];
+		stageTimes[4] = sortTime;
+		BCountersPrintJSON(stderr, "postprocess", BTimeNow() - totalTime, stageNames, stageTimes, 5, counters, numThreads);
+	}
+
+	pthread_mutex_destroy(&pipeline.lock);
+	pthread_cond_destroy(&pipeline.changed);
+	for(k=0;k<POSTPROCESS_NUM_BATCHES;k++) {
+		free(pipeline.batches[k].alignQueue);
+		free(pipeline.batches[k].foundTypes);
+		free(pipeline.batches[k].properPairs);
+		free(pipeline.batches[k].numEntries);
+		free(pipeline.batches[k].numEntriesN);
+	}
+	free(writeData.mappedEndCounts);
+	free(readGroupString);
+	free(threads);
+	free(data);
+	free(counters);
+}
+
+/* TODO */
+/* Waits until the kth batch is in the given state */
+PostProcessBatch *PostProcessPipelineWait(PostProcessPipeline *pipeline,
+		int32_t k,
+		int32_t state)
+{
+	PostProcessBatch *batch = &pipeline->batches[k % POSTPROCESS_NUM_BATCHES];
+
+	pthread_mutex_lock(&pipeline->lock);
+	while(batch->state != state) {
+		pthread_cond_wait(&pipeline->changed, &pipeline->lock);
+	}
+	pthread_mutex_unlock(&pipeline->lock);
+
+	return batch;
+}
+
+/* TODO */
+void PostProcessPipelineSet(PostProcessPipeline *pipeline,
+		PostProcessBatch *batch,
+		int32_t state)
+{
+	pthread_mutex_lock(&pipeline->lock);
+	batch->state = state;
+	pthread_cond_broadcast(&pipeline->changed);
+	pthread_mutex_unlock(&pipeline->lock);
+}
+
+/* TODO */
+/* The input is a single gzip stream so it is read by one thread */
+void *PostProcessReadThread(void *arg)
+{
+	PostProcessReadThreadData *data = (PostProcessReadThreadData*)arg;
+	PostProcessBatch *batch=NULL;
+	int32_t k;
+	int64_t startTime, endTime, startPos;
+
+	for(k=0;;k++) {
+		startTime = BTimeNow();
+		batch = PostProcessPipelineWait(data->pipeline, k, PostProcessBatchEmpty);
+		endTime = BTimeNow();
+		data->counters.counts[CounterWaitTime] += endTime - startTime;
+		startPos = gztell(data->fp);
+		batch->numRead = GetAlignedReads(data->fp, batch->alignQueue, data->queueLength);
+		data->counters.counts[CounterBytesRead] += gztell(data->fp) - startPos;
+		data->counters.counts[CounterIOTime] += BTimeNow() - endTime;
+		PostProcessPipelineSet(data->pipeline, batch, PostProcessBatchRead);
+		if(0 == batch->numRead) {
+			break;
+		}
+	}
+
+	return arg;
+}
+
+/* TODO */
+void *PostProcessWriteThread(void *arg)
+{
+	char *FnName="PostProcessWriteThread";
+	PostProcessWriteThreadData *data = (PostProcessWriteThreadData*)arg;
+	PostProcessBatch *batch=NULL;
+	PostProcessFormatThreadData *formatData=NULL;
+	pthread_t *formatThreads=NULL;
+	int32_t numFormatThreads = data->numFormatThreads;
+	int32_t i, k, queueIndex, numEnds, errCode;
+	int32_t numReadsProcessed = 0;
+	int64_t startTime, endTime, startPos=0;
+	int inMemory;
+	void *status=NULL;
+
+	/* Only SAM is formatted in memory, since BAF is compressed into a
+	 * single stream */
+	if(SAM != data->outputFormat) {
+		numFormatThreads = 1;
+	}
+	/* Formatting in memory also gives the number of bytes written */
+	inMemory = (1 < numFormatThreads || NULL != data->sort || (SAM == data->outputFormat && 1 == data->timing)) ? 1 : 0;
+	if(1 == inMemory) {
+		formatThreads=malloc(sizeof(pthread_t)*numFormatThreads);
+		if(NULL==formatThreads) {
+			PrintError(FnName, "formatThreads", "Could not allocate memory", Exit, MallocMemory);
+		}
+		formatData=malloc(sizeof(PostProcessFormatThreadData)*numFormatThreads);
+		if(NULL==formatData) {
+			PrintError(FnName, "formatData", "Could not allocate memory", Exit, MallocMemory);
+		}
+	}
+
+	for(k=0;;k++) {
+		startTime = BTimeNow();
+		batch = PostProcessPipelineWait(data->pipeline, k, PostProcessBatchFiltered);
+		endTime = BTimeNow();
+		data->counters.counts[CounterWaitTime] += endTime - startTime;
+		if(0 == batch->numRead) {
+			break;
+		}
+
+		/* Count */
+		for(queueIndex=0;queueIndex<batch->numRead;queueIndex++) {
+			if(NoneFound != batch->foundTypes[queueIndex]) {
+				data->numReported++;
 			}
 
 			// Get the # of ends
 			numEnds = 0;
-			for(i=0;i<alignQueue[queueIndex].numEnds;i++) {
-				if(0 < alignQueue[queueIndex].ends[i].numEntries) {
+			for(i=0;i<batch->alignQueue[queueIndex].numEnds;i++) {
+				if(0 < batch->alignQueue[queueIndex].ends[i].numEntries) {
 					numEnds++;
 				}
 			}
 			if(0 == numEnds) {
-				numUnmapped++;
+				data->numUnmapped++;
 			}
 			// Clean up
-			if(mappedEndCountsNumEnds < numEnds) {
+			if(data->mappedEndCountsNumEnds < numEnds) {
 				// Reallocate
-				mappedEndCounts = realloc(mappedEndCounts, sizeof(int32_t)*(1+numEnds));
-				if(NULL == mappedEndCounts) {
-					PrintError(FnName, "mappedEndCounts", "Could not reallocate memory", Exit, ReallocMemory);
+				data->mappedEndCounts = realloc(data->mappedEndCounts, sizeof(int32_t)*(1+numEnds));
+				if(NULL == data->mappedEndCounts) {
+					PrintError(FnName, "data->mappedEndCounts", "Could not reallocate memory", Exit, ReallocMemory);
 				}
 				// Initialize
-				for(i=1+mappedEndCountsNumEnds;i<=numEnds;i++) {
-					mappedEndCounts[i] = 0;
+				for(i=1+data->mappedEndCountsNumEnds;i<=numEnds;i++) {
+					data->mappedEndCounts[i] = 0;
+				}
+				data->mappedEndCountsNumEnds = numEnds;
+			}
+			data->mappedEndCounts[numEnds]++;
+		}
+
+		/* Print to Output file */
+		startTime = BTimeNow();
+		if(1 == inMemory) {
+			for(i=0;i<numFormatThreads;i++) {
+				formatData[i].batch = batch;
+				formatData[i].startIndex = (int32_t)(((int64_t)batch->numRead * i) / numFormatThreads);
+				formatData[i].endIndex = (int32_t)(((int64_t)batch->numRead * (i+1)) / numFormatThreads);
+				formatData[i].rg = data->rg;
+				formatData[i].outputID = data->outputID;
+				formatData[i].readGroupString = data->readGroupString;
+				formatData[i].algorithm = data->algorithm;
+				formatData[i].outputFormat = data->outputFormat;
+				formatData[i].baseQualityType = data->baseQualityType;
+				formatData[i].output = NULL;
+				formatData[i].outputLength = 0;
+				errCode = pthread_create(&formatThreads[i], NULL, PostProcessFormatThread, &formatData[i]);
+				if(0!=errCode) {
+					PrintError(FnName, "pthread_create: errCode", "Could not start thread", Exit, ThreadError);
 				}
-				mappedEndCountsNumEnds = numEnds;
 			}
-			mappedEndCounts[numEnds]++;
-
-			// Proper pair ? 
-			int properPair = 0;
-			if(2 == alignQueue[queueIndex].numEnds && 0 == unpaired) {
-                            if(1 == alignQueue[queueIndex].ends[0].numEntries && 1 == alignQueue[queueIndex].ends[1].numEntries) {
-                                properPair = 1 - isDiscordantPair(&alignQueue[queueIndex].ends[0].entries[0],
-                                                                  &alignQueue[queueIndex].ends[1].entries[0],
-                                                                  strandedness,
-                                                                  positioning,
-                                                                  &bins);
-                            }
+			/* Write in order */
+			for(i=0;i<numFormatThreads;i++) {
+				errCode = pthread_join(formatThreads[i], &status);
+				if(0!=errCode) {
+					PrintError(FnName, "pthread_join: errCode", "Thread returned an error", Exit, ThreadError);
+				}
+				data->counters.counts[CounterBytesWritten] += formatData[i].outputLength;
+				if(NULL != data->sort) {
+					PostProcessSortAdd(data->sort, formatData[i].output, formatData[i].outputLength);
+				}
+				else if(formatData[i].outputLength != fwrite(formatData[i].output, sizeof(char), formatData[i].outputLength, data->fpReported)) {
+					PrintError(FnName, "formatData[i].output", "Could not write to the output file", Exit, WriteFileError);
+				}
+				free(formatData[i].output);
 			}
-			AlignedReadConvertPrintOutputFormat(&alignQueue[queueIndex], rg, fpReported, fpReportedGZ, (NULL == outputID) ? "" : outputID, readGroupString, algorithm, numEntries[queueIndex], outputFormat, properPair, baseQualityType, BinaryOutput);
+		}
+		else {
+			if(BAF == data->outputFormat) {
+				startPos = gztell(data->fpReportedGZ);
+			}
+			for(queueIndex=0;queueIndex<batch->numRead;queueIndex++) {
+				AlignedReadConvertPrintOutputFormat(&batch->alignQueue[queueIndex], data->rg, data->fpReported, data->fpReportedGZ, (NULL == data->outputID) ? "" : data->outputID, data->readGroupString, data->algorithm, batch->numEntries[queueIndex], data->outputFormat, batch->properPairs[queueIndex], data->baseQualityType, BinaryOutput);
 
-			/* Free memory */
-			AlignedReadFree(&alignQueue[queueIndex]);
+				/* Free memory */
+				AlignedReadFree(&batch->alignQueue[queueIndex]);
+			}
+			if(BAF == data->outputFormat) {
+				data->counters.counts[CounterBytesWritten] += gztell(data->fpReportedGZ) - startPos;
+			}
 		}
+		data->counters.counts[CounterIOTime] += BTimeNow() - startTime;
 
 		// Free
-		for(i=0;i<numRead;i++) {
-			free(numEntries[i]);
-			numEntries[i] = NULL;
-			numEntriesN[i] = 0;
+		for(i=0;i<batch->numRead;i++) {
+			free(batch->numEntries[i]);
+			batch->numEntries[i] = NULL;
+			batch->numEntriesN[i] = 0;
 		}
 
-		numReadsProcessed += numRead;
+		numReadsProcessed += batch->numRead;
 		if(VERBOSE >= 0) {
 			fprintf(stderr, "Reads processed: %d\n%s", numReadsProcessed, BREAK_LINE);
 		}
+
+		/* Hand back to the reader */
+		PostProcessPipelineSet(data->pipeline, batch, PostProcessBatchEmpty);
 	}
-        /* Free */
-        PEDBinsFree(&bins);
-	if(0 <= VERBOSE) {
-		fprintf(stderr, "Alignment complete.\n");
+
+	free(formatThreads);
+	free(formatData);
+
+	return arg;
+}
+
+/* TODO */
+/* Formats a contiguous range of the batch into memory */
+void *PostProcessFormatThread(void *arg)
+{
+	char *FnName="PostProcessFormatThread";
+	PostProcessFormatThreadData *data = (PostProcessFormatThreadData*)arg;
+	PostProcessBatch *batch = data->batch;
+	FILE *fp=NULL;
+	int32_t queueIndex;
+
+	if(!(fp=open_memstream(&data->output, &data->outputLength))) {
+		PrintError(FnName, "fp", "Could not open a memory stream", Exit, OpenFileError);
 	}
+	for(queueIndex=data->startIndex;queueIndex<data->endIndex;queueIndex++) {
+		AlignedReadConvertPrintOutputFormat(&batch->alignQueue[queueIndex], data->rg, fp, NULL, (NULL == data->outputID) ? "" : data->outputID, data->readGroupString, data->algorithm, batch->numEntries[queueIndex], data->outputFormat, batch->properPairs[queueIndex], data->baseQualityType, BinaryOutput);
 
+		/* Free memory */
+		AlignedReadFree(&batch->alignQueue[queueIndex]);
+	}
+	fclose(fp);
 
-	/* Close output files, if necessary */
-	if(BAF == outputFormat) {
-		gzclose(fpReportedGZ);
+	return arg;
+}
+
+/* TODO */
+void PostProcessSortInitialize(PostProcessSort *sort,
+		RGBinary *rg,
+		int32_t memoryLimit,
+		char *tmpDir,
+		int32_t numThreads)
+{
+	char *FnName="PostProcessSortInitialize";
+	int32_t i;
+
+	/* Look up the contig of each record by name, in the order of the header */
+	sort->numContigs = rg->numContigs;
+	sort->contigs = malloc(sizeof(PostProcessSortContig)*sort->numContigs);
+	if(NULL == sort->contigs) {
+		PrintError(FnName, "sort->contigs", "Could not allocate memory", Exit, MallocMemory);
 	}
-	else {
-		fclose(fpReported);
+	for(i=0;i<sort->numContigs;i++) {
+		sort->contigs[i].contigName = rg->contigs[i].contigName;
+		sort->contigs[i].contig = i;
 	}
-	/* Close the input file */
-	gzclose(fp);
+	qsort(sort->contigs, sort->numContigs, sizeof(PostProcessSortContig), PostProcessSortContigCompare);
+
+	sort->tmpDir = tmpDir;
+	sort->memoryLimit = memoryLimit*((int64_t)1048576);
+	sort->numThreads = numThreads;
+	sort->text = NULL;
+	sort->textLength = sort->textMaxLength = 0;
+	sort->records = sort->tmpRecords = NULL;
+	sort->numRecords = sort->maxNumRecords = 0;
+	sort->runs = NULL;
+	sort->numRuns = 0;
+}
 
-	if(VERBOSE>=0) {
-		fprintf(stderr, "%s", BREAK_LINE);
-		fprintf(stderr, "Found %10lld reads with no ends mapped.\n", 
-				(long long int)numUnmapped);
-		if(!(mappedEndCountsNumEnds < 1 || numUnmapped == mappedEndCounts[0])) {
-			fprintf(stderr, "%d < 1 || %d == %d\n",
-					mappedEndCountsNumEnds,
-					(int)numUnmapped,
-					mappedEndCounts[0]);
+/* TODO */
+/* Buffers the formatted records, spilling a sorted run once the memory limit
+ * is reached */
+void PostProcessSortAdd(PostProcessSort *sort,
+		char *text,
+		int64_t length)
+{
+	char *FnName="PostProcessSortAdd";
+	int64_t i, start, numRecords;
+
+	if(length <= 0) {
+		return;
+	}
+	for(i=numRecords=0;i<length;i++) {
+		if('\n' == text[i]) numRecords++;
+	}
+	assert('\n' == text[length-1]);
+
+	if(0 < sort->numRecords &&
+			sort->memoryLimit < sort->textLength + length + 2*sizeof(PostProcessSortRecord)*(sort->numRecords + numRecords)) {
+		PostProcessSortWriteRun(sort);
+	}
+
+	/* Reallocate */
+	if(sort->textMaxLength < sort->textLength + length) {
+		sort->textMaxLength = GETMAX(2*sort->textMaxLength, sort->textLength + length);
+		sort->text = realloc(sort->text, sizeof(char)*sort->textMaxLength);
+		if(NULL == sort->text) {
+			PrintError(FnName, "sort->text", "Could not reallocate memory", Exit, ReallocMemory);
+		}
+	}
+	if(sort->maxNumRecords < sort->numRecords + numRecords) {
+		sort->maxNumRecords = GETMAX(2*sort->maxNumRecords, sort->numRecords + numRecords);
+		sort->records = realloc(sort->records, sizeof(PostProcessSortRecord)*sort->maxNumRecords);
+		if(NULL == sort->records) {
+			PrintError(FnName, "sort->records", "Could not reallocate memory", Exit, ReallocMemory);
 		}
-		assert(mappedEndCountsNumEnds < 1 || numUnmapped == mappedEndCounts[0]);
-		for(i=1;i<=mappedEndCountsNumEnds;i++) {
-			if(1 == i) fprintf(stderr, "Found %10d reads with %2d end mapped.\n", mappedEndCounts[i], i);
-			else fprintf(stderr, "Found %10d reads with %2d ends mapped.\n", mappedEndCounts[i], i);
+		/* Only used while sorting */
+		free(sort->tmpRecords);
+		sort->tmpRecords = NULL;
+	}
+
+	memcpy(sort->text + sort->textLength, text, sizeof(char)*length);
+	for(i=start=0;i<length;i++) {
+		if('\n' == text[i]) {
+			sort->records[sort->numRecords].key = PostProcessSortGetKey(sort, text + start, i + 1 - start);
+			sort->records[sort->numRecords].offset = sort->textLength + start;
+			sort->records[sort->numRecords].length = i + 1 - start;
+			sort->numRecords++;
+			start = i + 1;
 		}
-		fprintf(stderr, "Found %10lld reads with at least one end mapping.\n",
-				(long long int)numReported);
-		fprintf(stderr, "%s", BREAK_LINE);
 	}
-	free(mappedEndCounts);
-	free(readGroupString);
-	free(threads);
+	sort->textLength += length;
+}
+
+/* TODO */
+/* Unmapped records without a mapped mate go last */
+uint64_t PostProcessSortGetKey(PostProcessSort *sort,
+		char *record,
+		int64_t length)
+{
+	char *FnName="PostProcessSortGetKey";
+	int64_t i, nameStart, nameLength;
+	int32_t low, mid, high, cmp;
+	long int position;
+
+	/* Skip QNAME and FLAG */
+	for(i=0;i<length && '\t' != record[i];i++);
+	for(i++;i<length && '\t' != record[i];i++);
+	/* RNAME */
+	nameStart = ++i;
+	for(;i<length && '\t' != record[i];i++);
+	nameLength = i - nameStart;
+	if(length <= i) {
+		PrintError(FnName, "record", "Could not parse the SAM record", Exit, OutOfRange);
+	}
+	if(1 == nameLength && '*' == record[nameStart]) {
+		return UINT64_MAX;
+	}
+	position = strtol(record + i + 1, NULL, 10);
+
+	low = 0;
+	high = sort->numContigs - 1;
+	while(low <= high) {
+		mid = (low + high)/2;
+		cmp = strncmp(record + nameStart, sort->contigs[mid].contigName, nameLength);
+		if(0 == cmp && '\0' != sort->contigs[mid].contigName[nameLength]) {
+			cmp = -1;
+		}
+		if(cmp < 0) {
+			high = mid - 1;
+		}
+		else if(0 < cmp) {
+			low = mid + 1;
+		}
+		else {
+			return (((uint64_t)sort->contigs[mid].contig) << 32) | ((uint32_t)position);
+		}
+	}
+	PrintError(FnName, "RNAME", "Could not find the contig of the SAM record", Exit, OutOfRange);
+	return UINT64_MAX;
+}
+
+/* TODO */
+int PostProcessSortContigCompare(const void *a, const void *b)
+{
+	return strcmp(((PostProcessSortContig*)a)->contigName, ((PostProcessSortContig*)b)->contigName);
+}
+
+/* TODO */
+/* Sorts the buffered records in contiguous slices, one per thread, and
+ * returns the slices as runs to be merged */
+int32_t PostProcessSortRecords(PostProcessSort *sort,
+		PostProcessSortRun **slices)
+{
+	char *FnName="PostProcessSortRecords";
+	PostProcessSortThreadData *data=NULL;
+	pthread_t *threads=NULL;
+	int32_t i, numSlices, errCode;
+	int64_t start, end;
+	void *status=NULL;
+
+	numSlices = (sort->numRecords < sort->numThreads) ? (int32_t)sort->numRecords : sort->numThreads;
+	if(0 == numSlices) {
+		(*slices) = NULL;
+		return 0;
+	}
+
+	if(NULL == sort->tmpRecords) {
+		sort->tmpRecords = malloc(sizeof(PostProcessSortRecord)*sort->maxNumRecords);
+		if(NULL == sort->tmpRecords) {
+			PrintError(FnName, "sort->tmpRecords", "Could not allocate memory", Exit, MallocMemory);
+		}
+	}
+	data = malloc(sizeof(PostProcessSortThreadData)*numSlices);
+	if(NULL == data) {
+		PrintError(FnName, "data", "Could not allocate memory", Exit, MallocMemory);
+	}
+	threads = malloc(sizeof(pthread_t)*numSlices);
+	if(NULL == threads) {
+		PrintError(FnName, "threads", "Could not allocate memory", Exit, MallocMemory);
+	}
+	(*slices) = malloc(sizeof(PostProcessSortRun)*numSlices);
+	if(NULL == (*slices)) {
+		PrintError(FnName, "(*slices)", "Could not allocate memory", Exit, MallocMemory);
+	}
+
+	for(i=0;i<numSlices;i++) {
+		start = (sort->numRecords * i) / numSlices;
+		end = (sort->numRecords * (i+1)) / numSlices;
+		data[i].records = sort->records + start;
+		data[i].tmpRecords = sort->tmpRecords + start;
+		data[i].numRecords = end - start;
+		(*slices)[i].fp = NULL;
+		(*slices)[i].fileName = NULL;
+		(*slices)[i].records = sort->records + start;
+		(*slices)[i].cur = 0;
+		(*slices)[i].numRecords = end - start;
+		(*slices)[i].text = sort->text;
+		(*slices)[i].textMaxLength = 0;
+	}
+	if(1 == numSlices) {
+		PostProcessSortThread(&data[0]);
+	}
+	else {
+		for(i=0;i<numSlices;i++) {
+			errCode = pthread_create(&threads[i], NULL, PostProcessSortThread, &data[i]);
+			if(0!=errCode) {
+				PrintError(FnName, "pthread_create: errCode", "Could not start thread", Exit, ThreadError);
+			}
+		}
+		for(i=0;i<numSlices;i++) {
+			errCode = pthread_join(threads[i], &status);
+			if(0!=errCode) {
+				PrintError(FnName, "pthread_join: errCode", "Thread returned an error", Exit, ThreadError);
+			}
+		}
+	}
+
 	free(data);
-	free(alignQueue);
-	free(foundTypes);
-	free(numEntries);
-	free(numEntriesN);
+	free(threads);
+
+	return numSlices;
+}
+
+/* TODO */
+/* A stable least significant digit radix sort, skipping the digits that are
+ * the same for every record */
+void *PostProcessSortThread(void *arg)
+{
+	PostProcessSortThreadData *data = (PostProcessSortThreadData*)arg;
+	PostProcessSortRecord *src = data->records;
+	PostProcessSortRecord *dest = data->tmpRecords;
+	PostProcessSortRecord *tmp = NULL;
+	int64_t counts[256];
+	int64_t i, sum, count;
+	int32_t shift, digit;
+
+	if(data->numRecords <= 1) {
+		return arg;
+	}
+
+	for(shift=0;shift<64;shift+=8) {
+		for(digit=0;digit<256;digit++) {
+			counts[digit] = 0;
+		}
+		for(i=0;i<data->numRecords;i++) {
+			counts[(src[i].key >> shift) & 0xFF]++;
+		}
+		if(counts[(src[0].key >> shift) & 0xFF] == data->numRecords) {
+			continue;
+		}
+		for(digit=sum=0;digit<256;digit++) {
+			count = counts[digit];
+			counts[digit] = sum;
+			sum += count;
+		}
+		for(i=0;i<data->numRecords;i++) {
+			dest[counts[(src[i].key >> shift) & 0xFF]++] = src[i];
+		}
+		tmp = src; src = dest; dest = tmp;
+	}
+	if(src != data->records) {
+		memcpy(data->records, src, sizeof(PostProcessSortRecord)*data->numRecords);
+	}
+
+	return arg;
+}
+
+/* TODO */
+/* Sorts the buffered records and spills them as a compressed run */
+void PostProcessSortWriteRun(PostProcessSort *sort)
+{
+	char *FnName="PostProcessSortWriteRun";
+	PostProcessSortRun *slices=NULL;
+	PostProcessSortRun *run=NULL;
+	int32_t numSlices;
+
+	numSlices = PostProcessSortRecords(sort, &slices);
+
+	sort->runs = realloc(sort->runs, sizeof(PostProcessSortRun)*(sort->numRuns+1));
+	if(NULL == sort->runs) {
+		PrintError(FnName, "sort->runs", "Could not reallocate memory", Exit, ReallocMemory);
+	}
+	run = &sort->runs[sort->numRuns];
+	run->fp = OpenTmpGZFile(sort->tmpDir, &run->fileName, TmpCompressionFast);
+	run->records = NULL;
+	run->cur = 0;
+	run->numRecords = sort->numRecords;
+	run->text = NULL;
+	run->textMaxLength = 0;
+	PostProcessSortMerge(slices, numSlices, run->fp, NULL);
+	ReopenTmpGZFile(&run->fp, &run->fileName);
+	sort->numRuns++;
+
+	if(0 <= VERBOSE) {
+		fprintf(stderr, "Wrote sorted run %d with %lld records.\n",
+				sort->numRuns,
+				(long long int)sort->numRecords);
+	}
+
+	sort->textLength = 0;
+	sort->numRecords = 0;
+	free(slices);
+}
+
+/* TODO */
+/* Merges the sorted runs, breaking ties by the order of the runs so the output
+ * does not depend on the memory limit or number of threads */
+void PostProcessSortMerge(PostProcessSortRun *runs,
+		int32_t numRuns,
+		gzFile fpGZ,
+		FILE *fp)
+{
+	char *FnName="PostProcessSortMerge";
+	PostProcessSortRun *r=NULL;
+	int32_t *heap=NULL;
+	int32_t i, numHeap=0;
+
+	if(0 == numRuns) {
+		return;
+	}
+	heap = malloc(sizeof(int32_t)*numRuns);
+	if(NULL == heap) {
+		PrintError(FnName, "heap", "Could not allocate memory", Exit, MallocMemory);
+	}
+
+	/* Build the heap */
+	for(i=0;i<numRuns;i++) {
+		if(1 == PostProcessSortRunNext(&runs[i])) {
+			heap[numHeap] = i;
+			numHeap++;
+		}
+	}
+	for(i=numHeap/2-1;0<=i;i--) {
+		PostProcessSortSiftDown(runs, heap, numHeap, i);
+	}
+
+	/* Merge */
+	while(0 < numHeap) {
+		r = &runs[heap[0]];
+		if(NULL != fpGZ) {
+			if(sizeof(uint64_t) != gzwrite(fpGZ, &r->record.key, sizeof(uint64_t)) ||
+					sizeof(int64_t) != gzwrite(fpGZ, &r->record.length, sizeof(int64_t)) ||
+					r->record.length != gzwrite(fpGZ, r->text + r->record.offset, sizeof(char)*r->record.length)) {
+				PrintError(FnName, "record", "Could not write to the sorted run", Exit, WriteFileError);
+			}
+		}
+		else if(r->record.length != fwrite(r->text + r->record.offset, sizeof(char), r->record.length, fp)) {
+			PrintError(FnName, "record", "Could not write to the output file", Exit, WriteFileError);
+		}
+		if(0 == PostProcessSortRunNext(r)) {
+			numHeap--;
+			heap[0] = heap[numHeap];
+		}
+		PostProcessSortSiftDown(runs, heap, numHeap, 0);
+	}
+
+	free(heap);
+}
+
+/* TODO */
+int32_t PostProcessSortRunNext(PostProcessSortRun *run)
+{
+	char *FnName="PostProcessSortRunNext";
+
+	if(run->numRecords <= run->cur) {
+		return 0;
+	}
+	run->cur++;
+	if(NULL == run->fp) {
+		run->record = run->records[run->cur-1];
+		return 1;
+	}
+
+	if(sizeof(uint64_t) != gzread(run->fp, &run->record.key, sizeof(uint64_t)) ||
+			sizeof(int64_t) != gzread(run->fp, &run->record.length, sizeof(int64_t))) {
+		PrintError(FnName, "record", "Could not read from the sorted run", Exit, ReadFileError);
+	}
+	if(run->textMaxLength < run->record.length) {
+		run->textMaxLength = run->record.length;
+		run->text = realloc(run->text, sizeof(char)*run->textMaxLength);
+		if(NULL == run->text) {
+			PrintError(FnName, "run->text", "Could not reallocate memory", Exit, ReallocMemory);
+		}
+	}
+	if(run->record.length != gzread(run->fp, run->text, sizeof(char)*run->record.length)) {
+		PrintError(FnName, "record", "Could not read from the sorted run", Exit, ReadFileError);
+	}
+	run->record.offset = 0;
+	return 1;
+}
+
+/* TODO */
+int32_t PostProcessSortRunCompare(PostProcessSortRun *runs, int32_t a, int32_t b)
+{
+	if(runs[a].record.key != runs[b].record.key) {
+		return (runs[a].record.key < runs[b].record.key) ? -1 : 1;
+	}
+	return (a < b) ? -1 : 1;
+}
+
+/* TODO */
+void PostProcessSortSiftDown(PostProcessSortRun *runs, int32_t *heap, int32_t numHeap, int32_t i)
+{
+	int32_t child, tmp;
+
+	while(2*i + 1 < numHeap) {
+		child = 2*i + 1;
+		if(child + 1 < numHeap && 
+				PostProcessSortRunCompare(runs, heap[child+1], heap[child]) < 0) {
+			child++;
+		}
+		if(PostProcessSortRunCompare(runs, heap[i], heap[child]) <= 0) {
+			break;
+		}
+		tmp = heap[child]; heap[child] = heap[i]; heap[i] = tmp;
+		i = child;
+	}
+}
+
+/* TODO */
+/* Merges the spilled runs with the records still in memory into the output */
+void PostProcessSortFinish(PostProcessSort *sort,
+		FILE *fp)
+{
+	char *FnName="PostProcessSortFinish";
+	PostProcessSortRun *slices=NULL;
+	int32_t i, numSlices;
+
+	numSlices = PostProcessSortRecords(sort, &slices);
+
+	/* The runs on disk come before those in memory */
+	sort->runs = realloc(sort->runs, sizeof(PostProcessSortRun)*(sort->numRuns+numSlices));
+	if(NULL == sort->runs && 0 < sort->numRuns + numSlices) {
+		PrintError(FnName, "sort->runs", "Could not reallocate memory", Exit, ReallocMemory);
+	}
+	for(i=0;i<numSlices;i++) {
+		sort->runs[sort->numRuns+i] = slices[i];
+	}
+	free(slices);
+
+	if(0 <= VERBOSE && 0 < sort->numRuns) {
+		fprintf(stderr, "Merging %d sorted runs.\n", sort->numRuns + (0 < numSlices ? 1 : 0));
+	}
+	PostProcessSortMerge(sort->runs, sort->numRuns+numSlices, NULL, fp);
+
+	/* Delete the runs */
+	for(i=0;i<sort->numRuns;i++) {
+		CloseTmpGZFile(&sort->runs[i].fp, &sort->runs[i].fileName, 1);
+		free(sort->runs[i].text);
+	}
+	free(sort->runs);
+	sort->runs = NULL;
+	sort->numRuns = 0;
+	sort->textLength = 0;
+	sort->numRecords = 0;
+}
+
+/* TODO */
+void PostProcessSortFree(PostProcessSort *sort)
+{
+	free(sort->contigs);
+	free(sort->text);
+	free(sort->records);
+	free(sort->tmpRecords);
+	free(sort->runs);
+	sort->contigs = NULL;
+	sort->text = NULL;
+	sort->records = sort->tmpRecords = NULL;
+	sort->runs = NULL;
 }
 
 void *ReadInputFilterAndOutputThread(void *arg)
@@ -426,16 +1174,20 @@ void *ReadInputFilterAndOutputThread(void *arg)
 	AlignedRead *alignQueue = data->alignQueue;
 	int queueLength = data->queueLength;
 	int8_t *foundTypes = data->foundTypes;
+	int8_t *properPairs = data->properPairs;
 	int32_t threadID = data->threadID;
 	int32_t numThreads = data->numThreads;
 	int32_t **numEntries = data->numEntries;
 	int32_t *numEntriesN = data->numEntriesN;
-	int32_t j;
+	BCounters *counters = data->counters;
+	int32_t i, j;
 	int32_t queueIndex=0;
+	int64_t startTime = BTimeNow();
 	AlignMatrix matrix;
 	AlignMatrixInitialize(&matrix); 
 
 	for(queueIndex=threadID;queueIndex<queueLength;queueIndex+=numThreads) {
+		counters->counts[CounterReads]++;
 
                 if(numEntriesN[queueIndex] < alignQueue[queueIndex].numEnds) {
                         numEntriesN[queueIndex] = alignQueue[queueIndex].numEnds;
@@ -463,11 +1215,36 @@ void *ReadInputFilterAndOutputThread(void *arg)
                                 minimumMappingQuality,
                                 minimumNormalizedScore,
                                 bins);
+
+		if(NoneFound == foundTypes[queueIndex]) {
+			/* Free the alignments for output */
+			for(i=0;i<alignQueue[queueIndex].numEnds;i++) {
+				for(j=0;j<alignQueue[queueIndex].ends[i].numEntries;j++) {
+					AlignedEntryFree(&alignQueue[queueIndex].ends[i].entries[j]);
+				}
+				alignQueue[queueIndex].ends[i].numEntries=0;
+			}
+		}
+
+		// Proper pair ? 
+		properPairs[queueIndex] = 0;
+		if(2 == alignQueue[queueIndex].numEnds && NULL != bins) {
+			if(1 == alignQueue[queueIndex].ends[0].numEntries && 1 == alignQueue[queueIndex].ends[1].numEntries) {
+				properPairs[queueIndex] = 1 - isDiscordantPair(&alignQueue[queueIndex].ends[0].entries[0],
+						&alignQueue[queueIndex].ends[1].entries[0],
+						strandedness,
+						positioning,
+						bins);
+			}
+		}
 	}
 
 	// Free
 	AlignMatrixFree(&matrix);
 
+	data->computeTime = BTimeNow() - startTime;
+	counters->counts[CounterComputeTime] += data->computeTime;
+
 	return arg;
 }
 
@@ -484,6 +1261,11 @@ int32_t GetAlignedReads(gzFile fp, AlignedRead *alignQueue, int32_t maxToRead)
 	return numRead;
 }
 
+static inline int32_t getPairedPenalty(int mismatchScore, double numStd)
+{
+  return (int)(mismatchScore * -1.0 * log10( erfc(M_SQRT1_2 * numStd)) + 0.499);
+}
+
 static int32_t getPairedScore(AlignedEntry *aOne,
                               AlignedEntry *aTwo,
                               int strandedness,
@@ -514,11 +1296,42 @@ static int32_t getPairedScore(AlignedEntry *aOne,
           }
       }
   }
-  s -= (int)(mismatchScore * -1.0 * log10( erfc(M_SQRT1_2 * numStd)) + 0.499);
+  s -= getPairedPenalty(mismatchScore, numStd);
 
   return s;
 }
 
+static inline void updatePairedBest(int32_t score,
+                                    int32_t num,
+                                    int32_t *bestScore,
+                                    int32_t *bestNum,
+                                    int32_t *penultimateScore,
+                                    int32_t *penultimateNum)
+{
+  if((*bestScore) < score) {
+      (*penultimateScore) = (*bestScore);
+      (*penultimateNum) = (*bestNum);
+      (*bestScore) = score;
+      (*bestNum) = num;
+  }
+  else if((*bestScore) == score) {
+      (*bestNum) += num;
+  }
+  else if((*penultimateScore) < score) {
+      (*penultimateScore) = score;
+      (*penultimateNum) = num;
+  }
+  else if((*penultimateScore) == score) {
+      (*penultimateNum) += num;
+  }
+}
+
+/* Pairs the alignments of the two ends.  Only pairs on the same contig
+ * and strand whose distance is near the insert size are scored 
+ * individually, found by searching the second end sorted by location.
+ * All other pairs receive the largest insert size penalty, so the best
+ * of them are found from the distinct scores of each end.  The pair 
+ * chosen is the same as when scoring all pairs in order. */
 void DoPairing(AlignedRead *tmpA, 
                int algorithm,
                int positioning, 
@@ -530,81 +1343,137 @@ void DoPairing(AlignedRead *tmpA,
                PEDBins *b)
 {
   char *FnName="DoPairing";
-  int32_t i, j;
+  int32_t i, j, k;
       int32_t bestScore, bestNum;
       int32_t penultimateScore, penultimateNum;
-      int32_t *bestScoreIndexesI = NULL;
-      int32_t *bestScoreIndexesJ = NULL;
-      int32_t bestScoreIndexesMem = 16;
+      int32_t bestScoreIndexI = 0;
+      int32_t bestScoreIndexJ = 0;
+      int32_t numOne = tmpA->ends[0].numEntries;
+      int32_t numTwo = tmpA->ends[1].numEntries;
+      PairingEntry *two = NULL;
+      PairingScore *scored = NULL;
+      int32_t numScored = 0, scoredMem = 0;
+      int32_t *scoredSums = NULL;
+      PairingScoreCount *countsOne = NULL, *countsTwo = NULL;
+      int32_t numCountsOne = 0, numCountsTwo = 0;
+      int32_t unscoredSums[2], unscoredNums[2], numUnscored;
+      int32_t maxPenalty = getPairedPenalty(mismatchScore, INSERT_MAX_STD);
+      int32_t useWindow, start, end, sign;
+      int64_t low = 0, high = 0, lowPos, highPos;
+      AlignedEntry *one = NULL;
+
+      // sort the second end by location
+      two = malloc(sizeof(PairingEntry) * numTwo);
+      if(NULL == two) {
+          PrintError(FnName, "two", "Could not allocate memory", Exit, MallocMemory);
+      }
+      for(j=0;j<numTwo;j++) {
+          two[j].contig = tmpA->ends[1].entries[j].contig;
+          two[j].strand = tmpA->ends[1].entries[j].strand;
+          two[j].position = tmpA->ends[1].entries[j].position;
+          two[j].index = j;
+      }
+      qsort(two, numTwo, sizeof(PairingEntry), PairingEntryCompare);
 
-      bestScoreIndexesI = malloc(sizeof(int32_t) * bestScoreIndexesMem);
-      if(NULL == bestScoreIndexesI) {
-          PrintError(FnName, "bestScoreIndexesI", "Could not allocate memory", Exit, MallocMemory);
+      // the distances that could receive less than the largest penalty
+      useWindow = (0 < b->std && fabs(b->avg) + INSERT_MAX_STD * b->std < INT_MAX) ? 1 : 0;
+      if(1 == useWindow) {
+          low = (int64_t)floor(b->avg - INSERT_MAX_STD * b->std) - 1;
+          high = (int64_t)ceil(b->avg + INSERT_MAX_STD * b->std) + 1;
       }
-      bestScoreIndexesJ = malloc(sizeof(int32_t) * bestScoreIndexesMem);
-      if(NULL == bestScoreIndexesJ) {
-          PrintError(FnName, "bestScoreIndexesJ", "Could not allocate memory", Exit, MallocMemory);
+
+      // score the pairs within the window
+      for(i=0;i<numOne;i++) {
+          one = &tmpA->ends[0].entries[i];
+          start = PairingEntryFind(two, numTwo, one->contig, CHAR_MIN, -1);
+          while(start < numTwo && two[start].contig == one->contig) {
+              end = PairingEntryFind(two, numTwo, one->contig, two[start].strand, INT64_MAX);
+              if(0 == getStrandDiff(one->strand, two[start].strand, positioning)) {
+                  if(1 == useWindow) {
+                      sign = getPositionDiff(0, 1, one->strand, two[start].strand, strandedness, positioning);
+                      lowPos = (0 < sign) ? (one->position + low) : (one->position - high);
+                      highPos = (0 < sign) ? (one->position + high) : (one->position - low);
+                      k = PairingEntryFind(two, numTwo, one->contig, two[start].strand, lowPos);
+                  }
+                  else {
+                      highPos = INT64_MAX;
+                      k = start;
+                  }
+                  for(;k<end && two[k].position <= highPos;k++) {
+                      numScored++;
+                      if(scoredMem < numScored) {
+                          scoredMem = (0 == scoredMem) ? 16 : (2 * scoredMem);
+                          scored = realloc(scored, sizeof(PairingScore) * scoredMem);
+                          if(NULL == scored) {
+                              PrintError(FnName, "scored", "Could not reallocate memory", Exit, ReallocMemory);
+                          }
+                      }
+                      scored[numScored-1].i = i;
+                      scored[numScored-1].j = two[k].index;
+                      scored[numScored-1].score = getPairedScore(one, 
+                                                                 &tmpA->ends[1].entries[two[k].index],
+                                                                 positioning,
+                                                                 strandedness,
+                                                                 avgMismatchQuality,
+                                                                 matchScore,
+                                                                 mismatchScore,
+                                                                 b);
+                  }
+              }
+              start = end;
+          }
+      }
+      free(two);
+      two = NULL;
+
+      // the sums of the alignment scores of the pairs scored, highest first
+      qsort(scored, numScored, sizeof(PairingScore), PairingScoreCompare);
+      if(0 < numScored) {
+          scoredSums = malloc(sizeof(int32_t) * numScored);
+          if(NULL == scoredSums) {
+              PrintError(FnName, "scoredSums", "Could not allocate memory", Exit, MallocMemory);
+          }
       }
+      for(k=0;k<numScored;k++) {
+          scoredSums[k] = (int)(tmpA->ends[0].entries[scored[k].i].score + tmpA->ends[1].entries[scored[k].j].score);
+      }
+      qsort(scoredSums, numScored, sizeof(int32_t), PairingSumCompare);
+
+      // the best of all other pairs
+      GetPairingScoreCounts(&tmpA->ends[0], &countsOne, &numCountsOne);
+      GetPairingScoreCounts(&tmpA->ends[1], &countsTwo, &numCountsTwo);
+      numUnscored = GetPairingUnscoredBest(countsOne, 
+                                           numCountsOne, 
+                                           countsTwo, 
+                                           numCountsTwo, 
+                                           scoredSums, 
+                                           numScored, 
+                                           unscoredSums, 
+                                           unscoredNums);
 
       bestScore = INT_MIN;
       bestNum = 0;
       penultimateScore = INT_MIN;
       penultimateNum = 0;
 
-      for(i=0;i<tmpA->ends[0].numEntries;i++) {
-          for(j=0;j<tmpA->ends[1].numEntries;j++) {
-              int32_t score = getPairedScore(&tmpA->ends[0].entries[i], 
-                                             &tmpA->ends[1].entries[j],
-                                             positioning,
-                                             strandedness,
-                                             avgMismatchQuality,
-                                             matchScore,
-                                             mismatchScore,
-                                             b);
-              if(bestScore < score) {
-                  penultimateScore = bestScore;
-                  penultimateNum = bestNum;
-                  bestScore = score;
-                  bestNum = 1;
-                  bestScoreIndexesI[bestNum-1] = i;
-                  bestScoreIndexesJ[bestNum-1] = j;
-              }
-              else if(bestScore == score) {
-                  bestNum++;
-                  if(bestScoreIndexesMem < bestNum) {
-                      bestScoreIndexesMem = bestNum;
-                      bestScoreIndexesI = realloc(bestScoreIndexesI, sizeof(int32_t) * bestScoreIndexesMem);
-                      if(NULL == bestScoreIndexesI) {
-                          PrintError(FnName, "bestScoreIndexesI", "Could not allocate memory", Exit, ReallocMemory);
-                      }
-                      bestScoreIndexesJ = realloc(bestScoreIndexesJ, sizeof(int32_t) * bestScoreIndexesMem);
-                      if(NULL == bestScoreIndexesJ) {
-                          PrintError(FnName, "bestScoreIndexesJ", "Could not allocate memory", Exit, ReallocMemory);
-                      }
-                  }
-                  bestScoreIndexesI[bestNum-1] = i;
-                  bestScoreIndexesJ[bestNum-1] = j;
-              }
-              else if(penultimateScore < score) {
-                  penultimateScore = score;
-                  penultimateNum = 1;
-              }
-              else if(penultimateScore == score) {
-                  penultimateNum++;
-              }
-          }
+      for(k=0;k<numScored;k++) {
+          updatePairedBest(scored[k].score, 1, &bestScore, &bestNum, &penultimateScore, &penultimateNum);
+      }
+      for(k=0;k<numUnscored;k++) {
+          updatePairedBest(unscoredSums[k] - maxPenalty, unscoredNums[k], &bestScore, &bestNum, &penultimateScore, &penultimateNum);
       }
       
       if(1 < bestNum) {
           if(1 == randomBest) {
               // pick a random one
-              i = (int)(drand48() * bestNum);
-              // copy over
-              if(i != bestScoreIndexesI[i]) {
-                  AlignedEntryCopy(&tmpA->ends[0].entries[0], &tmpA->ends[0].entries[bestScoreIndexesI[i]]);
+              k = (int)(drand48() * bestNum);
+              GetPairingNth(tmpA, scored, numScored, countsTwo, numCountsTwo, maxPenalty, bestScore, k, &bestScoreIndexI, &bestScoreIndexJ);
+              // move over
+              if(k != bestScoreIndexI) {
+                  AlignedEntryMove(&tmpA->ends[0].entries[0], &tmpA->ends[0].entries[bestScoreIndexI]);
               }
-              if(i != bestScoreIndexesJ[i]) {
-                  AlignedEntryCopy(&tmpA->ends[1].entries[0], &tmpA->ends[1].entries[bestScoreIndexesJ[i]]);
+              if(k != bestScoreIndexJ) {
+                  AlignedEntryMove(&tmpA->ends[1].entries[0], &tmpA->ends[1].entries[bestScoreIndexJ]);
               }
               // reallocate
               AlignedEndReallocate(&tmpA->ends[0], 1);
@@ -616,11 +1485,12 @@ void DoPairing(AlignedRead *tmpA,
           }
       }
       else {
-          if(0 != bestScoreIndexesI[0]) {
-              AlignedEntryCopy(&tmpA->ends[0].entries[0], &tmpA->ends[0].entries[bestScoreIndexesI[0]]);
+          GetPairingNth(tmpA, scored, numScored, countsTwo, numCountsTwo, maxPenalty, bestScore, 0, &bestScoreIndexI, &bestScoreIndexJ);
+          if(0 != bestScoreIndexI) {
+              AlignedEntryMove(&tmpA->ends[0].entries[0], &tmpA->ends[0].entries[bestScoreIndexI]);
           }
-          if(0 != bestScoreIndexesJ[0]) {
-              AlignedEntryCopy(&tmpA->ends[1].entries[0], &tmpA->ends[1].entries[bestScoreIndexesJ[0]]);
+          if(0 != bestScoreIndexJ) {
+              AlignedEntryMove(&tmpA->ends[1].entries[0], &tmpA->ends[1].entries[bestScoreIndexJ]);
           }
           // reallocate
           AlignedEndReallocate(&tmpA->ends[0], 1);
@@ -658,8 +1528,283 @@ void DoPairing(AlignedRead *tmpA,
       }
       
       // free
-      free(bestScoreIndexesI);
-      free(bestScoreIndexesJ);
+      free(scored);
+      free(scoredSums);
+      free(countsOne);
+      free(countsTwo);
+}
+
+int PairingEntryCompare(const void *a, const void *b)
+{
+	const PairingEntry *x = (const PairingEntry*)a;
+	const PairingEntry *y = (const PairingEntry*)b;
+
+	if(x->contig != y->contig) {
+		return (x->contig < y->contig) ? -1 : 1;
+	}
+	if(x->strand != y->strand) {
+		return (x->strand < y->strand) ? -1 : 1;
+	}
+	if(x->position != y->position) {
+		return (x->position < y->position) ? -1 : 1;
+	}
+	return (x->index < y->index) ? -1 : ((x->index > y->index) ? 1 : 0);
+}
+
+/* Returns the first entry at or after the given location */
+int32_t PairingEntryFind(PairingEntry *entries,
+		int32_t numEntries,
+		uint32_t contig,
+		char strand,
+		int64_t position)
+{
+	int32_t low = 0, high = numEntries, mid;
+
+	while(low < high) {
+		mid = low + (high - low)/2;
+		if(entries[mid].contig < contig ||
+				(entries[mid].contig == contig && 
+				 (entries[mid].strand < strand ||
+				  (entries[mid].strand == strand && entries[mid].position < position)))) {
+			low = mid + 1;
+		}
+		else {
+			high = mid;
+		}
+	}
+	return low;
+}
+
+/* Orders the pairs by the first end, then the second end */
+int PairingScoreCompare(const void *a, const void *b)
+{
+	const PairingScore *x = (const PairingScore*)a;
+	const PairingScore *y = (const PairingScore*)b;
+
+	if(x->i != y->i) {
+		return (x->i < y->i) ? -1 : 1;
+	}
+	return (x->j < y->j) ? -1 : ((x->j > y->j) ? 1 : 0);
+}
+
+/* Orders the sums highest first */
+int PairingSumCompare(const void *a, const void *b)
+{
+	const int32_t x = *((const int32_t*)a);
+	const int32_t y = *((const int32_t*)b);
+
+	return (x < y) ? 1 : ((x > y) ? -1 : 0);
+}
+
+/* Gets the distinct alignment scores of an end, highest first */
+void GetPairingScoreCounts(AlignedEnd *end,
+		PairingScoreCount **counts,
+		int32_t *numCounts)
+{
+	char *FnName="GetPairingScoreCounts";
+	int32_t *scores=NULL;
+	int32_t i;
+
+	scores = malloc(sizeof(int32_t)*end->numEntries);
+	if(NULL == scores) {
+		PrintError(FnName, "scores", "Could not allocate memory", Exit, MallocMemory);
+	}
+	(*counts) = malloc(sizeof(PairingScoreCount)*end->numEntries);
+	if(NULL == (*counts)) {
+		PrintError(FnName, "counts", "Could not allocate memory", Exit, MallocMemory);
+	}
+	for(i=0;i<end->numEntries;i++) {
+		scores[i] = end->entries[i].score;
+	}
+	qsort(scores, end->numEntries, sizeof(int32_t), PairingSumCompare);
+
+	(*numCounts) = 0;
+	for(i=0;i<end->numEntries;i++) {
+		if(0 == (*numCounts) || (*counts)[(*numCounts)-1].score != scores[i]) {
+			(*counts)[(*numCounts)].score = scores[i];
+			(*counts)[(*numCounts)].count = 0;
+			(*numCounts)++;
+		}
+		(*counts)[(*numCounts)-1].count++;
+	}
+
+	free(scores);
+}
+
+/* Returns how many alignments have the given score */
+int32_t GetPairingScoreCount(PairingScoreCount *counts,
+		int32_t numCounts,
+		int32_t score)
+{
+	int32_t low = 0, high = numCounts-1, mid;
+
+	while(low <= high) {
+		mid = low + (high - low)/2;
+		if(counts[mid].score == score) {
+			return counts[mid].count;
+		}
+		else if(score < counts[mid].score) {
+			low = mid + 1;
+		}
+		else {
+			high = mid - 1;
+		}
+	}
+	return 0;
+}
+
+/* Gets the two highest distinct sums of the scores of the two ends, and
+ * how many pairs have each, among the pairs not scored individually.  
+ * The combinations of distinct scores are visited from the highest sum
+ * down using a heap holding at most one combination per score of the
+ * first end.  The sums of the pairs scored individually are given 
+ * highest first.  Returns the number of sums found. */
+int32_t GetPairingUnscoredBest(PairingScoreCount *one,
+		int32_t numOne,
+		PairingScoreCount *two,
+		int32_t numTwo,
+		int32_t *scoredSums,
+		int32_t numScored,
+		int32_t *sums,
+		int32_t *nums)
+{
+	char *FnName="GetPairingUnscoredBest";
+	int32_t *heapOne=NULL, *heapTwo=NULL;
+	int32_t heapSize, numFound=0, s=0;
+	int32_t x, y, tmp, cur, child, sum;
+	int64_t num;
+
+	heapOne = malloc(sizeof(int32_t)*numOne);
+	if(NULL == heapOne) {
+		PrintError(FnName, "heapOne", "Could not allocate memory", Exit, MallocMemory);
+	}
+	heapTwo = malloc(sizeof(int32_t)*numOne);
+	if(NULL == heapTwo) {
+		PrintError(FnName, "heapTwo", "Could not allocate memory", Exit, MallocMemory);
+	}
+	heapOne[0] = heapTwo[0] = 0;
+	heapSize = 1;
+
+	while(0 < heapSize && numFound < 2) {
+		sum = one[heapOne[0]].score + two[heapTwo[0]].score;
+		num = 0;
+		/* Visit all combinations with this sum */
+		while(0 < heapSize && sum == one[heapOne[0]].score + two[heapTwo[0]].score) {
+			x = heapOne[0];
+			y = heapTwo[0];
+			num += ((int64_t)one[x].count)*two[y].count;
+			/* Replace the top with the next combinations */
+			if(0 == y && x+1 < numOne) {
+				/* Start the next score of the first end */
+				heapOne[heapSize] = x+1;
+				heapTwo[heapSize] = 0;
+				for(cur=heapSize, heapSize++;0 < cur;cur=(cur-1)/2) {
+					child = cur;
+					tmp = (cur-1)/2;
+					if(one[heapOne[tmp]].score + two[heapTwo[tmp]].score < one[heapOne[child]].score + two[heapTwo[child]].score) {
+						x = heapOne[tmp]; heapOne[tmp] = heapOne[child]; heapOne[child] = x;
+						y = heapTwo[tmp]; heapTwo[tmp] = heapTwo[child]; heapTwo[child] = y;
+					}
+					else {
+						break;
+					}
+				}
+			}
+			if(y+1 < numTwo) {
+				heapTwo[0] = y+1;
+			}
+			else {
+				heapSize--;
+				heapOne[0] = heapOne[heapSize];
+				heapTwo[0] = heapTwo[heapSize];
+			}
+			/* Sift down */
+			for(cur=0;2*cur+1 < heapSize;cur=child) {
+				child = 2*cur+1;
+				if(child+1 < heapSize && 
+						one[heapOne[child]].score + two[heapTwo[child]].score < one[heapOne[child+1]].score + two[heapTwo[child+1]].score) {
+					child++;
+				}
+				if(one[heapOne[cur]].score + two[heapTwo[cur]].score < one[heapOne[child]].score + two[heapTwo[child]].score) {
+					x = heapOne[cur]; heapOne[cur] = heapOne[child]; heapOne[child] = x;
+					y = heapTwo[cur]; heapTwo[cur] = heapTwo[child]; heapTwo[child] = y;
+				}
+				else {
+					break;
+				}
+			}
+		}
+		/* Remove the pairs scored individually */
+		while(s < numScored && sum < scoredSums[s]) {
+			s++;
+		}
+		while(s < numScored && sum == scoredSums[s]) {
+			num--;
+			s++;
+		}
+		if(0 < num) {
+			sums[numFound] = sum;
+			nums[numFound] = (int32_t)num;
+			numFound++;
+		}
+	}
+
+	free(heapOne);
+	free(heapTwo);
+
+	return numFound;
+}
+
+/* Gets the nth pair with the given score, in the order of the first end
+ * then the second end */
+void GetPairingNth(AlignedRead *a,
+		PairingScore *scored,
+		int32_t numScored,
+		PairingScoreCount *countsTwo,
+		int32_t numCountsTwo,
+		int32_t maxPenalty,
+		int32_t score,
+		int32_t n,
+		int32_t *bestI,
+		int32_t *bestJ)
+{
+	char *FnName="GetPairingNth";
+	int32_t i, j, s, start, target, count, found;
+
+	for(i=s=0;i<a->ends[0].numEntries;i++) {
+		/* The score of the second end for pairs not scored individually */
+		target = score + maxPenalty - a->ends[0].entries[i].score;
+		count = GetPairingScoreCount(countsTwo, numCountsTwo, target);
+		for(start=s;s<numScored && scored[s].i == i;s++) {
+			if(target == a->ends[1].entries[scored[s].j].score) {
+				count--;
+			}
+			if(score == scored[s].score) {
+				count++;
+			}
+		}
+		if(n < count) {
+			for(j=0, s=start;j<a->ends[1].numEntries;j++) {
+				if(s < numScored && scored[s].i == i && scored[s].j == j) {
+					found = (score == scored[s].score) ? 1 : 0;
+					s++;
+				}
+				else {
+					found = (target == a->ends[1].entries[j].score) ? 1 : 0;
+				}
+				if(1 == found) {
+					if(0 == n) {
+						(*bestI) = i;
+						(*bestJ) = j;
+						return;
+					}
+					n--;
+				}
+			}
+		}
+		n -= count;
+	}
+	PrintError(FnName, NULL, "Could not find the pair", Exit, OutOfRange);
 }
 
 int FilterAlignedRead(AlignedRead *a,
@@ -680,28 +1825,24 @@ int FilterAlignedRead(AlignedRead *a,
 	char *FnName="FilterAlignedRead";
 	int foundType;
 	int32_t *foundTypes=NULL;
-	AlignedRead tmpA;
 	int32_t i, j, k, ctr;
 	int32_t best, bestIndex, numBest;
 
-	AlignedReadInitialize(&tmpA);
-
-	/* We should only modify "a" if it is going to be reported */ 
-	/* Copy in case we do not find anything to report */
-	AlignedReadCopy(&tmpA, a);
+	/* The alignments are filtered in place, moving the ones kept to the 
+	 * front.  If nothing is found, the caller discards the alignments. */
 
 	foundType=NoneFound;
-	foundTypes=malloc(sizeof(int32_t)*tmpA.numEnds);
+	foundTypes=malloc(sizeof(int32_t)*a->numEnds);
 	if(NULL == foundTypes) {
 		PrintError(FnName, "foundTypes", "Could not allocate memory", Exit, MallocMemory);
 	}
         
         if(NULL != b && 
-           0 <= strandedness && 0 <= positioning && 2 == tmpA.numEnds 
+           0 <= strandedness && 0 <= positioning && 2 == a->numEnds 
            && BestScore == algorithm 
-           && 1 <= tmpA.ends[0].numEntries && 1 <= tmpA.ends[1].numEntries) {
+           && 1 <= a->ends[0].numEntries && 1 <= a->ends[1].numEntries) {
             // Do pairing
-            DoPairing(&tmpA,
+            DoPairing(a,
                       algorithm,
                       positioning, 
                       strandedness,
@@ -712,8 +1853,8 @@ int FilterAlignedRead(AlignedRead *a,
                       b);
 
             // check if any were found
-            for(i=0;i<tmpA.numEnds;i++) {
-                if(1 <= tmpA.ends[i].numEntries) {
+            for(i=0;i<a->numEnds;i++) {
+                if(1 <= a->ends[i].numEntries) {
                     foundTypes[i]=Found;
                 }
                 else {
@@ -723,51 +1864,51 @@ int FilterAlignedRead(AlignedRead *a,
         }
         else {
 		/* Pick alignment for each end individually (is this a good idea?) */
-		for(i=0;i<tmpA.numEnds;i++) {
+		for(i=0;i<a->numEnds;i++) {
 			/* Choose each end */
 			switch(algorithm) {
 				case NoFiltering:
 				case AllNotFiltered:
-					foundTypes[i] = (0<tmpA.ends[i].numEntries)?Found:NoneFound;
+					foundTypes[i] = (0<a->ends[i].numEntries)?Found:NoneFound;
 					break;
 				case Unique:
-					foundTypes[i]=(1==tmpA.ends[i].numEntries)?Found:NoneFound;
+					foundTypes[i]=(1==a->ends[i].numEntries)?Found:NoneFound;
 					break;
 				case BestScore:
 				case BestScoreAll:
 					best = INT_MIN;
 					bestIndex = -1;
 					numBest = 0;
-					for(j=0;j<tmpA.ends[i].numEntries;j++) {
-						if(best < tmpA.ends[i].entries[j].score) {
-							best = tmpA.ends[i].entries[j].score;
+					for(j=0;j<a->ends[i].numEntries;j++) {
+						if(best < a->ends[i].entries[j].score) {
+							best = a->ends[i].entries[j].score;
 							bestIndex = j;
 							numBest = 1;
 						}
-						else if(best == tmpA.ends[i].entries[j].score) {
+						else if(best == a->ends[i].entries[j].score) {
 							numBest++;
 						}
 					}
-					// Copy all to the front
+					// Move all to the front
 					ctr=0;
-					for(j=0;j<tmpA.ends[i].numEntries;j++) {
-						if(tmpA.ends[i].entries[j].score == best) {
+					for(j=0;j<a->ends[i].numEntries;j++) {
+						if(a->ends[i].entries[j].score == best) {
 							if(ctr != j) {
-								AlignedEntryCopy(&tmpA.ends[i].entries[ctr], 
-										&tmpA.ends[i].entries[j]);
+								AlignedEntryMove(&a->ends[i].entries[ctr], 
+										&a->ends[i].entries[j]);
 							}
 							ctr++;
 						}
 					}
 					assert(ctr == numBest);
-					AlignedEndReallocate(&tmpA.ends[i], numBest);
+					AlignedEndReallocate(&a->ends[i], numBest);
 					// Random
 					if(BestScore == algorithm) {
 						if(1 < numBest && 1 == randomBest) {
 							int32_t keep = (int)(drand48() * numBest);
-							AlignedEntryCopy(&tmpA.ends[i].entries[0], &tmpA.ends[i].entries[keep]);
-							AlignedEndReallocate(&tmpA.ends[i], 1);
-							tmpA.ends[i].entries[0].mappingQuality = 0; // ambiguous
+							AlignedEntryMove(&a->ends[i].entries[0], &a->ends[i].entries[keep]);
+							AlignedEndReallocate(&a->ends[i], 1);
+							a->ends[i].entries[0].mappingQuality = 0; // ambiguous
 							numBest = 1;
 						}
 						if(1 == numBest) {
@@ -792,7 +1933,7 @@ int FilterAlignedRead(AlignedRead *a,
 			}
 			/* Free if not found */
 			if(NoneFound == foundTypes[i]) {
-				AlignedEndReallocate(&tmpA.ends[i],
+				AlignedEndReallocate(&a->ends[i],
 						0);
 			}
 		}
@@ -800,39 +1941,40 @@ int FilterAlignedRead(AlignedRead *a,
 
 	if(INT_MIN < minimumMappingQuality ||
 			INT_MIN < minimumNormalizedScore) {
-		for(i=0;i<tmpA.numEnds;i++) {
-			for(j=k=0;j<tmpA.ends[i].numEntries;j++) {
-				if(minimumMappingQuality <= tmpA.ends[i].entries[j].mappingQuality &&
-						minimumNormalizedScore <= tmpA.ends[i].entries[j].score/AlignedEntryGetReadLength(&tmpA.ends[i].entries[j])) {
-					// Copy to the front
+		for(i=0;i<a->numEnds;i++) {
+			for(j=k=0;j<a->ends[i].numEntries;j++) {
+				if(minimumMappingQuality <= a->ends[i].entries[j].mappingQuality &&
+						minimumNormalizedScore <= a->ends[i].entries[j].score/AlignedEntryGetReadLength(&a->ends[i].entries[j])) {
+					// Move to the front
 					if(j != k) {
-						AlignedEntryCopy(&tmpA.ends[i].entries[k], &tmpA.ends[i].entries[j]);
+						AlignedEntryMove(&a->ends[i].entries[k], &a->ends[i].entries[j]);
 					}
 					k++;
 				}
 			}
 			// Reallocate
-			if(k < tmpA.ends[i].numEntries) {
-				AlignedEndReallocate(&tmpA.ends[i], k);
+			if(k < a->ends[i].numEntries) {
+				AlignedEndReallocate(&a->ends[i], k);
 			}
 		}
 	}
 
 	// Found if one end is found
 	foundType=NoneFound;
-	for(i=0;NoneFound==foundType && i<tmpA.numEnds;i++) {
+	for(i=0;NoneFound==foundType && i<a->numEnds;i++) {
 		if(Found == foundTypes[i]) {
 			foundType=Found;
 			break;
 		}
 	}
 
-	/* copy back */
+	/* Reported reads do not keep the key miss fraction from the input */
 	if(NoneFound != foundType) {
-		AlignedReadFree(a);
-		AlignedReadCopy(a, &tmpA);
+		for(i=0;i<a->numEnds;i++) {
+			a->ends[i].keyMissFraction = 0;
+		}
 	}
-	AlignedReadFree(&tmpA);
+
 	free(foundTypes);
 
 
@@ -843,14 +1985,16 @@ int32_t GetPEDBins(AlignedRead *alignQueue,
 		int queueLength,
                 int strandedness,
                 int positioning,
+		int numThreads,
 		PEDBins *b)
 {
 	char *FnName="GetPEDBins";
-	int64_t counter, foundType;
-	int32_t alignQueueLength;
-	int32_t numRead, queueIndex;
-
-	alignQueueLength=queueLength;
+	int32_t i, errCode;
+	int32_t *distances=NULL;
+	int8_t *toInsert=NULL;
+	pthread_t *threads=NULL;
+	PEDBinsThreadData *data=NULL;
+	void *status=NULL;
 
 	/* Go through each read */
 	if(VERBOSE >= 0) {
@@ -860,69 +2004,59 @@ int32_t GetPEDBins(AlignedRead *alignQueue,
 		else
 			fprintf(stderr, "Collecting paired end statistics...\n");
 	}
-	counter = numRead = 0;
-
-	// TODO: make this multi-threaded
-	for(queueIndex=0;queueIndex<queueLength;queueIndex++) {
-		if(2 == alignQueue[queueIndex].numEnds) { // Only paired end data
-			AlignedRead tmpA;
-
-			// Filter base on best scoring
-			AlignedReadInitialize(&tmpA);
-			AlignedReadCopy(&tmpA, &alignQueue[queueIndex]);
-
-			foundType=FilterAlignedRead(&tmpA,
-					NULL,
-					NULL,
-					NULL,
-					BestScore,
-                                        -1,
-                                        -1,
-					INT_MIN,
-					0,
-                                        INT_MIN,
-					INT_MIN,
-					INT_MIN,
-					INT_MIN,
-					NULL);
-
-			if(Found == foundType) {
-                                int32_t toInsert = 0, positionDiff = 0;
-				assert(2 == tmpA.numEnds);
-				/* Must only have one alignment per end and on the same contig.
-				 * There is a potential this will be inferred incorrectly under
-				 * many scenarios.  Be careful! */
-				if(1 == tmpA.ends[0].numEntries &&
-						1 == tmpA.ends[1].numEntries &&
-						tmpA.ends[0].entries[0].contig == tmpA.ends[1].entries[0].contig) {
-                                    // Strands are OK
-                                    int32_t strandDiff = getStrandDiff(tmpA.ends[0].entries[0].strand, tmpA.ends[1].entries[0].strand, strandedness);
-                                    //fprintf(stderr, "strandDiff=%d\n", strandDiff);
-                                    if(0 == strandDiff) {
-                                        // Positions are OK
-                                        //fprintf(stderr, "positionDiff=%d\n", positionDiff);
-                                        positionDiff = getPositionDiff(tmpA.ends[0].entries[0].position, 
-                                                                       tmpA.ends[1].entries[0].position, 
-                                                                       tmpA.ends[0].entries[0].strand, 
-                                                                       tmpA.ends[1].entries[0].strand, 
-                                                                       positioning,
-                                                                       strandedness);
-                                        if(2 == positioning || 0 <= positionDiff) {
-                                            toInsert = 1;
-                                        }
-                                    }
-                                }
-                                if(1 == toInsert) {
-                                    PEDBinsInsert(b, positionDiff); 
-				}
-			}
-			AlignedReadFree(&tmpA);
+
+	distances=malloc(sizeof(int32_t)*queueLength);
+	if(NULL == distances) {
+		PrintError(FnName, "distances", "Could not allocate memory", Exit, MallocMemory);
+	}
+	toInsert=malloc(sizeof(int8_t)*queueLength);
+	if(NULL == toInsert) {
+		PrintError(FnName, "toInsert", "Could not allocate memory", Exit, MallocMemory);
+	}
+	threads=malloc(sizeof(pthread_t)*numThreads);
+	if(NULL == threads) {
+		PrintError(FnName, "threads", "Could not allocate memory", Exit, MallocMemory);
+	}
+	data=malloc(sizeof(PEDBinsThreadData)*numThreads);
+	if(NULL == data) {
+		PrintError(FnName, "data", "Could not allocate memory", Exit, MallocMemory);
+	}
+
+	/* Get the distance for each read */
+	for(i=0;i<numThreads;i++) {
+		data[i].alignQueue = alignQueue;
+		data[i].queueLength = queueLength;
+		data[i].strandedness = strandedness;
+		data[i].positioning = positioning;
+		data[i].distances = distances;
+		data[i].toInsert = toInsert;
+		data[i].numThreads = numThreads;
+		data[i].threadID = i;
+		errCode = pthread_create(&threads[i], NULL, GetPEDBinsThread, &data[i]);
+		if(0!=errCode) {
+			PrintError(FnName, "pthread_create: errCode", "Could not start thread", Exit, ThreadError);
+		}
+	}
+	for(i=0;i<numThreads;i++) {
+		errCode = pthread_join(threads[i], &status);
+		if(0!=errCode) {
+			PrintError(FnName, "pthread_join: errCode", "Thread returned an error", Exit, ThreadError);
 		}
+	}
 
-		/* Increment counter */
-		counter++;
+	/* Insert in the order the reads were read, since the bins are relative
+	 * to the minimum distance seen so far */
+	for(i=0;i<queueLength;i++) {
+		if(1 == toInsert[i]) {
+			PEDBinsInsert(b, distances[i]); 
+		}
 	}
 
+	free(distances);
+	free(toInsert);
+	free(threads);
+	free(data);
+
 	if(1 == b->doCalc && b->numDistances < MIN_PEDBINS_SIZE) {
 		fprintf(stderr, "Found only %d distances to infer the insert size distribution\n", b->numDistances);
 		PrintError(FnName, "b->numDistances", "Not enough distances to infer insert size distribution", Warn, OutOfRange);
@@ -938,6 +2072,76 @@ int32_t GetPEDBins(AlignedRead *alignQueue,
 	return 0;
 }
 
+void *GetPEDBinsThread(void *arg)
+{
+	PEDBinsThreadData *data = (PEDBinsThreadData*)arg;
+	AlignedRead *alignQueue = data->alignQueue;
+	int32_t queueIndex;
+	int32_t bestOne, bestTwo;
+	AlignedEntry *one=NULL, *two=NULL;
+
+	for(queueIndex=data->threadID;queueIndex<data->queueLength;queueIndex+=data->numThreads) {
+		data->toInsert[queueIndex] = 0;
+		data->distances[queueIndex] = 0;
+		if(2 != alignQueue[queueIndex].numEnds) { // Only paired end data
+			continue;
+		}
+		/* Must only have one best scoring alignment per end and on the same
+		 * contig.  This is what filtering by best score would keep, without
+		 * copying the read.  There is a potential this will be inferred 
+		 * incorrectly under many scenarios.  Be careful! */
+		bestOne = GetUniqueBestScoreIndex(&alignQueue[queueIndex].ends[0]);
+		bestTwo = GetUniqueBestScoreIndex(&alignQueue[queueIndex].ends[1]);
+		if(bestOne < 0 || bestTwo < 0) {
+			continue;
+		}
+		one = &alignQueue[queueIndex].ends[0].entries[bestOne];
+		two = &alignQueue[queueIndex].ends[1].entries[bestTwo];
+		if(one->contig == two->contig) {
+			// Strands are OK
+			if(0 == getStrandDiff(one->strand, two->strand, data->strandedness)) {
+				// Positions are OK
+				data->distances[queueIndex] = getPositionDiff(one->position, 
+						two->position, 
+						one->strand, 
+						two->strand, 
+						data->positioning,
+						data->strandedness);
+				if(2 == data->positioning || 0 <= data->distances[queueIndex]) {
+					data->toInsert[queueIndex] = 1;
+				}
+			}
+		}
+	}
+
+	return arg;
+}
+
+/* Returns the index of the best scoring entry if it is unique, -1 otherwise */
+int32_t GetUniqueBestScoreIndex(AlignedEnd *end)
+{
+	int32_t j, best, bestIndex, numBest;
+
+	best = INT_MIN;
+	bestIndex = -1;
+	numBest = 0;
+	for(j=0;j<end->numEntries;j++) {
+		if(best < end->entries[j].score) {
+			best = end->entries[j].score;
+			bestIndex = j;
+			numBest = 1;
+		}
+		else if(best == end->entries[j].score) {
+			if(bestIndex < 0) {
+				bestIndex = j;
+			}
+			numBest++;
+		}
+	}
+
+	return (1 == numBest) ? bestIndex : -1;
+}
+
 void PEDBinsInitialize(PEDBins *b, int insertSizeSpecified, double insertSizeAvg, double insertSizeStdDev)
 {
 	int32_t i;
@@ -1,6 +1,7 @@
 #ifndef RUNPOSTPROCESS_H_
 #define RUNPOSTPROCESS_H_
 
+#include <pthread.h>
 #include "AlignedRead.h"
 #include "AlignMatrix.h"
 
@@ -31,13 +32,154 @@ typedef struct {
 	int minimumNormalizedScore;
 	int queueLength;
 	int8_t *foundTypes;
+	int8_t *properPairs;
 	AlignedRead *alignQueue;
 	int32_t **numEntries;
 	int32_t *numEntriesN;
 	int32_t numThreads;
 	int32_t threadID;
+	BCounters *counters;
+	int64_t computeTime;
 } PostProcessThreadData;
 
+/* A batch of reads passed between the postprocess stages */
+typedef struct {
+	AlignedRead *alignQueue;
+	int32_t numRead;
+	int8_t *foundTypes;
+	int8_t *properPairs;
+	int32_t **numEntries;
+	int32_t *numEntriesN;
+	int32_t state;
+} PostProcessBatch;
+
+/* The batches are used in turn by the read, filter and write stages */
+typedef struct {
+	PostProcessBatch batches[POSTPROCESS_NUM_BATCHES];
+	pthread_mutex_t lock;
+	pthread_cond_t changed;
+} PostProcessPipeline;
+
+typedef struct {
+	PostProcessPipeline *pipeline;
+	gzFile fp;
+	int32_t queueLength;
+	BCounters counters;
+} PostProcessReadThreadData;
+
+typedef struct {
+	PostProcessPipeline *pipeline;
+	RGBinary *rg;
+	FILE *fpReported;
+	gzFile fpReportedGZ;
+	char *outputID;
+	char *readGroupString;
+	int algorithm;
+	int outputFormat;
+	int baseQualityType;
+	int numFormatThreads;
+	int32_t numUnmapped;
+	int32_t numReported;
+	int32_t *mappedEndCounts;
+	int32_t mappedEndCountsNumEnds;
+	struct PostProcessSort *sort; /* NULL unless sorting by coordinate */
+	int timing;
+	BCounters counters;
+} PostProcessWriteThreadData;
+
+typedef struct {
+	PostProcessBatch *batch;
+	int32_t startIndex;
+	int32_t endIndex;
+	RGBinary *rg;
+	char *outputID;
+	char *readGroupString;
+	int algorithm;
+	int outputFormat;
+	int baseQualityType;
+	char *output;
+	size_t outputLength;
+} PostProcessFormatThreadData;
+
+typedef struct {
+	AlignedRead *alignQueue;
+	int queueLength;
+        int strandedness;
+        int positioning;
+	int32_t *distances;
+	int8_t *toInsert;
+	int32_t numThreads;
+	int32_t threadID;
+} PEDBinsThreadData;
+
+/* A SAM record buffered for sorting by coordinate */
+typedef struct {
+	uint64_t key; /* contig index in the upper 32 bits, position in the lower */
+	int64_t offset;
+	int64_t length;
+} PostProcessSortRecord;
+
+/* A sorted run being merged, either spilled to disk or still in memory */
+typedef struct {
+	gzFile fp;
+	char *fileName;
+	PostProcessSortRecord *records; /* in memory only */
+	int64_t cur;
+	int64_t numRecords;
+	char *text;
+	int64_t textMaxLength; /* allocated when reading from disk */
+	PostProcessSortRecord record;
+} PostProcessSortRun;
+
+typedef struct {
+	char *contigName;
+	int32_t contig;
+} PostProcessSortContig;
+
+typedef struct PostProcessSort {
+	PostProcessSortContig *contigs; /* sorted by name */
+	int32_t numContigs;
+	char *tmpDir;
+	int64_t memoryLimit;
+	int32_t numThreads;
+	char *text;
+	int64_t textLength;
+	int64_t textMaxLength;
+	PostProcessSortRecord *records;
+	PostProcessSortRecord *tmpRecords;
+	int64_t numRecords;
+	int64_t maxNumRecords;
+	PostProcessSortRun *runs; /* spilled to disk */
+	int32_t numRuns;
+} PostProcessSort;
+
+typedef struct {
+	PostProcessSortRecord *records;
+	PostProcessSortRecord *tmpRecords;
+	int64_t numRecords;
+} PostProcessSortThreadData;
+
+/* An alignment of the second end, sorted by location when pairing */
+typedef struct {
+	uint32_t contig;
+	char strand;
+	uint32_t position;
+	int32_t index;
+} PairingEntry;
+
+/* A pair of alignments close enough to be scored individually */
+typedef struct {
+	int32_t i;
+	int32_t j;
+	int32_t score;
+} PairingScore;
+
+/* A distinct alignment score of one end, and how many alignments have it */
+typedef struct {
+	int32_t score;
+	int32_t count;
+} PairingScoreCount;
+
 void ReadInputFilterAndOutput(RGBinary *rg,
 		char *inputFileName,
 		int algorithm,
@@ -54,19 +196,56 @@ void ReadInputFilterAndOutput(RGBinary *rg,
 		double insertSizeAvg,
 		double insertSizeStdDev,
 		int numThreads,
+		int numFormatThreads,
 		int queueLength,
 		int outputFormat,
 		char *outputID,
 		char *readGroup,
                 int baseQualityType,
+		int sort,
+		int32_t sortMemoryLimit,
+		char *tmpDir,
+		int timing,
 		FILE *fpOut);
 
 void *ReadInputFilterAndOutputThread(void*);
 
-int32_t GetPEDBins(AlignedRead*, int, int, int, PEDBins*);
+PostProcessBatch *PostProcessPipelineWait(PostProcessPipeline*, int32_t, int32_t);
+void PostProcessPipelineSet(PostProcessPipeline*, PostProcessBatch*, int32_t);
+void *PostProcessReadThread(void*);
+void *PostProcessWriteThread(void*);
+void *PostProcessFormatThread(void*);
+
+void PostProcessSortInitialize(PostProcessSort*, RGBinary*, int32_t, char*, int32_t);
+void PostProcessSortAdd(PostProcessSort*, char*, int64_t);
+uint64_t PostProcessSortGetKey(PostProcessSort*, char*, int64_t);
+int PostProcessSortContigCompare(const void*, const void*);
+int32_t PostProcessSortRecords(PostProcessSort*, PostProcessSortRun**);
+void *PostProcessSortThread(void*);
+void PostProcessSortWriteRun(PostProcessSort*);
+void PostProcessSortMerge(PostProcessSortRun*, int32_t, gzFile, FILE*);
+int32_t PostProcessSortRunNext(PostProcessSortRun*);
+int32_t PostProcessSortRunCompare(PostProcessSortRun*, int32_t, int32_t);
+void PostProcessSortSiftDown(PostProcessSortRun*, int32_t*, int32_t, int32_t);
+void PostProcessSortFinish(PostProcessSort*, FILE*);
+void PostProcessSortFree(PostProcessSort*);
+
+int32_t GetPEDBins(AlignedRead*, int, int, int, int, PEDBins*);
+void *GetPEDBinsThread(void*);
+int32_t GetUniqueBestScoreIndex(AlignedEnd*);
 
 int32_t GetAlignedReads(gzFile, AlignedRead*, int32_t);
 
+void DoPairing(AlignedRead*, int, int, int, int, int, int, int, PEDBins*);
+int PairingEntryCompare(const void*, const void*);
+int32_t PairingEntryFind(PairingEntry*, int32_t, uint32_t, char, int64_t);
+int PairingScoreCompare(const void*, const void*);
+int PairingSumCompare(const void*, const void*);
+void GetPairingScoreCounts(AlignedEnd*, PairingScoreCount**, int32_t*);
+int32_t GetPairingScoreCount(PairingScoreCount*, int32_t, int32_t);
+int32_t GetPairingUnscoredBest(PairingScoreCount*, int32_t, PairingScoreCount*, int32_t, int32_t*, int32_t, int32_t*, int32_t*);
+void GetPairingNth(AlignedRead*, PairingScore*, int32_t, PairingScoreCount*, int32_t, int32_t, int32_t, int32_t, int32_t*, int32_t*);
+
 int FilterAlignedRead(AlignedRead *a,
 		RGBinary *rg,
 		AlignMatrix *matrix,
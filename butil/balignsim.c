@@ -169,8 +169,10 @@ void Run(RGBinary *rg,
 	char *alignFileName=NULL;
 	gzFile notAlignedFP=NULL;
 	char *notAlignedFileName=NULL;
-	int32_t totalAlignTime = 0;
-	int32_t totalFileHandlingTime = 0;
+	int64_t totalAlignTime = 0;
+	int64_t totalFileHandlingTime = 0;
+	int64_t totalRescueTime = 0;
+	BCounters *counters=NULL;
 	double mismatchScore;
 	ScoringMatrix sm;
 	SimRead r;
@@ -215,9 +217,9 @@ void Run(RGBinary *rg,
 	}
 
 	/* Open tmp files */
-	matchesFP = OpenTmpGZFile(tmpDir, &matchesFileName);
-	alignFP = OpenTmpGZFile(tmpDir, &alignFileName);
-	notAlignedFP = OpenTmpGZFile(tmpDir, &notAlignedFileName);
+	matchesFP = OpenTmpGZFile(tmpDir, &matchesFileName, DEFAULT_TMP_COMPRESSION);
+	alignFP = OpenTmpGZFile(tmpDir, &alignFileName, DEFAULT_TMP_COMPRESSION);
+	notAlignedFP = OpenTmpGZFile(tmpDir, &notAlignedFileName, DEFAULT_TMP_COMPRESSION);
 
 	/* Get scoring matrix */
 	ScoringMatrixInitialize(&sm);
@@ -415,6 +417,11 @@ void Run(RGBinary *rg,
 	/* Run "../bfast/RunDynamicProgramming" from balign */
 	fprintf(stderr, "%s", BREAK_LINE);
 	fprintf(stderr, "../bfast/Running local alignment.\n");
+	counters = malloc(sizeof(BCounters)*(numThreads+1));
+	if(NULL == counters) {
+		PrintError(FnName, "counters", "Could not allocate memory", Exit, MallocMemory);
+	}
+	BCountersInitialize(counters, numThreads+1);
 	RunDynamicProgramming(matchesFP,
 			rg,
 			scoringMatrixFileName,
@@ -433,9 +440,17 @@ void Run(RGBinary *rg,
 			0,
 			0,
 			0,
+			0,
+			0.0,
+			0.0,
+			INSERT_MAX_STD,
+			RESCUE_NUM_HITS,
 			alignFP,
 			&totalAlignTime,
-			&totalFileHandlingTime);
+			&totalFileHandlingTime,
+			&totalRescueTime,
+			counters);
+	free(counters);
 	fprintf(stderr, "%s", BREAK_LINE);
 
 	/* Re-initialize */
@@ -498,7 +513,7 @@ void Run(RGBinary *rg,
 	CloseTmpGZFile(&alignFP, &alignFileName, 1);
 	CloseTmpGZFile(&notAlignedFP, &notAlignedFileName, 1);
 
-	fprintf(stdout, "%d\t%d\t%d\t%d\t%d\t%d\t%d\t%d\t%d\t%d\n",
+	fprintf(stdout, "%d\t%d\t%d\t%d\t%d\t%d\t%d\t%d\t%d\t%.3lf\n",
 			numReads,
 			numScoreLessThan,
 			numScoreEqual,
@@ -508,6 +523,6 @@ void Run(RGBinary *rg,
 			numErrors,
 			deletionLength,
 			insertionLength,
-			totalAlignTime
+			totalAlignTime/1000000000.0
 		   );
 }
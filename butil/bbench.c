@@ -0,0 +1,770 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include <string.h>
+#include <limits.h>
+#include <config.h>
+#include <unistd.h>
+#include <zlib.h>
+#include <sys/stat.h>
+
+#include "../bfast/BLibDefinitions.h"
+#include "../bfast/BLib.h"
+#include "../bfast/BError.h"
+#include "../bfast/RGBinary.h"
+#include "../bfast/RGIndex.h"
+#include "../bfast/RGMatch.h"
+#include "../bfast/RGMatches.h"
+#include "../bfast/RGReads.h"
+#include "../bfast/AlignedRead.h"
+#include "../bfast/AlignedEntry.h"
+#include "../bfast/AlignedReadConvert.h"
+#include "../bfast/ScoringMatrix.h"
+#include "../bfast/AlignMatrix.h"
+#include "../bfast/Align.h"
+#include "../bfast/aflib.h"
+#include "../bfast/RunMatch.h"
+#include "../bfast/RunLocalAlign.h"
+#include "../bfast/RunPostProcess.h"
+#include "SimRead.h"
+#include "bbench.h"
+
+#define Name "bbench"
+
+/* Times the core kernels on reads simulated from the given reference
+ * and prints the results as JSON.  The reads are generated from a fixed
+ * seed, and each benchmark reports a checksum of its results, so the
+ * output of two builds on the same machine can be compared directly.
+ * */
+
+int PrintUsage()
+{
+	fprintf(stderr, "%s %s\n", "bfast", PACKAGE_VERSION);
+	fprintf(stderr, "\nUsage:%s [options]\n", Name);
+	fprintf(stderr, "\t-f\tFILE\tSpecifies the file name of the FASTA reference genome\n");
+	fprintf(stderr, "\t-i\tFILE\tSpecifies the bfast index file name\n");
+	fprintf(stderr, "\t-A\tINT\t0: NT space 1: Color space\n");
+	fprintf(stderr, "\t-N\tINT\tSpecifies the number of reads to simulate (Default %d)\n", BBENCH_DEFAULT_NUM_READS);
+	fprintf(stderr, "\t-l\tINT\tSpecifies the read length (Default %d)\n", BBENCH_DEFAULT_READ_LENGTH);
+	fprintf(stderr, "\t-s\tINT\tSpecifies the number of SNPs per read (Default 0)\n");
+	fprintf(stderr, "\t-e\tINT\tSpecifies the number of color errors per read (Default 0)\n");
+	fprintf(stderr, "\t-r\tINT\tSpecifies the number of times each benchmark is run (Default %d)\n", BBENCH_DEFAULT_NUM_REPEATS);
+	fprintf(stderr, "\t-S\tINT\tSpecifies the random seed (Default %d)\n", BBENCH_DEFAULT_SEED);
+	fprintf(stderr, "\t-n\tINT\tSpecifies the number of threads for the end-to-end benchmark (Default 1)\n");
+	fprintf(stderr, "\t-E\t\tSkip the end-to-end benchmark\n");
+	fprintf(stderr, "\t-T\tDIR\tSpecifies the directory in which to store temporary file\n");
+	fprintf(stderr, "\t-h\t\tprints this help message\n");
+	fprintf(stderr, "\nThe end-to-end benchmark runs match, localalign and postprocess\n");
+	fprintf(stderr, "using the main indexes of the reference, as bfast align does.\n");
+	fprintf(stderr, "\nsend bugs to %s\n",
+			PACKAGE_BUGREPORT);
+	return 1;
+}
+
+int main(int argc, char *argv[])
+{
+	char *fastaFileName=NULL;
+	char *indexFileName=NULL;
+	char tmpDir[MAX_FILENAME_LENGTH]="./";
+	int space = NTSpace;
+	int numReads = BBENCH_DEFAULT_NUM_READS;
+	int readLength = BBENCH_DEFAULT_READ_LENGTH;
+	int numSNPs = 0;
+	int numErrors = 0;
+	int numRepeats = BBENCH_DEFAULT_NUM_REPEATS;
+	int seed = BBENCH_DEFAULT_SEED;
+	int numThreads = 1;
+	int endToEnd = 1;
+	int c, i;
+	RGBinary rg, rgIndex;
+	RGIndex index;
+	ScoringMatrix sm;
+	AlignMatrix matrix;
+	BBenchData data;
+	BBenchResult results[BBENCH_MAX_NUM_BENCHMARKS];
+	int32_t numResults=0;
+
+	while((c = getopt(argc, argv, "e:f:i:l:n:r:s:A:N:S:T:Eh")) >= 0) {
+		switch(c) {
+			case 'e': numErrors=atoi(optarg); break;
+			case 'f': fastaFileName=strdup(optarg); break;
+			case 'h': return PrintUsage();
+			case 'i': indexFileName=strdup(optarg); break;
+			case 'l': readLength=atoi(optarg); break;
+			case 'n': numThreads=atoi(optarg); break;
+			case 'r': numRepeats=atoi(optarg); break;
+			case 's': numSNPs=atoi(optarg); break;
+			case 'A': space=atoi(optarg); break;
+			case 'E': endToEnd=0; break;
+			case 'N': numReads=atoi(optarg); break;
+			case 'S': seed=atoi(optarg); break;
+			case 'T': strcpy(tmpDir, optarg); break;
+			default: fprintf(stderr, "Unrecognized option: -%c\n", c); return 1;
+		}
+	}
+
+	if(1 == argc || argc != optind) {
+		return PrintUsage();
+	}
+
+	if(NULL == fastaFileName) {
+		PrintError(Name, "fastaFileName", "Command line option", Exit, InputArguments);
+	}
+	if(NULL == indexFileName) {
+		PrintError(Name, "indexFileName", "Command line option", Exit, InputArguments);
+	}
+	if(NTSpace != space && ColorSpace != space) {
+		PrintError(Name, "space", "Command line option", Exit, InputArguments);
+	}
+	if(numReads <= 0) {
+		PrintError(Name, "numReads", "Command line option", Exit, InputArguments);
+	}
+	if(readLength <= 0 || SEQUENCE_LENGTH <= readLength + 1) {
+		PrintError(Name, "readLength", "Command line option", Exit, InputArguments);
+	}
+	if(numSNPs < 0 || readLength < numSNPs) {
+		PrintError(Name, "numSNPs", "Command line option", Exit, InputArguments);
+	}
+	if(numErrors < 0 || readLength < numErrors || (NTSpace == space && 0 < numErrors)) {
+		PrintError(Name, "numErrors", "Command line option", Exit, InputArguments);
+	}
+	if(numRepeats <= 0) {
+		PrintError(Name, "numRepeats", "Command line option", Exit, InputArguments);
+	}
+	if(numThreads <= 0) {
+		PrintError(Name, "numThreads", "Command line option", Exit, InputArguments);
+	}
+
+	/* Only the results are printed */
+	VERBOSE = -1;
+
+	/* Read in the reference genome and the index */
+	RGBinaryReadBinary(&rg, NTSpace, fastaFileName);
+	if(ColorSpace == space) {
+		RGBinaryReadBinary(&rgIndex, ColorSpace, fastaFileName);
+	}
+	RGIndexRead(&index, indexFileName);
+	if(space != index.space) {
+		PrintError(Name, "space", "The index was not created in the given space", Exit, OutOfRange);
+	}
+	ScoringMatrixInitialize(&sm);
+	AlignMatrixInitialize(&matrix);
+
+	data.rg = &rg;
+	data.rgIndex = (ColorSpace == space) ? &rgIndex : &rg;
+	data.index = &index;
+	data.sm = &sm;
+	data.matrix = &matrix;
+	data.space = space;
+	data.numReads = numReads;
+	data.fastaFileName = fastaFileName;
+	data.tmpDir = tmpDir;
+	data.numThreads = numThreads;
+
+	fprintf(stderr, "Simulating %d reads.\n", numReads);
+	BBenchSimulateReads(&data, readLength, numSNPs, numErrors, seed);
+
+	/* Each benchmark uses the output of the previous */
+	BBenchRun(&results[numResults++], "RGIndexGetIndex", BBenchIndexGetIndex, &data, numRepeats);
+	BBenchRun(&results[numResults++], "RGReadsFindMatches", BBenchFindMatches, &data, numRepeats);
+	BBenchRun(&results[numResults++],
+			(NTSpace == space) ? "AlignNTSpaceGappedBounded" : "AlignColorSpaceGappedBounded",
+			BBenchGappedBounded, &data, numRepeats);
+	BBenchRun(&results[numResults++], "AlignRGMatches", BBenchAlignRGMatches, &data, numRepeats);
+
+	/* Write the matches and alignments to be read back */
+	data.matchesFP = OpenTmpGZFile(tmpDir, &data.matchesFileName, TmpCompressionDefault);
+	data.alignedFP = OpenTmpGZFile(tmpDir, &data.alignedFileName, TmpCompressionDefault);
+	for(i=0;i<numReads;i++) {
+		RGMatchesPrint(data.matchesFP, &data.matches[i]);
+		AlignedReadPrint(&data.aligned[i], data.alignedFP);
+	}
+	ReopenTmpGZFile(&data.matchesFP, &data.matchesFileName);
+	ReopenTmpGZFile(&data.alignedFP, &data.alignedFileName);
+
+	BBenchRun(&results[numResults++], "RGMatchesRead", BBenchRGMatchesRead, &data, numRepeats);
+	BBenchRun(&results[numResults++], "AlignedReadRead", BBenchAlignedReadRead, &data, numRepeats);
+	BBenchRun(&results[numResults++], "AlignedReadConvertPrintSAM", BBenchFormatSAM, &data, numRepeats);
+	if(1 == endToEnd) {
+		BBenchRun(&results[numResults++], "endToEnd", BBenchEndToEnd, &data, numRepeats);
+	}
+	assert(numResults <= BBENCH_MAX_NUM_BENCHMARKS);
+
+	BBenchPrintJSON(stdout, results, numResults, &data, indexFileName, readLength, numSNPs, numErrors, numRepeats, seed);
+
+	/* Free */
+	CloseTmpGZFile(&data.matchesFP, &data.matchesFileName, 1);
+	CloseTmpGZFile(&data.alignedFP, &data.alignedFileName, 1);
+	if(0 != remove(data.readsFileName)) {
+		PrintError(Name, data.readsFileName, "Could not delete temporary file", Exit, DeleteFileError);
+	}
+	free(data.readsFileName);
+	for(i=0;i<numReads;i++) {
+		RGMatchesFree(&data.matches[i]);
+		AlignedReadFree(&data.aligned[i]);
+		free(data.references[i]);
+	}
+	free(data.matches);
+	free(data.aligned);
+	free(data.references);
+	free(data.referenceLengths);
+	free(data.referencePositions);
+	free(data.strands);
+	AlignMatrixFree(&matrix);
+	RGIndexDelete(&index);
+	if(ColorSpace == space) {
+		RGBinaryDelete(&rgIndex);
+	}
+	RGBinaryDelete(&rg);
+	free(fastaFileName);
+	free(indexFileName);
+
+	return 0;
+}
+
+/* TODO */
+/* The reads are also written as FASTQ for the end-to-end benchmark */
+void BBenchSimulateReads(BBenchData *data,
+		int32_t readLength,
+		int32_t numSNPs,
+		int32_t numErrors,
+		int32_t seed)
+{
+	char *FnName="BBenchSimulateReads";
+	int64_t rgLength=0;
+	int32_t i, j;
+	SimRead r;
+	RGMatch *m=NULL;
+	FILE *fp=NULL;
+
+	for(i=0;i<data->rg->numContigs;i++) {
+		rgLength += data->rg->contigs[i].sequenceLength;
+	}
+
+	data->matches = malloc(sizeof(RGMatches)*data->numReads);
+	if(NULL == data->matches) {
+		PrintError(FnName, "data->matches", "Could not allocate memory", Exit, MallocMemory);
+	}
+	data->aligned = malloc(sizeof(AlignedRead)*data->numReads);
+	if(NULL == data->aligned) {
+		PrintError(FnName, "data->aligned", "Could not allocate memory", Exit, MallocMemory);
+	}
+	data->references = malloc(sizeof(char*)*data->numReads);
+	if(NULL == data->references) {
+		PrintError(FnName, "data->references", "Could not allocate memory", Exit, MallocMemory);
+	}
+	data->referenceLengths = malloc(sizeof(int32_t)*data->numReads);
+	if(NULL == data->referenceLengths) {
+		PrintError(FnName, "data->referenceLengths", "Could not allocate memory", Exit, MallocMemory);
+	}
+	data->referencePositions = malloc(sizeof(int32_t)*data->numReads);
+	if(NULL == data->referencePositions) {
+		PrintError(FnName, "data->referencePositions", "Could not allocate memory", Exit, MallocMemory);
+	}
+	data->strands = malloc(sizeof(char)*data->numReads);
+	if(NULL == data->strands) {
+		PrintError(FnName, "data->strands", "Could not allocate memory", Exit, MallocMemory);
+	}
+
+	fp = OpenTmpFile(data->tmpDir, &data->readsFileName);
+
+	srand(seed);
+	SimReadInitialize(&r);
+	for(i=0;i<data->numReads;i++) {
+		SimReadGetRandom(data->rg,
+				rgLength,
+				&r,
+				data->space,
+				0,
+				0,
+				0,
+				numSNPs,
+				numErrors,
+				readLength,
+				1,
+				0);
+		r.readNum = i+1;
+		SimReadPrint(&r, fp);
+
+		/* Store as the input to the search */
+		RGMatchesInitialize(&data->matches[i]);
+		RGMatchesReallocate(&data->matches[i], 1);
+		data->matches[i].readName = SimReadGetName(&r);
+		data->matches[i].readNameLength = strlen(data->matches[i].readName);
+		m = &data->matches[i].ends[0];
+		m->readLength = strlen(r.readOne);
+		m->read = strdup(r.readOne);
+		if(NULL == m->read) {
+			PrintError(FnName, "m->read", "Could not allocate memory", Exit, MallocMemory);
+		}
+		m->qualLength = (ColorSpace == data->space) ? m->readLength - 1 : m->readLength;
+		m->qual = malloc(sizeof(char)*(m->qualLength + 1));
+		if(NULL == m->qual) {
+			PrintError(FnName, "m->qual", "Could not allocate memory", Exit, MallocMemory);
+		}
+		for(j=0;j<m->qualLength;j++) {
+			m->qual[j] = QUAL2CHAR(SIMREAD_DEFAULT_QUAL);
+		}
+		m->qual[m->qualLength] = '\0';
+
+		/* Get the reference around the true location */
+		data->references[i] = NULL;
+		data->strands[i] = r.strand;
+		RGBinaryGetReference(data->rg,
+				r.contig,
+				r.pos,
+				r.strand,
+				OFFSET_LENGTH,
+				&data->references[i],
+				readLength,
+				&data->referenceLengths[i],
+				&data->referencePositions[i]);
+
+		AlignedReadInitialize(&data->aligned[i]);
+		SimReadDelete(&r);
+	}
+
+	fclose(fp);
+}
+
+/* TODO */
+/* Returns the read length, with the read in nucleotides and the colors
+ * without the adaptor (see AlignRGMatchesOneEnd) */
+int32_t BBenchGetReadAndColors(char *in,
+		int32_t inLength,
+		int32_t space,
+		char *read,
+		char *colors)
+{
+	int32_t i, readLength;
+
+	strcpy(read, in);
+	if(NTSpace == space) {
+		return inLength;
+	}
+	strcpy(colors, in);
+	NormalizeColorSpaceRead(colors, inLength, COLOR_SPACE_START_NT);
+	readLength = ConvertReadFromColorSpace(read, inLength);
+	for(i=0;i<readLength;i++) {
+		switch(colors[i+1]) {
+			case '0':
+			case '1':
+			case '2':
+			case '3':
+				colors[i] = colors[i+1]; break;
+			default:
+				colors[i] = '4';
+		}
+	}
+	colors[i]='\0';
+	return readLength;
+}
+
+/* TODO */
+/* Runs the benchmark the given number of times, keeping the minimum and
+ * median times */
+void BBenchRun(BBenchResult *result,
+		char *name,
+		int64_t (*benchmark)(BBenchData*),
+		BBenchData *data,
+		int32_t numRepeats)
+{
+	char *FnName="BBenchRun";
+	int64_t *times=NULL;
+	int64_t startTime, checksum;
+	int32_t i;
+
+	times = malloc(sizeof(int64_t)*numRepeats);
+	if(NULL == times) {
+		PrintError(FnName, "times", "Could not allocate memory", Exit, MallocMemory);
+	}
+
+	fprintf(stderr, "Running %s.\n", name);
+	result->name = name;
+	result->numRepeats = numRepeats;
+	for(i=0;i<numRepeats;i++) {
+		data->numOps = 0;
+		startTime = BTimeNow();
+		checksum = benchmark(data);
+		times[i] = BTimeNow() - startTime;
+		if(0 < i && checksum != result->checksum) {
+			PrintError(FnName, name, "The results differed between runs", Warn, OutOfRange);
+		}
+		result->checksum = checksum;
+		result->numOps = data->numOps;
+	}
+
+	qsort(times, numRepeats, sizeof(int64_t), BBenchTimeCompare);
+	result->minTime = times[0];
+	result->medianTime = times[numRepeats/2];
+
+	free(times);
+}
+
+/* TODO */
+int BBenchTimeCompare(const void *a, const void *b)
+{
+	int64_t x = *((int64_t*)a), y = *((int64_t*)b);
+	return (x < y) ? -1 : ((x == y) ? 0 : 1);
+}
+
+/* TODO */
+/* Looks up every key of every read, as the search does for one strand */
+int64_t BBenchIndexGetIndex(BBenchData *data)
+{
+	int8_t read[SEQUENCE_LENGTH];
+	int64_t startIndex, endIndex, checksum=0;
+	int32_t i, j, readLength, readOffset;
+	RGMatch *m=NULL;
+
+	readOffset = (ColorSpace == data->space) ? 2 : 0;
+	for(i=0;i<data->numReads;i++) {
+		m = &data->matches[i].ends[0];
+		readLength = m->readLength - readOffset;
+		ConvertSequenceToIntegers(m->read + readOffset, read, readLength);
+		for(j=0;j + data->index->width <= readLength;j++) {
+			if(0 < RGIndexGetIndex(data->index, data->rgIndex, read + j, data->index->width, &startIndex, &endIndex)) {
+				checksum += endIndex - startIndex + 1;
+			}
+			data->numOps++;
+		}
+	}
+	return checksum;
+}
+
+/* TODO */
+int64_t BBenchFindMatches(BBenchData *data)
+{
+	int64_t checksum=0;
+	int32_t i;
+	RGMatch *m=NULL;
+
+	for(i=0;i<data->numReads;i++) {
+		m = &data->matches[i].ends[0];
+		RGMatchClearMatches(m);
+		m->maxReached = 0;
+		RGReadsFindMatches(data->index,
+				data->rgIndex,
+				m,
+				0,
+				NULL,
+				0,
+				data->space,
+				0,
+				0,
+				0,
+				0,
+				0,
+				MAX_KEY_MATCHES,
+				MAX_KEY_MISS_FRACTION,
+				MAX_NUM_MATCHES,
+				BothStrands,
+				NULL);
+		checksum += m->numEntries;
+		data->numOps++;
+	}
+	return checksum;
+}
+
+/* TODO */
+/* Aligns each read to the reference around its true location */
+int64_t BBenchGappedBounded(BBenchData *data)
+{
+	char read[SEQUENCE_LENGTH]="\0";
+	char colors[SEQUENCE_LENGTH]="\0";
+	int64_t checksum=0;
+	int32_t i, readLength;
+	RGMatch *m=NULL;
+	AlignedEntry a;
+
+	for(i=0;i<data->numReads;i++) {
+		m = &data->matches[i].ends[0];
+		readLength = BBenchGetReadAndColors(m->read, m->readLength, data->space, read, colors);
+		if(data->matrix->nrow < readLength + 1 || data->matrix->ncol < data->referenceLengths[i] + 1) {
+			AlignMatrixReallocate(data->matrix,
+					GETMAX(data->matrix->nrow, readLength + 1),
+					GETMAX(data->matrix->ncol, data->referenceLengths[i] + 1));
+		}
+		AlignedEntryInitialize(&a);
+		AlignGappedBounded(read,
+				colors,
+				readLength,
+				data->references[i],
+				data->referenceLengths[i],
+				data->sm,
+				&a,
+				data->matrix,
+				data->space,
+				data->referencePositions[i],
+				data->strands[i],
+				NEGATIVE_INFINITY,
+				readLength,
+				readLength);
+		checksum += (int64_t)a.score + a.position;
+		AlignedEntryFree(&a);
+		data->numOps++;
+	}
+	return checksum;
+}
+
+/* TODO */
+int64_t BBenchAlignRGMatches(BBenchData *data)
+{
+	int64_t checksum=0;
+	int32_t i;
+
+	for(i=0;i<data->numReads;i++) {
+		AlignedReadFree(&data->aligned[i]);
+		AlignedReadInitialize(&data->aligned[i]);
+		checksum += AlignRGMatches(&data->matches[i],
+				data->rg,
+				&data->aligned[i],
+				data->space,
+				OFFSET_LENGTH,
+				data->sm,
+				Gapped,
+				Constrained,
+				AllAlignments,
+				0,
+				0,
+				NoMirroring,
+				0,
+				data->matrix,
+				NULL);
+		checksum += data->aligned[i].ends[0].numEntries;
+		data->numOps++;
+	}
+	return checksum;
+}
+
+/* TODO */
+int64_t BBenchRGMatchesRead(BBenchData *data)
+{
+	int64_t checksum=0;
+	RGMatches m;
+
+	gzrewind(data->matchesFP);
+	RGMatchesInitialize(&m);
+	while(EOF != RGMatchesRead(data->matchesFP, &m)) {
+		checksum += m.ends[0].numEntries;
+		data->numOps++;
+		RGMatchesFree(&m);
+	}
+	return checksum;
+}
+
+/* TODO */
+int64_t BBenchAlignedReadRead(BBenchData *data)
+{
+	int64_t checksum=0;
+	AlignedRead a;
+
+	gzrewind(data->alignedFP);
+	AlignedReadInitialize(&a);
+	while(EOF != AlignedReadRead(&a, data->alignedFP)) {
+		checksum += a.ends[0].numEntries;
+		data->numOps++;
+		AlignedReadFree(&a);
+	}
+	return checksum;
+}
+
+/* TODO */
+/* The checksum is the number of bytes formatted */
+int64_t BBenchFormatSAM(BBenchData *data)
+{
+	char *FnName="BBenchFormatSAM";
+	FILE *fp=NULL;
+	char *output=NULL;
+	size_t outputLength=0;
+	int32_t numEntries[1];
+	int32_t i;
+
+	if(!(fp = open_memstream(&output, &outputLength))) {
+		PrintError(FnName, "output", "Could not open a memory stream", Exit, OpenFileError);
+	}
+	for(i=0;i<data->numReads;i++) {
+		numEntries[0] = data->aligned[i].ends[0].numEntries;
+		AlignedReadConvertPrintOutputFormat(&data->aligned[i],
+				data->rg,
+				fp,
+				NULL,
+				"",
+				NULL,
+				AllNotFiltered,
+				numEntries,
+				SAM,
+				0,
+				0,
+				BinaryOutput);
+		data->numOps++;
+	}
+	fclose(fp);
+	free(output);
+	return (int64_t)outputLength;
+}
+
+/* TODO */
+/* Runs match, localalign and postprocess as bfast align does, with the
+ * output written to a temporary file.  The checksum is the size of the
+ * output. */
+int64_t BBenchEndToEnd(BBenchData *data)
+{
+	char *FnName="BBenchEndToEnd";
+	char *matchFileName=NULL, *alignFileName=NULL, *outputFileName=NULL;
+	FILE *matchFP=NULL, *alignFP=NULL, *outputFP=NULL;
+	struct stat st;
+	RGBinary rg;
+
+	matchFP = OpenTmpFile(data->tmpDir, &matchFileName);
+	RunMatch(data->fastaFileName,
+			NULL,
+			NULL,
+			NULL,
+			data->readsFileName,
+			NULL,
+			IndexesMemorySerial,
+			0,
+			0,
+			0,
+			AFILE_NO_COMPRESSION,
+			data->space,
+			1,
+			INT_MAX,
+			0,
+			MAX_KEY_MATCHES,
+			MAX_KEY_MISS_FRACTION,
+			MAX_NUM_MATCHES,
+			BothStrands,
+			data->numThreads,
+			DEFAULT_MATCHES_QUEUE_LENGTH,
+			data->tmpDir,
+			DEFAULT_TMP_COMPRESSION,
+			0,
+			matchFP);
+	fclose(matchFP);
+
+	alignFP = OpenTmpFile(data->tmpDir, &alignFileName);
+	RunAligner(data->fastaFileName,
+			matchFileName,
+			NULL,
+			Gapped,
+			Constrained,
+			AllAlignments,
+			data->space,
+			1,
+			INT_MAX,
+			OFFSET_LENGTH,
+			MAX_NUM_MATCHES,
+			AVG_MISMATCH_QUALITY,
+			data->numThreads,
+			DEFAULT_MATCHES_QUEUE_LENGTH,
+			0,
+			0,
+			NoMirroring,
+			0,
+			0,
+			0.0,
+			0.0,
+			INSERT_MAX_STD,
+			RESCUE_NUM_HITS,
+			0,
+			alignFP);
+	fclose(alignFP);
+	if(0 != remove(matchFileName)) {
+		PrintError(FnName, matchFileName, "Could not delete temporary file", Exit, DeleteFileError);
+	}
+
+	outputFP = OpenTmpFile(data->tmpDir, &outputFileName);
+	RGBinaryReadBinary(&rg, NTSpace, data->fastaFileName);
+	ReadInputFilterAndOutput(&rg,
+			alignFileName,
+			BestScore,
+			data->space,
+			-1,
+			-1,
+			1,
+			AVG_MISMATCH_QUALITY,
+			NULL,
+			0,
+			INT_MIN,
+			INT_MIN,
+			0,
+			0.0,
+			0.0,
+			data->numThreads,
+			data->numThreads,
+			DEFAULT_LOCALALIGN_QUEUE_LENGTH,
+			SAM,
+			NULL,
+			NULL,
+			0,
+			0,
+			POSTPROCESS_SORT_DEFAULT_MEMORY_LIMIT,
+			data->tmpDir,
+			0,
+			outputFP);
+	fclose(outputFP);
+	RGBinaryDelete(&rg);
+	if(0 != remove(alignFileName)) {
+		PrintError(FnName, alignFileName, "Could not delete temporary file", Exit, DeleteFileError);
+	}
+
+	if(0 != stat(outputFileName, &st)) {
+		PrintError(FnName, outputFileName, "Could not get the size of the file", Exit, ReadFileError);
+	}
+	if(0 != remove(outputFileName)) {
+		PrintError(FnName, outputFileName, "Could not delete temporary file", Exit, DeleteFileError);
+	}
+	free(matchFileName);
+	free(alignFileName);
+	free(outputFileName);
+
+	data->numOps = data->numReads;
+	return (int64_t)st.st_size;
+}
+
+/* TODO */
+/* The keys and their order are fixed so the output of two runs can be
+ * compared line by line */
+void BBenchPrintJSON(FILE *fp,
+		BBenchResult *results,
+		int32_t numResults,
+		BBenchData *data,
+		char *indexFileName,
+		int32_t readLength,
+		int32_t numSNPs,
+		int32_t numErrors,
+		int32_t numRepeats,
+		int32_t seed)
+{
+	int32_t i;
+
+	fprintf(fp, "{\n");
+	fprintf(fp, "\"program\":\"%s\",\"version\":\"%s\",\n", Name, PACKAGE_VERSION);
+	fprintf(fp, "\"parameters\":{\"fasta\":\"%s\",\"index\":\"%s\",\"space\":%d,\"numReads\":%d,\"readLength\":%d,\"numSNPs\":%d,\"numErrors\":%d,\"repeats\":%d,\"seed\":%d,\"numThreads\":%d},\n",
+			data->fastaFileName,
+			indexFileName,
+			data->space,
+			data->numReads,
+			readLength,
+			numSNPs,
+			numErrors,
+			numRepeats,
+			seed,
+			data->numThreads);
+	fprintf(fp, "\"benchmarks\":[\n");
+	for(i=0;i<numResults;i++) {
+		fprintf(fp, "{\"name\":\"%s\",\"ops\":%lld,\"checksum\":%lld,\"minTime\":%.9lf,\"medianTime\":%.9lf,\"nsPerOp\":%.3lf,\"opsPerSecond\":%.3lf}%s\n",
+				results[i].name,
+				(long long int)results[i].numOps,
+				(long long int)results[i].checksum,
+				results[i].minTime/1000000000.0,
+				results[i].medianTime/1000000000.0,
+				(0 < results[i].numOps) ? results[i].minTime/(double)results[i].numOps : 0.0,
+				(0 < results[i].minTime) ? results[i].numOps*1000000000.0/results[i].minTime : 0.0,
+				(i < numResults - 1) ? "," : "");
+	}
+	fprintf(fp, "]\n");
+	fprintf(fp, "}\n");
+}
@@ -0,0 +1,65 @@
+#ifndef BBENCH_H_
+#define BBENCH_H_
+
+#include "../bfast/BLibDefinitions.h"
+#include "../bfast/AlignMatrix.h"
+
+#define BBENCH_DEFAULT_NUM_READS 10000
+#define BBENCH_DEFAULT_READ_LENGTH 50
+#define BBENCH_DEFAULT_NUM_REPEATS 5
+#define BBENCH_DEFAULT_SEED 1
+#define BBENCH_MAX_NUM_BENCHMARKS 16
+
+/* The inputs shared by the benchmarks, generated once up front */
+typedef struct {
+	RGBinary *rg; /* nucleotide space, as used for alignment */
+	RGBinary *rgIndex; /* the space of the index */
+	RGIndex *index;
+	ScoringMatrix *sm;
+	AlignMatrix *matrix;
+	int32_t space;
+	int32_t numReads;
+	/* The simulated reads, with the candidate locations found by the search */
+	RGMatches *matches;
+	/* The true location of each read and the reference around it */
+	char **references;
+	int32_t *referenceLengths;
+	int32_t *referencePositions;
+	char *strands;
+	AlignedRead *aligned;
+	/* Files written during setup and read back by the decoding benchmarks */
+	char *fastaFileName;
+	char *readsFileName;
+	gzFile matchesFP;
+	char *matchesFileName;
+	gzFile alignedFP;
+	char *alignedFileName;
+	char *tmpDir;
+	int32_t numThreads;
+	int64_t numOps; /* set by each benchmark */
+} BBenchData;
+
+typedef struct {
+	char *name;
+	int64_t numOps;
+	int64_t checksum;
+	int64_t minTime;
+	int64_t medianTime;
+	int32_t numRepeats;
+} BBenchResult;
+
+void BBenchSimulateReads(BBenchData*, int32_t, int32_t, int32_t, int32_t);
+int32_t BBenchGetReadAndColors(char*, int32_t, int32_t, char*, char*);
+void BBenchRun(BBenchResult*, char*, int64_t (*)(BBenchData*), BBenchData*, int32_t);
+int BBenchTimeCompare(const void*, const void*);
+int64_t BBenchIndexGetIndex(BBenchData*);
+int64_t BBenchFindMatches(BBenchData*);
+int64_t BBenchGappedBounded(BBenchData*);
+int64_t BBenchAlignRGMatches(BBenchData*);
+int64_t BBenchRGMatchesRead(BBenchData*);
+int64_t BBenchAlignedReadRead(BBenchData*);
+int64_t BBenchFormatSAM(BBenchData*);
+int64_t BBenchEndToEnd(BBenchData*);
+void BBenchPrintJSON(FILE*, BBenchResult*, int32_t, BBenchData*, char*, int32_t, int32_t, int32_t, int32_t, int32_t);
+
+#endif
@@ -11,18 +11,19 @@
 #include "../bfast/BLib.h"
 #include "../bfast/BError.h"
 #include "../bfast/RGIndex.h"
-#include "../bfast/RGRanges.h"
-#include "../bfast/RGMatch.h"
-#include "../bfast/RGReads.h"
 #include "bindexdist.h"
 
 #define Name "bindexdist"
-#define BINDEXDIST_ROTATE_NUM 100000
-#define BINDEXDIST_SORT_ROTATE_INC 0.01
 
 /* Prints each unique read from the genome and the number 
  * of times it occurs, where the genome is contained in 
  * the bfast index file.
+ *
+ * Each read is the key of the index (the bases under the 
+ * mask), packed two bits per base into a 64-bit word.  The 
+ * index is already sorted, so the forward counts are the 
+ * lengths of the runs of equal keys.  The reverse strand 
+ * keys are radix sorted and merged with the forward keys.
  * */
 
 int PrintUsage()
@@ -34,7 +35,6 @@ int PrintUsage()
 	fprintf(stderr, "\t-s\tINT\tStrands 0: both strands 1: forward only 2: reverse only\n");
 	fprintf(stderr, "\t-n\tINT\tSpecifies the number of threads to use (Default 1)\n");
 	fprintf(stderr, "\t-A\tINT\t0: NT space 1: Color space\n");
-	fprintf(stderr, "\t-T\tDIR\tSpecifies the directory in which to store temporary file\n");
 	fprintf(stderr, "\t-h\t\tprints this help message\n");
 	fprintf(stderr, "\nsend bugs to %s\n",
 			PACKAGE_BUGREPORT);
@@ -45,7 +45,6 @@ int main(int argc, char *argv[])
 {
 	char *indexFileName=NULL;
 	char *fastaFileName=NULL;
-	char tmpDir[MAX_FILENAME_LENGTH]="./";
 	int numThreads = 1;
 	int whichStrand = 0;
 	int space = NTSpace;
@@ -61,7 +60,7 @@ int main(int argc, char *argv[])
 			case 's': whichStrand=atoi(optarg); break;
 			case 'n': numThreads=atoi(optarg); break;
 			case 'A': space=atoi(optarg); break;
-			case 'T': strcpy(tmpDir, optarg); break;
+			case 'T': break; /* No longer uses temporary files */
 			default: fprintf(stderr, "Unrecognized option: -%c\n", c); return 1;
 		}
 	}
@@ -96,7 +95,6 @@ int main(int argc, char *argv[])
 	PrintDistribution(&index, 
 			&rg, 
 			whichStrand,
-			tmpDir,
 			numThreads); 
 	fprintf(stderr, "%s", BREAK_LINE);
 
@@ -116,110 +114,37 @@ int main(int argc, char *argv[])
 void PrintDistribution(RGIndex *index, 
 		RGBinary *rg,
 		int whichStrand,
-		char *tmpDir,
 		int numThreads)
 {
 	char *FnName = "PrintDistribution";
-	FILE *fp;
-	int64_t startIndex = 0;
-	int64_t endIndex = index->length-1;
-	int64_t curIndex=0, nextIndex=0;
-	int64_t counter=0;
-	int64_t numDifferent = 0;
-	int64_t numForward, numReverse;
-	int64_t prevIndex=0;
-	char *read=NULL;
-	char *reverseRead=NULL;
+	int32_t *maskPositions=NULL;
+	int32_t keysize=0, symmetric=1;
+	uint64_t *keys=NULL, *reverseKeys=NULL;
+	int64_t *counts=NULL, *reverseCounts=NULL;
+	int64_t numKeys=0, numReverseKeys=0;
 	int64_t i, j;
-	char **reads=NULL;
-	int64_t *readCounts=NULL;
-	int64_t numReads=0;
 	pthread_t *threads=NULL;
 	ThreadData *data=NULL;
 	int errCode;
 	void *status;
 
-	fprintf(stderr, "Out of %lld, currently on:\n0",
-			(long long int)(endIndex - startIndex + 1));
-	/* Go through every possible read in the genome using the index */
-	for(curIndex=startIndex, nextIndex=startIndex, counter=0, numDifferent=0;
-			curIndex <= endIndex;
-			curIndex = nextIndex) {
-		if(counter >= BINDEXDIST_ROTATE_NUM) {
-			fprintf(stderr, "\r%10lld", 
-					(long long int)(curIndex-startIndex));
-			counter -= BINDEXDIST_ROTATE_NUM;
-		}
-		/* Get the matches for the contig/pos */
-		GetMatchesFromContigPos(index,
-				rg,
-				(index->contigType==Contig_8)?(index->contigs_8[curIndex]):(index->contigs_32[curIndex]),
-				index->positions[curIndex],
-				&numForward, 
-				&numReverse,
-				&read,
-				&reverseRead);
-		assert(numForward + numReverse> 0);
-
-		nextIndex += numForward;
-		counter += numForward;
-		/* In case reverse is zero */
-		if(numForward <= 0) {
-			nextIndex++;
-			counter++;
-		}
-
-		/* Reallocate memory */
-		prevIndex = numReads;
-		if((BothStrands == whichStrand || ReverseStrand == whichStrand) &&
-				numReverse == 0) {
-			numReads+=2; /* One for both strands */
-		}
-		else {
-			numReads++; /* Only for + strand */
-		}
-		reads = realloc(reads, sizeof(char*)*numReads);
-		if(NULL==reads) {
-			PrintError(FnName, "reads", "Could not allocate memory", Exit, MallocMemory);
-		}
-		while(prevIndex < numReads) {
-			reads[prevIndex] = malloc(sizeof(char)*(index->width+1));
-			if(NULL==reads[prevIndex]) {
-				PrintError(FnName, "reads[prevIndex]", "Could not allocate memory", Exit, MallocMemory);
-			}
-			prevIndex++;
-		}
-		readCounts = realloc(readCounts, sizeof(int64_t)*numReads);
-		if(NULL==readCounts) {
-			PrintError(FnName, "readCounts", "Could not allocate memory", Exit, MallocMemory);
+	/* Get the offsets of the key within the mask */
+	maskPositions = malloc(sizeof(int32_t)*index->width);
+	if(NULL==maskPositions) {
+		PrintError(FnName, "maskPositions", "Could not allocate memory", Exit, MallocMemory);
+	}
+	for(i=0;i<index->width;i++) {
+		if(1 == index->mask[i]) {
+			maskPositions[keysize++] = i;
 		}
-		/* Copy over */
-		assert(strlen(read) < SEQUENCE_LENGTH);
-		assert(strlen(reverseRead) < SEQUENCE_LENGTH);
-		ToLowerRead(read, index->width+1); 
-		strcpy(reads[numReads-1], read);
-		readCounts[numReads-1] = numForward+numReverse;
-		if((BothStrands == whichStrand || ReverseStrand == whichStrand) &&
-				numReverse == 0) {
-			if(0 == strcmp(reverseRead, read)) {
-				fprintf(stderr, "read=%s\nreverseRead=%s\n",
-						read,
-						reverseRead);
-			}
-			assert(0 != strcmp(reverseRead, read));
-			ToLowerRead(reverseRead, index->width+1); 
-			strcpy(reads[numReads-2], reverseRead);
-			readCounts[numReads-2] = numForward+numReverse;
+		if(index->mask[i] != index->mask[index->width-1-i]) {
+			symmetric = 0;
 		}
-
-		/* Free memory */
-		free(read);
-		read = NULL;
-		free(reverseRead);
-		reverseRead = NULL;
 	}
-	fprintf(stderr, "\r%10lld\n", 
-			(long long int)(curIndex-startIndex+1));
+	assert(keysize == index->keysize);
+	if(BINDEXDIST_MAX_KEYSIZE < keysize) {
+		PrintError(FnName, "index->keysize", "The key of the index must be at most 32 bases", Exit, OutOfRange);
+	}
 
 	/* Allocate memory for threads */
 	threads=malloc(sizeof(pthread_t)*numThreads);
@@ -233,24 +158,32 @@ void PrintDistribution(RGIndex *index,
 	}
 
 	for(i=0;i<numThreads;i++) {
-		data[i].reads = reads;
-		data[i].readCounts = readCounts;
-		data[i].low = i*(numReads/numThreads);
-		data[i].high = (i+1)*(numReads/numThreads)-1;
-		data[i].tmpDir = tmpDir;
-		data[i].readLength = index->width;
-		data[i].showPercentComplete = 0;
+		data[i].index = index;
+		data[i].rg = rg;
+		data[i].maskPositions = maskPositions;
+		data[i].symmetric = symmetric;
+		data[i].low = i*(index->length/numThreads);
+		data[i].high = (i+1)*(index->length/numThreads)-1;
+		data[i].keys = NULL;
+		data[i].counts = NULL;
+		data[i].numKeys = data[i].maxKeys = 0;
+		data[i].reverseKeys = NULL;
+		data[i].reverseCounts = NULL;
+		data[i].numReverseKeys = data[i].maxReverseKeys = 0;
+		data[i].threadID = i;
 	}
 	data[0].low = 0;
-	data[numThreads-1].high = numReads-1;
-	data[numThreads-1].showPercentComplete = 1;
+	data[numThreads-1].high = index->length-1;
 
+	fprintf(stderr, "Counting %lld index entries with %d threads.\n",
+			(long long int)index->length,
+			numThreads);
 	/* Open threads */
 	for(i=0;i<numThreads;i++) {
 		/* Start thread */
 		errCode = pthread_create(&threads[i], /* thread struct */
 				NULL, /* default thread attributes */
-				MergeSortReads, /* start routine */
+				CountKmers, /* start routine */
 				&data[i]); /* data to routine */
 		if(0!=errCode) {
 			PrintError(FnName, "pthread_create: errCode", "Could not start thread", Exit, ThreadError);
@@ -267,456 +200,362 @@ void PrintDistribution(RGIndex *index,
 		}
 	}
 
-	/* Merge results from the sorts */
-	fprintf(stderr, "\rMerging sorts from threads...    \n");
-	for(j=1;j<numThreads;j=j*2) {
-		for(i=0;i<numThreads;i+=2*j) {
-			MergeHelper(reads,
-					readCounts,
-					data[i].low,
-					data[i+j].low-1,
-					data[i+2*j-1].high,
-					tmpDir,
-					index->width);
+	/* Forward keys, in index order */
+	ConcatenateKmers(data, numThreads, FORWARD, &keys, &counts, &numKeys);
+	for(i=1;i<numKeys && keys[i-1] < keys[i];i++) {
+	}
+	if(i < numKeys) {
+		/* The index was not sorted by the packed key */
+		RadixSortKmers(keys, counts, numKeys, keysize);
+		numKeys = MergeKmerRuns(keys, counts, numKeys);
+	}
+	fprintf(stderr, "Found %lld unique reads.\n",
+			(long long int)numKeys);
+
+	/* Reverse keys */
+	ConcatenateKmers(data, numThreads, REVERSE, &reverseKeys, &reverseCounts, &numReverseKeys);
+	RadixSortKmers(reverseKeys, reverseCounts, numReverseKeys, keysize);
+	numReverseKeys = MergeKmerRuns(reverseKeys, reverseCounts, numReverseKeys);
+
+	/* Merge and print.  A read is counted on both strands, and reads 
+	 * found only on the reverse strand are printed unless the forward
+	 * strand alone was requested. */
+	for(i=j=0;i<numKeys || j<numReverseKeys;) {
+		if(numReverseKeys <= j || (i < numKeys && keys[i] < reverseKeys[j])) {
+			PrintKmer(stdout, keys[i], keysize, rg->space, counts[i]);
+			i++;
+		}
+		else if(numKeys <= i || reverseKeys[j] < keys[i]) {
+			if(ForwardStrand != whichStrand) {
+				PrintKmer(stdout, reverseKeys[j], keysize, rg->space, reverseCounts[j]);
+			}
+			j++;
+		}
+		else {
+			PrintKmer(stdout, keys[i], keysize, rg->space, counts[i] + reverseCounts[j]);
+			i++;
+			j++;
 		}
 	}
-	fprintf(stderr, "../bfast/Sorting complete.\n");
-	fprintf(stderr, "%s", BREAK_LINE);
-
-	/* Remove duplicates */
-	/*
-	   fprintf(stderr, "%s", BREAK_LINE);
-	   fprintf(stderr, "../bfast/Removing duplicates.\n");
-	   prevIndex = 0;
-	   for(i=1;i<numReads;i++) {
-	   if(strcmp(reads[prevIndex], reads[i]) == 0) {
-	   free(reads[i]);
-	   reads[i] = NULL;
-	   readCounts[i] = 0;
-	   }
-	   else {
-	   prevIndex++;
-	   if(i != prevIndex) {
-	   assert(reads[prevIndex]==NULL);
-	   assert(reads[i]!=NULL);
-	   reads[prevIndex]=reads[i];
-	   reads[i]=NULL;
-	   }
-	   readCounts[prevIndex]=readCounts[i];
-	   }
-	   }
-	   numReads = prevIndex+1;
-	   reads = realloc(reads, sizeof(char*)*numReads);
-	   if(NULL==reads) {
-	   PrintError(FnName, "reads", "Could not reallocate memory", Exit, ReallocMemory);
-	   }
-	   readCounts = realloc(readCounts, sizeof(int64_t)*numReads);
-	   if(NULL==readCounts) {
-	   PrintError(FnName, "readCounts", "Could not reallocate memory", Exit, ReallocMemory);
-	   }
-	   fprintf(stderr, "../bfast/Removing duplicates complete.\n");
-	   fprintf(stderr, "%s", BREAK_LINE);
-	   */
-
-	/* Open the output file */
-	if(!(fp = fdopen(fileno(stdout), "w"))) {
-		PrintError(FnName, "stdout", "Could not open stdout for writing", Exit, OpenFileError);
-	}
-
-	/* Print */
-	for(i=0;i<numReads;i++) {
-		/* Duplicates */
-		fprintf(fp, "%s\t%lld\n",
-				reads[i],
-				(long long int)readCounts[i]);
-	}
-
-	/* Close the file */
-	fclose(fp);
+	fflush(stdout);
 
 	/* Free memory */
-	for(i=0;i<numReads;i++) {
-		free(reads[i]);
-		reads[i]=NULL;
-	}
-	free(reads);
-	reads=NULL;
-	free(readCounts);
-	readCounts=NULL;
+	free(keys);
+	free(counts);
+	free(reverseKeys);
+	free(reverseCounts);
+	free(maskPositions);
+	free(threads);
+	free(data);
 }
 
-void *MergeSortReads(void *arg)
+/* TODO */
+void *CountKmers(void *arg)
 {
+	char *FnName = "CountKmers";
 	ThreadData *data = (ThreadData*)arg;
-	char **reads = data->reads;
-	int64_t *readCounts = data->readCounts;
-	int64_t low = data->low;
-	int64_t high = data->high;
-	char *tmpDir = data->tmpDir;
-	int readLength = data->readLength;
-
-	double curPercentComplete = 0.0;
-	/* Call helper */
-	if(data->showPercentComplete == 1) {
-		fprintf(stderr, "\r%3.2lf percent complete", 0.0);
-	}
-
-	MergeSortReadsHelper(reads,
-			readCounts,
-			low,
-			high,
-			low,
-			high - low,
-			data->showPercentComplete,
-			&curPercentComplete,
-			tmpDir,
-			readLength);
-	if(data->showPercentComplete == 1) {
-		fprintf(stderr, "\r");
-		fprintf(stderr, "thread %3.2lf percent complete", 100.0);
+	RGIndex *index = data->index;
+	int64_t cur, next, count;
+	uint64_t key, nextKey=0, prevKey, reverseKey;
+
+	cur = data->low;
+	if(data->high < cur) {
+		return NULL;
+	}
+	if(1 != GetKmer(index, data->rg, data->maskPositions, cur, FORWARD, &key)) {
+		PrintError(FnName, "key", "Could not get the key of an index entry", Exit, OutOfRange);
+	}
+	/* Skip the run owned by the previous thread */
+	if(0 < cur) {
+		GetKmer(index, data->rg, data->maskPositions, cur-1, FORWARD, &prevKey);
+		while(key == prevKey && cur < data->high) {
+			cur++;
+			GetKmer(index, data->rg, data->maskPositions, cur, FORWARD, &key);
+		}
+		if(key == prevKey) {
+			return NULL;
+		}
 	}
 
-	return NULL;
-}
+	while(cur <= data->high) {
+		/* Find the end of the run */
+		for(next=cur+1, count=1;next < index->length;next++, count++) {
+			if(1 != GetKmer(index, data->rg, data->maskPositions, next, FORWARD, &nextKey)) {
+				PrintError(FnName, "nextKey", "Could not get the key of an index entry", Exit, OutOfRange);
+			}
+			if(nextKey != key) {
+				break;
+			}
+		}
+		AppendKmer(&data->keys, &data->counts, &data->numKeys, &data->maxKeys, key, count);
 
-void MergeSortReadsHelper(char **reads,
-		int64_t *readCounts,
-		int64_t low,
-		int64_t high,
-		int64_t startLow,
-		int64_t total,
-		int showPercentComplete,
-		double *curPercentComplete,
-		char *tmpDir,
-		int readLength)
-{
-	int64_t mid = (low + high)/2;
-	if(low >= high) {
-
-		if(showPercentComplete == 1) {
-			assert(NULL!=curPercentComplete);
-			if((*curPercentComplete) < 100.0*((double)(low - startLow))/total) {
-				while((*curPercentComplete) < 100.0*((double)(low - startLow))/total) {
-					(*curPercentComplete) += BINDEXDIST_SORT_ROTATE_INC;
+		/* Reverse strand */
+		if(1 == data->symmetric) {
+			AppendKmer(&data->reverseKeys, &data->reverseCounts, &data->numReverseKeys, &data->maxReverseKeys, 
+					GetReverseKmer(key, index->keysize, index->space), count);
+		}
+		else {
+			/* The reverse key depends on the bases outside the mask */
+			for(;cur < next;cur++) {
+				if(1 == GetKmer(index, data->rg, data->maskPositions, cur, REVERSE, &reverseKey)) {
+					AppendKmer(&data->reverseKeys, &data->reverseCounts, &data->numReverseKeys, &data->maxReverseKeys, reverseKey, 1);
 				}
-				PrintPercentCompleteShort((*curPercentComplete));
 			}
 		}
-		return;
+
+		cur = next;
+		key = nextKey;
 	}
 
-	/* Sort recursively */
-	MergeSortReadsHelper(reads,
-			readCounts,
-			low,
-			mid,
-			startLow, 
-			total,
-			showPercentComplete,
-			curPercentComplete,
-			tmpDir,
-			readLength);
-	MergeSortReadsHelper(reads,
-			readCounts,
-			mid+1,
-			high,
-			startLow, 
-			total,
-			showPercentComplete,
-			curPercentComplete,
-			tmpDir,
-			readLength);
-
-	/* Merge the two lists */
-	MergeHelper(reads,
-			readCounts,
-			low,
-			mid,
-			high,
-			tmpDir,
-			readLength);
+	return NULL;
 }
 
-void MergeHelper(char **reads,
-		int64_t *readCounts,
-		int64_t low,
-		int64_t mid,
-		int64_t high,
-		char *tmpDir,
-		int readLength)
+/* Packs the bases under the mask at the given index entry, two 
+ * bits per base with the first base in the highest bits.  For the 
+ * reverse strand, the mask is read over the reverse compliment 
+ * (reverse only in color space).  Returns zero if a base is an N.
+ * */
+int32_t GetKmer(RGIndex *index,
+		RGBinary *rg,
+		int32_t *maskPositions,
+		int64_t indexPos,
+		char strand,
+		uint64_t *key)
 {
-	char *FnName = "MergeHelper";
-	int64_t i=0;
-	char **tmpReads=NULL;
-	int64_t *tmpReadCounts=NULL;
-	int64_t startUpper, startLower, endUpper, endLower;
-	int64_t ctr=0;
-	FILE *tmpLowerFP=NULL;
-	FILE *tmpUpperFP=NULL;
-	char *tmpLowerFileName=NULL;
-	char *tmpUpperFileName=NULL;
-	char tmpLowerRead[SEQUENCE_LENGTH]="\0";
-	char tmpUpperRead[SEQUENCE_LENGTH]="\0";
-	long long int tmpLowerReadCount=0;
-	long long int tmpUpperReadCount=0;
-	int eofLower, eofUpper;
-
-	/* Merge the two lists */
-	/* Since we want to keep space requirement small, use an upper bound on memory,
-	 * so that we use tmp files when memory requirements become to large */
-	if( (high-low+1)*(sizeof(int64_t) + sizeof(char*)) <= ONE_GIGABYTE) {
-
-		/* Use memory */
-		tmpReads = malloc(sizeof(char*)*(high-low+1));
-		if(NULL == tmpReads) {
-			PrintError(FnName, "tmpReads", "Could not allocate memory", Exit, MallocMemory);
+	int32_t i;
+	uint32_t contig = (index->contigType==Contig_8)?(index->contigs_8[indexPos]):(index->contigs_32[indexPos]);
+	int32_t position = index->positions[indexPos];
+	uint64_t base;
+
+	(*key) = 0;
+	for(i=0;i<index->keysize;i++) {
+		switch(RGBinaryGetBase(rg, 
+					contig, 
+					position + ((FORWARD==strand)?maskPositions[i]:(index->width-1-maskPositions[i])))) {
+			case 'a':
+			case 'A':
+				base = 0;
+				break;
+			case 'c':
+			case 'C':
+				base = 1;
+				break;
+			case 'g':
+			case 'G':
+				base = 2;
+				break;
+			case 't':
+			case 'T':
+				base = 3;
+				break;
+			default:
+				return 0;
 		}
-		tmpReadCounts = malloc(sizeof(int64_t)*(high-low+1));
-		if(NULL == tmpReadCounts) {
-			PrintError(FnName, "tmpReadCounts", "Could not allocate memory", Exit, MallocMemory);
+		if(REVERSE == strand && NTSpace == index->space) {
+			base = 3 - base;
 		}
+		(*key) = ((*key) << 2) | base;
+	}
+	return 1;
+}
 
-		/* Merge */
-		startLower = low;
-		endLower = mid;
-		startUpper = mid+1;
-		endUpper = high;
-		ctr=0;
-		while( (startLower <= endLower) && (startUpper <= endUpper) ) {
-			if(strcmp(reads[startLower], reads[startUpper]) <= 0) {
-				tmpReads[ctr] = reads[startLower];
-				tmpReadCounts[ctr] = readCounts[startLower];
-				startLower++;
-			}
-			else {
-				tmpReads[ctr] = reads[startUpper];
-				tmpReadCounts[ctr] = readCounts[startUpper];
-				startUpper++;
-			}
-			ctr++;
-		}
-		while(startLower <= endLower) {
-			tmpReads[ctr] = reads[startLower];
-			tmpReadCounts[ctr] = readCounts[startLower];
-			startLower++;
-			ctr++;
-		}
-		while(startUpper <= endUpper) {
-			tmpReads[ctr] = reads[startUpper];
-			tmpReadCounts[ctr] = readCounts[startUpper];
-			startUpper++;
-			ctr++;
-		}
-		/* Copy back */
-		for(i=low, ctr=0;
-				i<=high;
-				i++, ctr++) {
-			reads[i] = tmpReads[ctr];
-			readCounts[i] = tmpReadCounts[ctr];
+/* The key read from the reverse strand under a symmetric mask */
+uint64_t GetReverseKmer(uint64_t key,
+		int32_t keysize,
+		int32_t space)
+{
+	uint64_t reverseKey = 0;
+	int32_t i;
+
+	for(i=0;i<keysize;i++) {
+		reverseKey = (reverseKey << 2) | (key & 0x3);
+		key >>= 2;
+	}
+	if(NTSpace == space) {
+		/* Compliment */
+		reverseKey = ~reverseKey;
+		if(keysize < BINDEXDIST_MAX_KEYSIZE) {
+			reverseKey &= (((uint64_t)1) << (2*keysize)) - 1;
 		}
+	}
+	return reverseKey;
+}
 
-		/* Free memory */
-		free(tmpReads);
-		tmpReads=NULL;
-		free(tmpReadCounts);
-		tmpReadCounts=NULL;
-	}
-	else {
-		/* Use tmp files */
-		assert(sizeof(int64_t) == sizeof(long long int));
-
-		/* Open tmp files */
-		tmpLowerFP = OpenTmpFile(tmpDir, &tmpLowerFileName);
-		tmpUpperFP = OpenTmpFile(tmpDir, &tmpUpperFileName);
-
-		/* Print to tmp files */
-		for(i=low;i<=mid;i++) {
-			if(0 > fprintf(tmpLowerFP, "%s\t%lld\n", 
-						reads[i],
-						(long long int)readCounts[i])) { 
-				PrintError(FnName, NULL, "Could not write to tmp lower file", Exit, WriteFileError);
-			}
+/* TODO */
+void AppendKmer(uint64_t **keys,
+		int64_t **counts,
+		int64_t *numKeys,
+		int64_t *maxKeys,
+		uint64_t key,
+		int64_t count)
+{
+	char *FnName = "AppendKmer";
+
+	if((*maxKeys) <= (*numKeys)) {
+		(*maxKeys) = (0 == (*maxKeys)) ? 1024 : 2*(*maxKeys);
+		(*keys) = realloc((*keys), sizeof(uint64_t)*(*maxKeys));
+		if(NULL==(*keys)) {
+			PrintError(FnName, "(*keys)", "Could not reallocate memory", Exit, ReallocMemory);
 		}
-		for(i=mid+1;i<=high;i++) {
-			if(0 > fprintf(tmpUpperFP, "%s\t%lld\n",
-						reads[i],
-						(long long int)readCounts[i])) {
-				PrintError(FnName, NULL, "Could not write to tmp upper file", Exit, WriteFileError);
-			}
+		(*counts) = realloc((*counts), sizeof(int64_t)*(*maxKeys));
+		if(NULL==(*counts)) {
+			PrintError(FnName, "(*counts)", "Could not reallocate memory", Exit, ReallocMemory);
 		}
+	}
+	(*keys)[(*numKeys)] = key;
+	(*counts)[(*numKeys)] = count;
+	(*numKeys)++;
+}
 
-		/* Move to beginning of the files */
-		fseek(tmpLowerFP, 0 , SEEK_SET);
-		fseek(tmpUpperFP, 0 , SEEK_SET);
+/* Moves the keys from each thread into one list, in thread order */
+void ConcatenateKmers(ThreadData *data,
+		int numThreads,
+		int strand,
+		uint64_t **keys,
+		int64_t **counts,
+		int64_t *numKeys)
+{
+	char *FnName = "ConcatenateKmers";
+	int i;
 
-		/* Merge tmp files back into index */
-		/* Get first contig/pos */
-		if(0 > fscanf(tmpLowerFP, "%s %lld\n",
-					tmpLowerRead,
-					&tmpLowerReadCount)) {
-			PrintError(FnName, NULL, "Could not read in tmp lower", Exit, ReadFileError);
+	(*numKeys) = 0;
+	for(i=0;i<numThreads;i++) {
+		(*numKeys) += (FORWARD == strand) ? data[i].numKeys : data[i].numReverseKeys;
+	}
+	(*keys) = malloc(sizeof(uint64_t)*((*numKeys) + 1));
+	if(NULL==(*keys)) {
+		PrintError(FnName, "(*keys)", "Could not allocate memory", Exit, MallocMemory);
+	}
+	(*counts) = malloc(sizeof(int64_t)*((*numKeys) + 1));
+	if(NULL==(*counts)) {
+		PrintError(FnName, "(*counts)", "Could not allocate memory", Exit, MallocMemory);
+	}
+	for(i=0, (*numKeys)=0;i<numThreads;i++) {
+		if(FORWARD == strand) {
+			memcpy((*keys) + (*numKeys), data[i].keys, sizeof(uint64_t)*data[i].numKeys);
+			memcpy((*counts) + (*numKeys), data[i].counts, sizeof(int64_t)*data[i].numKeys);
+			(*numKeys) += data[i].numKeys;
+			free(data[i].keys);
+			free(data[i].counts);
+			data[i].keys = NULL;
+			data[i].counts = NULL;
 		}
-		if(0 > fscanf(tmpUpperFP, "%s %lld\n",
-					tmpUpperRead,
-					&tmpUpperReadCount)) {
-			PrintError(FnName, NULL, "Could not read in tmp upper", Exit, ReadFileError);
+		else {
+			memcpy((*keys) + (*numKeys), data[i].reverseKeys, sizeof(uint64_t)*data[i].numReverseKeys);
+			memcpy((*counts) + (*numKeys), data[i].reverseCounts, sizeof(int64_t)*data[i].numReverseKeys);
+			(*numKeys) += data[i].numReverseKeys;
+			free(data[i].reverseKeys);
+			free(data[i].reverseCounts);
+			data[i].reverseKeys = NULL;
+			data[i].reverseCounts = NULL;
 		}
-		for(i=low, ctr=0, eofLower = 0, eofUpper = 0;
-				i<=high &&
-				eofLower == 0 &&
-				eofUpper == 0;
-				i++, ctr++) {
-			if(strcmp(tmpLowerRead, tmpUpperRead) <= 0) {
-				/* Copy lower */
-				strcpy(reads[i], tmpLowerRead);
-				readCounts[i] = tmpLowerReadCount;
-				/* Get new tmpLower */
-				if(0 > fscanf(tmpLowerFP, "%s %lld\n",
-							tmpLowerRead,
-							&tmpLowerReadCount)) {
-					eofLower = 1;
-				}
-			}
-			else {
-				/* Copy upper */
-				strcpy(reads[i], tmpUpperRead);
-				readCounts[i] = tmpUpperReadCount;
-				/* Get new tmpUpper */
-				if(0 > fscanf(tmpUpperFP, "%s %lld\n",
-							tmpUpperRead,
-							&tmpUpperReadCount)) {
-					eofUpper = 1;
-				}
-			}
+	}
+}
+
+/* Least significant digit radix sort of the keys, carrying the counts */
+void RadixSortKmers(uint64_t *keys,
+		int64_t *counts,
+		int64_t numKeys,
+		int32_t keysize)
+{
+	char *FnName = "RadixSortKmers";
+	uint64_t *tmpKeys=NULL, *srcKeys, *destKeys, *swapKeys;
+	int64_t *tmpCounts=NULL, *srcCounts, *destCounts, *swapCounts;
+	int64_t *offsets=NULL;
+	int64_t i, sum, tmp;
+	int32_t shift, digit;
+	int64_t numBuckets = ((int64_t)1) << BINDEXDIST_RADIX_BITS;
+
+	if(numKeys <= 1) {
+		return;
+	}
+
+	tmpKeys = malloc(sizeof(uint64_t)*numKeys);
+	if(NULL==tmpKeys) {
+		PrintError(FnName, "tmpKeys", "Could not allocate memory", Exit, MallocMemory);
+	}
+	tmpCounts = malloc(sizeof(int64_t)*numKeys);
+	if(NULL==tmpCounts) {
+		PrintError(FnName, "tmpCounts", "Could not allocate memory", Exit, MallocMemory);
+	}
+	offsets = malloc(sizeof(int64_t)*numBuckets);
+	if(NULL==offsets) {
+		PrintError(FnName, "offsets", "Could not allocate memory", Exit, MallocMemory);
+	}
+
+	srcKeys = keys; srcCounts = counts;
+	destKeys = tmpKeys; destCounts = tmpCounts;
+	for(shift=0;shift<2*keysize;shift+=BINDEXDIST_RADIX_BITS) {
+		/* Count */
+		memset(offsets, 0, sizeof(int64_t)*numBuckets);
+		for(i=0;i<numKeys;i++) {
+			offsets[(srcKeys[i] >> shift) & (numBuckets-1)]++;
 		}
-		while(eofLower != 1) {
-			/* Copy lower */
-			strcpy(reads[i], tmpLowerRead);
-			readCounts[i] = tmpLowerReadCount;
-			/* Get new tmpLower */
-			if(0 > fscanf(tmpLowerFP, "%s %lld\n",
-						tmpLowerRead,
-						&tmpLowerReadCount)) {
-				eofLower = 1;
-			}
-			i++;
-			ctr++;
+		/* Prefix sum */
+		for(digit=0, sum=0;digit<numBuckets;digit++) {
+			tmp = offsets[digit];
+			offsets[digit] = sum;
+			sum += tmp;
 		}
-		while(eofUpper != 1) {
-			/* Copy upper */
-			strcpy(reads[i], tmpUpperRead);
-			readCounts[i] = tmpUpperReadCount;
-			/* Get new tmpUpper */
-			if(0 > fscanf(tmpUpperFP, "%s %lld\n",
-						tmpUpperRead,
-						&tmpUpperReadCount)) {
-				eofUpper = 1;
-			}
-			i++;
-			ctr++;
+		/* Scatter */
+		for(i=0;i<numKeys;i++) {
+			tmp = offsets[(srcKeys[i] >> shift) & (numBuckets-1)]++;
+			destKeys[tmp] = srcKeys[i];
+			destCounts[tmp] = srcCounts[i];
 		}
-		assert(ctr == (high - low + 1));
-		assert(i == high + 1);
-
-		/* Close tmp files */
-		CloseTmpFile(&tmpLowerFP, &tmpLowerFileName);
-		CloseTmpFile(&tmpUpperFP, &tmpUpperFileName);
+		swapKeys = srcKeys; srcKeys = destKeys; destKeys = swapKeys;
+		swapCounts = srcCounts; srcCounts = destCounts; destCounts = swapCounts;
+	}
+	if(srcKeys != keys) {
+		memcpy(keys, srcKeys, sizeof(uint64_t)*numKeys);
+		memcpy(counts, srcCounts, sizeof(int64_t)*numKeys);
 	}
+
+	free(tmpKeys);
+	free(tmpCounts);
+	free(offsets);
 }
 
-/* Get the matches for the contig/pos */
-void GetMatchesFromContigPos(RGIndex *index,
-		RGBinary *rg,
-		uint32_t curContig,
-		uint32_t curPos,
-		int64_t *numForward,
-		int64_t *numReverse, 
-		char **read,
-		char **reverseRead)
+/* Sums the counts of equal adjacent keys, returning the new number of keys */
+int64_t MergeKmerRuns(uint64_t *keys,
+		int64_t *counts,
+		int64_t numKeys)
 {
-	char *FnName = "GetMatchesFromContigPos";
-	int returnLength, returnPosition;
-	RGRanges ranges;
-	RGMatch match;
-	int readLength = index->width;
-	int32_t i;
-	int8_t readInt[SEQUENCE_LENGTH];
-
-	/* Initialize */
-	RGRangesInitialize(&ranges);
-	RGMatchInitialize(&match);
-
-	/* Get the read */
-	RGBinaryGetReference(rg,
-			curContig,
-			curPos,
-			FORWARD,
-			0,
-			read,
-			readLength,
-			&returnLength,
-			&returnPosition);
-	assert(returnLength == readLength);
-	assert(returnPosition == curPos);
-	RGBinaryGetReference(rg,
-			curContig,
-			curPos,
-			REVERSE,
-			0,
-			reverseRead,
-			readLength,
-			&returnLength,
-			&returnPosition);
-	assert(returnLength == readLength);
-	assert(returnPosition == curPos);
-
-	ConvertSequenceToIntegers((*read), readInt, readLength);
-	RGIndexGetRangesBothStrands(index,
-			rg,
-			readInt,
-			readLength,
-			0,
-			INT_MAX,
-			INT_MAX,
-			rg->space,
-			BothStrands,
-			&ranges);
-
-	/* Transfer ranges to matches */
-	RGRangesCopyToRGMatch(&ranges,
-			index,
-			&match,
-			rg->space,
-			0);
-
-	/* Remove duplicates */
-	RGMatchRemoveDuplicates(&match,
-			INT_MAX);
-
-	assert(0 < ranges.numEntries);
-	(*numForward) = (*numReverse) = 0;
-	for(i=0;i<match.numEntries;i++) {
-		switch(match.strands[i]) {
-			case FORWARD:
-				(*numForward)++;
-				break;
-			case REVERSE:
-				(*numReverse)++;
-				break;
-			default:
-				PrintError(FnName, NULL, "Could not understand strand", Exit, OutOfRange);
-				break;
+	int64_t i, prev;
+
+	if(numKeys <= 0) {
+		return 0;
+	}
+	for(i=1, prev=0;i<numKeys;i++) {
+		if(keys[i] == keys[prev]) {
+			counts[prev] += counts[i];
+		}
+		else {
+			prev++;
+			keys[prev] = keys[i];
+			counts[prev] = counts[i];
 		}
 	}
+	return prev+1;
+}
 
-	assert((*numForward)>0);
-	assert((*numReverse) >= 0);
+/* TODO */
+void PrintKmer(FILE *fp,
+		uint64_t key,
+		int32_t keysize,
+		int32_t space,
+		int64_t count)
+{
+	char read[BINDEXDIST_MAX_KEYSIZE+1];
+	char *alphabet = (NTSpace == space) ? "acgt" : "0123";
+	int32_t i;
 
-	if(ColorSpace == rg->space) {
-		ConvertColorsFromStorage((*read), readLength);
-		ConvertColorsFromStorage((*reverseRead), readLength);
+	for(i=keysize-1;0<=i;i--) {
+		read[i] = alphabet[key & 0x3];
+		key >>= 2;
 	}
-
-	RGRangesFree(&ranges);
-	RGMatchFree(&match);
+	read[keysize] = '\0';
+	fprintf(fp, "%s\t%lld\n",
+			read,
+			(long long int)count);
 }
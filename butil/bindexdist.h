@@ -3,23 +3,39 @@
 
 #include "../bfast/RGIndex.h"
 #include "../bfast/RGBinary.h"
-#include "../bfast/RGMatch.h"
+
+#define BINDEXDIST_MAX_KEYSIZE 32 /* bases in a 64-bit packed k-mer */
+#define BINDEXDIST_RADIX_BITS 16
 
 typedef struct {
-	char **reads;
-	int64_t *readCounts;
+	RGIndex *index;
+	RGBinary *rg;
+	int32_t *maskPositions; /* offsets of the ones in the mask */
+	int32_t symmetric; /* the mask reads the same on the reverse strand */
+	/* The thread owns every run of equal k-mers starting in [low, high] */
 	int64_t low;
 	int64_t high;
-	char *tmpDir;
-	int readLength;
-	int showPercentComplete;
+	/* Forward k-mers and their counts, one per run */
+	uint64_t *keys;
+	int64_t *counts;
+	int64_t numKeys;
+	int64_t maxKeys;
+	/* Reverse strand k-mers and their counts */
+	uint64_t *reverseKeys;
+	int64_t *reverseCounts;
+	int64_t numReverseKeys;
+	int64_t maxReverseKeys;
 	int threadID;
 } ThreadData;
 
-void PrintDistribution(RGIndex*, RGBinary*, int, char*, int);
-void GetMatchesFromContigPos(RGIndex*, RGBinary*, uint32_t, uint32_t, int64_t*, int64_t*, char**, char**);
-void *MergeSortReads(void *arg);
-void MergeSortReadsHelper(char**, int64_t*, int64_t, int64_t, int64_t, int64_t, int, double*, char*, int);
-void MergeHelper(char**, int64_t*, int64_t, int64_t, int64_t, char*, int);
+void PrintDistribution(RGIndex*, RGBinary*, int, int);
+void *CountKmers(void*);
+int32_t GetKmer(RGIndex*, RGBinary*, int32_t*, int64_t, char, uint64_t*);
+uint64_t GetReverseKmer(uint64_t, int32_t, int32_t);
+void AppendKmer(uint64_t**, int64_t**, int64_t*, int64_t*, uint64_t, int64_t);
+void ConcatenateKmers(ThreadData*, int, int, uint64_t**, int64_t**, int64_t*);
+void RadixSortKmers(uint64_t*, int64_t*, int64_t, int32_t);
+int64_t MergeKmerRuns(uint64_t*, int64_t*, int64_t);
+void PrintKmer(FILE*, uint64_t, int32_t, int32_t, int64_t);
 
 #endif
@@ -25,6 +25,7 @@ int PrintUsage()
 	fprintf(stderr, "%s %s\n", "bfast", PACKAGE_VERSION);
 	fprintf(stderr, "\nUsage:%s [options] <bmf files>\n", Name);
 	fprintf(stderr, "\t-M\tINT\tSpecifies the maximum total number of matches to consider (default: %d).\n", MAX_NUM_MATCHES);
+	fprintf(stderr, "\t-n\tINT\tSpecifies the number of threads to use (default: 1).\n");
 	fprintf(stderr, "\t-Q\tINT\tSpecifies the number of reads to cache (default: %d).\n", DEFAULT_MATCHES_QUEUE_LENGTH);
 	fprintf(stderr, "\t-h\t\tprints this help message\n");
 	fprintf(stderr, "\nsend bugs to %s\n",
@@ -36,15 +37,18 @@ int main(int argc, char *argv[])
 {
 	int32_t queueLength = DEFAULT_MATCHES_QUEUE_LENGTH;
 	int32_t maxNumMatches = MAX_NUM_MATCHES;
+	int32_t numThreads = 1;
 	int c, i, numWritten;
 	int startTime, endTime, seconds, minutes, hours;
 	gzFile *inputFPs=NULL;
 	gzFile outputFP=NULL;
 	int32_t numInputFPs=0;
 
-	while((c = getopt(argc, argv, "Q:h")) >= 0) {
+	while((c = getopt(argc, argv, "M:n:Q:h")) >= 0) {
 		switch(c) {
 			case 'h': return PrintUsage();
+			case 'M': maxNumMatches=atoi(optarg); break;
+			case 'n': numThreads=atoi(optarg); break;
 			case 'Q': queueLength=atoi(optarg); break;
 			default: fprintf(stderr, "Unrecognized option: -%c\n", c); return 1;
 		}
@@ -53,6 +57,9 @@ int main(int argc, char *argv[])
 	if(1 == argc || argc == optind) {
 		return PrintUsage();
 	}
+	if(numThreads <= 0) {
+		PrintError(Name, "numThreads", "Must be greater than zero", Exit, OutOfRange);
+	}
 
 	// allocate memory for bmf file pointers
 	numInputFPs=(argc-optind);
@@ -83,7 +90,8 @@ int main(int argc, char *argv[])
 			numInputFPs,
 			outputFP,
 			maxNumMatches,
-			queueLength);
+			queueLength,
+			numThreads);
 	endTime=time(NULL);
 	if(VERBOSE >= 0) {
 		seconds = (int)(endTime - startTime);
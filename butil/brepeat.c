@@ -5,6 +5,7 @@
 #include <config.h>
 #include <limits.h>
 #include <unistd.h>  
+#include <pthread.h>
 
 #include "../bfast/BLibDefinitions.h"
 #include "../bfast/BError.h"
@@ -26,6 +27,7 @@ int PrintUsage()
 	fprintf(stderr, "\t-m\tINT\tMinimum unit length\n");
 	fprintf(stderr, "\t-M\tINT\tMaximum unit length\n");
 	fprintf(stderr, "\t-r\tINT\tMinimum total repeat length\n");
+	fprintf(stderr, "\t-n\tINT\tNumber of threads (default 1)\n");
 	fprintf(stderr, "\t-h\t\tprints this help message\n");
 	fprintf(stderr, "\nsend bugs to %s\n",
 			PACKAGE_BUGREPORT);
@@ -38,16 +40,22 @@ int main(int argc, char *argv[])
 	char *fastaFileName=NULL;
 	int minUnitLength=-1, maxUnitLength=-1;
 	int minLength=-1;
+	int numThreads=1;
 	char unit[MAX_UNIT_LENGTH+1]="\0";
 	RGBinary rg;
-	int c;
+	ThreadData *data=NULL;
+	int32_t *bestEnds=NULL, *bestUnitLengths=NULL;
+	uint64_t *bases=NULL, *unknown=NULL;
+	int64_t numWords;
+	int c, i;
 
-	while((c = getopt(argc, argv, "f:m:r:M:h")) >= 0) {
+	while((c = getopt(argc, argv, "f:m:n:r:M:h")) >= 0) {
 		switch(c) {
 			case 'f': fastaFileName=strdup(optarg); break;
 			case 'h': return PrintUsage();
 			case 'm': minUnitLength=atoi(optarg); break; 
 			case 'M': maxUnitLength=atoi(optarg); break; 
+			case 'n': numThreads=atoi(optarg); break;
 			case 'r': minLength=atoi(optarg); break;
 			default: fprintf(stderr, "Unrecognized option: -%c\n", c); return 1;
 		}
@@ -69,6 +77,9 @@ int main(int argc, char *argv[])
 	if(minLength <= 0) {
 		PrintError(Name, "minLength", "Command line option", Exit, InputArguments);
 	}
+	if(numThreads <= 0) {
+		PrintError(Name, "numThreads", "Command line option", Exit, InputArguments);
+	}
 
 	assert(minUnitLength <= maxUnitLength);
 	assert(maxUnitLength <= MAX_UNIT_LENGTH);
@@ -80,73 +91,76 @@ int main(int argc, char *argv[])
 	/* Read in the rg binary file */
 	RGBinaryReadBinary(&rg, NTSpace, fastaFileName);
 
+	data = malloc(sizeof(ThreadData)*numThreads);
+	if(NULL == data) {
+		PrintError(Name, "data", "Could not allocate memory", Exit, MallocMemory);
+	}
+	bestEnds = malloc(sizeof(int32_t)*BREPEAT_CHUNK_SIZE*numThreads);
+	if(NULL == bestEnds) {
+		PrintError(Name, "bestEnds", "Could not allocate memory", Exit, MallocMemory);
+	}
+	bestUnitLengths = malloc(sizeof(int32_t)*BREPEAT_CHUNK_SIZE*numThreads);
+	if(NULL == bestUnitLengths) {
+		PrintError(Name, "bestUnitLengths", "Could not allocate memory", Exit, MallocMemory);
+	}
+
 	fprintf(stderr, "Currently on:\n%2d %9d", -1, -1);
 	/* For each contig */
 	int curContig, curContigIndex;
 	for(curContig=1, curContigIndex=0;
 			curContig <= rg.numContigs && curContigIndex < rg.numContigs;
 			curContig++, curContigIndex++) {
-		/* For each starting position */
-		int curPos;
+		int32_t sequenceLength = rg.contigs[curContigIndex].sequenceLength;
 		int prevBestUnitLength=-1;
 		int prevBestStart=-1;
 		int prevBestLength=-1;
 		int prevBestEnd=-1;
-		for(curPos=1;
-				curPos <= rg.contigs[curContigIndex].sequenceLength;
-				curPos++) {
-			if(curPos%BREPEAT_ROTATE_NUM==0) {
-				fprintf(stderr, "\r%2d %9d",
-						curContig,
-						curPos);
-			}
+		int batchStart;
 
-			if(ToLower(RGBinaryGetBase(&rg, curContig, curPos)) != 'n') {
-
-				/* For each unit length */
-				int bestEnd=-1;
-				char bestUnit[MAX_UNIT_LENGTH+1]="\0";
-				int bestUnitLength=-1;
-				int curUnitLength;
-				for(curUnitLength=minUnitLength;curUnitLength<=maxUnitLength;curUnitLength++) { /* For each unit length */
-					/* Check bounds */
-					if(curPos + curUnitLength - 1 <= rg.contigs[curContigIndex].sequenceLength) {
-						/* Get the current unit */
-						int i;
-						for(i=0;i<curUnitLength;i++) {
-							unit[i] = ToLower(RGBinaryGetBase(&rg,
-										curContig,
-										curPos+i));
-						}
-						unit[curUnitLength]='\0';
-						int end = curPos+curUnitLength-1;
-
-						/* extend the unit */
-						int cont=1;
-						int curStart;
-						for(curStart=curPos + curUnitLength;cont==1 && curStart <= rg.contigs[curContigIndex].sequenceLength-curUnitLength+1;curStart+=curUnitLength) {
-							/* Check that the bases match cur */
-							int j;
-							for(j=0;j<curUnitLength;j++) {
-								if(unit[j] != ToLower(RGBinaryGetBase(&rg, curContig, curStart+j))) {
-									cont = 0;
-								}
-							}
-							if(cont == 1) {
-								end = curStart+curUnitLength-1;
-							}
-						}
+		/* Pack the contig two bits per base */
+		numWords = (sequenceLength + BREPEAT_BASES_PER_WORD - 1)/BREPEAT_BASES_PER_WORD + 1;
+		bases = realloc(bases, sizeof(uint64_t)*numWords);
+		if(NULL == bases) {
+			PrintError(Name, "bases", "Could not reallocate memory", Exit, ReallocMemory);
+		}
+		unknown = realloc(unknown, sizeof(uint64_t)*numWords);
+		if(NULL == unknown) {
+			PrintError(Name, "unknown", "Could not reallocate memory", Exit, ReallocMemory);
+		}
+		for(i=0;i<numThreads;i++) {
+			data[i].rg = &rg;
+			data[i].contig = curContig;
+			data[i].sequenceLength = sequenceLength;
+			data[i].bases = bases;
+			data[i].unknown = unknown;
+			data[i].lowWord = i*(numWords/numThreads);
+			data[i].highWord = (i+1)*(numWords/numThreads)-1;
+			data[i].minUnitLength = minUnitLength;
+			data[i].maxUnitLength = maxUnitLength;
+			data[i].minLength = minLength;
+			data[i].threadID = i;
+		}
+		data[numThreads-1].highWord = numWords-1;
+		RunThreads(PackContig, data, numThreads);
 
-						if(end-curPos+1 >= minLength && 
-								(end - curPos +1 ) > curUnitLength && 
-								(bestEnd <= 0 || end-curPos+1 > (bestEnd - curPos + 1))) {
-							bestEnd = end;
-							strcpy(bestUnit, unit);
-							bestUnitLength = curUnitLength;
-						}
-					}
+		/* Scan a batch of positions in parallel, then output in order */
+		for(batchStart=1;
+				batchStart <= sequenceLength;
+				batchStart += BREPEAT_CHUNK_SIZE*numThreads) {
+			int curPos, batchEnd;
+			for(i=0;i<numThreads;i++) {
+				data[i].startPos = batchStart + i*BREPEAT_CHUNK_SIZE;
+				data[i].endPos = GETMIN(sequenceLength, data[i].startPos + BREPEAT_CHUNK_SIZE - 1);
+				data[i].bestEnds = bestEnds + i*BREPEAT_CHUNK_SIZE;
+				data[i].bestUnitLengths = bestUnitLengths + i*BREPEAT_CHUNK_SIZE;
+			}
+			RunThreads(FindRepeats, data, numThreads);
+
+			batchEnd = GETMIN(sequenceLength, batchStart + BREPEAT_CHUNK_SIZE*numThreads - 1);
+			for(curPos=batchStart;curPos<=batchEnd;curPos++) {
+				int bestEnd = bestEnds[curPos - batchStart];
+				int bestUnitLength = bestUnitLengths[curPos - batchStart];
 
-				}
 				if(bestEnd > 0 && 
 						bestUnitLength < (bestEnd - curPos + 1)) {
 					assert(bestEnd-curPos+1 >= minLength);
@@ -160,14 +174,19 @@ int main(int argc, char *argv[])
 						/* Skip */
 					}
 					else {
+						for(i=0;i<bestUnitLength;i++) {
+							unit[i] = ToLower(RGBinaryGetBase(&rg,
+										curContig,
+										curPos+i));
+						}
+						unit[bestUnitLength]='\0';
 						fprintf(fp, "contig%d:%d-%d\t%d\t%d\t%s\n",
 								curContig,
 								curPos,
 								bestEnd,
 								bestEnd-curPos+1,
 								bestUnitLength,
-								bestUnit);
-						fflush(fp);
+								unit);
 					}
 					prevBestUnitLength = bestUnitLength;
 					prevBestStart = curPos;
@@ -175,11 +194,19 @@ int main(int argc, char *argv[])
 					prevBestEnd = bestEnd;
 				}
 			}
+			fprintf(stderr, "\r%2d %9d",
+					curContig,
+					batchEnd);
 		}
 	}
 
 	fprintf(stderr, "\n%s", BREAK_LINE);
 	fprintf(stderr, "Cleaning up.\n");
+	free(data);
+	free(bestEnds);
+	free(bestUnitLengths);
+	free(bases);
+	free(unknown);
 	/* Delete the rg */
 	RGBinaryDelete(&rg);
 	fclose(fp);
@@ -189,3 +216,150 @@ int main(int argc, char *argv[])
 	return 0;
 }
 
+/* Starts one thread per entry of data and waits for all of them */
+void RunThreads(void *(*routine)(void*), ThreadData *data, int numThreads)
+{
+	char *FnName="RunThreads";
+	pthread_t *threads=NULL;
+	int i, errCode;
+	void *status;
+
+	threads=malloc(sizeof(pthread_t)*numThreads);
+	if(NULL==threads) {
+		PrintError(FnName, "threads", "Could not allocate memory", Exit, MallocMemory);
+	}
+	for(i=0;i<numThreads;i++) {
+		/* Start thread */
+		errCode = pthread_create(&threads[i], /* thread struct */
+				NULL, /* default thread attributes */
+				routine, /* start routine */
+				&data[i]); /* data to routine */
+		if(0!=errCode) {
+			PrintError(FnName, "pthread_create: errCode", "Could not start thread", Exit, ThreadError);
+		}
+	}
+	for(i=0;i<numThreads;i++) {
+		/* Wait for the given thread to return */
+		errCode = pthread_join(threads[i],
+				&status);
+		/* Check the return code of the thread */
+		if(0!=errCode) {
+			PrintError(FnName, "pthread_join: errCode", "Thread returned an error", Exit, ThreadError);
+		}
+	}
+	free(threads);
+}
+
+/* Packs the words [lowWord, highWord] of the contig: two bits per base, with
+ * both bits set in unknown for an 'N'.  Case (repeat masking) is ignored,
+ * as it was by the ToLower in the base by base scan. */
+void *PackContig(void *arg)
+{
+	ThreadData *data = (ThreadData*)arg;
+	int64_t i, pos;
+	int32_t j;
+	uint8_t fourBit;
+
+	for(i=data->lowWord;i<=data->highWord;i++) {
+		data->bases[i] = data->unknown[i] = 0;
+		for(j=0;j<BREPEAT_BASES_PER_WORD;j++) {
+			pos = i*BREPEAT_BASES_PER_WORD + j + 1;
+			if(data->sequenceLength < pos) {
+				break;
+			}
+			fourBit = RGBinaryGetFourBit(data->rg, data->contig, pos);
+			if(2 == (fourBit >> 2)) {
+				data->unknown[i] |= ((uint64_t)3) << (2*j);
+			}
+			else {
+				data->bases[i] |= ((uint64_t)(fourBit & 0x03)) << (2*j);
+			}
+		}
+	}
+	return arg;
+}
+
+static inline uint64_t GetWord(uint64_t *packed, int32_t index)
+{
+	int32_t word = index / BREPEAT_BASES_PER_WORD;
+	int32_t shift = 2*(index % BREPEAT_BASES_PER_WORD);
+	if(0 == shift) {
+		return packed[word];
+	}
+	return (packed[word] >> shift) | (packed[word+1] << (64 - shift));
+}
+
+/* Counts the bits set in a word that only has bits on even positions */
+static inline int32_t PopCount(uint64_t x)
+{
+	x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+	x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+	return (int32_t)((x * 0x0101010101010101ULL) >> 56);
+}
+
+/* Returns the number of consecutive i >= 0 such that the base at pos + i
+ * equals the base at pos + i + unitLength, comparing a word at a time */
+int32_t GetPeriodicRun(uint64_t *bases, uint64_t *unknown, int32_t sequenceLength, int32_t pos, int32_t unitLength)
+{
+	int32_t i, limit = sequenceLength - unitLength - pos + 1;
+	uint64_t x;
+
+	for(i=0;i<limit;i+=BREPEAT_BASES_PER_WORD) {
+		x = (GetWord(bases, pos - 1 + i) ^ GetWord(bases, pos - 1 + unitLength + i)) |
+			(GetWord(unknown, pos - 1 + i) ^ GetWord(unknown, pos - 1 + unitLength + i));
+		x = (x | (x >> 1)) & 0x5555555555555555ULL;
+		if(0 != x) {
+			/* Count the matching bases below the first mismatch */
+			return GETMIN(limit, i + PopCount(((x & (~x + 1)) - 1) & 0x5555555555555555ULL));
+		}
+	}
+	return GETMAX(0, limit);
+}
+
+/* For each position in [startPos, endPos], finds the unit length with the
+ * longest run of (at least two) complete copies of the unit starting at that
+ * position.  The number of copies of each unit length is tracked
+ * incrementally: if the sequence is periodic for r bases past a position,
+ * it is periodic for r-1 bases past the next one. */
+void *FindRepeats(void *arg)
+{
+	ThreadData *data = (ThreadData*)arg;
+	int32_t runs[MAX_UNIT_LENGTH+1];
+	int32_t curPos, curUnitLength, end;
+
+	for(curUnitLength=data->minUnitLength;curUnitLength<=data->maxUnitLength;curUnitLength++) {
+		runs[curUnitLength] = -1;
+	}
+	for(curPos=data->startPos;curPos<=data->endPos;curPos++) {
+		int bestEnd=-1;
+		int bestUnitLength=-1;
+
+		if(2 != (RGBinaryGetFourBit(data->rg, data->contig, curPos) >> 2)) {
+			for(curUnitLength=data->minUnitLength;curUnitLength<=data->maxUnitLength;curUnitLength++) { /* For each unit length */
+				/* Check bounds */
+				if(data->sequenceLength < curPos + curUnitLength - 1) {
+					break;
+				}
+				if(runs[curUnitLength] < 0) {
+					runs[curUnitLength] = GetPeriodicRun(data->bases, data->unknown, data->sequenceLength, curPos, curUnitLength);
+				}
+				/* The unit plus all complete copies after it */
+				end = curPos + (1 + runs[curUnitLength]/curUnitLength)*curUnitLength - 1;
+				if(end-curPos+1 >= data->minLength && 
+						(end - curPos +1 ) > curUnitLength && 
+						(bestEnd <= 0 || end-curPos+1 > (bestEnd - curPos + 1))) {
+					bestEnd = end;
+					bestUnitLength = curUnitLength;
+				}
+			}
+		}
+		data->bestEnds[curPos - data->startPos] = bestEnd;
+		data->bestUnitLengths[curPos - data->startPos] = bestUnitLength;
+
+		/* Move the runs to the next position */
+		for(curUnitLength=data->minUnitLength;curUnitLength<=data->maxUnitLength;curUnitLength++) {
+			runs[curUnitLength] = (0 < runs[curUnitLength]) ? runs[curUnitLength] - 1 : -1;
+		}
+	}
+	return arg;
+}
@@ -1,7 +1,36 @@
 #ifndef BREPEAT_H_
 #define BREPEAT_H_
 
+#include "../bfast/BLibDefinitions.h"
+
 #define MAX_UNIT_LENGTH 2048
-#define BREPEAT_ROTATE_NUM 1000
+#define BREPEAT_BASES_PER_WORD 32
+#define BREPEAT_CHUNK_SIZE 1048576 /* positions scanned per thread per batch */
+
+typedef struct {
+	RGBinary *rg;
+	int32_t contig;
+	int32_t sequenceLength;
+	/* 2-bit packed contig, with one word of padding */
+	uint64_t *bases;
+	uint64_t *unknown;
+	int64_t lowWord;
+	int64_t highWord;
+	/* Positions to scan */
+	int32_t startPos;
+	int32_t endPos;
+	int32_t minUnitLength;
+	int32_t maxUnitLength;
+	int32_t minLength;
+	/* Best repeat starting at each position, -1 if none */
+	int32_t *bestEnds;
+	int32_t *bestUnitLengths;
+	int threadID;
+} ThreadData;
+
+void *PackContig(void*);
+void *FindRepeats(void*);
+int32_t GetPeriodicRun(uint64_t*, uint64_t*, int32_t, int32_t, int32_t);
+void RunThreads(void *(*)(void*), ThreadData*, int);
 
 #endif
@@ -40,7 +40,10 @@ void PrintUsage()
 	fprintf(stderr, "******************************* Event Options (default =0 ) ***********************************\n");
 	fprintf(stderr, "\t-M\tINT\tmaximum number of mismatches\n");
 	fprintf(stderr, "\t-E\tINT\tmaximum number of color errors (-A 1)\n");
+	fprintf(stderr, "\t-x\tINT\t1: compute the accuracy of reads with mismatches and color errors exactly\n");
 	fprintf(stderr, "******************************* Miscellaneous Options  ****************************************\n");
+	fprintf(stderr, "\t-R\tINT\trandom number seed (default: the current time)\n");
+	fprintf(stderr, "\t-T\tINT\tnumber of threads (default: 1)\n");
 	fprintf(stderr, "\t-p\tNULL\tprints the program parameters\n");
 	fprintf(stderr, "\t-h\tNULL\tprints this message\n");
 	fprintf(stderr, "\nsend bugs to %s\n",
@@ -65,6 +68,9 @@ void PrintProgramParameters(arguments *args)
 	fprintf(stderr, "maximum insertion length:\t%d\n", args->maxInsertionLength);
 	fprintf(stderr, "maximum number of mismatches:\t%d\n", args->maxNumMismatches);
 	fprintf(stderr, "maximum number of color errors:\t%d\n", args->maxNumColorErrors);
+	fprintf(stderr, "random number seed:\t\t%llu\n", (unsigned long long int)args->seed);
+	fprintf(stderr, "number of threads:\t\t%d\n", args->numThreads);
+	fprintf(stderr, "exact accuracy:\t\t\t%d\n", args->exact);
 	fprintf(stderr, "%s", BREAK_LINE);
 }
 
@@ -83,6 +89,9 @@ void AssignDefaultValues(arguments *args)
 	args->maxNumMismatches=0;
 	args->maxInsertionLength=0;
 	args->maxNumColorErrors=0;
+	args->seed=(uint64_t)time(NULL);
+	args->numThreads=1;
+	args->exact=0;
 }
 
 void ValidateArguments(arguments *args)
@@ -91,7 +100,17 @@ void ValidateArguments(arguments *args)
 
 	if(args->algorithm < 0 || args->algorithm > 2) {
 		PrintError(FnName, "Command line argument", "algorithm", Exit, OutOfRange);	}	if(args->readLength <= 0) {		PrintError(FnName, "Command line argument", "readLength", Exit, OutOfRange);	}
-	if(args->numEventsToSample <= 0) {
+	if(args->readLength > READ_PROFILE_MAX_LENGTH) {
+		PrintError(FnName, "Command line argument", "readLength", Exit, OutOfRange);
+	}
+	if(args->numThreads <= 0) {
+		PrintError(FnName, "Command line argument", "numThreads", Exit, OutOfRange);
+	}
+	if(args->exact < 0 || 1 < args->exact) {
+		PrintError(FnName, "Command line argument", "exact", Exit, OutOfRange);
+	}
+	if(args->numEventsToSample <= 0 &&
+			!(args->exact == 1 && args->algorithm == 0)) {
 		PrintError(FnName, "Command line argument", "numEventsToSample", Exit, OutOfRange);	}	if(args->numIndexesToSample < 0 ||			(args->algorithm == 0 && args->numIndexesToSample <= 0)) {		PrintError(FnName, "Command line argument", "numIndexesToSample", Exit, OutOfRange);
 		}
 	if(args->algorithm == 0) {
@@ -159,6 +178,9 @@ void ParseCommandLineArguments(int argc, char *argv[], arguments *args)
 			case 'r':
 				args->readLength = atoi(argv[i+1]);
 				break;
+			case 'R':
+				args->seed = strtoull(argv[i+1], NULL, 10);
+				break;
 			case 's':
 				args->numIndexesToSample = atoi(argv[i+1]);
 				break;
@@ -168,9 +190,15 @@ void ParseCommandLineArguments(int argc, char *argv[], arguments *args)
 			case 't':
 				args->accuracyThreshold = atoi(argv[i+1]);
 				break;
+			case 'T':
+				args->numThreads = atoi(argv[i+1]);
+				break;
 			case 'w':
 				args->maxKeyWidth = atoi(argv[i+1]);
 				break;
+			case 'x':
+				args->exact = atoi(argv[i+1]);
+				break;
 			default:
 				fprintf(stderr, "*** Error.  Could not understand command line option %s.  Terminating! ***\n",
 						argv[i]);
@@ -209,7 +237,10 @@ int main(int argc, char *argv[])
 					args.accuracyThreshold,
 					args.space,
 					args.maxNumMismatches,
-					args.maxNumColorErrors);
+					args.maxNumColorErrors,
+					args.seed,
+					args.numThreads,
+					args.exact);
 			break;
 		case EvaluateRGIndexAccuracies:
 			RunEvaluateRGIndexAccuracies(args.inputFileName,
@@ -218,7 +249,10 @@ int main(int argc, char *argv[])
 					args.space,
 					args.maxNumMismatches,
 					args.maxInsertionLength,
-					args.maxNumColorErrors);
+					args.maxNumColorErrors,
+					args.seed,
+					args.numThreads,
+					args.exact);
 			break;
 		case ProgramParameters:
 			/* Do nothing */
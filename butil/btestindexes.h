@@ -17,6 +17,9 @@ typedef struct {
 	int maxNumMismatches;
 	int maxInsertionLength;
 	int maxNumColorErrors;
+	uint64_t seed;
+	int numThreads;
+	int exact;
 } arguments;
 
 /* Command line functions */
@@ -0,0 +1,120 @@
+#!/bin/sh
+
+. test.definitions.sh
+
+echo "      Skipping reads with the Bloom filter of the secondary index.";
+
+OUTPUT_ID=$OUTPUT_ID_NT;
+RG_FASTA=$OUTPUT_DIR"bloom.$OUTPUT_ID.fa";
+READS=$OUTPUT_DIR"reads.bloom.$OUTPUT_ID.fastq";
+
+# Start from no index
+rm -f $RG_FASTA*;
+cp $OUTPUT_DIR$OUTPUT_ID".fa" $RG_FASTA;
+
+# Change four bases of every second read so that no key of the contiguous
+# main index matches it, but a key of the spaced secondary index does.
+# Then add random reads, which neither index finds.
+awk 'NR%4==1 {
+	$0=sprintf("@bloom_%d", (NR+3)/4);
+}
+NR%8==6 {
+	n=split("6 18 30 42",p," ");
+	for(i=1;i<=n;i++) {
+		c=substr($0,p[i],1);
+		d=(c=="A")?"C":(c=="C")?"G":(c=="G")?"T":"A";
+		$0=substr($0,1,p[i]-1) d substr($0,p[i]+1);
+	}
+} {print}
+END {
+	srand(7);
+	for(i=1;i<=500;i++) {
+		s="";
+		for(j=0;j<50;j++) {
+			s=s substr("ACGT",1+int(4*rand()),1);
+		}
+		printf("@random_%d\n%s\n+\n%s\n", i, s, "22222222222222222222222222222222222222222222222222");
+	}
+}' $OUTPUT_DIR"reads.$OUTPUT_ID.fastq" > $READS;
+
+CMD=$CMD_PREFIX"bfast fasta2brg -f $RG_FASTA -A 0";
+eval $CMD 2> /dev/null;
+if [ "$?" -ne "0" ]; then
+	echo $CMD;
+	eval $CMD;
+	exit 1
+fi
+
+# A contiguous main index, and a spaced secondary index with its filter
+for INDEX in 1 2
+do
+	case $INDEX in
+		1) OPTIONS="-m 1111111111111111111111";
+		;;
+		2) OPTIONS="-m 111110111111111110111111 -B";
+		;;
+	esac
+	CMD=$CMD_PREFIX"bfast index -f $RG_FASTA -A 0 -w 8 -i $INDEX -n $NUM_THREADS -T $TMP_DIR $OPTIONS";
+	eval $CMD 2> /dev/null;
+	if [ "$?" -ne "0" ]; then
+		echo $CMD;
+		eval $CMD;
+		exit 1
+	fi
+done
+
+# Find matches with the main index only, with the secondary index, and
+# with the secondary index skipping reads with none of its keys
+for RUN in 0 1 2
+do
+	case $RUN in
+		0) OPTIONS="-i 1";
+		;;
+		1) OPTIONS="-i 1 -I 2";
+		;;
+		2) OPTIONS="-i 1 -I 2 -B 1";
+		;;
+	esac
+	BMF=${OUTPUT_DIR}bfast.matches.file.bloom.$RUN.$OUTPUT_ID.bmf;
+	CMD="${CMD_PREFIX}bfast match -f $RG_FASTA -r $READS -A 0 -n $NUM_THREADS -T $TMP_DIR -t $OPTIONS > $BMF";
+	eval $CMD 2> ${TMP_DIR}bloom.$RUN.log;
+	if [ "$?" -ne "0" ]; then
+		echo $CMD;
+		eval $CMD;
+		exit 1
+	fi
+	CMD="${CMD_PREFIX}bfast bmfconvert -O 1 $BMF";
+	eval $CMD 2> /dev/null;
+	if [ "$?" -ne "0" ]; then
+		echo $CMD;
+		eval $CMD;
+		exit 1
+	fi
+	# The reads with matches, in order of name
+	paste - - < ${OUTPUT_DIR}bfast.matches.file.bloom.$RUN.$OUTPUT_ID.txt | awk -F '\t' '0 < $5' | sort > ${TMP_DIR}bloom.$RUN.found.txt;
+done
+
+# The secondary index must find reads, and the filter must skip reads
+# without losing any of them
+FOUND_0=`wc -l < ${TMP_DIR}bloom.0.found.txt`;
+FOUND_1=`wc -l < ${TMP_DIR}bloom.1.found.txt`;
+REJECTED=`grep -o '"readsRejected":[0-9]*' ${TMP_DIR}bloom.2.log | head -1 | cut -d: -f2`;
+if [ "$FOUND_1" -le "$FOUND_0" ]; then
+	echo "The secondary index found no reads ($FOUND_0 reads found, $FOUND_1 with -I 2).";
+	exit 1
+fi
+if [ -z "$REJECTED" ] || [ "$REJECTED" -le "0" ]; then
+	echo "No reads were skipped with -B 1.";
+	exit 1
+fi
+CMD="cmp ${TMP_DIR}bloom.1.found.txt ${TMP_DIR}bloom.2.found.txt";
+eval $CMD;
+if [ "$?" -ne "0" ]; then
+	echo $CMD;
+	exit 1
+fi
+rm ${TMP_DIR}bloom.*;
+
+# Test passed!
+echo "      Reads skipped.";
+exit 0
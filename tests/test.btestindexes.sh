@@ -0,0 +1,54 @@
+#!/bin/sh
+
+. test.definitions.sh
+
+echo "      Testing index sets.";
+
+MASKS=$OUTPUT_DIR"btestindexes.masks.txt";
+echo "111101111011101111" > $MASKS;
+echo "1111111111111111" >> $MASKS;
+
+for SPACE in 0 1
+do
+	for ALGORITHM in 0 1
+	do
+		echo "        Testing -A "$SPACE "-a "$ALGORITHM;
+
+		case $ALGORITHM in
+			0) OPTIONS="-S 1000 -s 20 -l 12 -w 16 -n 2 -t 90";
+			;;
+			1) OPTIONS="-S 2000 -f $MASKS";
+			;;
+		esac
+		if [ "$SPACE" -eq "1" ]; then
+			OPTIONS="$OPTIONS -E 1";
+		fi
+
+		# The same seed must give the same result with any number of threads
+		for THREADS in 1 3
+		do
+			CMD="../butil/btestindexes -a $ALGORITHM -r 50 -A $SPACE -M 2 $OPTIONS -R 7 -T $THREADS > ${OUTPUT_DIR}btestindexes.$SPACE.$ALGORITHM.$THREADS.txt";
+			eval $CMD 2> /dev/null;
+			if [ "$?" -ne "0" ]; then
+				echo $CMD;
+				eval $CMD;
+				exit 1
+			fi
+		done
+
+		if [ ! -s ${OUTPUT_DIR}btestindexes.$SPACE.$ALGORITHM.1.txt ]; then
+			echo "No output for -A $SPACE -a $ALGORITHM.";
+			exit 1
+		fi
+		CMD="cmp ${OUTPUT_DIR}btestindexes.$SPACE.$ALGORITHM.1.txt ${OUTPUT_DIR}btestindexes.$SPACE.$ALGORITHM.3.txt";
+		eval $CMD;
+		if [ "$?" -ne "0" ]; then
+			echo $CMD;
+			exit 1
+		fi
+	done
+done
+
+# Test passed!
+echo "      Index sets tested.";
+exit 0
@@ -0,0 +1,47 @@
+#!/bin/sh
+
+. test.definitions.sh
+
+echo "      Searching all bins at once.";
+
+OUTPUT_ID=$OUTPUT_ID_NT;
+RG_FASTA=$OUTPUT_DIR$OUTPUT_ID".fa";
+READS=$OUTPUT_DIR"reads.$OUTPUT_ID.fastq";
+
+# Search the bins of the index one at a time, all at once, and all at once
+# stopping on unique matches
+for RUN in 0 1 2
+do
+	case $RUN in
+		0) OPTIONS="";
+		;;
+		1) OPTIONS="-l";
+		;;
+		2) OPTIONS="-l -U";
+		;;
+	esac
+	echo "        Testing run "$RUN" "$OPTIONS;
+
+	CMD="${CMD_PREFIX}bfast match -f $RG_FASTA -r $READS -A 0 -n $NUM_THREADS -T $TMP_DIR $OPTIONS > ${OUTPUT_DIR}bfast.matches.file.loadall.$RUN.$OUTPUT_ID.bmf";
+	eval $CMD 2> /dev/null;
+	if [ "$?" -ne "0" ]; then
+		echo $CMD;
+		eval $CMD;
+		exit 1
+	fi
+done
+
+# With a single index, the matches must be the same
+for RUN in 1 2
+do
+	CMD="cmp ${OUTPUT_DIR}bfast.matches.file.loadall.0.$OUTPUT_ID.bmf ${OUTPUT_DIR}bfast.matches.file.loadall.$RUN.$OUTPUT_ID.bmf";
+	eval $CMD;
+	if [ "$?" -ne "0" ]; then
+		echo $CMD;
+		exit 1
+	fi
+done
+
+# Test passed!
+echo "      All bins searched at once.";
+exit 0
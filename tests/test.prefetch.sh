@@ -0,0 +1,70 @@
+#!/bin/sh
+
+. test.definitions.sh
+
+echo "      Loading indexes in the background.";
+
+OUTPUT_ID=$OUTPUT_ID_NT;
+READS=$OUTPUT_DIR"reads.$OUTPUT_ID.fastq";
+RG_FASTA_LARGE=$OUTPUT_DIR"prefetch.$OUTPUT_ID.fa";
+
+# Bins with a larger hash, so that two of them do not fit in a few megabytes
+rm -f $RG_FASTA_LARGE*;
+cp $OUTPUT_DIR$OUTPUT_ID".fa" $RG_FASTA_LARGE;
+CMD=$CMD_PREFIX"bfast fasta2brg -f $RG_FASTA_LARGE -A 0";
+eval $CMD 2> /dev/null;
+if [ "$?" -ne "0" ]; then
+	echo $CMD;
+	eval $CMD;
+	exit 1
+fi
+CMD=$CMD_PREFIX"bfast index -f $RG_FASTA_LARGE -A 0 -m 1111111111111111111111 -w 10 -d 1 -i 1 -n $NUM_THREADS -T $TMP_DIR";
+eval $CMD 2> /dev/null;
+if [ "$?" -ne "0" ]; then
+	echo $CMD;
+	eval $CMD;
+	exit 1
+fi
+
+# The binned index from test.index.sh, then the bins with the larger hash
+for RG_FASTA in $OUTPUT_DIR$OUTPUT_ID".fa" $RG_FASTA_LARGE
+do
+	# Without loading in the background, loading every next bin, and
+	# loading no next bin since two do not fit
+	for PREFETCH in 0 1000 6
+	do
+		echo "        Testing "$RG_FASTA" -P "$PREFETCH;
+		CMD="${CMD_PREFIX}bfast match -f $RG_FASTA -r $READS -A 0 -n $NUM_THREADS -T $TMP_DIR -P $PREFETCH > ${OUTPUT_DIR}bfast.matches.file.prefetch.$PREFETCH.$OUTPUT_ID.bmf";
+		eval $CMD 2> ${TMP_DIR}prefetch.$PREFETCH.log;
+		if [ "$?" -ne "0" ]; then
+			echo $CMD;
+			eval $CMD;
+			exit 1
+		fi
+	done
+
+	# Loading in the background must not change the matches
+	for PREFETCH in 1000 6
+	do
+		CMD="cmp ${OUTPUT_DIR}bfast.matches.file.prefetch.0.$OUTPUT_ID.bmf ${OUTPUT_DIR}bfast.matches.file.prefetch.$PREFETCH.$OUTPUT_ID.bmf";
+		eval $CMD;
+		if [ "$?" -ne "0" ]; then
+			echo $CMD;
+			exit 1
+		fi
+	done
+
+	if grep -q "Not loading" ${TMP_DIR}prefetch.1000.log; then
+		echo "Did not load the next bin of $RG_FASTA in the background with -P 1000.";
+		exit 1
+	fi
+done
+if ! grep -q "Not loading" ${TMP_DIR}prefetch.6.log; then
+	echo "Loaded the next bin of $RG_FASTA_LARGE in the background with -P 6.";
+	exit 1
+fi
+rm ${TMP_DIR}prefetch.*;
+
+# Test passed!
+echo "      Indexes loaded in the background.";
+exit 0
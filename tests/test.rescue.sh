@@ -0,0 +1,84 @@
+#!/bin/sh
+
+. test.definitions.sh
+
+echo "      Rescuing mates.";
+
+OUTPUT_ID=$OUTPUT_ID_NT;
+REF_ID=$OUTPUT_ID;
+RG_FASTA=$OUTPUT_DIR$REF_ID".fa";
+READS=$OUTPUT_DIR"reads.rescue.$OUTPUT_ID.fastq";
+
+# Change four bases of the second end of each pair so that no key of the
+# index matches it, but it is still within the mismatches mate rescue allows
+awk 'NR%8==6 {
+	n=split("6 18 30 42",p," ");
+	for(i=1;i<=n;i++) {
+		c=substr($0,p[i],1);
+		d=(c=="A")?"C":(c=="C")?"G":(c=="G")?"T":"A";
+		$0=substr($0,1,p[i]-1) d substr($0,p[i]+1);
+	}
+} {print}' $OUTPUT_DIR"reads.$OUTPUT_ID.fastq" > $READS;
+
+CMD="${CMD_PREFIX}bfast match -f $RG_FASTA -r $READS -A 0 -n $NUM_THREADS -T $TMP_DIR > ${OUTPUT_DIR}bfast.matches.file.rescue.$OUTPUT_ID.bmf";
+eval $CMD 2> /dev/null;
+if [ "$?" -ne "0" ]; then
+	echo $CMD;
+	eval $CMD;
+	exit 1
+fi
+
+for RESCUE in 0 1
+do
+	echo "        Testing -v "$RESCUE;
+
+	OPTIONS="";
+	if [ "$RESCUE" -eq "1" ]; then
+		OPTIONS="-v 570 -w 60 -k 3 -N 2";
+	fi
+
+	# Run local alignment
+	CMD="${CMD_PREFIX}bfast localalign -f $RG_FASTA -m ${OUTPUT_DIR}bfast.matches.file.rescue.$OUTPUT_ID.bmf -A 0 -n $NUM_THREADS -o 15 $OPTIONS > ${OUTPUT_DIR}bfast.aligned.file.rescue.$RESCUE.$OUTPUT_ID.baf";
+	eval $CMD 2> /dev/null;
+	if [ "$?" -ne "0" ]; then
+		echo $CMD;
+		eval $CMD;
+		exit 1
+	fi
+
+	# Run postprocess
+	CMD="${CMD_PREFIX}bfast postprocess -f $RG_FASTA -i ${OUTPUT_DIR}bfast.aligned.file.rescue.$RESCUE.$OUTPUT_ID.baf -a 3 -n $NUM_THREADS > ${OUTPUT_DIR}bfast.reported.file.rescue.$RESCUE.$OUTPUT_ID.sam";
+	eval $CMD 2> /dev/null;
+	if [ "$?" -ne "0" ]; then
+		echo $CMD;
+		eval $CMD;
+		exit 1
+	fi
+done
+
+# Count the mapped second ends, and those at the position they were simulated from
+for RESCUE in 0 1
+do
+	awk '!/^@/ && 1 == int($2/128)%2 && 0 == int($2/4)%2 {
+		split($1,a,"_");
+		n++;
+		if($4 == a[3]) { correct++; }
+	} END { print n+0, correct+0 }' ${OUTPUT_DIR}bfast.reported.file.rescue.$RESCUE.$OUTPUT_ID.sam > ${TMP_DIR}rescue.$RESCUE.txt;
+done
+read MAPPED_0 CORRECT_0 < ${TMP_DIR}rescue.0.txt;
+read MAPPED_1 CORRECT_1 < ${TMP_DIR}rescue.1.txt;
+rm ${TMP_DIR}rescue.0.txt ${TMP_DIR}rescue.1.txt;
+
+# Mates must be rescued, and all of them to where they came from
+if [ "$MAPPED_1" -le "$MAPPED_0" ]; then
+	echo "No mates were rescued ($MAPPED_0 second ends mapped, $MAPPED_1 with -v).";
+	exit 1
+fi
+if [ `expr $MAPPED_1 - $MAPPED_0` -ne `expr $CORRECT_1 - $CORRECT_0` ]; then
+	echo "Mates were rescued to the wrong position ($MAPPED_0/$CORRECT_0 mapped/correct, $MAPPED_1/$CORRECT_1 with -v).";
+	exit 1
+fi
+
+# Test passed!
+echo "      Mates rescued.";
+exit 0
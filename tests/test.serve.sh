@@ -0,0 +1,94 @@
+#!/bin/sh
+
+. test.definitions.sh
+
+echo "      Serving indexes.";
+
+SERVE_NAME="bfast.test.$$";
+SERVE_LOG=$TMP_DIR"serve.log";
+
+for SPACE in 0 1
+do
+	case $SPACE in
+		0) OUTPUT_ID=$OUTPUT_ID_NT;
+		;;
+		1) OUTPUT_ID=$OUTPUT_ID_CS;
+		;;
+	esac
+	echo "        Testing -A "$SPACE;
+
+	RG_FASTA=$OUTPUT_DIR$OUTPUT_ID".fa";
+	READS=$OUTPUT_DIR"reads.$OUTPUT_ID.fastq";
+
+	# Serve the reference genome and indexes, and wait until they are loaded
+	${CMD_PREFIX}bfast index-serve -f $RG_FASTA -A $SPACE -S $SERVE_NAME 2> $SERVE_LOG &
+	SERVE_PID=$!;
+	TRIES=0;
+	while ! grep -q "Serving until interrupted" $SERVE_LOG
+	do
+		TRIES=`expr $TRIES + 1`;
+		if ! kill -0 $SERVE_PID 2> /dev/null || [ "$TRIES" -gt "120" ]; then
+			kill $SERVE_PID 2> /dev/null;
+			cat $SERVE_LOG;
+			exit 1
+		fi
+		sleep 1;
+	done
+
+	# The served indexes must find the same matches as those read from disk
+	for LOAD in 0 1
+	do
+		OPTIONS="";
+		if [ "$LOAD" -eq "1" ]; then
+			OPTIONS="-l";
+		fi
+		for SERVED in 0 1
+		do
+			if [ "$SERVED" -eq "1" ]; then
+				SOURCE="-S $SERVE_NAME";
+			else
+				SOURCE="";
+			fi
+			CMD="${CMD_PREFIX}bfast match -f $RG_FASTA $SOURCE -r $READS -A $SPACE -n $NUM_THREADS -T $TMP_DIR $OPTIONS > ${OUTPUT_DIR}bfast.matches.file.serve.$SERVED.$OUTPUT_ID.bmf";
+			eval $CMD 2> /dev/null;
+			if [ "$?" -ne "0" ]; then
+				kill $SERVE_PID;
+				echo $CMD;
+				eval $CMD;
+				exit 1
+			fi
+		done
+
+		CMD="cmp ${OUTPUT_DIR}bfast.matches.file.serve.0.$OUTPUT_ID.bmf ${OUTPUT_DIR}bfast.matches.file.serve.1.$OUTPUT_ID.bmf";
+		eval $CMD;
+		if [ "$?" -ne "0" ]; then
+			kill $SERVE_PID;
+			echo $CMD;
+			exit 1
+		fi
+	done
+
+	# Shutting down the server must remove what it served
+	kill $SERVE_PID;
+	wait $SERVE_PID;
+	if [ "$?" -ne "0" ]; then
+		cat $SERVE_LOG;
+		exit 1
+	fi
+	if [ -d /dev/shm ] && [ -e /dev/shm/$SERVE_NAME ]; then
+		echo "/dev/shm/$SERVE_NAME was not removed.";
+		exit 1
+	fi
+	CMD="${CMD_PREFIX}bfast match -f $RG_FASTA -S $SERVE_NAME -r $READS -A $SPACE -n $NUM_THREADS -T $TMP_DIR > /dev/null";
+	eval $CMD 2> /dev/null;
+	if [ "$?" -eq "0" ]; then
+		echo $CMD;
+		echo "Attached to $SERVE_NAME after the server was shut down.";
+		exit 1
+	fi
+done
+rm $SERVE_LOG;
+
+# Test passed!
+echo "      Indexes served.";
+exit 0
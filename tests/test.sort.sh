@@ -0,0 +1,48 @@
+#!/bin/sh
+
+. test.definitions.sh
+
+echo "      Sorting reported reads.";
+
+TAB=`printf '\t'`;
+
+for SPACE in 0 1
+do
+	case $SPACE in
+		0) OUTPUT_ID=$OUTPUT_ID_NT;
+		;;
+		1) OUTPUT_ID=$OUTPUT_ID_CS;
+		;;
+	esac
+	echo "        Testing -A "$SPACE;
+
+	RG_FASTA=$OUTPUT_DIR$OUTPUT_ID".fa";
+	ALIGN=$OUTPUT_DIR"bfast.aligned.file.$OUTPUT_ID.baf";
+	SAM=$OUTPUT_DIR"bfast.reported.file.$OUTPUT_ID.sam";
+	SORTED=$OUTPUT_DIR"bfast.reported.file.sorted.$OUTPUT_ID.sam";
+	EXPECTED=$OUTPUT_DIR"bfast.reported.file.expected.$OUTPUT_ID.sam";
+
+	# Keep few reads in memory so that sorted runs are written to and merged from disk
+	CMD="${CMD_PREFIX}bfast postprocess -f $RG_FASTA -i $ALIGN -a 3 -n $NUM_THREADS -C -L 1 -Q 1000 -T $TMP_DIR > $SORTED";
+	eval $CMD 2> /dev/null;
+	if [ "$?" -ne "0" ]; then
+		echo $CMD;
+		eval $CMD;
+		exit 1
+	fi
+
+	# The unsorted output sorted by contig and position, unmapped last, keeping ties in order
+	(grep "^@" $SAM | sed 's/^\(@HD.*\)SO:[a-z]*/\1SO:coordinate/';
+	grep -v "^@" $SAM | awk 'BEGIN{OFS="\t"} {print ($3=="*")?1:0, $4, $0}' | sort -s -t "$TAB" -k1,1n -k2,2n | cut -f3-) > $EXPECTED;
+
+	CMD="cmp $SORTED $EXPECTED";
+	eval $CMD;
+	if [ "$?" -ne "0" ]; then
+		echo $CMD;
+		exit 1
+	fi
+done
+
+# Test passed!
+echo "      Reported reads sorted.";
+exit 0
@@ -0,0 +1,84 @@
+#!/bin/sh
+
+. test.definitions.sh
+
+echo "      Updating an index.";
+
+OUTPUT_ID=$OUTPUT_ID_NT;
+MASK="111101111011101111";
+WIDTH="8";
+DEPTH="1";
+RG_FASTA=$OUTPUT_DIR"update.$OUTPUT_ID.fa";
+RG_FASTA_FULL=$OUTPUT_DIR"update.full.$OUTPUT_ID.fa";
+READS=$OUTPUT_DIR"reads.update.$OUTPUT_ID.fastq";
+
+# Start from no index
+rm -f $RG_FASTA* $RG_FASTA_FULL*;
+
+# The new contig is the start of another genome
+cp $OUTPUT_DIR$OUTPUT_ID".fa" $RG_FASTA;
+cp $RG_FASTA $RG_FASTA_FULL;
+echo ">extra" >> $RG_FASTA_FULL;
+awk 'NR>1' $OUTPUT_DIR$OUTPUT_ID_CS".fa" | head -40 >> $RG_FASTA_FULL;
+
+# Add reads from the new contig
+cp $OUTPUT_DIR"reads.$OUTPUT_ID.fastq" $READS;
+awk 'NR>1' $OUTPUT_DIR$OUTPUT_ID_CS".fa" | head -40 | tr -d '\n' | awk '{
+	for(i=1;i+49<=length($0);i+=37) {
+		printf("@extra_%d\n%s\n+\n%s\n", i, toupper(substr($0,i,50)), "22222222222222222222222222222222222222222222222222");
+	}
+}' >> $READS;
+
+# Create the index before the new contig is added, add it with -u, and
+# create the index of the whole reference from scratch
+for STEP in 0 1 2
+do
+	echo "        Testing step "$STEP;
+	case $STEP in
+		0) FASTA=$RG_FASTA; OPTIONS="";
+		;;
+		1) FASTA=$RG_FASTA; OPTIONS="-u"; cp $RG_FASTA_FULL $RG_FASTA;
+		;;
+		2) FASTA=$RG_FASTA_FULL; OPTIONS="";
+		;;
+	esac
+
+	CMD=$CMD_PREFIX"bfast fasta2brg -f $FASTA -A 0";
+	eval $CMD 2> /dev/null;
+	if [ "$?" -ne "0" ]; then
+		echo $CMD;
+		eval $CMD;
+		exit 1
+	fi
+
+	CMD=$CMD_PREFIX"bfast index -f $FASTA -A 0 -m $MASK -w $WIDTH -d $DEPTH -i 1 -n $NUM_THREADS -T $TMP_DIR $OPTIONS";
+	eval $CMD 2> /dev/null;
+	if [ "$?" -ne "0" ]; then
+		echo $CMD;
+		eval $CMD;
+		exit 1
+	fi
+done
+
+# The updated index must find the same matches as the index made from scratch
+for FASTA in $RG_FASTA $RG_FASTA_FULL
+do
+	CMD="${CMD_PREFIX}bfast match -f $FASTA -r $READS -A 0 -n $NUM_THREADS -T $TMP_DIR > $FASTA.bmf";
+	eval $CMD 2> /dev/null;
+	if [ "$?" -ne "0" ]; then
+		echo $CMD;
+		eval $CMD;
+		exit 1
+	fi
+done
+
+CMD="cmp $RG_FASTA.bmf $RG_FASTA_FULL.bmf";
+eval $CMD;
+if [ "$?" -ne "0" ]; then
+	echo $CMD;
+	exit 1
+fi
+
+# Test passed!
+echo "      Index successfully updated.";
+exit 0